@@ -1046,6 +1046,23 @@ core.register_chatcommand("status", {
 	end,
 })
 
+core.register_chatcommand("tick_profile", {
+	params = "[chrome | collapsed]",
+	description = S("Write the timings of the last server steps to a file"),
+	privs = {server=true},
+	func = function(name, param)
+		local format = param ~= "" and param or "chrome"
+		if format ~= "chrome" and format ~= "collapsed" then
+			return false, S("Unknown format: @1", format)
+		end
+		local path, err = core.dump_tick_profile(format)
+		if not path then
+			return false, S("Failed to write tick profile: @1", err)
+		end
+		return true, S("Tick profile written to @1", path)
+	end,
+})
+
 local function get_time(timeofday)
 	local time = math.floor(timeofday * 1440)
 	local minute = time % 60
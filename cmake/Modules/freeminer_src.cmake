@@ -466,12 +466,17 @@ set(FMcommon_SRCS ${FMcommon_SRCS}
     fm_abm_world.cpp
     fm_abm.cpp
     fm_bitset.cpp
+    fm_block_delta.cpp
+    fm_cached_map_block.cpp
     fm_clientiface.cpp
+    fm_content_scan.cpp
     fm_far_calc.cpp
     fm_liquid.cpp
     fm_map.cpp
+    fm_noise_kernels.cpp
     fm_server.cpp
     fm_serverenvironment.cpp
+    fm_tick_recorder.cpp
     fm_util.cpp
     fm_world_merge.cpp
     key_value_storage.cpp
@@ -98,6 +98,41 @@ void benchGetObjectsInArea(Catch::Benchmark::Chronometer &meter)
 	mgr.clear(); // implementation expects this
 }
 
+template <size_t N>
+void benchUpdateObjectPos(Catch::Benchmark::Chronometer &meter)
+{
+	server::ActiveObjectMgr mgr;
+	fill(mgr, N);
+	std::vector<u16> ids;
+	mgr.step(0, [&ids] (const ServerActiveObjectPtr &obj) {
+		ids.push_back(obj->getId());
+	});
+	size_t i = 0;
+	meter.measure([&] {
+		// same as every moving object does once per step
+		mgr.updateObjectPos(ids[i++ % ids.size()], randpos());
+	});
+
+	mgr.clear(); // implementation expects this
+}
+
+template <size_t N>
+void benchGetAddedActiveObjectsAroundPos(Catch::Benchmark::Chronometer &meter)
+{
+	server::ActiveObjectMgr mgr;
+	fill(mgr, N);
+	const std::set<u16> current_objects;
+	std::vector<u16> added;
+	meter.measure([&] {
+		added.clear();
+		// once per player and step
+		mgr.getAddedActiveObjectsAroundPos(randpos(), "", 300.0f, 0, current_objects, added);
+		return added.size();
+	});
+
+	mgr.clear(); // implementation expects this
+}
+
 #define BENCH_INSIDE_RADIUS(_count) \
 	BENCHMARK_ADVANCED("inside_radius_" #_count)(Catch::Benchmark::Chronometer meter) \
 	{ benchGetObjectsInsideRadius<_count>(meter); };
@@ -106,14 +141,31 @@ void benchGetObjectsInArea(Catch::Benchmark::Chronometer &meter)
 	BENCHMARK_ADVANCED("in_area_" #_count)(Catch::Benchmark::Chronometer meter) \
 	{ benchGetObjectsInArea<_count>(meter); };
 
+#define BENCH_UPDATE_POS(_count) \
+	BENCHMARK_ADVANCED("update_pos_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchUpdateObjectPos<_count>(meter); };
+
+#define BENCH_ADDED_AROUND_POS(_count) \
+	BENCHMARK_ADVANCED("added_around_pos_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchGetAddedActiveObjectsAroundPos<_count>(meter); };
+
 TEST_CASE("ActiveObjectMgr") {
 	BENCH_INSIDE_RADIUS(200)
+	BENCH_INSIDE_RADIUS(1000)
 	BENCH_INSIDE_RADIUS(1450)
 	BENCH_INSIDE_RADIUS(10000)
+	BENCH_INSIDE_RADIUS(50000)
 
 	BENCH_IN_AREA(200)
 	BENCH_IN_AREA(1450)
 	BENCH_IN_AREA(10000)
-}
+	BENCH_IN_AREA(50000)
+
+	BENCH_UPDATE_POS(1000)
+	BENCH_UPDATE_POS(10000)
+	BENCH_UPDATE_POS(50000)
 
-// TODO benchmark active object manager update costs
+	BENCH_ADDED_AROUND_POS(1000)
+	BENCH_ADDED_AROUND_POS(10000)
+	BENCH_ADDED_AROUND_POS(50000)
+}
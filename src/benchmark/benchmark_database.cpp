@@ -283,6 +283,163 @@ static void benchmarkListAllBlocks(
 	};
 }
 
+// A cube of neighbouring blocks, as loaded around a player or merged to a far block
+static std::vector<v3bpos_t> generateTestArea(int index, int edge = 4)
+{
+	std::vector<v3bpos_t> area;
+	const auto base = generateTestPosition(index);
+	for (int x = 0; x < edge; ++x)
+		for (int y = 0; y < edge; ++y)
+			for (int z = 0; z < edge; ++z)
+				area.emplace_back(base.X + x, base.Y + y, base.Z + z);
+	return area;
+}
+
+// Per block calls against one saveBlocks/loadBlocks for the same area
+template <typename DatabaseFactory>
+static void benchmarkBatch(
+		DatabaseFactory factory, const std::string &db_name, size_t iterations)
+{
+	const std::string test_data = generateTestData();
+
+	BENCHMARK_ADVANCED("SaveArea_single_" + db_name)(Catch::Benchmark::Chronometer meter)
+	{
+		initialize_benchmark_environment();
+		auto db = factory();
+		if (!db) {
+			meter.measure([] { return 0; }); // Skip if database not available
+			return;
+		}
+
+		db->beginSave();
+		meter.measure([&](int i) {
+			for (const auto &pos : generateTestArea(i % iterations))
+				db->saveBlock(pos, test_data);
+			return i;
+		});
+		db->endSave();
+	};
+
+	BENCHMARK_ADVANCED("SaveArea_batch_" + db_name)(Catch::Benchmark::Chronometer meter)
+	{
+		initialize_benchmark_environment();
+		auto db = factory();
+		if (!db) {
+			meter.measure([] { return 0; }); // Skip if database not available
+			return;
+		}
+
+		std::vector<std::pair<v3bpos_t, std::string_view>> batch;
+		db->beginSave();
+		meter.measure([&](int i) {
+			batch.clear();
+			for (const auto &pos : generateTestArea(i % iterations))
+				batch.emplace_back(pos, test_data);
+			return db->saveBlocks(batch);
+		});
+		db->endSave();
+	};
+
+	const auto populate = [&](MapDatabase *db) {
+		db->beginSave();
+		for (size_t i = 0; i < iterations; ++i)
+			for (const auto &pos : generateTestArea(i))
+				db->saveBlock(pos, test_data);
+		db->endSave();
+	};
+
+	BENCHMARK_ADVANCED("LoadArea_single_" + db_name)(Catch::Benchmark::Chronometer meter)
+	{
+		initialize_benchmark_environment();
+		auto db = factory();
+		if (!db) {
+			meter.measure([] { return 0; }); // Skip if database not available
+			return;
+		}
+		populate(db.get());
+
+		std::string loaded_data;
+		meter.measure([&](int i) {
+			size_t bytes = 0;
+			for (const auto &pos : generateTestArea(i % iterations)) {
+				db->loadBlock(pos, &loaded_data);
+				bytes += loaded_data.size();
+			}
+			return bytes;
+		});
+	};
+
+	BENCHMARK_ADVANCED("LoadArea_batch_" + db_name)(Catch::Benchmark::Chronometer meter)
+	{
+		initialize_benchmark_environment();
+		auto db = factory();
+		if (!db) {
+			meter.measure([] { return 0; }); // Skip if database not available
+			return;
+		}
+		populate(db.get());
+
+		meter.measure([&](int i) {
+			size_t bytes = 0;
+			db->loadBlocks(generateTestArea(i % iterations),
+					[&](const v3bpos_t &, std::string &&block) { bytes += block.size(); });
+			return bytes;
+		});
+	};
+}
+
+#if USE_LEVELDB
+// Area of 16x16x16 blocks read from a database opened for every run, so that
+// nothing is cached, with text and Morton keys
+static void benchmarkLevelDBLayout(bool morton_keys, const std::string &name)
+{
+	constexpr bpos_t EDGE = 16;
+	const std::string db_path = g_test_directory + DIR_DELIM + "leveldb_layout_" + name;
+	fs::CreateAllDirs(db_path);
+
+	// The area and more blocks around it
+	{
+		Database_LevelDB db(db_path, morton_keys);
+		REQUIRE(db.mortonKeys() == morton_keys);
+		const std::string test_data = generateTestData();
+		std::vector<std::pair<v3bpos_t, std::string_view>> batch;
+		for (bpos_t x = -EDGE; x < 2 * EDGE; ++x)
+			for (bpos_t z = -EDGE; z < 2 * EDGE; ++z) {
+				batch.clear();
+				for (bpos_t y = -EDGE; y < 2 * EDGE; ++y)
+					batch.emplace_back(v3bpos_t(x, y, z), test_data);
+				db.saveBlocks(batch);
+			}
+	}
+
+	std::vector<v3bpos_t> area;
+	for (bpos_t x = 0; x < EDGE; ++x)
+		for (bpos_t y = 0; y < EDGE; ++y)
+			for (bpos_t z = 0; z < EDGE; ++z)
+				area.emplace_back(x, y, z);
+
+	BENCHMARK("LevelDB_area_single_" + name) {
+		Database_LevelDB db(db_path);
+		std::string block;
+		size_t bytes = 0;
+		for (const auto &pos : area) {
+			db.loadBlock(pos, &block);
+			bytes += block.size();
+		}
+		return bytes;
+	};
+
+	BENCHMARK("LevelDB_area_batch_" + name) {
+		Database_LevelDB db(db_path);
+		size_t bytes = 0;
+		db.loadBlocks(area, [&](const v3bpos_t &, std::string &&block) {
+			bytes += block.size();
+		});
+		return bytes;
+	};
+}
+#endif
+
 } // namespace
 
 TEST_CASE("benchmark_database_operations")
@@ -338,6 +495,31 @@ TEST_CASE("benchmark_database_operations")
 	}
 }
 
+TEST_CASE("benchmark_database_batch")
+{
+	const auto iterations = 100;
+
+	const auto have_postgresl = !!create_postgresql_database();
+	const auto have_redis = !!create_redis_database();
+
+	benchmarkBatch(create_dummy_database, "Dummy", iterations);
+	benchmarkBatch(create_leveldb_database, "LevelDB", iterations);
+	benchmarkBatch(create_sqlite3_database, "SQLite3", iterations);
+	if (have_postgresl)
+		benchmarkBatch(create_postgresql_database, "Postgresql", iterations);
+	if (have_redis)
+		benchmarkBatch(create_redis_database, "Redis", iterations);
+}
+
+TEST_CASE("benchmark_database_leveldb_layout")
+{
+#if USE_LEVELDB
+	initialize_benchmark_environment();
+	benchmarkLevelDBLayout(false, "text");
+	benchmarkLevelDBLayout(true, "morton");
+#endif
+}
+
 // Cleanup at the end
 TEST_CASE("benchmark_database_cleanup")
 {
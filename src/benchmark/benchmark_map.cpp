@@ -7,6 +7,10 @@
 #include "map.h"
 #include "mapsector.h"
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 namespace {
 class TestMap : public Map {
 public:
@@ -14,22 +18,11 @@ class TestMap : public Map {
 
 	MapBlock * createBlockTest(v3bpos_t p)
 	{
-		v2pos_t p2d(p.X, p.Z);
-		s16 block_y = p.Y;
-
-		MapSector *sector = getSectorNoGenerate(p2d);
-/*
-		if (!sector) {
-			sector = new MapSector(this, p2d, m_gamedef);
-			m_sectors[p2d] = sector;
-		}
-*/
-
-		MapBlock *block = sector->getBlockNoCreateNoEx(p /*block_y*/);
+		MapBlock *block = getBlockNoCreateNoEx(p);
 		if (block)
 			return block;
 
-		return sector->createBlankBlock(p).get();
+		return createBlankBlock(p).get();
 	}
 
 };
@@ -40,7 +33,7 @@ static void fillMap(TestMap &map, s16 n)
 	for(s16 z=0; z<n; z++)
 	for(s16 y=0; y<n; y++)
 	for(s16 x=0; x<n; x++) {
-		v3s16 p(x,y,z);
+		v3bpos_t p(x,y,z);
 		// create an empty block
 		map.createBlockTest(p);
 	}
@@ -105,6 +98,49 @@ static int readNodes(Map &map, s16 n)
 }
 
 
+// Readers on all threads while one thread keeps creating and erasing blocks,
+// as the Server, Env, Abm, Liquid, SendBlocks and emerge threads do
+static int readBlocksThreaded(TestMap &map, s16 n, int threads)
+{
+	std::atomic_int result = 0;
+	std::atomic_bool stop = false;
+	std::thread writer([&] {
+		for (bpos_t i = 0; !stop; i = (i + 1) % 1000) {
+			v3bpos_t p(n + 1 + i % 10, i / 100, (i / 10) % 10);
+			if (!map.m_blocks.erase(p))
+				map.createBlankBlock(p);
+		}
+	});
+	std::vector<std::thread> readers;
+	for (int t = 0; t < threads; ++t) {
+		readers.emplace_back([&] {
+			int found = 0;
+			for (int i = 0; i < n * n * n; i++) {
+				v3bpos_t p(myrand_range(0, n), myrand_range(0, n), myrand_range(0, n));
+				// no cache: measure the block container itself
+				if (map.getBlockNoCreateNoEx(p, false, true))
+					found++;
+			}
+			result += found;
+		});
+	}
+	for (auto &reader : readers)
+		reader.join();
+	stop = true;
+	writer.join();
+	return result;
+}
+
+#define BENCH_THREADS(_count, _threads) \
+	BENCHMARK_ADVANCED("readFilledThreads_" #_count "_" #_threads)(Catch::Benchmark::Chronometer meter) { \
+		DummyGameDef gamedef; \
+		TestMap map(&gamedef); \
+		fillMap(map, _count); \
+		meter.measure([&] { \
+			return readBlocksThreaded(map, _count, _threads); \
+		}); \
+	};
+
 #define BENCH1(_count) \
 	BENCHMARK_ADVANCED("create_" #_count)(Catch::Benchmark::Chronometer meter) { \
 		DummyGameDef gamedef; \
@@ -178,4 +214,9 @@ static int readNodes(Map &map, s16 n)
 TEST_CASE("benchmark_map") {
 	BENCH1(10)
 	BENCH1(40) // 64.000 blocks
+
+	BENCH_THREADS(40, 1)
+	BENCH_THREADS(40, 4)
+	BENCH_THREADS(40, 16)
+	BENCH_THREADS(40, 32)
 }
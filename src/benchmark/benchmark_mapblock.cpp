@@ -3,7 +3,9 @@
 // Copyright (C) 2023 Minetest Authors
 
 #include "catch.h"
+#include "fm_content_scan.h"
 #include "mapblock.h"
+#include <array>
 #include <vector>
 
 typedef std::vector<MapBlock*> MBContainer;
@@ -170,3 +172,87 @@ TEST_CASE("benchmark_mapblock") {
 	BENCH1(2200)
 	BENCH1(7500) // <- default client_mapblock_limit
 }
+
+// Nodes of a block: air, stone with ores, surface
+
+constexpr u32 NODES = MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE;
+
+static std::vector<MapNode> makeNodes(const std::string &kind)
+{
+	std::vector<MapNode> nodes(NODES);
+	u32 rand = 1;
+	const auto next = [&] { return (rand = rand * 1664525 + 1013904223) >> 8; };
+	for (u32 i = 0; i < NODES; i++) {
+		if (kind == "air") {
+			nodes[i] = MapNode(CONTENT_AIR, 0xff, 0);
+		} else if (kind == "stone") {
+			// stone with 3 ores and some caves
+			const u32 r = next() % 100;
+			nodes[i] = r < 4 ? MapNode(11 + r % 3) : r < 6 ? MapNode(CONTENT_AIR) : MapNode(10);
+		} else {
+			// surface: a dozen contents, varying light and param2
+			nodes[i] = MapNode(10 + next() % 12, next() % 16, next() % 4);
+		}
+	}
+	return nodes;
+}
+
+// Finding trigger contents, per node against content_scan (fm_content_scan.h)
+
+static u32 triggersPerNode(const MapNode *nodes, const std::vector<bool> &active)
+{
+	u32 found = 0;
+	for (u32 i = 0; i < NODES; i++)
+		found += active[nodes[i].getContent()];
+	return found;
+}
+
+// contents of the block are cached until it is modified, see MapBlock::getContents
+static std::vector<content_t> activeContents(
+		const MapNode *nodes, const std::vector<bool> &active)
+{
+	std::vector<content_t> contents;
+	content_scan::collect(nodes, NODES, contents);
+	std::erase_if(contents, [&](content_t c) { return !active[c]; });
+	return contents;
+}
+
+static u32 triggersScan(const MapNode *nodes, const std::vector<content_t> &contents)
+{
+	if (contents.empty())
+		return 0;
+	std::array<uint64_t, NODES / 64> where;
+	content_scan::match(nodes, NODES, contents.data(), contents.size(),
+			where.data());
+	u32 found = 0;
+	for (const auto w : where)
+		found += __builtin_popcountll(w);
+	return found;
+}
+
+#define BENCH_CONTENT_SCAN(_kind) \
+	{ \
+		const auto nodes = makeNodes(_kind); \
+		std::vector<bool> active(CONTENT_ID_CAPACITY); \
+		active[11] = active[12] = true; \
+		const auto contents = activeContents(nodes.data(), active); \
+		REQUIRE(triggersPerNode(nodes.data(), active) == triggersScan(nodes.data(), contents)); \
+		BENCHMARK("triggers_per_node_" _kind) { \
+			return triggersPerNode(nodes.data(), active); \
+		}; \
+		BENCHMARK("triggers_content_scan_" _kind) { \
+			return triggersScan(nodes.data(), contents); \
+		}; \
+		std::vector<content_t> collected; \
+		BENCHMARK("collect_contents_" _kind) { \
+			content_scan::collect(nodes.data(), nodes.size(), collected); \
+			return collected.size(); \
+		}; \
+	}
+
+TEST_CASE("benchmark_mapblock_content_scan") {
+	WARN("content_scan: " << content_scan::implementation());
+	BENCH_CONTENT_SCAN("air")
+	BENCH_CONTENT_SCAN("stone")
+	BENCH_CONTENT_SCAN("surface")
+}
@@ -0,0 +1,137 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "mapgen/mapgen.h"
+#include "mapgen/mapgen_math_fractal.h"
+#include "noise.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+// One mapgen chunk
+const v3pos_t chunk_min(0, -40, 0), chunk_max(79, 39, 79);
+constexpr pos_t STEP = 8;
+
+// MapgenMath density: a menger sponge scaled so the chunk crosses its surface
+double math_value(const v3pos_t &p)
+{
+	const double s = 1.0 / 3000;
+	return mapgen_math::mengersponge(
+			p.X * s + 0.31, p.Y * s + 0.55, p.Z * s + 0.12, s, 13);
+}
+
+bool math_solid(double d)
+{
+	return d > 0;
+}
+
+// MapgenEarth density: a height map lookup per column, noise stands in for hgt
+const NoiseParams np_height(0, 30, v3f(200, 200, 200), 4242, 4, 0.5, 2.0);
+
+pos_t earth_height(pos_t x, pos_t z)
+{
+	return NoiseFractal2D(&np_height, x, z, 1);
+}
+
+template <typename T, typename Value, typename Solid>
+u32 count_solid(Value &&value, Solid &&solid)
+{
+	u32 count = 0;
+	for (pos_t z = chunk_min.Z; z <= chunk_max.Z; ++z)
+		for (pos_t y = chunk_min.Y; y <= chunk_max.Y; ++y)
+			for (pos_t x = chunk_min.X; x <= chunk_max.X; ++x)
+				count += solid((T)value(v3pos_t(x, y, z)));
+	return count;
+}
+
+template <typename T, typename Solid>
+u32 count_solid(const AdaptiveSampler<T> &sampler, Solid &&solid)
+{
+	return count_solid<T>([&](const v3pos_t &p) { return sampler.get(p); }, solid);
+}
+
+// Nodes that the sampler got wrong
+template <typename T, typename Value, typename Solid>
+u32 count_wrong(const AdaptiveSampler<T> &sampler, Value &&value, Solid &&solid)
+{
+	return count_solid<T>([&](const v3pos_t &p) {
+		return (T)(solid(sampler.get(p)) != solid((T)value(p)));
+	}, [](T wrong) { return wrong != 0; });
+}
+
+}
+
+TEST_CASE("benchmark_mapgen_sampling")
+{
+	const u32 volume = 80 * 80 * 80;
+
+	// Math: every node against the coarse lattice
+	{
+		AdaptiveSampler<double> sampler;
+		sampler.sample(chunk_min, chunk_max, STEP, math_value, math_solid);
+		const u32 solid = count_solid<double>(math_value, math_solid);
+		CHECK(solid > 0);
+		CHECK(solid < volume);
+		CHECK(sampler.evaluated < volume / 2);
+		// Fractal detail below the lattice step is lost, but not much
+		CHECK(count_wrong(sampler, math_value, math_solid) < volume / 100);
+
+		BENCHMARK("math_full", i) {
+			return count_solid<double>(math_value, math_solid);
+		};
+
+		BENCHMARK("math_adaptive", i) {
+			sampler.sample(chunk_min, chunk_max, STEP, math_value, math_solid);
+			return sampler.evaluated;
+		};
+	}
+
+	// Earth: on the surface every column is needed, above it only the lattice
+	for (const pos_t y0 : {-40, 40}) {
+		const v3pos_t min(chunk_min.X, y0, chunk_min.Z);
+		const v3pos_t max(chunk_max.X, y0 + 79, chunk_max.Z);
+		const std::string name = y0 < 0 ? "surface" : "above";
+
+		std::vector<pos_t> heights(80 * 80);
+		std::vector<bool> have_height(heights.size());
+		const auto value = [&](const v3pos_t &p) {
+			const size_t n = p.Z * 80 + p.X;
+			if (!have_height[n]) {
+				heights[n] = earth_height(p.X, p.Z);
+				have_height[n] = true;
+			}
+			return (float)(heights[n] - p.Y);
+		};
+		const auto solid = [](float v) { return v >= 0; };
+		const auto lookups = [&] {
+			u32 count = 0;
+			for (bool have : have_height)
+				count += have;
+			return count;
+		};
+
+		AdaptiveSampler<float> sampler;
+		sampler.sample(min, max, STEP, value, solid);
+		if (y0 > 0)
+			CHECK(lookups() < heights.size() / 10);
+
+		BENCHMARK("earth_full_" + name, i) {
+			u32 count = 0;
+			for (pos_t z = min.Z; z <= max.Z; ++z)
+				for (pos_t x = min.X; x <= max.X; ++x) {
+					const pos_t height = earth_height(x, z);
+					for (pos_t y = min.Y; y <= max.Y; ++y)
+						count += height >= y;
+				}
+			return count;
+		};
+
+		BENCHMARK("earth_adaptive_" + name, i) {
+			have_height.assign(have_height.size(), false);
+			sampler.sample(min, max, STEP, value, solid);
+			return lookups();
+		};
+	}
+}
@@ -0,0 +1,226 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "catch.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "irr_v3d.h"
+#include "threading/coalescing_priority_queue.h"
+#include "threading/mpmc_queue.h"
+
+// Enqueue to result latency of the mesh update queues: one game thread queues
+// blocks around the player (with duplicates, like neighbour updates do)
+// while workers pop, "mesh" and return results which the game thread collects.
+
+namespace
+{
+using clock_type = std::chrono::steady_clock;
+
+struct update
+{
+	v3bpos_t p;
+	clock_type::time_point queued;
+};
+
+struct result
+{
+	v3bpos_t p;
+	clock_type::time_point queued;
+};
+
+void make_mesh()
+{
+	// a few microseconds of work
+	volatile uint32_t x = 0;
+	for (int i = 0; i < 2000; ++i)
+		x = x * 1664525 + 1013904223;
+}
+
+std::vector<v3bpos_t> make_positions(size_t count)
+{
+	std::vector<v3bpos_t> positions;
+	for (bpos_t r = 0; positions.size() < count; ++r)
+		for (bpos_t x = -r; x <= r && positions.size() < count; ++x)
+			for (bpos_t z = -r; z <= r && positions.size() < count; ++z)
+				positions.emplace_back(x, r % 8, z);
+	return positions;
+}
+
+// Layout of MeshUpdateQueue before: one mutex, linear search for duplicates
+class mutex_mesh_queue
+{
+public:
+	bool add(const v3bpos_t &p)
+	{
+		const auto lock = std::lock_guard(m_mutex);
+		for (const auto *u : m_queue)
+			if (u->p == p)
+				return false;
+		m_queue.emplace_back(new update{p, clock_type::now()});
+		return true;
+	}
+
+	update *pop()
+	{
+		const auto lock = std::lock_guard(m_mutex);
+		for (auto it = m_queue.begin(); it != m_queue.end(); ++it) {
+			if (m_inflight.count((*it)->p))
+				continue;
+			auto *u = *it;
+			m_queue.erase(it);
+			m_inflight.insert(u->p);
+			return u;
+		}
+		return nullptr;
+	}
+
+	void done(const v3bpos_t &p)
+	{
+		const auto lock = std::lock_guard(m_mutex);
+		m_inflight.erase(p);
+	}
+
+private:
+	std::mutex m_mutex;
+	std::vector<update *> m_queue;
+	std::unordered_set<v3bpos_t> m_inflight;
+};
+
+// MeshUpdateQueue needs a Client, this makes the same queue calls:
+// buckets by distance to the player, merge of a queued mesh, drop of a mesh
+// made while another thread queued it, done() after meshing
+class lockfree_mesh_queue
+{
+public:
+	static constexpr size_t BUCKETS = 16;
+	static constexpr bpos_t BUCKET_BLOCKS = 4;
+
+	bool add(const v3bpos_t &p)
+	{
+		return m_queue.add(
+				p, 1 + p.getDistanceFrom({}) / BUCKET_BLOCKS,
+				[&] { return new update{p, clock_type::now()}; },
+				[](update *) { return false; }, [](update *u) { delete u; });
+	}
+
+	update *pop()
+	{
+		update *u = nullptr;
+		m_queue.pop(u);
+		return u;
+	}
+
+	void done(const v3bpos_t &p) { m_queue.done(p); }
+
+private:
+	coalescing_priority_queue<v3bpos_t, update *, BUCKETS> m_queue;
+};
+
+template <class Queue>
+class mesh_pipeline
+{
+public:
+	explicit mesh_pipeline(size_t workers)
+	{
+		for (size_t i = 0; i < workers; ++i)
+			m_workers.emplace_back([this] { work(); });
+	}
+
+	~mesh_pipeline()
+	{
+		m_stop = true;
+		for (auto &worker : m_workers)
+			worker.join();
+	}
+
+	// Queue all positions (twice, second time as neighbour updates),
+	// returns mean enqueue to result latency in us after all results arrived
+	double run(const std::vector<v3bpos_t> &positions)
+	{
+		size_t queued = 0;
+		for (const auto &p : positions)
+			queued += m_queue.add(p);
+		for (const auto &p : positions)
+			queued += m_queue.add(p);
+
+		size_t received = 0;
+		double latency_us = 0;
+		while (received < queued) {
+			result r;
+			if (!m_results.try_pop(r)) {
+				std::this_thread::yield();
+				continue;
+			}
+			++received;
+			latency_us += std::chrono::duration<double, std::micro>(
+					clock_type::now() - r.queued)
+								  .count();
+		}
+		return latency_us / received;
+	}
+
+private:
+	void work()
+	{
+		while (!m_stop) {
+			auto *u = m_queue.pop();
+			if (!u) {
+				std::this_thread::yield();
+				continue;
+			}
+			make_mesh();
+			m_results.push(result{u->p, u->queued});
+			m_queue.done(u->p);
+			delete u;
+		}
+	}
+
+	Queue m_queue;
+	mpmc_queue<result, 1024> m_results;
+	std::atomic_bool m_stop{false};
+	std::vector<std::thread> m_workers;
+};
+
+template <class Queue>
+void bench_pipeline(const char *name, size_t workers, size_t blocks)
+{
+	const auto positions = make_positions(blocks);
+	mesh_pipeline<Queue> pipeline(workers);
+	BENCHMARK(name)
+	{
+		return pipeline.run(positions);
+	};
+}
+}
+
+TEST_CASE("benchmark_mesh_queue")
+{
+	constexpr size_t blocks = 2000;
+	for (const size_t workers : {4, 8, 16}) {
+		const auto suffix = std::to_string(workers) + "_workers";
+		bench_pipeline<mutex_mesh_queue>(
+				("mutex_enqueue_to_result_" + suffix).c_str(), workers, blocks);
+		bench_pipeline<lockfree_mesh_queue>(
+				("lockfree_enqueue_to_result_" + suffix).c_str(), workers, blocks);
+	}
+}
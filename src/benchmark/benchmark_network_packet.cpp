@@ -0,0 +1,130 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "catch.h"
+
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <string>
+#include "network/fm_packet_buffer.h"
+#include "network/networkpacket.h"
+
+// A packet broadcast to 100 peers (chat message, time of day): every peer
+// got its own copy of the wire form before, now the peers share one buffer.
+// The send queue of each peer holds its buffer until a few packets later.
+
+namespace
+{
+constexpr size_t PEERS = 100;
+constexpr size_t QUEUE = 8;
+constexpr size_t COUNTED_BROADCASTS = 100;
+
+// Heap allocations of this thread while counting, see operator new below
+thread_local bool t_count_allocations = false;
+thread_local size_t t_allocations = 0;
+
+// Mean heap allocations of one call of f
+template <class F>
+double count_allocations(F &&f)
+{
+	t_allocations = 0;
+	t_count_allocations = true;
+	for (size_t i = 0; i < COUNTED_BROADCASTS; ++i)
+		f();
+	t_count_allocations = false;
+	return double(t_allocations) / COUNTED_BROADCASTS;
+}
+
+NetworkPacket make_packet(size_t size)
+{
+	NetworkPacket pkt(TOCLIENT_CHAT_MESSAGE, size, 1);
+	pkt << std::string(size - 2, 'x');
+	return pkt;
+}
+
+template <class Buffer>
+struct peer_queues
+{
+	std::vector<std::deque<Buffer>> queues{PEERS};
+
+	void push(size_t peer, Buffer &&buffer)
+	{
+		auto &queue = queues[peer];
+		queue.emplace_back(std::move(buffer));
+		if (queue.size() > QUEUE)
+			queue.pop_front();
+	}
+};
+}
+
+// Replaced for the allocation counts. Benchmarks are not in release builds,
+// the rest of the program only pays a thread-local test per allocation.
+void *operator new(std::size_t size)
+{
+	if (t_count_allocations)
+		++t_allocations;
+	if (void *p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+// copy: oldForgePacket() and the SharedBuffer of the send queue (data, refcount).
+// Allocations are counted the same way for both, after the benchmark filled
+// the queues, with the packet itself.
+#define BENCH_BROADCAST(_size) \
+	{ \
+		peer_queues<SharedBuffer<u8>> copies; \
+		const auto broadcast_copy = [&] { \
+			auto pkt = make_packet(_size); \
+			for (size_t peer = 0; peer < PEERS; ++peer) \
+				copies.push(peer, SharedBuffer<u8>(pkt.oldForgePacket())); \
+		}; \
+		BENCHMARK("broadcast_copy_" #_size) { broadcast_copy(); }; \
+		peer_queues<packet_buffer> shared; \
+		const auto broadcast_shared = [&] { \
+			auto pkt = make_packet(_size); \
+			for (size_t peer = 0; peer < PEERS; ++peer) \
+				shared.push(peer, packet_buffer(pkt.forge())); \
+		}; \
+		BENCHMARK("broadcast_shared_" #_size) { broadcast_shared(); }; \
+		auto &pool = packet_buffer_pool::instance(); \
+		const auto reuses = pool.reuses(); \
+		const double copy = count_allocations(broadcast_copy); \
+		const double shared_count = count_allocations(broadcast_shared); \
+		CHECK(shared_count < copy); \
+		WARN("heap allocations per broadcast of " #_size " B: copy " << copy \
+				<< ", shared " << shared_count << " (pool reuses " \
+				<< double(pool.reuses() - reuses) / COUNTED_BROADCASTS << ")"); \
+	}
+
+TEST_CASE("benchmark_network_packet")
+{
+	BENCH_BROADCAST(64)
+	BENCH_BROADCAST(1000)
+	BENCH_BROADCAST(16000)
+}
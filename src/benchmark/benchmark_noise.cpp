@@ -0,0 +1,84 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "fm_noise_kernels.h"
+#include "noise.h"
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Chunk sized maps as in mapgen: 80x80 columns, 80x82x80 volumes
+constexpr u32 CSIZE = 80;
+
+// Eased 2D terrain noise like MapgenV7
+const NoiseParams np_terrain(4, 70, v3f(600, 600, 600), 82341, 5, 0.6, 2.0);
+// Absolute value 3D noise like cave and ridge noises
+const NoiseParams np_cave(0, 12, v3f(96, 96, 96), 52534, 4, 0.5, 2.0,
+		NOISE_FLAG_EASED | NOISE_FLAG_ABSVALUE);
+
+std::vector<float> map2d(const char *kernels, const float *persistence = nullptr)
+{
+	REQUIRE(noise_kernels::use(kernels));
+	Noise noise(&np_terrain, 1234, CSIZE, CSIZE);
+	const float *result = noise.noiseMap2D(-1234.5f, 4321.25f, const_cast<float *>(persistence));
+	std::vector<float> out(result, result + CSIZE * CSIZE);
+	noise_kernels::use(nullptr);
+	return out;
+}
+
+std::vector<float> map3d(const char *kernels)
+{
+	REQUIRE(noise_kernels::use(kernels));
+	Noise noise(&np_cave, 1234, CSIZE, CSIZE + 2, CSIZE);
+	const float *result = noise.noiseMap3D(-1234.5f, -81.f, 4321.25f);
+	std::vector<float> out(result, result + CSIZE * (CSIZE + 2) * CSIZE);
+	noise_kernels::use(nullptr);
+	return out;
+}
+
+// Same operations in the same order: bit-for-bit, unless the compiler
+// contracts the scalar reference into FMA (see fm_noise_kernels.h)
+bool same(const std::vector<float> &a, const std::vector<float> &b)
+{
+	return a.size() == b.size() &&
+			!std::memcmp(a.data(), b.data(), a.size() * sizeof(float));
+}
+
+}
+
+TEST_CASE("benchmark_noise")
+{
+	std::vector<float> persistence(CSIZE * CSIZE);
+	for (size_t i = 0; i < persistence.size(); ++i)
+		persistence[i] = 0.4f + (i % 7) * 0.05f;
+
+	const auto ref2d = map2d("scalar");
+	const auto ref2d_persist = map2d("scalar", persistence.data());
+	const auto ref3d = map3d("scalar");
+
+	for (const char *kernels : {"scalar", "sse4.1", "avx2"}) {
+		if (!noise_kernels::use(kernels))
+			continue;
+		noise_kernels::use(nullptr);
+		const std::string name = kernels;
+
+		CHECK(same(map2d(kernels), ref2d));
+		CHECK(same(map2d(kernels, persistence.data()), ref2d_persist));
+		CHECK(same(map3d(kernels), ref3d));
+
+		noise_kernels::use(kernels);
+		Noise noise2d(&np_terrain, 1234, CSIZE, CSIZE);
+		Noise noise3d(&np_cave, 1234, CSIZE, CSIZE + 2, CSIZE);
+
+		BENCHMARK("noiseMap2D_" + name, i) {
+			return noise2d.noiseMap2D(i * 80.f, 0)[i % (CSIZE * CSIZE)];
+		};
+
+		BENCHMARK("noiseMap3D_" + name, i) {
+			return noise3d.noiseMap3D(i * 80.f, 0, 0)[i % (CSIZE * CSIZE)];
+		};
+		noise_kernels::use(nullptr);
+	}
+}
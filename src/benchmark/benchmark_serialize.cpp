@@ -3,9 +3,13 @@
 // Copyright (C) 2022 Minetest Authors
 
 #include "catch.h"
+#include "noise.h"
+#include "serialization.h"
 #include "util/serialize.h"
+#include <chrono>
 #include <sstream>
 #include <ios>
+#include <vector>
 
 // Builds a string of exactly `length` characters by repeating `s` (rest cut off)
 static std::string makeRepeatTo(const std::string &s, size_t length)
@@ -54,3 +58,117 @@ static std::string makeRepeatTo(const std::string &s, size_t length)
 TEST_CASE("benchmark_serialize") {
 	BENCH_ALL()
 }
+
+// Map block compression with a zstd dictionary (map_zstd_dictionary)
+
+// Something like an uncompressed version 29 map block: mapping, terrain
+// around a surface, light
+static std::string makeBlockLikeData(u32 seed)
+{
+	PseudoRandom pr(seed);
+	std::ostringstream os(std::ios::binary);
+	writeU8(os, 0x08);
+	writeU16(os, 0xffff);
+	writeU32(os, pr.next());
+	writeU8(os, 0);
+	const char *names[] = {"air", "default:stone", "default:dirt", "default:dirt_with_grass",
+			"default:stone_with_coal", "default:water_source", "default:sand",
+			"default:gravel"};
+	const u16 count = pr.range(4, 8);
+	writeU16(os, count);
+	for (u16 i = 0; i < count; i++) {
+		writeU16(os, i);
+		os << serializeString16(names[i]);
+	}
+	writeU8(os, 2);
+	writeU8(os, 2);
+	const int surface = pr.range(-4, 20);
+	std::string param1;
+	for (int i = 0; i < 4096; i++) {
+		const int y = i / 16 % 16 + (i % 16 + i / 256) / 8;
+		u16 c = y > surface ? 0 : y == surface ? 3 : y > surface - 3 ? 2 : 1;
+		if (c == 1 && count > 4 && pr.range(0, 30) == 0)
+			c = 4;
+		writeU16(os, c);
+		param1 += char(y > surface ? 0xff - std::min(15, y - surface) : 0);
+	}
+	os << param1;
+	for (int i = 0; i < 4096; i++)
+		writeU8(os, 0);
+	writeU8(os, 0);
+	writeU8(os, 0);
+	writeU16(os, 0);
+	writeU8(os, 10);
+	writeU16(os, 0);
+	return os.str();
+}
+
+TEST_CASE("benchmark_serialize_zstd_dictionary") {
+	std::vector<std::string> samples;
+	for (u32 i = 0; i < 1000; i++)
+		samples.emplace_back(makeBlockLikeData(i));
+	const auto dictionary = trainZstdDictionary(samples);
+	REQUIRE(!dictionary.empty());
+	const u32 id = addZstdDictionary(dictionary);
+	REQUIRE(id != 0);
+
+	// other blocks than the trained ones
+	std::vector<std::string> blocks;
+	for (u32 i = 0; i < 256; i++)
+		blocks.emplace_back(makeBlockLikeData(100000 + i));
+
+	const auto compressAll = [&](u32 dict, std::vector<std::string> &out) {
+		out.clear();
+		for (const auto &block : blocks) {
+			std::ostringstream os(std::ios::binary);
+			compress(block, os, 29, -1, dict);
+			out.emplace_back(os.str());
+		}
+	};
+	const auto decompressAll = [&](const std::vector<std::string> &in) {
+		size_t size = 0;
+		for (const auto &data : in) {
+			std::istringstream is(data, std::ios::binary);
+			std::ostringstream os(std::ios::binary);
+			decompress(is, os, 29);
+			size += os.tellp();
+		}
+		return size;
+	};
+
+	size_t raw = 0;
+	for (const auto &block : blocks)
+		raw += block.size();
+	for (const u32 dict : {0u, id}) {
+		std::vector<std::string> compressed;
+		const auto start = std::chrono::steady_clock::now();
+		compressAll(dict, compressed);
+		const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - start).count();
+		size_t size = 0;
+		for (const auto &data : compressed)
+			size += data.size();
+		WARN((dict ? "dictionary" : "plain") << ": " << blocks.size() << " blocks, "
+				<< raw << " -> " << size << " bytes, ratio " << double(raw) / size
+				<< ", compress " << us << " us");
+	}
+
+	std::vector<std::string> compressed;
+	BENCHMARK("compress_plain") {
+		compressAll(0, compressed);
+		return compressed.size();
+	};
+	BENCHMARK("decompress_plain") {
+		return decompressAll(compressed);
+	};
+	BENCHMARK("compress_dictionary") {
+		compressAll(id, compressed);
+		return compressed.size();
+	};
+	BENCHMARK("decompress_dictionary") {
+		return decompressAll(compressed);
+	};
+	BENCHMARK("train_dictionary") {
+		return trainZstdDictionary(samples).size();
+	};
+}
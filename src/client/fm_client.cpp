@@ -20,6 +20,7 @@
 #include "network/fm_networkprotocol.h"
 #include "network/networkpacket.h"
 #include "profiler.h"
+#include "serialization.h"
 #include "server.h"
 #include "threading/lock.h"
 #include "util/directiontables.h"
@@ -128,6 +129,14 @@ void Client::handleCommand_FreeminerInit(NetworkPacket *pkt)
 		packet[TOCLIENT_INIT_WEATHER].convert(use_weather);
 	}
 
+	if (packet.contains(TOCLIENT_INIT_MAP_ZSTD_DICTIONARY)) {
+		std::string dictionary;
+		packet[TOCLIENT_INIT_MAP_ZSTD_DICTIONARY].convert(dictionary);
+		if (!addZstdDictionary(dictionary))
+			errorstream << "Client: Invalid map zstd dictionary of "
+						<< dictionary.size() << " bytes" << std::endl;
+	}
+
 	//if (packet.count(TOCLIENT_INIT_PROTOCOL_VERSION_FM))
 	//	packet[TOCLIENT_INIT_PROTOCOL_VERSION_FM].convert( not used );
 }
@@ -243,6 +252,8 @@ void Client::handleCommand_BlockDatasFm(NetworkPacket *pkt)
 		if (obj.type == msgpack::type::ARRAY) {
 			auto blocks_array = obj.as<std::vector<msgpack::object>>();
 
+			// Near blocks are acked like TOCLIENT_BLOCKDATA
+			std::vector<v3bpos_t> blocks_to_ack;
 			for (const auto &block_obj : blocks_array) {
 				if (block_obj.type == msgpack::type::MAP) {
 					MsgpackPacket block_packet = block_obj.as<MsgpackPacket>();
@@ -251,8 +262,21 @@ void Client::handleCommand_BlockDatasFm(NetworkPacket *pkt)
 
 					// Process each block in the array
 					processSingleBlockData(block_packet_safe);
+
+					block_step_t step = 0;
+					block_packet_safe.convert_safe(TOCLIENT_BLOCKDATA_STEP, step);
+					if (!step) {
+						blocks_to_ack.emplace_back(
+								block_packet_safe[TOCLIENT_BLOCKDATA_POS].as<v3bpos_t>());
+					}
+					if (blocks_to_ack.size() == 255) {
+						sendGotBlocks(blocks_to_ack);
+						blocks_to_ack.clear();
+					}
 				}
 			}
+			if (!blocks_to_ack.empty())
+				sendGotBlocks(blocks_to_ack);
 		}
 	} else {
 		// Handle single block (legacy compatibility)
@@ -268,8 +292,43 @@ void Client::processSingleBlockData(MsgpackPacketSafe &packet)
 	std::istringstream istr(
 			packet[TOCLIENT_BLOCKDATA_DATA].as<std::string>(), std::ios_base::binary);
 
+	uint64_t version = 0;
+	packet.convert_safe(TOCLIENT_BLOCKDATA_VERSION, version);
+	uint64_t delta_base = 0;
+	packet.convert_safe(TOCLIENT_BLOCKDATA_DELTA_BASE, delta_base);
+
 	MapBlockPtr block{};
-	if (step) {
+	if (delta_base) {
+		// Changes of a block we have, else ask for the whole block
+		block = m_env.getMap().getBlock(bpos);
+		bool applied = false;
+		if (block) {
+			const auto lock = block->lock_unique_rec();
+			if (block->net_version == delta_base) {
+				try {
+					block->deSerializeDelta(istr, m_server_ser_ver);
+					weather::heat_t heat = 0;
+					packet.convert_safe(TOCLIENT_BLOCKDATA_HEAT, heat);
+					block->heat = heat;
+					weather::humidity_t humidity = 0;
+					packet.convert_safe(TOCLIENT_BLOCKDATA_HUMIDITY, humidity);
+					block->humidity = humidity;
+					block->net_version = version;
+					applied = true;
+				} catch (const std::exception &ex) {
+					errorstream << "fm block delta deSerialize fail " << bpos << " : "
+								<< ex.what() << "\n";
+				}
+			}
+		}
+		if (!applied) {
+			if (block)
+				block->net_version = 0;
+			std::vector<v3bpos_t> deleted{bpos};
+			sendDeletedBlocks(deleted);
+			return;
+		}
+	} else if (step) {
 		auto &far_blocks_storage = getEnv().getClientMap().far_blocks_storage[step];
 		const auto lock = far_blocks_storage.lock_unique_rec();
 		if (const auto it = far_blocks_storage.find(bpos);
@@ -287,9 +346,10 @@ void Client::processSingleBlockData(MsgpackPacketSafe &packet)
 			block = m_env.getMap().createBlankBlock(bpos);
 		}
 	}
-	{
+	if (!delta_base) {
 		const auto lock = block->lock_unique_rec();
 		block->far_step = step;
+		block->net_version = 0;
 
 		content_t content_only{CONTENT_IGNORE};
 		packet.convert_safe(TOCLIENT_BLOCKDATA_CONTENT_ONLY, content_only);
@@ -327,6 +387,7 @@ void Client::processSingleBlockData(MsgpackPacketSafe &packet)
 		weather::humidity_t humidity = 0;
 		packet[TOCLIENT_BLOCKDATA_HUMIDITY].convert(humidity);
 		block->humidity = humidity;
+		block->net_version = version;
 	}
 
 	mesh_thread_pool.enqueue([this, block, bpos, step]() {
@@ -117,56 +117,73 @@ bool MeshUpdateQueue::addBlock(Map *map, v3bpos_t p, bool ack_block_to_server,
 	// (where all coordinate are divisible by the chunk size)
 	const auto mesh_position = mesh_grid.getMeshPos(p);
 
-	MutexAutoLock lock(m_mutex);
+	const auto crack_level = m_client->getCrackLevel();
+	const auto crack_pos = m_client->getCrackPos();
 
 	/*
-		Mark the block as urgent if requested
+		Urgent updates go first, others nearest to the player first
 	*/
-	if (urgent)
-		m_urgents.insert(mesh_position);
-
-	/*
-		Find if block is already in queue.
-		If it is, update the data and quit.
-	*/
-	for (QueuedMeshUpdate *q : m_queue) {
-		if (q->p == mesh_position) {
-			if (ack_block_to_server)
-				q->ack_list.push_back(p);
-			q->crack_level = m_client->getCrackLevel();
-			q->crack_pos = m_client->getCrackPos();
-			q->urgent |= urgent;
-			q->retrieveBlocks(map, mesh_grid.cell_size);
-			return true;
-		}
+	size_t bucket = 0;
+	if (!urgent) {
+		const auto *player = m_client->getEnv().getLocalPlayer();
+		const auto player_pos = player
+				? getNodeBlockPos(floatToInt(player->getPosition(), BS))
+				: mesh_position;
+		bucket = 1 + player_pos.getDistanceFrom(mesh_position) / BUCKET_BLOCKS;
 	}
 
-	/*
-		Grab the relevant blocks first
-	*/
-	UnqueuedMeshUpdate q{new QueuedMeshUpdate()};
-	q->p = mesh_position;
-	if (ack_block_to_server)
-		q->ack_list.push_back(p);
-	q->crack_level = m_client->getCrackLevel();
-	q->crack_pos = m_client->getCrackPos();
-	q->urgent = urgent;
-	q->retrieveBlocks(map, mesh_grid.cell_size);
-
-	/*
-		Air blocks won't suddenly become visible due to a neighbor update, so
-		skip those.
-		Note: this can be extended with more precise checks in the future
-	*/
-	if (from_neighbor && q->checkSkip(mesh_grid.cell_size)) {
-		assert(!ack_block_to_server);
-		m_urgents.erase(mesh_position);
+	bool skipped = false;
+	m_queue.add(mesh_position, bucket,
+			[&]() -> QueuedMeshUpdate * {
+				/*
+					Grab the relevant blocks first
+				*/
+				UnqueuedMeshUpdate q{new QueuedMeshUpdate()};
+				q->p = mesh_position;
+				if (ack_block_to_server)
+					q->ack_list.push_back(p);
+				q->crack_level = crack_level;
+				q->crack_pos = crack_pos;
+				q->urgent = urgent;
+				q->retrieveBlocks(map, mesh_grid.cell_size);
+
+				/*
+					Air blocks won't suddenly become visible due to a neighbor update, so
+					skip those.
+					Note: this can be extended with more precise checks in the future
+				*/
+				if (from_neighbor && q->checkSkip(mesh_grid.cell_size)) {
+					assert(!ack_block_to_server);
+					skipped = true;
+					return nullptr;
+				}
+
+				// Put into queue, pointer moved from `q`.
+				return q.release();
+			},
+			/*
+				Block is already in queue, update the data.
+			*/
+			[&](QueuedMeshUpdate *q) {
+				if (ack_block_to_server)
+					q->ack_list.push_back(p);
+				q->crack_level = crack_level;
+				q->crack_pos = crack_pos;
+				q->retrieveBlocks(map, mesh_grid.cell_size);
+				// Became urgent: jump the queue, e.g. neighbours of a dug node
+				const bool raise = urgent && !q->urgent;
+				q->urgent |= urgent;
+				return raise;
+			},
+			/*
+				Queued by another thread meanwhile, merged above.
+			*/
+			[](QueuedMeshUpdate *q) {
+				DroppingDeleter{}(q);
+			});
+
+	if (skipped)
 		g_profiler->add("MeshUpdateQueue: updates skipped", 1);
-		return true;
-	}
-
-	// Put into queue, pointer moved from `q`.
-	m_queue.push_back(q.release());
 
 	return true;
 }
@@ -176,54 +193,32 @@ bool MeshUpdateQueue::addBlock(Map *map, v3bpos_t p, bool ack_block_to_server,
 QueuedMeshUpdate *MeshUpdateQueue::pop()
 {
 	QueuedMeshUpdate *result = nullptr;
-	{
-		MutexAutoLock lock(m_mutex);
-
-		bool must_be_urgent = !m_urgents.empty();
-		for (auto i = m_queue.begin(); i != m_queue.end(); ++i) {
-			QueuedMeshUpdate *q = *i;
-			if (must_be_urgent && m_urgents.count(q->p) == 0)
-				continue;
-			// Make sure no two threads are processing the same mapblock, as that causes racing conditions
-			if (m_inflight_blocks.find(q->p) != m_inflight_blocks.end())
-				continue;
-			m_queue.erase(i);
-			m_urgents.erase(q->p);
-			m_inflight_blocks.insert(q->p);
-			result = q;
-			break;
-		}
-	}
+	// No two threads process the same mapblock, as that causes racing conditions:
+	// the position is not popped again until done()
+	if (!m_queue.pop(result))
+		return nullptr;
 
-	if (result)
-		fillDataFromMapBlocks(result);
+	fillDataFromMapBlocks(result);
 
 	return result;
 }
 
 void MeshUpdateQueue::done(v3bpos_t pos)
 {
-	MutexAutoLock lock(m_mutex);
-	m_inflight_blocks.erase(pos);
+	m_queue.done(pos);
 }
 
 void MeshUpdateQueue::clear(bool finish)
 {
-	MutexAutoLock lock(m_mutex);
-	decltype(m_queue) new_queue;
-	for (auto *it : m_queue) {
+	m_queue.filter([&](QueuedMeshUpdate *it) {
 		// If we're in an active game session clearing updates that the
 		// server expects us to ack will cause problems.
-		if (it->ack_list.empty() || finish) {
-			m_urgents.erase(it->p);
-			m_inflight_blocks.erase(it->p);
-			it->dropBlocks();
-			delete it;
-		} else {
-			new_queue.push_back(it);
-		}
-	}
-	m_queue = std::move(new_queue);
+		if (!it->ack_list.empty() && !finish)
+			return true;
+		it->dropBlocks();
+		delete it;
+		return false;
+	});
 }
 
 void MeshUpdateQueue::fillDataFromMapBlocks(QueuedMeshUpdate *q)
@@ -367,24 +362,14 @@ void MeshUpdateManager::updateBlock(Map *map, v3bpos_t p, bool ack_block_to_serv
 void MeshUpdateManager::putResult(MeshUpdateResult &&result)
 {
 	if (result.urgent)
-		m_queue_out_urgent.push_back(std::move(result));
+		m_queue_out_urgent.push(std::move(result));
 	else
-		m_queue_out.push_back(std::move(result));
+		m_queue_out.push(std::move(result));
 }
 
 bool MeshUpdateManager::getNextResult(MeshUpdateResult &r)
 {
-	if (!m_queue_out_urgent.empty_try()) {
-		r = m_queue_out_urgent.pop_frontNoEx();
-		return true;
-	}
-
-	if (!m_queue_out.empty_try()) {
-		r = m_queue_out.pop_frontNoEx();
-		return true;
-	}
-
-	return false;
+	return m_queue_out_urgent.try_pop(r) || m_queue_out.try_pop(r);
 }
 
 void MeshUpdateManager::clearAllQueues(bool finish)
@@ -399,15 +384,15 @@ void MeshUpdateManager::clearAllQueues(bool finish)
 	// Same problem as in MeshUpdateQueue::clear() here: we can't just blindly
 	// throw away results that the server expects to receive an ack for.
 	const auto &do_it = [&finish, &drop_result] (ResultQueue &queue) {
-		auto helper = queue.iterLocked();
-		for (auto it = helper.begin(); it != helper.end(); ) {
-			if (it->ack_list.empty() || finish) {
-				drop_result(*it);
-				it = helper.erase(it);
-			} else {
-				++it;
-			}
+		std::vector<MeshUpdateResult> keep;
+		for (MeshUpdateResult r; queue.try_pop(r); ) {
+			if (r.ack_list.empty() || finish)
+				drop_result(r);
+			else
+				keep.emplace_back(std::move(r));
 		}
+		for (auto &r : keep)
+			queue.push(std::move(r));
 	};
 	do_it(m_queue_out_urgent);
 	do_it(m_queue_out);
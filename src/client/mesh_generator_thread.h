@@ -9,7 +9,8 @@
 #include <unordered_set>
 #include "irrlichttypes_bloated.h"
 #include "mapblock.h"
-#include "threading/mutex_auto_lock.h"
+#include "threading/coalescing_priority_queue.h"
+#include "threading/mpmc_queue.h"
 #include "util/thread.h"
 #include <vector>
 #include <memory>
@@ -56,7 +57,10 @@ struct QueuedMeshUpdate
 };
 
 /*
-	A thread-safe queue of mesh update tasks and a cache of MapBlock data
+	A thread-safe queue of mesh update tasks and a cache of MapBlock data.
+	Updates are popped nearest to the player first (urgent ones before all),
+	updates of an already queued mesh are merged into it.
+	The game thread never waits for a queue-wide lock held by the workers.
 */
 class MeshUpdateQueue
 {
@@ -89,21 +93,19 @@ class MeshUpdateQueue
 	// Marks a position as finished, unblocking the next update
 	void done(v3bpos_t pos);
 
-	size_t size()
-	{
-		MutexAutoLock lock(m_mutex);
-		return m_queue.size();
-	}
+	size_t size() { return m_queue.size(); }
 
 	/// @param finish if true, also clears updates that need to be acked to the server
 	void clear(bool finish = false);
 
 private:
+	// bucket 0 is urgent, then by distance to the player
+	static constexpr size_t BUCKETS = 16;
+	static constexpr bpos_t BUCKET_BLOCKS = 4;
+
 	Client *m_client;
-	std::vector<QueuedMeshUpdate *> m_queue;
-	std::unordered_set<v3bpos_t> m_urgents;
-	std::unordered_set<v3bpos_t> m_inflight_blocks;
-	std::mutex m_mutex;
+	// also tracks meshes in flight between pop() and done()
+	coalescing_priority_queue<v3bpos_t, QueuedMeshUpdate *, BUCKETS> m_queue;
 
 	// TODO: Add callback to update these when g_settings changes, and update all meshes
 	bool m_cache_smooth_lighting;
@@ -168,7 +170,7 @@ class MeshUpdateManager
 	bool isRunning();
 
 private:
-	typedef MutexedQueue<MeshUpdateResult> ResultQueue;
+	typedef mpmc_queue<MeshUpdateResult, 1024> ResultQueue;
 
 	void deferUpdate();
 
@@ -21,6 +21,7 @@
 #include "irrlichttypes.h"
 #include "serverenvironment.h"
 #include "servermap.h"
+#include "fm_cached_map_block.h"
 #if 0
 #include "chathandler.h"
 #include "content_sao.h"
@@ -354,6 +355,7 @@ size_t ServerEnvironment::nodeUpdateReal(const v3pos_t &pos, u8 recursion_limit,
 #endif
 	ItemGroupList groups;
 	size_t ret = 0;
+	cached_map_block blocks(m_map.get(), "Node update");
 	// update nodes around
 	for (pos_t x = pos.X - 1; x <= pos.X + 1; x++) {
 		for (pos_t y = pos.Y - 1; y <= pos.Y + 1; y++) {
@@ -365,7 +367,7 @@ size_t ServerEnvironment::nodeUpdateReal(const v3pos_t &pos, u8 recursion_limit,
 					continue;
 				}
 
-				n = m_map->getNode(n_pos);
+				n = blocks.getNode(n_pos);
 				// Current mapblock not loaded, ignore
 				if (n.getContent() == CONTENT_IGNORE) {
 					continue;
@@ -373,7 +375,7 @@ size_t ServerEnvironment::nodeUpdateReal(const v3pos_t &pos, u8 recursion_limit,
 
 				const ContentFeatures &f = ndef->get(n);
 				groups = f.groups;
-				n_bottom = m_map->getNode(v3pos_t(x, y - 1, z));
+				n_bottom = blocks.getNode(v3pos_t(x, y - 1, z));
 
 				// Check is the node is considered valid to fall
 				if (n_bottom.getContent() != CONTENT_IGNORE && (destroy || itemgroup_get(groups, "falling_node"))) {
@@ -384,6 +386,8 @@ size_t ServerEnvironment::nodeUpdateReal(const v3pos_t &pos, u8 recursion_limit,
 						(f.name.compare(f_under.name) != 0 || (f_under.leveled &&
 							n_bottom.getLevel(ndef) < n_bottom.getMaxLevel(ndef))) &&
 						(!f_under.walkable || f_under.buildable_to)) {
+						// do not hold block locks while objects and nodes are changed
+						blocks.clear();
 						if (spawnFallingActiveObject(f.name, intToFloat(v3pos_t(x,y,z),BS), n, fast)) {
 							removeNode(n_pos, fast, false);
 							ret += 1 + nodeUpdateReal(n_pos, recursion_limit, fast, destroy);
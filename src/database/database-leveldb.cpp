@@ -20,6 +20,9 @@
 #include "util/string.h"
 
 #include "leveldb/db.h"
+#include "leveldb/write_batch.h"
+
+#include <algorithm>
 
 
 #define ENSURE_STATUS_OK(s) \
@@ -29,7 +32,10 @@
 	}
 
 
-Database_LevelDB::Database_LevelDB(const std::string &savedir)
+// fm: not a block key, value "morton" if the keys are Morton keys
+static const char *const LAYOUT_KEY = "layout";
+
+Database_LevelDB::Database_LevelDB(const std::string &savedir, bool morton_keys)
 {
 	leveldb::Options options;
 	options.create_if_missing = true;
@@ -38,13 +44,30 @@ Database_LevelDB::Database_LevelDB(const std::string &savedir)
 		savedir + DIR_DELIM + "map.db", &db);
 	ENSURE_STATUS_OK(status);
 	m_database.reset(db);
+
+	// The key layout is fixed when the database is created
+	std::string layout;
+	if (m_database->Get(leveldb::ReadOptions(), LAYOUT_KEY, &layout).ok()) {
+		m_morton = layout == "morton";
+	} else if (morton_keys) {
+		std::unique_ptr<leveldb::Iterator> it(m_database->NewIterator(leveldb::ReadOptions()));
+		it->SeekToFirst();
+		if (!it->Valid()) {
+			status = m_database->Put(leveldb::WriteOptions(), LAYOUT_KEY, "morton");
+			ENSURE_STATUS_OK(status);
+			m_morton = true;
+		} else {
+			warningstream << "LevelDB: " << savedir << " has blocks, keeping its key"
+				<< " layout. Use --migrate leveldb to change it." << std::endl;
+		}
+	}
 }
 
 bool Database_LevelDB::saveBlock(const v3bpos_t &pos, std::string_view data)
 {
 	leveldb::Slice data_s(data.data(), data.size());
 	leveldb::Status status = m_database->Put(leveldb::WriteOptions(),
-			getBlockAsString(pos), data_s);
+			getKey(pos), data_s);
 			//i64tos(getBlockAsInteger(pos)), data_s);
 			//getBlockAsStringCompatible(pos), data_s);
 	if (!status.ok()) {
@@ -53,8 +76,9 @@ bool Database_LevelDB::saveBlock(const v3bpos_t &pos, std::string_view data)
 		return false;
 	}
 
-        // delete old format
-        auto status_del = m_database->Delete(leveldb::WriteOptions(), i64tos(getBlockAsInteger(pos)));
+	// delete old format
+	if (!m_morton)
+		m_database->Delete(leveldb::WriteOptions(), i64tos(getBlockAsInteger(pos)));
 
 	return true;
 }
@@ -62,11 +86,16 @@ bool Database_LevelDB::saveBlock(const v3bpos_t &pos, std::string_view data)
 void Database_LevelDB::loadBlock(const v3bpos_t &pos, std::string *block)
 {
 	leveldb::Status status0 = m_database->Get(leveldb::ReadOptions(),
-		getBlockAsString(pos), block);
+		getKey(pos), block);
 
 	if (status0.ok() && !block->empty())
 		return;
 
+	if (m_morton) {
+		block->clear();
+		return;
+	}
+
 	leveldb::Status status = m_database->Get(leveldb::ReadOptions(),
 		getBlockAsStringCompatible(pos), block);
 
@@ -76,7 +105,7 @@ void Database_LevelDB::loadBlock(const v3bpos_t &pos, std::string *block)
 
 bool Database_LevelDB::deleteBlock(const v3bpos_t &pos)
 {
-	auto status = m_database->Delete(leveldb::WriteOptions(), getBlockAsString(pos));
+	auto status = m_database->Delete(leveldb::WriteOptions(), getKey(pos));
 	if (!status.ok()) {
 		warningstream << "deleteBlock: LevelDB error deleting block "
 			<< pos << ": " << status.ToString() << std::endl;
@@ -92,11 +121,81 @@ void Database_LevelDB::listAllLoadableBlocks(std::vector<v3bpos_t> &dst)
 	if (!it)
 		return;
 	for (it->SeekToFirst(); it->Valid(); it->Next()) {
-		dst.push_back(getStringAsBlock(it->key().ToString()));
+		const auto key = it->key();
+		if (key == leveldb::Slice(LAYOUT_KEY))
+			continue;
+		v3bpos_t pos;
+		if (m_morton && getMortonKeyAsBlock({key.data(), key.size()}, pos))
+			dst.push_back(pos);
+		else
+			dst.push_back(getStringAsBlock(key.ToString()));
 	}
 	ENSURE_STATUS_OK(it->status());  // Check for any errors found during the scan
 }
 
+bool Database_LevelDB::saveBlocks(block_batch blocks)
+{
+	// One write for all blocks instead of a log append per block
+	leveldb::WriteBatch batch;
+	for (const auto &[pos, data] : blocks) {
+		batch.Put(getKey(pos), leveldb::Slice(data.data(), data.size()));
+		// delete old format
+		if (!m_morton)
+			batch.Delete(i64tos(getBlockAsInteger(pos)));
+	}
+	auto status = m_database->Write(leveldb::WriteOptions(), &batch);
+	if (!status.ok()) {
+		warningstream << "saveBlocks: LevelDB error saving " << blocks.size()
+			<< " blocks: " << status.ToString() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void Database_LevelDB::loadBlocks(std::span<const v3bpos_t> positions,
+		const load_callback &callback)
+{
+	// Seeks in key order on one iterator reuse the table blocks it has read
+	std::vector<std::pair<std::string, v3bpos_t>> keys;
+	keys.reserve(positions.size());
+	for (const auto &pos : positions)
+		keys.emplace_back(getKey(pos), pos);
+	std::sort(keys.begin(), keys.end(),
+			[](const auto &a, const auto &b) { return a.first < b.first; });
+	keys.erase(std::unique(keys.begin(), keys.end(),
+			[](const auto &a, const auto &b) { return a.first == b.first; }), keys.end());
+
+	// Close keys, like an area in Morton order, are reached by a few Next()
+	constexpr int NEXT_MAX = 8;
+
+	std::unique_ptr<leveldb::Iterator> it(m_database->NewIterator(leveldb::ReadOptions()));
+	bool positioned = false;
+	std::string block;
+	for (const auto &[key, pos] : keys) {
+		const leveldb::Slice key_s(key);
+		for (int i = 0; positioned && i < NEXT_MAX && it->Valid() &&
+				it->key().compare(key_s) < 0; ++i)
+			it->Next();
+		if (!positioned || (it->Valid() && it->key().compare(key_s) < 0)) {
+			it->Seek(key_s);
+			positioned = true;
+		}
+
+		if (it->Valid() && it->key() == key_s) {
+			block.assign(it->value().data(), it->value().size());
+		} else if (!m_morton) {
+			auto status = m_database->Get(leveldb::ReadOptions(),
+					getBlockAsStringCompatible(pos), &block);
+			if (!status.ok())
+				block.clear();
+		}
+		callback(pos, std::move(block));
+		block.clear();
+	}
+	ENSURE_STATUS_OK(it->status());
+}
+
 PlayerDatabaseLevelDB::PlayerDatabaseLevelDB(const std::string &savedir, const std::string &name)
 {
 	leveldb::Options options;
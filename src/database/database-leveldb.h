@@ -17,7 +17,9 @@
 class Database_LevelDB : public MapDatabase
 {
 public:
-	Database_LevelDB(const std::string &savedir);
+	/// @param morton_keys key a new database by getBlockAsMortonKey, an
+	/// existing one keeps its layout
+	Database_LevelDB(const std::string &savedir, bool morton_keys = false);
 	~Database_LevelDB() = default;
 
 	/* fmtodo?:
@@ -30,11 +32,23 @@ class Database_LevelDB : public MapDatabase
 	bool deleteBlock(const v3bpos_t &pos);
 	void listAllLoadableBlocks(std::vector<v3bpos_t> &dst);
 
+	bool saveBlocks(block_batch blocks) override;
+	void loadBlocks(std::span<const v3bpos_t> positions,
+			const load_callback &callback) override;
+
 	void beginSave() {}
 	void endSave() {}
 
+	bool mortonKeys() const { return m_morton; }
+
 private:
+	std::string getKey(const v3bpos_t &pos) const
+	{
+		return m_morton ? getBlockAsMortonKey(pos) : getBlockAsString(pos);
+	}
+
 	std::unique_ptr<leveldb::DB> m_database;
+	bool m_morton = false;
 };
 
 class PlayerDatabaseLevelDB : public PlayerDatabase
@@ -19,7 +19,10 @@
 #include "exceptions.h"
 #include "remoteplayer.h"
 #include "server/player_sao.h"
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <map>
 
 Database_PostgreSQL::Database_PostgreSQL(const std::string &connect_string,
 	const char *type) :
@@ -201,6 +204,11 @@ void MapDatabasePostgreSQL::initStatements()
 				"UPDATE SET data = $4::bytea");
 	}
 
+	prepareStatement("read_blocks",
+		"SELECT posX, posY, posZ, data FROM blocks JOIN "
+			"unnest($1::int4[], $2::int4[], $3::int4[]) AS p(x, y, z) "
+			"ON posX = p.x AND posY = p.y AND posZ = p.z");
+
 	prepareStatement("delete_block", "DELETE FROM blocks WHERE "
 		"posX = $1::int4 AND posY = $2::int4 AND posZ = $3::int4");
 
@@ -264,6 +272,56 @@ void MapDatabasePostgreSQL::loadBlock(const v3bpos_t &pos, std::string *block)
 	PQclear(results);
 }
 
+void MapDatabasePostgreSQL::loadBlocks(std::span<const v3bpos_t> positions,
+		const load_callback &callback)
+{
+	// One round trip per chunk instead of per block
+	constexpr size_t CHUNK = 1000;
+
+	verifyDatabase();
+
+	for (size_t begin = 0; begin < positions.size(); begin += CHUNK) {
+		const auto chunk = positions.subspan(begin,
+				std::min(CHUNK, positions.size() - begin));
+
+		// Positions as int4[] literals
+		std::string coords[3];
+		std::map<v3bpos_t, std::string> missing;
+		for (const auto &pos : chunk) {
+			if (!missing.emplace(pos, std::string()).second)
+				continue;
+			for (int i = 0; i < 3; ++i) {
+				coords[i] += coords[i].empty() ? '{' : ',';
+				coords[i] += std::to_string(i == 0 ? pos.X : i == 1 ? pos.Y : pos.Z);
+			}
+		}
+		for (auto &c : coords)
+			c += '}';
+
+		const char *args[] = { coords[0].c_str(), coords[1].c_str(), coords[2].c_str() };
+		PGresult *results = execPrepared("read_blocks", ARRLEN(args), args, false);
+
+		const auto pg_to_int4 = [&](int row, int col) {
+			s32 value;
+			memcpy(&value, PQgetvalue(results, row, col), sizeof(value));
+			return (s32)ntohl(value);
+		};
+		const int numrows = PQntuples(results);
+		for (int row = 0; row < numrows; ++row) {
+			const v3bpos_t pos(pg_to_int4(row, 0), pg_to_int4(row, 1), pg_to_int4(row, 2));
+			auto it = missing.find(pos);
+			if (it == missing.end())
+				continue;
+			callback(pos, pg_to_string(results, row, 3));
+			missing.erase(it);
+		}
+		PQclear(results);
+
+		for (auto &[pos, block] : missing)
+			callback(pos, std::move(block));
+	}
+}
+
 bool MapDatabasePostgreSQL::deleteBlock(const v3bpos_t &pos)
 {
 	verifyDatabase();
@@ -114,6 +114,9 @@ class MapDatabasePostgreSQL : private Database_PostgreSQL, public MapDatabase
 	bool deleteBlock(const v3bpos_t &pos);
 	void listAllLoadableBlocks(std::vector<v3bpos_t> &dst);
 
+	void loadBlocks(std::span<const v3bpos_t> positions,
+			const load_callback &callback) override;
+
 	PARENT_CLASS_FUNCS
 
 protected:
@@ -0,0 +1,243 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "database-snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "exceptions.h"
+#include "filesys.h"
+#include "irrlicht_changes/printing.h"
+#include "log.h"
+#include "util/serialize.h"
+
+namespace
+{
+constexpr char MAGIC[8] = {'F', 'M', 'S', 'N', 'A', 'P', '0', '1'};
+// magic, u32 key size, u32 entry size, u64 count, u64 index offset
+constexpr size_t HEADER_SIZE = 32;
+// Morton key without the 'm', u32 size, u64 offset
+constexpr size_t KEY_SIZE = 3 * sizeof(bpos_t);
+constexpr size_t ENTRY_SIZE = KEY_SIZE + 4 + 8;
+
+std::string getKey(const v3bpos_t &pos)
+{
+	return MapDatabase::getBlockAsMortonKey(pos).substr(1);
+}
+
+bool keyLess(const std::pair<std::string, v3bpos_t> &a,
+		const std::pair<std::string, v3bpos_t> &b)
+{
+	return a.first < b.first;
+}
+}
+
+Database_Snapshot::Database_Snapshot(const std::string &savedir)
+{
+	const std::string path = savedir + DIR_DELIM + FILE_NAME;
+	if (!m_file.open(path))
+		throw DatabaseException("Snapshot: can't map " + path);
+
+	const u8 *data = m_file.data();
+	if (m_file.size() < HEADER_SIZE || memcmp(data, MAGIC, sizeof(MAGIC)))
+		throw DatabaseException("Snapshot: " + path + " is not a map snapshot");
+	if (readU32(data + 8) != KEY_SIZE || readU32(data + 12) != ENTRY_SIZE)
+		throw DatabaseException("Snapshot: " + path +
+				" was built with another block position size");
+	m_count = readU64(data + 16);
+	const u64 index_offset = readU64(data + 24);
+	if (index_offset < HEADER_SIZE || index_offset > m_file.size() ||
+			m_count > (m_file.size() - index_offset) / ENTRY_SIZE)
+		throw DatabaseException("Snapshot: " + path + " is truncated");
+	m_index = data + index_offset;
+
+	infostream << "Snapshot: " << path << " with " << m_count << " blocks" << std::endl;
+}
+
+std::string_view Database_Snapshot::entryKey(size_t i) const
+{
+	return {reinterpret_cast<const char *>(m_index + i * ENTRY_SIZE), KEY_SIZE};
+}
+
+std::string_view Database_Snapshot::entryData(size_t i) const
+{
+	const u8 *entry = m_index + i * ENTRY_SIZE;
+	const u32 size = readU32(entry + KEY_SIZE);
+	const u64 offset = readU64(entry + KEY_SIZE + 4);
+	if (offset < HEADER_SIZE || offset > m_file.size() || size > m_file.size() - offset) {
+		errorstream << "Snapshot: invalid index entry " << i << std::endl;
+		return {};
+	}
+	return m_file.view(offset, size);
+}
+
+size_t Database_Snapshot::lowerBound(std::string_view key, size_t first) const
+{
+	size_t count = m_count - first;
+	while (count) {
+		const size_t step = count / 2;
+		if (entryKey(first + step) < key) {
+			first += step + 1;
+			count -= step + 1;
+		} else {
+			count = step;
+		}
+	}
+	return first;
+}
+
+bool Database_Snapshot::saveBlock(const v3bpos_t &pos, std::string_view data)
+{
+	errorstream << "Snapshot: read-only, not saving block " << pos << std::endl;
+	return false;
+}
+
+void Database_Snapshot::loadBlock(const v3bpos_t &pos, std::string *block)
+{
+	const auto key = getKey(pos);
+	const size_t i = lowerBound(key);
+	if (i < m_count && entryKey(i) == key)
+		block->assign(entryData(i));
+	else
+		block->clear();
+}
+
+bool Database_Snapshot::deleteBlock(const v3bpos_t &pos)
+{
+	return false;
+}
+
+void Database_Snapshot::listAllLoadableBlocks(std::vector<v3bpos_t> &dst)
+{
+	dst.reserve(dst.size() + m_count);
+	std::string key = "m";
+	v3bpos_t pos;
+	for (size_t i = 0; i < m_count; ++i) {
+		key.resize(1);
+		key += entryKey(i);
+		if (getMortonKeyAsBlock(key, pos))
+			dst.push_back(pos);
+	}
+}
+
+void Database_Snapshot::loadBlocks(std::span<const v3bpos_t> positions,
+		const load_callback &callback)
+{
+	// In key order every search starts at the last found entry
+	std::vector<std::pair<std::string, v3bpos_t>> keys;
+	keys.reserve(positions.size());
+	for (const auto &pos : positions)
+		keys.emplace_back(getKey(pos), pos);
+	std::sort(keys.begin(), keys.end(), keyLess);
+
+	size_t i = 0;
+	for (const auto &[key, pos] : keys) {
+		i = lowerBound(key, i);
+		std::string block;
+		if (i < m_count && entryKey(i) == key)
+			block.assign(entryData(i));
+		callback(pos, std::move(block));
+	}
+}
+
+bool Database_Snapshot::build(MapDatabase *source, const std::string &savedir)
+{
+	// Blocks are read in chunks and written in key order
+	constexpr size_t CHUNK = 1024;
+
+	std::vector<v3bpos_t> positions;
+	source->listAllLoadableBlocks(positions);
+	std::vector<std::pair<std::string, v3bpos_t>> keys;
+	keys.reserve(positions.size());
+	for (const auto &pos : positions)
+		keys.emplace_back(getKey(pos), pos);
+	positions = {};
+	std::sort(keys.begin(), keys.end(), keyLess);
+	keys.erase(std::unique(keys.begin(), keys.end(),
+			[](const auto &a, const auto &b) { return a.first == b.first; }), keys.end());
+
+	const std::string path = savedir + DIR_DELIM + FILE_NAME,
+		tmp_path = path + ".tmp";
+	std::ofstream os(tmp_path, std::ios_base::binary | std::ios_base::trunc);
+	if (!os.good()) {
+		errorstream << "Snapshot: can't write " << tmp_path << std::endl;
+		return false;
+	}
+
+	u8 header[HEADER_SIZE] = {};
+	os.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+	std::string index;
+	u64 offset = HEADER_SIZE;
+	size_t count = 0;
+	std::vector<v3bpos_t> chunk;
+	std::vector<std::string> blocks;
+	for (size_t begin = 0; begin < keys.size(); begin += CHUNK) {
+		const auto first = keys.begin() + begin,
+			last = keys.begin() + std::min(keys.size(), begin + CHUNK);
+		chunk.clear();
+		for (auto it = first; it != last; ++it)
+			chunk.push_back(it->second);
+		blocks.assign(chunk.size(), {});
+		source->loadBlocks(chunk, [&](const v3bpos_t &pos, std::string &&block) {
+			const std::pair<std::string, v3bpos_t> key{getKey(pos), pos};
+			const auto it = std::lower_bound(first, last, key, keyLess);
+			if (it != last && it->first == key.first)
+				blocks[it - first] = std::move(block);
+		});
+
+		for (size_t i = 0; i < chunk.size(); ++i) {
+			const auto &block = blocks[i];
+			if (block.empty() || block.size() > U32_MAX)
+				continue;
+			os.write(block.data(), block.size());
+			u8 entry[ENTRY_SIZE];
+			memcpy(entry, first[i].first.data(), KEY_SIZE);
+			writeU32(entry + KEY_SIZE, block.size());
+			writeU64(entry + KEY_SIZE + 4, offset);
+			index.append(reinterpret_cast<const char *>(entry), sizeof(entry));
+			offset += block.size();
+			++count;
+		}
+	}
+	os.write(index.data(), index.size());
+
+	memcpy(header, MAGIC, sizeof(MAGIC));
+	writeU32(header + 8, KEY_SIZE);
+	writeU32(header + 12, ENTRY_SIZE);
+	writeU64(header + 16, count);
+	writeU64(header + 24, offset);
+	os.seekp(0);
+	os.write(reinterpret_cast<const char *>(header), sizeof(header));
+	os.close();
+	if (!os.good()) {
+		errorstream << "Snapshot: failed to write " << tmp_path << std::endl;
+		return false;
+	}
+
+	// A server still mapping the old file keeps reading it until restart
+	if (fs::PathExists(path))
+		fs::DeleteSingleFileOrEmptyDirectory(path);
+	if (!fs::Rename(tmp_path, path)) {
+		errorstream << "Snapshot: can't rename " << tmp_path << " to " << path << std::endl;
+		return false;
+	}
+
+	actionstream << "Snapshot: wrote " << count << " blocks to " << path << std::endl;
+	return true;
+}
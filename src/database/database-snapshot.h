@@ -0,0 +1,69 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include "database.h"
+#include "util/mapped_file.h"
+
+/*
+Read-only map database in one memory mapped file, built offline from another
+backend with --snapshot-map and used as readonly_backend = snapshot.
+
+Blocks are stored as in the source database, sorted by Morton key
+(MapDatabase::getBlockAsMortonKey), followed by a sorted index of
+(key, size, offset). A load is a binary search in the index and a copy out of
+the mapping: no syscall, and the pages are shared by every server process
+using the same file.
+*/
+
+class Database_Snapshot : public MapDatabase
+{
+public:
+	static constexpr const char *FILE_NAME = "map.snapshot";
+
+	/// @throws DatabaseException if savedir has no valid snapshot
+	Database_Snapshot(const std::string &savedir);
+
+	/// Write a snapshot of all blocks of source into savedir
+	/// @return false on error
+	static bool build(MapDatabase *source, const std::string &savedir);
+
+	bool saveBlock(const v3bpos_t &pos, std::string_view data);
+	void loadBlock(const v3bpos_t &pos, std::string *block);
+	bool deleteBlock(const v3bpos_t &pos);
+	void listAllLoadableBlocks(std::vector<v3bpos_t> &dst);
+
+	void loadBlocks(std::span<const v3bpos_t> positions,
+			const load_callback &callback) override;
+
+	void beginSave() {}
+	void endSave() {}
+
+	size_t size() const { return m_count; }
+
+private:
+	/// Index of the first entry not less than key, from first on
+	size_t lowerBound(std::string_view key, size_t first = 0) const;
+	std::string_view entryKey(size_t i) const;
+	std::string_view entryData(size_t i) const;
+
+	mapped_file m_file;
+	const u8 *m_index = nullptr;
+	size_t m_count = 0;
+};
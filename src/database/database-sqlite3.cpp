@@ -14,7 +14,9 @@
 #include "irrlicht_changes/printing.h"
 #include "server/player_sao.h"
 
+#include <algorithm>
 #include <cassert>
+#include <tuple>
 
 // When to print messages when the database is being held locked by another process
 // Note: I've seen occasional delays of over 250ms while running minetestmapper.
@@ -221,6 +223,7 @@ MapDatabaseSQLite3::~MapDatabaseSQLite3()
 	FINALIZE_STATEMENT(write)
 	FINALIZE_STATEMENT(list)
 	FINALIZE_STATEMENT(delete)
+	FINALIZE_STATEMENT(read_range)
 }
 
 
@@ -260,6 +263,7 @@ void MapDatabaseSQLite3::initStatements()
 		PREPARE_STATEMENT(write, "REPLACE INTO `blocks` (`x`, `y`, `z`, `data`) VALUES (?, ?, ?, ?)");
 		PREPARE_STATEMENT(delete, "DELETE FROM `blocks` WHERE `x` = ? AND `y` = ? AND `z` = ?");
 		PREPARE_STATEMENT(list, "SELECT `x`, `y`, `z` FROM `blocks`");
+		PREPARE_STATEMENT(read_range, "SELECT `y`, `data` FROM `blocks` WHERE `x` = ? AND `z` = ? AND `y` BETWEEN ? AND ? ORDER BY `y`");
 	} else {
 		PREPARE_STATEMENT(read, "SELECT `data` FROM `blocks` WHERE `pos` = ? LIMIT 1");
 		PREPARE_STATEMENT(write, "REPLACE INTO `blocks` (`pos`, `data`) VALUES (?, ?)");
@@ -352,6 +356,77 @@ void MapDatabaseSQLite3::listAllLoadableBlocks(std::vector<v3bpos_t> &dst)
 	sqlite3_reset(m_stmt_list);
 }
 
+bool MapDatabaseSQLite3::saveBlocks(block_batch blocks)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	verifyDatabase();
+
+	for (const auto &[pos, data] : blocks) {
+		int col = bindPos(m_stmt_write, pos);
+		blob_to_sqlite(m_stmt_write, col, data);
+
+		SQLRES(sqlite3_step(m_stmt_write), SQLITE_DONE, "Failed to save block")
+		sqlite3_reset(m_stmt_write);
+	}
+
+	return true;
+}
+
+void MapDatabaseSQLite3::loadBlocks(std::span<const v3bpos_t> positions,
+		const load_callback &callback)
+{
+	// Same order as the primary key, a column of blocks is one range read
+	std::vector<v3bpos_t> sorted(positions.begin(), positions.end());
+	std::sort(sorted.begin(), sorted.end(), [](const v3bpos_t &a, const v3bpos_t &b) {
+		return std::tie(a.X, a.Z, a.Y) < std::tie(b.X, b.Z, b.Y);
+	});
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+	std::vector<std::string> blocks(sorted.size());
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		verifyDatabase();
+
+		for (size_t begin = 0, end; begin < sorted.size(); begin = end) {
+			for (end = begin + 1; end < sorted.size() &&
+					sorted[end].X == sorted[begin].X &&
+					sorted[end].Z == sorted[begin].Z; ++end) {
+			}
+
+			// Single reads for sparse columns, not to read unwanted blocks
+			const s64 range = (s64)sorted[end - 1].Y - sorted[begin].Y + 1;
+			if (!m_new_format || end - begin == 1 || range > 2 * (s64)(end - begin)) {
+				for (size_t i = begin; i < end; ++i) {
+					bindPos(m_stmt_read, sorted[i]);
+					if (sqlite3_step(m_stmt_read) == SQLITE_ROW)
+						blocks[i].assign(sqlite_to_blob(m_stmt_read, 0));
+					sqlite3_reset(m_stmt_read);
+				}
+				continue;
+			}
+
+			int_to_sqlite(m_stmt_read_range, 1, sorted[begin].X);
+			int_to_sqlite(m_stmt_read_range, 2, sorted[begin].Z);
+			int_to_sqlite(m_stmt_read_range, 3, sorted[begin].Y);
+			int_to_sqlite(m_stmt_read_range, 4, sorted[end - 1].Y);
+			size_t i = begin;
+			while (i < end && sqlite3_step(m_stmt_read_range) == SQLITE_ROW) {
+				const auto y = sqlite_to_int(m_stmt_read_range, 0);
+				while (i < end && sorted[i].Y < y)
+					++i;
+				if (i < end && sorted[i].Y == y)
+					blocks[i++].assign(sqlite_to_blob(m_stmt_read_range, 1));
+			}
+			sqlite3_reset(m_stmt_read_range);
+		}
+	}
+
+	for (size_t i = 0; i < sorted.size(); ++i)
+		callback(sorted[i], std::move(blocks[i]));
+}
+
 /*
  * Player Database
  */
@@ -178,6 +178,10 @@ class MapDatabaseSQLite3 : private Database_SQLite3, public MapDatabase
 	bool deleteBlock(const v3bpos_t &pos);
 	void listAllLoadableBlocks(std::vector<v3bpos_t> &dst);
 
+	bool saveBlocks(block_batch blocks) override;
+	void loadBlocks(std::span<const v3bpos_t> positions,
+			const load_callback &callback) override;
+
 	PARENT_CLASS_FUNCS
 
 protected:
@@ -197,6 +201,8 @@ class MapDatabaseSQLite3 : private Database_SQLite3, public MapDatabase
 	sqlite3_stmt *m_stmt_write = nullptr;
 	sqlite3_stmt *m_stmt_list = nullptr;
 	sqlite3_stmt *m_stmt_delete = nullptr;
+	// fm: y range of a column, new format only
+	sqlite3_stmt *m_stmt_read_range = nullptr;
 };
 
 class PlayerDatabaseSQLite3 : private Database_SQLite3, public PlayerDatabase
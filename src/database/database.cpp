@@ -6,7 +6,9 @@
 #include "constants.h"
 #include "irr_v3d.h"
 #include "irrlichttypes.h"
+#include <array>
 #include <sstream>
+#include <type_traits>
 #include "util/string.h"
 
 /****************
@@ -76,3 +78,74 @@ v3bpos_t MapDatabase::getStringAsBlock(const std::string &i)
 	return getIntegerAsBlock(stoi64(i));
 #endif
 }
+
+namespace
+{
+// Bits of a byte spread to every third bit
+constexpr auto morton_spread = [] {
+	std::array<u32, 256> table{};
+	for (u32 b = 0; b < 256; ++b)
+		for (u32 i = 0; i < 8; ++i)
+			table[b] |= ((b >> i) & 1) << (i * 3);
+	return table;
+}();
+
+using ubpos_t = std::make_unsigned_t<bpos_t>;
+
+// Flip the sign bit: unsigned order is the signed order
+constexpr ubpos_t morton_bias = ubpos_t(1) << (sizeof(bpos_t) * 8 - 1);
+
+constexpr size_t morton_key_size = 1 + 3 * sizeof(bpos_t);
+}
+
+std::string MapDatabase::getBlockAsMortonKey(const v3bpos_t &pos)
+{
+	// ubpos_t ^ ubpos_t is int for 16 bit positions
+	const ubpos_t c[3] = {ubpos_t(ubpos_t(pos.X) ^ morton_bias),
+			ubpos_t(ubpos_t(pos.Y) ^ morton_bias), ubpos_t(ubpos_t(pos.Z) ^ morton_bias)};
+	std::string key(morton_key_size, 'm');
+	auto *out = reinterpret_cast<u8 *>(key.data()) + 1;
+	for (int byte = sizeof(bpos_t) - 1; byte >= 0; --byte) {
+		const u32 bits = morton_spread[(c[0] >> (byte * 8)) & 0xff] << 2 |
+						 morton_spread[(c[1] >> (byte * 8)) & 0xff] << 1 |
+						 morton_spread[(c[2] >> (byte * 8)) & 0xff];
+		*out++ = bits >> 16;
+		*out++ = bits >> 8;
+		*out++ = bits;
+	}
+	return key;
+}
+
+bool MapDatabase::getMortonKeyAsBlock(std::string_view key, v3bpos_t &pos)
+{
+	if (key.size() != morton_key_size || key[0] != 'm')
+		return false;
+	ubpos_t c[3] = {};
+	const auto *in = reinterpret_cast<const u8 *>(key.data()) + 1;
+	for (size_t i = 0; i < 3 * sizeof(bpos_t); i += 3) {
+		const u32 bits = u32(in[i]) << 16 | u32(in[i + 1]) << 8 | in[i + 2];
+		for (int b = 23; b >= 0; --b)
+			c[2 - b % 3] = c[2 - b % 3] << 1 | ((bits >> b) & 1);
+	}
+	pos = v3bpos_t(bpos_t(c[0] ^ morton_bias), bpos_t(c[1] ^ morton_bias),
+			bpos_t(c[2] ^ morton_bias));
+	return true;
+}
+
+bool MapDatabase::saveBlocks(block_batch blocks)
+{
+	bool ok = true;
+	for (const auto &[pos, data] : blocks)
+		ok &= saveBlock(pos, data);
+	return ok;
+}
+
+void MapDatabase::loadBlocks(std::span<const v3bpos_t> positions, const load_callback &callback)
+{
+	std::string block;
+	for (const auto &pos : positions) {
+		block.clear();
+		loadBlock(pos, &block);
+		callback(pos, std::move(block));
+	}
+}
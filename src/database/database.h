@@ -4,8 +4,11 @@
 
 #pragma once
 
+#include <functional>
+#include <span>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 #include "irr_v3d.h"
 #include "irrlichttypes.h"
@@ -33,6 +36,17 @@ class MapDatabase : public Database
 	virtual void loadBlock(const v3bpos_t &pos, std::string *block) = 0;
 	virtual bool deleteBlock(const v3bpos_t &pos) = 0;
 
+	// fm: batches, the defaults call saveBlock/loadBlock for every block
+	using block_batch = std::span<const std::pair<v3bpos_t, std::string_view>>;
+	using load_callback = std::function<void(const v3bpos_t &pos, std::string &&block)>;
+
+	/// Like saveBlock for every block, call between beginSave() and endSave()
+	/// @return false if any block failed
+	virtual bool saveBlocks(block_batch blocks);
+	/// Calls callback for every position, in any order, repeated positions
+	/// may be merged; block is empty if not found
+	virtual void loadBlocks(std::span<const v3bpos_t> positions, const load_callback &callback);
+
 	static s64 getBlockAsInteger(const v3bpos_t &pos);
 	static v3bpos_t getIntegerAsBlock(s64 i);
 	
@@ -41,6 +55,12 @@ class MapDatabase : public Database
 
 	//std::string getBlockAsString(const v3bpos_t &pos) const;
 	std::string getBlockAsStringCompatible(const v3bpos_t &pos) const;
+
+	// fm: 'm' and the bits of x, y, z interleaved, big endian: keys sort in
+	// Z-order, a cube of 2^n aligned blocks is one key range
+	static std::string getBlockAsMortonKey(const v3bpos_t &pos);
+	/// @return false if key is not a Morton key
+	static bool getMortonKeyAsBlock(std::string_view key, v3bpos_t &pos);
 	//v3bpos_t getStringAsBlock(const std::string &i) const;
 
 	virtual void listAllLoadableBlocks(std::vector<v3bpos_t> &dst) = 0;
@@ -195,6 +195,7 @@ void fm_set_default_settings(Settings *settings) {
 	settings->setDefault("liquid_relax", android ? "1" : "2");
 	settings->setDefault("liquid_fast_flood", "-200");
 	settings->setDefault("liquid_pressure", "false");
+	settings->setDefault("liquid_parallel", "true");
 	
 	// Weather
 	settings->setDefault("weather", threads ? "true" : "false");
@@ -240,6 +241,8 @@ void fm_set_default_settings(Settings *settings) {
 #if !MINETEST_PROTO
 	settings->setDefault("max_simultaneous_block_sends_per_client", "50"); // "10"
 #endif
+	settings->setDefault("serialized_block_cache_size", "64");
+	settings->setDefault("block_delta_cache_size", "64");
 	settings->setDefault("max_block_send_distance", "30"); // "9"
 	settings->setDefault("server_unload_unused_data_timeout", "65"); // "29"
 	settings->setDefault("max_objects_per_block", "100"); // "49"
@@ -292,6 +295,7 @@ void fm_set_default_settings(Settings *settings) {
 	settings->setDefault("animation_wd_stop", "219");
 */
 	settings->setDefault("more_threads", "true");
+	settings->setDefault("server_job_threads", "0");
 	settings->setDefault("console_enabled", debug ? "true" : "false");
 
 	if (win32) {
@@ -868,6 +872,7 @@ void set_default_settings()
 
 	settings->setDefault("chat_message_format", "<@name> @message");
 	settings->setDefault("profiler_print_interval", "0");
+	settings->setDefault("tick_recorder_steps", "0");
 	settings->setDefault("active_object_send_range_blocks", "8");
 	settings->setDefault("active_block_range", "4");
 	//settings->setDefault("max_simultaneous_block_sends_per_client", "1");
@@ -889,6 +894,9 @@ void set_default_settings()
 	settings->setDefault("chat_message_limit_trigger_kick", "50");
 	settings->setDefault("sqlite_synchronous", "2");
 	settings->setDefault("map_compression_level_disk", "-1");
+	settings->setDefault("map_save_threads", "2");
+	settings->setDefault("map_save_queue_size", "1024");
+	settings->setDefault("map_zstd_dictionary", "false");
 	settings->setDefault("map_compression_level_net", "-1");
 	settings->setDefault("full_block_send_enable_min_time_from_building", "2.0");
 	settings->setDefault("dedicated_server_step", "0.09");
@@ -936,6 +944,8 @@ void set_default_settings()
 	settings->setDefault("fixed_map_seed", "");
 	settings->setDefault("max_block_generate_distance", "10");
 	settings->setDefault("enable_mapgen_debug_info", "false");
+	settings->setDefault("mapgen_parallel", "false");
+	settings->setDefault("mapgen_part_size", "40");
 	Mapgen::setDefaultSettings(settings);
 
 	// Server list announcing
@@ -106,6 +106,11 @@ EmergeManager::EmergeManager(Server *server, MetricsBackend *mb)
 			"minetest_emerge_completed", help_str,
 			{{"status", emergeActionStrs[i]}}
 		);
+		m_emerge_latency_histogram[i] = mb->addHistogram(
+			"minetest_emerge_latency", "Time from enqueue to completed emerge (in seconds)",
+			MetricHistogram::latencyBuckets(),
+			{{"status", emergeActionStrs[i]}}
+		);
 	}
 
 	m_qlimit_total = g_settings->getU32("emergequeue_limit_total");
@@ -438,6 +443,7 @@ bool EmergeManager::pushBlockEmergeData(
 	} else {
 		bedata.flags = flags;
 		bedata.peer_requested = peer_requested;
+		bedata.enqueued_us = porting::getTimeUs();
 
 		count_peer++;
 	}
@@ -495,6 +501,14 @@ void EmergeManager::reportCompletedEmerge(EmergeAction action)
 	m_completed_emerge_counter[(int)action]->increment();
 }
 
+void EmergeManager::reportEmergeLatency(EmergeAction action, u64 enqueued_us)
+{
+	assert((size_t)action < ARRLEN(m_emerge_latency_histogram));
+	if (enqueued_us)
+		m_emerge_latency_histogram[(int)action]->observe(
+				(porting::getTimeUs() - enqueued_us) / 1e6);
+}
+
 
 ////
 //// EmergeThread
@@ -819,6 +833,7 @@ void *EmergeThread::run()
 		}
 
 		runCompletionCallbacks(pos, action, bedata.callbacks);
+		m_emerge->reportEmergeLatency(action, bedata.enqueued_us);
 
 		if (block) {
 			modified_blocks[pos] = block;
@@ -79,6 +79,7 @@ struct BlockEmergeData {
 	u16 peer_requested;
 	u16 flags;
 	EmergeCallbackList callbacks;
+	u64 enqueued_us = 0;
 };
 
 class EmergeParams {
@@ -220,6 +221,7 @@ class EmergeManager {
 
 	// Emerge metrics
 	MetricCounterPtr m_completed_emerge_counter[5];
+	MetricHistogramPtr m_emerge_latency_histogram[5];
 
 	// Managers of various map generation-related components
 	// Note that each Mapgen gets a copy(!) of these to work with
@@ -245,6 +247,7 @@ class EmergeManager {
 	bool popBlockEmergeData(v3bpos_t pos, BlockEmergeData *bedata);
 
 	void reportCompletedEmerge(EmergeAction action);
+	void reportEmergeLatency(EmergeAction action, u64 enqueued_us);
 
 	friend class EmergeThread;
 
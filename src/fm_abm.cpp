@@ -1,3 +1,4 @@
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <sstream>
@@ -9,6 +10,7 @@
 //#include "server/abmhandler.h"
 #include "serverenvironment.h"
 #include "servermap.h"
+#include "fm_content_scan.h"
 
 ABMHandler::ABMHandler(ServerEnvironment *env) : m_env(env)
 //ABMHandler::ABMHandler(std::vector<ABMWithState> &abms, float dtime_s,
@@ -37,6 +39,20 @@ void ABMHandler::init(std::vector<ABMWithState> &abms)
 			m_aabms_empty = false;
 		}
 	}
+
+	// groups are fixed after init, do not look them up for every node
+	const auto *ndef = m_env->getGameDef()->ndef();
+	m_active.assign(CONTENT_ID_CAPACITY, false);
+	m_hot.assign(CONTENT_ID_CAPACITY, 0);
+	m_water.assign(CONTENT_ID_CAPACITY, false);
+	for (size_t c = 0; c < CONTENT_ID_CAPACITY; ++c) {
+		if (c == CONTENT_IGNORE)
+			continue;
+		const auto &groups = ndef->get(c).groups;
+		m_hot[c] = itemgroup_get(groups, "hot");
+		m_water[c] = itemgroup_get(groups, "water");
+		m_active[c] = m_aabms[c] || m_hot[c] || m_water[c];
+	}
 }
 /*
 ABMHandler::~ABMHandler()
@@ -90,6 +106,32 @@ void ABMHandler::apply(MapBlock *block, int &blocks_scanned, int &abms_run,
 			block->abm_triggers->clear();
 	}
 
+	// Only nodes with abms, heat or humidity matter
+	std::vector<content_t> active;
+	for (const auto c : block->getContents())
+		if (m_active[c])
+			active.emplace_back(c);
+	if (active.empty()) {
+		g_profiler->add("ABM skipped blocks", 1);
+		return;
+	}
+
+	constexpr size_t nodecount = MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE;
+	std::array<uint64_t, nodecount / 64> where;
+	{
+		const auto lock = block->lock_shared_rec();
+		if (!block->data)
+			return;
+		if (block->m_is_mono_block) {
+			if (!m_aabms[block->data[0].param0])
+				return;
+			where.fill(~uint64_t{});
+		} else {
+			content_scan::match(
+					block->data, nodecount, active.data(), active.size(), where.data());
+		}
+	}
+
 #if ENABLE_THREADS
 	auto map = std::unique_ptr<VoxelManipulator>(new VoxelManipulator);
 	{
@@ -113,8 +155,6 @@ void ABMHandler::apply(MapBlock *block, int &blocks_scanned, int &abms_run,
 			this->countObjects(block, &m_env->getServerMap(), active_object_count_wider);
 	m_env->m_added_objects = 0;
 
-	auto *ndef = m_env->getGameDef()->ndef();
-
 #if !ENABLE_THREADS
 	auto lock_map = m_env->getServerMap().m_nothread_locker.try_lock_shared_rec();
 	if (!lock_map->owns_lock())
@@ -126,83 +166,77 @@ void ABMHandler::apply(MapBlock *block, int &blocks_scanned, int &abms_run,
 	int humidity_num = 0;
 
 	v3pos_t bpr = block->getPosRelative();
-	v3pos_t p0;
-	for (p0.X = 0; p0.X < MAP_BLOCKSIZE; p0.X++)
-		for (p0.Y = 0; p0.Y < MAP_BLOCKSIZE; p0.Y++)
-			for (p0.Z = 0; p0.Z < MAP_BLOCKSIZE; p0.Z++) {
-				v3pos_t p = p0 + bpr;
+	for (size_t w = 0; w < where.size(); ++w)
+		for (uint64_t bits = where[w]; bits; bits &= bits - 1) {
+			const size_t index = w * 64 + __builtin_ctzll(bits);
+			const v3pos_t p0(index % MAP_BLOCKSIZE, index / MAP_BLOCKSIZE % MAP_BLOCKSIZE,
+					index / (MAP_BLOCKSIZE * MAP_BLOCKSIZE));
+			v3pos_t p = p0 + bpr;
 #if ENABLE_THREADS
-				MapNode n = map->getNodeTry(p);
+			MapNode n = map->getNodeTry(p);
 #else
-				MapNode n = block->getNodeTry(p0);
+			MapNode n = block->getNodeTry(p0);
 #endif
-				content_t c = n.getContent();
-				if (c == CONTENT_IGNORE)
-					continue;
-
-				{
-					int hot = ((ItemGroupList)ndef->get(n).groups)["hot"];
-					// todo: int cold = ((ItemGroupList) ndef->get(n).groups)["cold"];
-					if (hot) {
-						++heat_num;
-						heat_sum += hot;
-					}
-
-					int humidity = ((ItemGroupList)ndef->get(n).groups)["water"];
-					if (humidity) {
-						++humidity_num;
-					}
+			content_t c = n.getContent();
+			if (c == CONTENT_IGNORE)
+				continue;
+
+			{
+				if (const int hot = m_hot[c]) {
+					++heat_num;
+					heat_sum += hot;
 				}
-
-				if (!m_aabms[c]) {
-					if (block->m_is_mono_block)
-						return;
-					continue;
+				if (m_water[c]) {
+					++humidity_num;
 				}
+			}
 
-				for (auto &ir : *(m_aabms[c])) {
-					auto i = &ir;
-					// Check neighbors
-					v3pos_t neighbor_pos;
-					auto &required_neighbors =
-							activate == 1 ? ir.abmws->required_neighbors_activate
-										  : ir.abmws->required_neighbors;
-					if (!required_neighbors.empty()) {
-						v3pos_t p1;
-						int neighbors_range = i->abmws->neighbors_range;
-						for (p1.X = p.X - neighbors_range; p1.X <= p.X + neighbors_range;
-								++p1.X)
-							for (p1.Y = p.Y - neighbors_range;
-									p1.Y <= p.Y + neighbors_range; ++p1.Y)
-								for (p1.Z = p.Z - neighbors_range;
-										p1.Z <= p.Z + neighbors_range; ++p1.Z) {
-									if (p1 == p)
-										continue;
-									MapNode n = map->getNodeTry(p1);
-									content_t c = n.getContent();
-									if (c == CONTENT_IGNORE)
-										continue;
-									if (required_neighbors.get(c)) {
-										neighbor_pos = p1;
-										goto neighbor_found;
-									}
+			if (!m_aabms[c])
+				continue;
+
+			for (auto &ir : *(m_aabms[c])) {
+				auto i = &ir;
+				// Check neighbors
+				v3pos_t neighbor_pos;
+				auto &required_neighbors =
+						activate == 1 ? ir.abmws->required_neighbors_activate
+									  : ir.abmws->required_neighbors;
+				if (!required_neighbors.empty()) {
+					v3pos_t p1;
+					int neighbors_range = i->abmws->neighbors_range;
+					for (p1.X = p.X - neighbors_range; p1.X <= p.X + neighbors_range;
+							++p1.X)
+						for (p1.Y = p.Y - neighbors_range;
+								p1.Y <= p.Y + neighbors_range; ++p1.Y)
+							for (p1.Z = p.Z - neighbors_range;
+									p1.Z <= p.Z + neighbors_range; ++p1.Z) {
+								if (p1 == p)
+									continue;
+								MapNode n = map->getNodeTry(p1);
+								content_t c = n.getContent();
+								if (c == CONTENT_IGNORE)
+									continue;
+								if (required_neighbors.get(c)) {
+									neighbor_pos = p1;
+									goto neighbor_found;
 								}
-						// No required neighbor found
-						continue;
-					}
-				neighbor_found:
+							}
+					// No required neighbor found
+					continue;
+				}
+			neighbor_found:
 
-					std::lock_guard<std::mutex> lock(block->abm_triggers_mutex);
+				std::lock_guard<std::mutex> lock(block->abm_triggers_mutex);
 
-					if (!block->abm_triggers)
-						block->abm_triggers =
-								std::make_unique<MapBlock::abm_triggers_type>();
+				if (!block->abm_triggers)
+					block->abm_triggers =
+							std::make_unique<MapBlock::abm_triggers_type>();
 
-					block->abm_triggers->emplace_back(
-							abm_trigger_one{i, p, c, active_object_count,
-									active_object_count_wider, neighbor_pos, activate});
-				}
+				block->abm_triggers->emplace_back(
+						abm_trigger_one{i, p, c, active_object_count,
+								active_object_count_wider, neighbor_pos, activate});
 			}
+		}
 	if (heat_num) {
 		float heat_avg = heat_sum / heat_num;
 		const int min = 2 * MAP_BLOCKSIZE;
@@ -222,6 +222,19 @@ void *AbmWorldThread::run()
 					return block;
 				};
 
+				{
+					// Block and neighbours not in memory with one database read
+					auto &smap = m_server->getEnv().getServerMap();
+					std::vector<v3bpos_t> missing;
+					if (!smap.getBlock(pos))
+						missing.emplace_back(pos);
+					for (const auto &dir : g_6dirs)
+						if (!smap.getBlock(pos + dir))
+							missing.emplace_back(pos + dir);
+					if (!missing.empty())
+						smap.loadBlocks(missing);
+				}
+
 				auto block = load_block(pos);
 				if (!block) {
 					continue;
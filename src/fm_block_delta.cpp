@@ -0,0 +1,127 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_block_delta.h"
+
+#include <vector>
+
+#include "exceptions.h"
+#include "util/serialize.h"
+
+namespace block_delta
+{
+namespace
+{
+constexpr size_t NODE_SIZE = 4;
+constexpr size_t RUN_HEADER_SIZE = 4;
+constexpr size_t LIST_ENTRY_SIZE = 2 + NODE_SIZE;
+
+void writeNode(std::ostream &os, const MapNode &n)
+{
+	writeU16(os, n.param0);
+	writeU8(os, n.param1);
+	writeU8(os, n.param2);
+}
+
+MapNode readNode(std::istream &is)
+{
+	MapNode n;
+	n.param0 = readU16(is);
+	n.param1 = readU8(is);
+	n.param2 = readU8(is);
+	return n;
+}
+
+struct run
+{
+	u16 start;
+	u16 length;
+};
+}
+
+void encode(std::ostream &os, const MapNode *base, size_t base_count, const MapNode *now,
+		size_t now_count, size_t nodecount)
+{
+	const auto node = [nodecount](const MapNode *nodes, size_t count, size_t i) {
+		return nodes[count == nodecount ? i : 0];
+	};
+
+	std::vector<run> runs;
+	size_t changed = 0;
+	for (size_t i = 0; i < nodecount; ++i) {
+		if (node(base, base_count, i) == node(now, now_count, i))
+			continue;
+		++changed;
+		// one unchanged node between costs as much as a new run
+		if (!runs.empty() && size_t(runs.back().start) + runs.back().length + 1 >= i)
+			runs.back().length = i - runs.back().start + 1;
+		else
+			runs.push_back({u16(i), 1});
+	}
+
+	size_t runs_size = runs.size() * RUN_HEADER_SIZE;
+	for (const auto &r : runs)
+		runs_size += r.length * NODE_SIZE;
+
+	if (runs_size <= changed * LIST_ENTRY_SIZE) {
+		writeU8(os, FORM_RUNS);
+		writeU16(os, runs.size());
+		for (const auto &r : runs) {
+			writeU16(os, r.start);
+			writeU16(os, r.length);
+			for (size_t i = r.start; i < size_t(r.start) + r.length; ++i)
+				writeNode(os, node(now, now_count, i));
+		}
+		return;
+	}
+
+	writeU8(os, FORM_LIST);
+	writeU16(os, changed);
+	for (size_t i = 0; i < nodecount; ++i) {
+		const auto n = node(now, now_count, i);
+		if (node(base, base_count, i) == n)
+			continue;
+		writeU16(os, i);
+		writeNode(os, n);
+	}
+}
+
+void decode(std::istream &is, MapNode *nodes, size_t nodecount)
+{
+	const u8 form = readU8(is);
+	const u16 count = readU16(is);
+	if (form == FORM_RUNS) {
+		for (u16 r = 0; r < count; ++r) {
+			const size_t start = readU16(is);
+			const size_t length = readU16(is);
+			if (start + length > nodecount)
+				throw SerializationError("block_delta: run out of block");
+			for (size_t i = start; i < start + length; ++i)
+				nodes[i] = readNode(is);
+		}
+	} else if (form == FORM_LIST) {
+		for (u16 c = 0; c < count; ++c) {
+			const size_t i = readU16(is);
+			if (i >= nodecount)
+				throw SerializationError("block_delta: node out of block");
+			nodes[i] = readNode(is);
+		}
+	} else {
+		throw SerializationError("block_delta: unknown form");
+	}
+}
+}
@@ -0,0 +1,51 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+
+#include "mapnode.h"
+
+/*
+Changed nodes of a block between two versions, sent instead of the whole
+block to a client having the older version (TOCLIENT_BLOCKDATA_DELTA).
+
+encode() writes the smaller of two forms:
+- runs: u16 start, u16 length and the nodes, for bulk edits
+- list: u16 index and the node, for scattered changes
+Nodes are whole (u16 content, u8 param1, u8 param2), decoding sets them.
+Node arrays of count 1 are mono blocks, all nodes equal to the first.
+*/
+
+namespace block_delta
+{
+enum form : u8
+{
+	FORM_RUNS = 0,
+	FORM_LIST = 1,
+};
+
+// Changes from base to now, both of nodecount nodes (or 1, see above)
+void encode(std::ostream &os, const MapNode *base, size_t base_count, const MapNode *now,
+		size_t now_count, size_t nodecount);
+
+// Set the changed nodes of nodecount nodes
+// @throws SerializationError
+void decode(std::istream &is, MapNode *nodes, size_t nodecount);
+}
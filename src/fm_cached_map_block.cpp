@@ -0,0 +1,165 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_cached_map_block.h"
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "map.h"
+#include "porting.h"
+#include "profiler.h"
+
+namespace
+{
+constexpr u64 REPORT_EVERY_MS = 1000;
+
+struct cache_stats
+{
+	std::string_view name;
+	uint32_t hit = 0, miss = 0;
+};
+
+// Caches live for one walk, many per step: sum them per thread and report
+// to g_profiler at most once per REPORT_EVERY_MS
+thread_local std::vector<cache_stats> stats;
+thread_local u64 stats_reported_ms = 0;
+
+void report_stats(const char *profiler_name, uint32_t hit, uint32_t miss)
+{
+	auto it = std::find_if(stats.begin(), stats.end(),
+			[&](const cache_stats &s) { return s.name == profiler_name; });
+	if (it == stats.end())
+		it = stats.insert(stats.end(), {profiler_name, 0, 0});
+	it->hit += hit;
+	it->miss += miss;
+
+	const auto now = porting::getTimeMs();
+	if (now - stats_reported_ms < REPORT_EVERY_MS)
+		return;
+	stats_reported_ms = now;
+	for (auto &s : stats) {
+		if (!s.hit && !s.miss)
+			continue;
+		const auto prefix = std::string("Block cache: ").append(s.name);
+		g_profiler->add(prefix + " hit", s.hit);
+		g_profiler->add(prefix + " miss", s.miss);
+		g_profiler->avg(prefix + " hit %", s.hit * 100.0f / (s.hit + s.miss));
+		s.hit = s.miss = 0;
+	}
+}
+}
+
+cached_map_block::cached_map_block(Map *map, const char *profiler_name) :
+		m_map{map}, m_profiler_name{profiler_name}
+{
+}
+
+cached_map_block::~cached_map_block()
+{
+	clear();
+	if (m_hit || m_miss)
+		report_stats(m_profiler_name, m_hit, m_miss);
+}
+
+void cached_map_block::clear()
+{
+	for (size_t i = 0; i < m_size; ++i) {
+		m_entries[i].lock.reset();
+		m_entries[i].block.reset();
+	}
+	m_size = 0;
+	m_last = 0;
+}
+
+MapBlock *cached_map_block::getBlock(
+		const v3bpos_t &blockpos, bool try_lock, bool *busy)
+{
+	if (busy)
+		*busy = false;
+
+	if (++m_lookups >= RELEASE_EVERY) {
+		m_lookups = 0;
+		clear();
+	}
+
+	if (m_size && m_entries[m_last].pos == blockpos) {
+		++m_hit;
+		m_entries[m_last].used = ++m_clock;
+		return m_entries[m_last].block.get();
+	}
+	for (size_t i = 0; i < m_size; ++i) {
+		if (m_entries[i].pos != blockpos)
+			continue;
+		++m_hit;
+		m_entries[i].used = ++m_clock;
+		m_last = i;
+		return m_entries[i].block.get();
+	}
+
+	++m_miss;
+	auto block = m_map->getBlock(blockpos);
+	if (!block)
+		return nullptr;
+
+	auto lock = block->try_lock_unique_rec();
+	if (!lock->owns_lock()) {
+		if (try_lock) {
+			if (busy)
+				*busy = true;
+			return nullptr;
+		}
+		// never wait for a block while holding others
+		clear();
+		lock = block->lock_unique_rec();
+	}
+
+	size_t i = m_size;
+	if (m_size < WAYS) {
+		++m_size;
+	} else {
+		i = 0;
+		for (size_t j = 1; j < m_size; ++j)
+			if (m_entries[j].used < m_entries[i].used)
+				i = j;
+	}
+
+	auto &e = m_entries[i];
+	// old lock goes first, while its block is still held
+	e.lock = std::move(lock);
+	e.block = std::move(block);
+	e.pos = blockpos;
+	e.used = ++m_clock;
+	m_last = i;
+	return e.block.get();
+}
+
+MapNode cached_map_block::getNode(const v3pos_t &pos)
+{
+	auto *block = getBlock(getNodeBlockPos(pos));
+	if (!block)
+		return m_map->getNode(pos);
+	return block->getNodeNoLock(pos - block->getPosRelative());
+}
+
+void cached_map_block::setNode(const v3pos_t &pos, const MapNode &n, bool important)
+{
+	auto *block = getBlock(getNodeBlockPos(pos));
+	if (!block)
+		return m_map->setNode(pos, n, important);
+	block->setNodeNoLock(pos - block->getPosRelative(), n, important);
+}
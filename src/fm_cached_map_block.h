@@ -0,0 +1,92 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include "irr_v3d.h"
+#include "mapblock.h"
+#include "mapnode.h"
+
+class Map;
+
+/*
+Small N-way LRU cache of locked map blocks for code that walks nodes and
+their neighbours: liquids, lighting, node updates.
+
+Blocks stay locked (unique) while they are in the cache, so repeated access
+to a 3x3x3 block neighbourhood costs neither Map::getBlock nor a lock.
+To never deadlock against other threads the cache does not wait for a lock
+while it holds others: a busy block first releases everything.
+Locks are also released every RELEASE_EVERY lookups, long walks must not
+starve other threads.
+
+Hits and misses are summed per thread on destruction and reported to
+g_profiler about once a second.
+Not thread safe, use one instance per thread on the stack.
+*/
+
+class cached_map_block
+{
+public:
+	// 3x3x3 neighbourhood
+	static constexpr size_t WAYS = 27;
+	static constexpr uint32_t RELEASE_EVERY = 4096;
+
+	explicit cached_map_block(Map *map, const char *profiler_name = "Map");
+	~cached_map_block();
+	cached_map_block(const cached_map_block &) = delete;
+	cached_map_block &operator=(const cached_map_block &) = delete;
+
+	// Locked block, nullptr if not loaded.
+	// With try_lock a block locked by someone else is not waited for:
+	// nullptr is returned and busy set.
+	// The pointer is valid until the next call of this cache.
+	MapBlock *getBlock(const v3bpos_t &blockpos, bool try_lock = false,
+			bool *busy = nullptr);
+
+	// Falls back to Map for not loaded blocks (ignore / InvalidPositionException)
+	MapNode getNode(const v3pos_t &pos);
+	void setNode(const v3pos_t &pos, const MapNode &n, bool important = false);
+
+	// Release all blocks and locks
+	void clear();
+
+	uint32_t hits() const { return m_hit; }
+	uint32_t misses() const { return m_miss; }
+
+private:
+	struct entry
+	{
+		v3bpos_t pos;
+		MapBlockPtr block;
+		std::unique_ptr<MapBlock::lock_rec_unique> lock;
+		uint32_t used = 0;
+	};
+
+	Map *m_map;
+	const char *m_profiler_name;
+	std::array<entry, WAYS> m_entries;
+	size_t m_size = 0;
+	// most recently used entry, most lookups hit it
+	size_t m_last = 0;
+	uint32_t m_clock = 0;
+	uint32_t m_lookups = 0;
+	uint32_t m_hit = 0, m_miss = 0;
+};
@@ -50,15 +50,9 @@ int RemoteClient::GetNextBlocksFm(ServerEnvironment *env, EmergeManager *emerge,
 	if (sao == NULL)
 		return 0;
 
-	/*
-		// Won't send anything if already sending
-		if(m_blocks_sending.size() >= g_settings->getU16
-				("max_simultaneous_block_sends_per_client"))
-		{
-			//infostream<<"Not sending any blocks, Queue full."<<std::endl;
-			return;
-		}
-	*/
+	// Won't send anything if the send window is full
+	if (!m_send_window.available())
+		return 0;
 
 	auto playerpos = sao->getBasePosition();
 
@@ -125,7 +119,7 @@ int RemoteClient::GetNextBlocksFm(ServerEnvironment *env, EmergeManager *emerge,
 
 	thread_local static const u16 max_simul_sends_setting =
 			g_settings->getU16("max_simultaneous_block_sends_per_client");
-	thread_local static const u16 max_simul_sends_usually = max_simul_sends_setting;
+	const u32 max_simul_sends_usually = m_send_window.limit();
 
 	/*
 		Check the time from last addNode/removeNode.
@@ -154,7 +148,7 @@ int RemoteClient::GetNextBlocksFm(ServerEnvironment *env, EmergeManager *emerge,
 		Number of blocks sending + number of blocks selected for sending
 	*/
 	u32 num_blocks_selected = 0;
-	u32 num_blocks_sending = 0;
+	const u32 num_blocks_sending = m_send_window.inFlight();
 
 	/*
 		next time d will be continued from the d from which the nearest
@@ -296,11 +290,12 @@ int RemoteClient::GetNextBlocksFm(ServerEnvironment *env, EmergeManager *emerge,
 			*/
 
 			// Start with the usual maximum
-			u16 max_simul_dynamic = max_simul_sends_usually;
+			u32 max_simul_dynamic = max_simul_sends_usually;
 
 			// If block is very close, allow full maximum
 			if (d <= BLOCK_ALWAYS_SEND_MAX_D)
-				max_simul_dynamic = max_simul_sends_setting;
+				max_simul_dynamic =
+						std::max<u32>(max_simul_sends_usually, max_simul_sends_setting);
 
 			// Don't select too many blocks for sending
 			if (num_blocks_selected + num_blocks_sending >= max_simul_dynamic) {
@@ -697,8 +692,8 @@ uint32_t RemoteClient::SendFarBlocks(const int32_t uptime)
 		std::vector<MapBlockPtr> blocks;
 		const auto send = [&]() {
 			if (!blocks.empty()) {
-				m_env->m_server->SendBlocksFm(
-						peer_id, blocks, serialization_version, net_proto_version);
+				m_env->m_server->SendBlocksFm(peer_id, blocks, serialization_version,
+						net_proto_version, nullptr, net_zstd_dictionary);
 			}
 		};
 		for (auto it = ordered.rbegin(); it != ordered.rend(); ++it) {
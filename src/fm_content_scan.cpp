@@ -0,0 +1,226 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_content_scan.h"
+
+#include <algorithm>
+#include <array>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CONTENT_SCAN_SSE2 1
+#define CONTENT_SCAN_AVX2 1
+#include <immintrin.h>
+#endif
+
+// Nodes are loaded as 32 bit lanes with the content in the low half
+static_assert(sizeof(MapNode) == 4);
+
+namespace content_scan
+{
+
+namespace
+{
+
+// Blocks are mostly long runs of one content: the kernels compare a vector
+// of nodes with the last content, only nodes after a change are looked up.
+
+using seen_bits = std::array<uint64_t, CONTENT_ID_CAPACITY / 64>;
+
+struct collector
+{
+	seen_bits &seen;
+	std::vector<content_t> &out;
+	content_t last;
+
+	void add(content_t c)
+	{
+		if (c == last)
+			return;
+		last = c;
+		auto &word = seen[c / 64];
+		const auto bit = uint64_t(1) << (c % 64);
+		if (!(word & bit)) {
+			word |= bit;
+			out.emplace_back(c);
+		}
+	}
+
+	void add(const MapNode *data, size_t begin, size_t count)
+	{
+		for (size_t i = begin; i < count; ++i)
+			add(data[i].param0);
+	}
+};
+
+using collect_func = void (*)(const MapNode *data, size_t count, collector &col);
+using match_func = void (*)(const MapNode *data, size_t count, const content_t *values,
+		size_t values_count, uint64_t *mask);
+
+void collect_scalar(const MapNode *data, size_t count, collector &col)
+{
+	col.add(data, 0, count);
+}
+
+void match_scalar(const MapNode *data, size_t begin, size_t count, const content_t *values,
+		size_t values_count, uint64_t *mask)
+{
+	for (size_t i = begin; i < count; ++i)
+		if (std::find(values, values + values_count, data[i].param0) !=
+				values + values_count)
+			mask[i / 64] |= uint64_t(1) << (i % 64);
+}
+
+void match_scalar(const MapNode *data, size_t count, const content_t *values,
+		size_t values_count, uint64_t *mask)
+{
+	match_scalar(data, 0, count, values, values_count, mask);
+}
+
+#if CONTENT_SCAN_SSE2
+
+void collect_sse2(const MapNode *data, size_t count, collector &col)
+{
+	const auto content_mask = _mm_set1_epi32(0xffff);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const auto v = _mm_and_si128(
+				_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), content_mask);
+		const auto last = _mm_set1_epi32(col.last);
+		if (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, last))) != 0xf)
+			col.add(data, i, i + 4);
+	}
+	col.add(data, i, count);
+}
+
+void match_sse2(const MapNode *data, size_t count, const content_t *values,
+		size_t values_count, uint64_t *mask)
+{
+	const auto content_mask = _mm_set1_epi32(0xffff);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const auto v = _mm_and_si128(
+				_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), content_mask);
+		auto any = _mm_setzero_si128();
+		for (size_t j = 0; j < values_count; ++j)
+			any = _mm_or_si128(any, _mm_cmpeq_epi32(v, _mm_set1_epi32(values[j])));
+		if (const uint64_t bits = _mm_movemask_ps(_mm_castsi128_ps(any)))
+			mask[i / 64] |= bits << (i % 64);
+	}
+	match_scalar(data, i, count, values, values_count, mask);
+}
+
+#endif
+
+#if CONTENT_SCAN_AVX2
+
+__attribute__((target("avx2"))) void collect_avx2(
+		const MapNode *data, size_t count, collector &col)
+{
+	const auto content_mask = _mm256_set1_epi32(0xffff);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const auto v = _mm256_and_si256(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)),
+				content_mask);
+		const auto last = _mm256_set1_epi32(col.last);
+		if (_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, last))) != 0xff)
+			col.add(data, i, i + 8);
+	}
+	col.add(data, i, count);
+}
+
+__attribute__((target("avx2"))) void match_avx2(const MapNode *data, size_t count,
+		const content_t *values, size_t values_count, uint64_t *mask)
+{
+	const auto content_mask = _mm256_set1_epi32(0xffff);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const auto v = _mm256_and_si256(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)),
+				content_mask);
+		auto any = _mm256_setzero_si256();
+		for (size_t j = 0; j < values_count; ++j)
+			any = _mm256_or_si256(
+					any, _mm256_cmpeq_epi32(v, _mm256_set1_epi32(values[j])));
+		if (const uint64_t bits = _mm256_movemask_ps(_mm256_castsi256_ps(any)))
+			mask[i / 64] |= bits << (i % 64);
+	}
+	match_scalar(data, i, count, values, values_count, mask);
+}
+
+#endif
+
+struct kernels
+{
+	collect_func collect = collect_scalar;
+	match_func match = match_scalar;
+	const char *name = "scalar";
+
+	kernels()
+	{
+#if CONTENT_SCAN_AVX2
+		if (__builtin_cpu_supports("avx2")) {
+			collect = collect_avx2;
+			match = match_avx2;
+			name = "avx2";
+			return;
+		}
+#endif
+#if CONTENT_SCAN_SSE2
+		collect = collect_sse2;
+		match = match_sse2;
+		name = "sse2";
+#endif
+	}
+};
+
+const kernels &get()
+{
+	static const kernels k;
+	return k;
+}
+
+}
+
+void collect(const MapNode *data, size_t count, std::vector<content_t> &out)
+{
+	out.clear();
+	if (!count)
+		return;
+	thread_local seen_bits seen{};
+	collector col{seen, out, data[0].param0};
+	seen[col.last / 64] |= uint64_t(1) << (col.last % 64);
+	out.emplace_back(col.last);
+	get().collect(data, count, col);
+	for (const auto c : out)
+		seen[c / 64] = 0;
+}
+
+void match(const MapNode *data, size_t count, const content_t *values, size_t values_count,
+		uint64_t *mask)
+{
+	std::fill(mask, mask + (count + 63) / 64, 0);
+	if (values_count)
+		get().match(data, count, values, values_count, mask);
+}
+
+const char *implementation()
+{
+	return get().name;
+}
+
+}
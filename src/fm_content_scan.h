@@ -0,0 +1,43 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mapnode.h"
+
+/*
+Scans of the contents of node arrays, for ABM analysis of whole blocks.
+AVX2 or SSE2 on x86-64, chosen at runtime, scalar elsewhere.
+*/
+
+namespace content_scan
+{
+// Distinct contents of count nodes, in order of first appearance
+void collect(const MapNode *data, size_t count, std::vector<content_t> &out);
+
+// Set bit i of mask (count / 64 words, rounded up) for every node i
+// with content in values
+void match(const MapNode *data, size_t count, const content_t *values, size_t values_count,
+		uint64_t *mask);
+
+// "avx2", "sse2" or "scalar"
+const char *implementation();
+}
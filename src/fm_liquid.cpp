@@ -22,6 +22,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "constants.h"
 
 #include "emerge.h"
+#include "fm_cached_map_block.h"
 #include "gamedef.h"
 #include "irr_v3d.h"
 #include "map.h"
@@ -33,9 +34,11 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "serverenvironment.h"
 #include "servermap.h"
 #include "settings.h"
+#include "threading/job_scheduler.h"
 #include "util/unordered_map_hash.h"
 #include <cstddef>
 #include <cstdint>
+#include <numeric>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -101,100 +104,90 @@ v3pos_t ServerMap::transforming_liquid_pop()
 	// return value;
 }
 
-class cached_map_block
-{
-	Map *map_{};
-	MapBlockPtr cached_block;
-	v3bpos_t cached_block_pos;
-	std::unique_ptr<MapBlock::lock_rec_unique> lock;
+namespace {
+// Liquid regions are cubes of 2x2x2 blocks. A node that is not on a region face
+// only reads and writes nodes of its own region, so the interiors of all regions
+// can be transformed concurrently. Face nodes are done afterwards in one pass.
+constexpr pos_t LIQUID_REGION_SIZE = MAP_BLOCKSIZE * 2;
 
-	int hit = 0, miss = 0;
+// Smaller queues are not worth the thread handoff
+constexpr size_t LIQUID_PARALLEL_MIN = 1000;
 
-public:
-	cached_map_block(Map *map) : map_{map} {}
-	~cached_map_block()
-	{
-		//DUMP(hit, miss, hit / (miss ? miss : 1));
-	}
+bool liquid_region_border(const v3pos_t &p)
+{
+	const auto face = [](pos_t c) {
+		const auto rel = c & (LIQUID_REGION_SIZE - 1);
+		return !rel || rel == LIQUID_REGION_SIZE - 1;
+	};
+	return face(p.X) || face(p.Y) || face(p.Z);
+}
 
-	MapBlockPtr change_block(const v3pos_t &pos)
-	{
-		auto blockpos = getNodeBlockPos(pos);
-		if (cached_block_pos == blockpos && cached_block) {
-			++hit;
-			return cached_block;
-		}
-		++miss;
-		lock = {};
-		cached_block = map_->getBlock(blockpos);
-		if (!cached_block)
-			return {};
-		cached_block_pos = blockpos;
-		lock = cached_block->lock_unique_rec();
-		return cached_block;
-	}
+// Pending nodes of one region and everything their transformation produced
+struct liquid_region_state
+{
+	// indexes in transforming_liquid_local, in queue order
+	std::vector<size_t> nodes;
+
+	std::unordered_set<v3bpos_t> node_update, node_drop;
+	std::vector<v3pos_t> must_reflow;
+	std::unordered_map<v3bpos_t, std::vector<v3pos_t>> fast_reflow;
+	std::unordered_map<v3bpos_t, size_t> falling;
+	unordered_set_v3bpos blocks_lighting_update;
+	size_t regenerated = 0;
 
-	MapNode getNode(const v3pos_t &pos)
+	void reflow(const v3pos_t &pos)
 	{
-		if (!change_block(pos)) {
-			return map_->getNode(pos);
+		const auto blockpos = getNodeBlockPos(pos);
+		v3pos_t relpos = pos - blockpos * MAP_BLOCKSIZE;
+		if (!relpos.X || !relpos.Y || !relpos.Z || relpos.X == MAP_BLOCKSIZE - 1 ||
+				relpos.Y == MAP_BLOCKSIZE - 1 || relpos.Z == MAP_BLOCKSIZE - 1) {
+			must_reflow.emplace_back(pos);
+			return;
 		}
-		v3pos_t relpos = pos - cached_block_pos * MAP_BLOCKSIZE;
-		return cached_block->getNodeNoLock(relpos);
+		fast_reflow[blockpos].emplace_back(pos);
 	}
 
-	void setNode(const v3pos_t &pos, const MapNode &n, bool important = false)
+	void merge(liquid_region_state &other)
 	{
-		if (!change_block(pos)) {
-			return map_->setNode(pos, n, important);
+		node_update.merge(other.node_update);
+		node_drop.merge(other.node_drop);
+		must_reflow.insert(
+				must_reflow.end(), other.must_reflow.begin(), other.must_reflow.end());
+		for (auto &[bp, list] : other.fast_reflow) {
+			auto &to = fast_reflow[bp];
+			to.insert(to.end(), list.begin(), list.end());
 		}
-		v3pos_t relpos = pos - cached_block_pos * MAP_BLOCKSIZE;
-		return cached_block->setNodeNoLock(relpos, n, important);
+		for (const auto &[bp, count] : other.falling)
+			falling[bp] += count;
+		blocks_lighting_update.merge(other.blocks_lighting_update);
+		regenerated += other.regenerated;
 	}
 };
+}
 
 size_t ServerMap::transformLiquidsReal(Server *m_server, unsigned int max_cycle_ms)
 {
 	const auto *nodemgr = m_nodedef;
 
 	// TimeTaker timer("transformLiquidsReal()");
-	size_t loopcount = 0;
+	const auto start_us = porting::getTimeUs();
 	const auto initial_size =
 			transforming_liquid_size() - m_transforming_liquid_local_size;
 
-	size_t regenerated = 0;
-
 #if LIQUID_DEBUG
 	bool debug = 1;
 #endif
 
-	thread_local static const uint8_t relax = g_settings->getS16("liquid_relax");
-	thread_local static const auto fast_flood = g_settings->getS16("liquid_fast_flood");
-	thread_local static const int water_level = g_settings->getS16("water_level");
+	// not thread_local: also read from the liquid worker threads
+	static const uint8_t relax = g_settings->getS16("liquid_relax");
+	static const auto fast_flood = g_settings->getS16("liquid_fast_flood");
+	static const int water_level = g_settings->getS16("water_level");
+	static const bool liquid_parallel = g_settings->getBool("liquid_parallel");
 	const int16_t liquid_pressure = m_server->m_emerge->mgparams->liquid_pressure;
 	// g_settings->getS16NoEx("liquid_pressure", liquid_pressure);
 
-	// list of nodes that due to viscosity have not reached their max level height
-	// unordered_map_v3pos<bool> must_reflow, must_reflow_second, must_reflow_third;
-	std::unordered_set<v3bpos_t> node_update, node_drop;
-	std::list<v3pos_t> must_reflow, must_reflow_second; //, must_reflow_third;
-	std::unordered_map<v3bpos_t, std::list<v3pos_t>> fast_reflow;
-	const auto reflow = [&must_reflow, &fast_reflow](const v3pos_t &pos) {
-		const auto blockpos = getNodeBlockPos(pos);
-		v3pos_t relpos = pos - blockpos * MAP_BLOCKSIZE;
-		if (!relpos.X || !relpos.Y || !relpos.Z || relpos.X == MAP_BLOCKSIZE - 1 ||
-				relpos.Y == MAP_BLOCKSIZE - 1 || relpos.Z == MAP_BLOCKSIZE - 1) {
-			must_reflow.emplace_back(pos);
-			return;
-		}
-		fast_reflow[blockpos].emplace_back(pos);
-	};
-
-	// List of MapBlocks that will require a lighting update (due to lava)
-	std::unordered_map<v3bpos_t, size_t> falling;
-	uint16_t loop_rand = myrand();
+	const uint16_t loop_rand = myrand();
 
-	unordered_set_v3bpos blocks_lighting_update;
 	std::vector<v3pos_t> transforming_liquid_local;
 
 	const auto end_ms = porting::getTimeMs() + max_cycle_ms;
@@ -211,710 +204,757 @@ size_t ServerMap::transformLiquidsReal(Server *m_server, unsigned int max_cycle_
 		m_transforming_liquid_local_size = transforming_liquid_local.size();
 	}
 
-	{
-		cached_map_block cached_map(this);
-
-		for (const auto &p0 : transforming_liquid_local) {
-			// This should be done here so that it is done when continue is used
-			//if (loopcount >= initial_size * 2 || porting::getTimeMs() > end_ms)
-			//	break;
-			++loopcount;
-			/*
-			Get a queued transforming liquid node
-		*/
-			//v3pos_t p0;
-			{
-				// MutexAutoLock lock(m_transforming_liquid_mutex);
-				// p0 = transforming_liquid_pop();
+	// loopcount is the 1-based queue index of p0, it drives the pseudo random
+	// choices below, so the result does not depend on which thread runs a node
+	const auto transform_node = [&](liquid_region_state &state,
+										cached_map_block &cached_map, const v3pos_t &p0,
+										const size_t loopcount) {
+		auto &node_update = state.node_update;
+		auto &node_drop = state.node_drop;
+		auto &falling = state.falling;
+		auto &blocks_lighting_update = state.blocks_lighting_update;
+		auto &regenerated = state.regenerated;
+		const auto reflow = [&state](const v3pos_t &pos) { state.reflow(pos); };
+		int16_t total_level = 0;
+		// u16 level_max = 0;
+		//  surrounding flowing liquid nodes
+		NodeNeighbor neighbors[7] = {{}};
+		// current level of every block
+		int8_t liquid_levels[7] = {-1, -1, -1, -1, -1, -1, -1};
+		// target levels
+		int8_t liquid_levels_want[7] = {-1, -1, -1, -1, -1, -1, -1};
+		int8_t can_liquid_same_level = 0;
+		int8_t can_liquid = 0;
+		// warning! when MINETEST_PROTO enabled - CONTENT_IGNORE != 0
+		content_t liquid_kind = CONTENT_IGNORE;
+		content_t liquid_kind_flowing = CONTENT_IGNORE;
+		content_t melt_kind = CONTENT_IGNORE;
+		content_t melt_kind_flowing = CONTENT_IGNORE;
+		// s8 viscosity = 0;
+
+		bool fall_down = false;
+		/*
+		Collect information about the environment, start from self
+	 */
+		bool want_continue = false;
+		for (uint8_t e = D_BOTTOM; e <= D_TOP; e++) {
+			uint8_t i = liquid_explore_map[e];
+			NodeNeighbor &nb = neighbors[i];
+			nb.pos = p0 + liquid_flow_dirs[i];
+			nb.node = cached_map.getNode(neighbors[i].pos);
+			nb.content = nb.node.getContent();
+			NeighborType nt = NEIGHBOR_SAME_LEVEL;
+			switch (i) {
+			case D_TOP:
+				nt = NEIGHBOR_UPPER;
+				break;
+			case D_BOTTOM:
+				nt = NEIGHBOR_LOWER;
+				break;
+			}
+			nb.type = nt;
+			nb.liquid = 0;
+			nb.infinity = 0;
+			nb.weight = 0;
+			nb.drop = 0;
+
+			if (!nb.node) {
+				//if (i == D_SELF && (loopcount % 8) && initial_size < m_liquid_step_flow * 3)	// must_reflow_third[nb.pos] = 1;
+				//	must_reflow_third.emplace_back(nb.pos);
+				continue;
 			}
-			int16_t total_level = 0;
-			// u16 level_max = 0;
-			//  surrounding flowing liquid nodes
-			NodeNeighbor neighbors[7] = {{}};
-			// current level of every block
-			int8_t liquid_levels[7] = {-1, -1, -1, -1, -1, -1, -1};
-			// target levels
-			int8_t liquid_levels_want[7] = {-1, -1, -1, -1, -1, -1, -1};
-			int8_t can_liquid_same_level = 0;
-			int8_t can_liquid = 0;
-			// warning! when MINETEST_PROTO enabled - CONTENT_IGNORE != 0
-			content_t liquid_kind = CONTENT_IGNORE;
-			content_t liquid_kind_flowing = CONTENT_IGNORE;
-			content_t melt_kind = CONTENT_IGNORE;
-			content_t melt_kind_flowing = CONTENT_IGNORE;
-			// s8 viscosity = 0;
-
-			bool fall_down = false;
-			/*
-			Collect information about the environment, start from self
-		 */
-			bool want_continue = false;
-			for (uint8_t e = D_BOTTOM; e <= D_TOP; e++) {
-				uint8_t i = liquid_explore_map[e];
-				NodeNeighbor &nb = neighbors[i];
-				nb.pos = p0 + liquid_flow_dirs[i];
-				nb.node = cached_map.getNode(neighbors[i].pos);
-				nb.content = nb.node.getContent();
-				NeighborType nt = NEIGHBOR_SAME_LEVEL;
-				switch (i) {
-				case D_TOP:
-					nt = NEIGHBOR_UPPER;
-					break;
-				case D_BOTTOM:
-					nt = NEIGHBOR_LOWER;
-					break;
-				}
-				nb.type = nt;
-				nb.liquid = 0;
-				nb.infinity = 0;
-				nb.weight = 0;
-				nb.drop = 0;
-
-				if (!nb.node) {
-					//if (i == D_SELF && (loopcount % 8) && initial_size < m_liquid_step_flow * 3)	// must_reflow_third[nb.pos] = 1;
-					//	must_reflow_third.emplace_back(nb.pos);
-					continue;
-				}
 
-				const auto &f = nodemgr->get(nb.content);
-				switch (f.liquid_type) {
-				case LIQUID_NONE:
-					if (nb.content == CONTENT_AIR) {
-						liquid_levels[i] = 0;
+			const auto &f = nodemgr->get(nb.content);
+			switch (f.liquid_type) {
+			case LIQUID_NONE:
+				if (nb.content == CONTENT_AIR) {
+					liquid_levels[i] = 0;
+					nb.liquid = 1;
+				}
+				// TODO: if (nb.content == CONTENT_AIR ||
+				// nodemgr->get(nb.node).buildable_to && !nodemgr->get(nb.node).walkable)
+				// { // need lua drop api for drop torches
+				else if (melt_kind_flowing != CONTENT_IGNORE &&
+						 nb.content == melt_kind_flowing &&
+						 nb.type != NEIGHBOR_UPPER && !(loopcount % 2)) {
+					uint8_t melt_max_level = nb.node.getMaxLevel(nodemgr);
+					uint8_t my_max_level =
+							MapNode(liquid_kind_flowing).getMaxLevel(nodemgr);
+					liquid_levels[i] =
+							((float)my_max_level / (melt_max_level ? melt_max_level
+																   : my_max_level)) *
+							nb.node.getLevel(nodemgr);
+					if (liquid_levels[i])
 						nb.liquid = 1;
-					}
-					// TODO: if (nb.content == CONTENT_AIR ||
-					// nodemgr->get(nb.node).buildable_to && !nodemgr->get(nb.node).walkable)
-					// { // need lua drop api for drop torches
-					else if (melt_kind_flowing != CONTENT_IGNORE &&
-							 nb.content == melt_kind_flowing &&
-							 nb.type != NEIGHBOR_UPPER && !(loopcount % 2)) {
-						uint8_t melt_max_level = nb.node.getMaxLevel(nodemgr);
-						uint8_t my_max_level =
-								MapNode(liquid_kind_flowing).getMaxLevel(nodemgr);
-						liquid_levels[i] =
-								((float)my_max_level / (melt_max_level ? melt_max_level
-																	   : my_max_level)) *
-								nb.node.getLevel(nodemgr);
-						if (liquid_levels[i])
-							nb.liquid = 1;
-					} else if (melt_kind != CONTENT_IGNORE && nb.content == melt_kind &&
-							   nb.type != NEIGHBOR_UPPER && !(loopcount % 8)) {
-						liquid_levels[i] =
-								nodemgr->get(liquid_kind_flowing).getMaxLevel();
-						if (liquid_levels[i])
-							nb.liquid = 1;
-					} else {
-						int drop = ((ItemGroupList)f.groups)["drop_by_liquid"];
-						if (drop && !(loopcount % drop)) {
-							liquid_levels[i] = 0;
-							nb.liquid = 1;
-							nb.drop = 1;
-						}
-					}
-
-					// todo: for erosion add something here..
-					break;
-				case LIQUID_SOURCE:
-					// if this node is not (yet) of a liquid type,
-					// choose the first liquid type we encounter
-					if (liquid_kind_flowing == CONTENT_IGNORE)
-						liquid_kind_flowing = f.liquid_alternative_flowing_id;
-					if (liquid_kind == CONTENT_IGNORE)
-						liquid_kind = nb.content;
-					if (liquid_kind_flowing == CONTENT_IGNORE)
-						liquid_kind_flowing = liquid_kind;
-					if (melt_kind == CONTENT_IGNORE)
-						melt_kind = f.melt_id;
-					if (melt_kind_flowing == CONTENT_IGNORE)
-						melt_kind_flowing =
-								nodemgr->get(f.melt_id).liquid_alternative_flowing_id;
-					if (melt_kind_flowing == CONTENT_IGNORE)
-						melt_kind_flowing = melt_kind;
-					if (nb.content == liquid_kind) {
+				} else if (melt_kind != CONTENT_IGNORE && nb.content == melt_kind &&
+						   nb.type != NEIGHBOR_UPPER && !(loopcount % 8)) {
+					liquid_levels[i] =
+							nodemgr->get(liquid_kind_flowing).getMaxLevel();
+					if (liquid_levels[i])
 						nb.liquid = 1;
-						if (nb.node.param2 & LIQUID_STABLE_MASK)
-							continue;
-						liquid_levels[i] =
-								nb.node.getLevel(nodemgr); // LIQUID_LEVEL_SOURCE;
-						nb.infinity = (nb.node.param2 & LIQUID_INFINITY_MASK);
-					}
-					break;
-				case LIQUID_FLOWING:
-					// if this node is not (yet) of a liquid type,
-					// choose the first liquid type we encounter
-					if (liquid_kind_flowing == CONTENT_IGNORE)
-						liquid_kind_flowing = nb.content;
-					if (liquid_kind == CONTENT_IGNORE)
-						liquid_kind = f.liquid_alternative_source_id;
-					if (liquid_kind == CONTENT_IGNORE)
-						liquid_kind = liquid_kind_flowing;
-					if (melt_kind_flowing == CONTENT_IGNORE)
-						melt_kind_flowing = f.melt_id;
-					if (melt_kind == CONTENT_IGNORE)
-						melt_kind = nodemgr->get(f.melt_id).liquid_alternative_source_id;
-					if (melt_kind == CONTENT_IGNORE)
-						melt_kind = melt_kind_flowing;
-					if (nb.content == liquid_kind_flowing) {
+				} else {
+					int drop = ((ItemGroupList)f.groups)["drop_by_liquid"];
+					if (drop && !(loopcount % drop)) {
+						liquid_levels[i] = 0;
 						nb.liquid = 1;
-						if (nb.node.param2 & LIQUID_STABLE_MASK)
-							continue;
-						liquid_levels[i] = nb.node.getLevel(nodemgr);
-						nb.infinity = (nb.node.param2 & LIQUID_INFINITY_MASK);
+						nb.drop = 1;
 					}
-					break;
-					case LiquidType_END:
-					break;
 				}
 
-				// DUMP(i, nb.liquid, nb.infinity, (int)liquid_levels[i], f.name);
-
-				// only self, top, bottom swap
-				if (f.liquid_type && e <= 2) {
-					try {
-						nb.weight = ((ItemGroupList)f.groups)["weight"];
-						if (e == 1 && neighbors[D_BOTTOM].weight &&
-								neighbors[D_SELF].weight > neighbors[D_BOTTOM].weight) {
-							cached_map.setNode(
-									neighbors[D_SELF].pos, neighbors[D_BOTTOM].node);
-							cached_map.setNode(
-									neighbors[D_BOTTOM].pos, neighbors[D_SELF].node);
-							// must_reflow_second[neighbors[D_SELF].pos] = 1;
-							// must_reflow_second[neighbors[D_BOTTOM].pos] = 1;
-							//must_reflow_second.emplace_back(neighbors[D_SELF].pos);
-							//must_reflow_second.emplace_back(neighbors[D_BOTTOM].pos);
-							reflow(neighbors[D_BOTTOM].pos);
-							reflow(neighbors[D_BOTTOM].pos);
+				// todo: for erosion add something here..
+				break;
+			case LIQUID_SOURCE:
+				// if this node is not (yet) of a liquid type,
+				// choose the first liquid type we encounter
+				if (liquid_kind_flowing == CONTENT_IGNORE)
+					liquid_kind_flowing = f.liquid_alternative_flowing_id;
+				if (liquid_kind == CONTENT_IGNORE)
+					liquid_kind = nb.content;
+				if (liquid_kind_flowing == CONTENT_IGNORE)
+					liquid_kind_flowing = liquid_kind;
+				if (melt_kind == CONTENT_IGNORE)
+					melt_kind = f.melt_id;
+				if (melt_kind_flowing == CONTENT_IGNORE)
+					melt_kind_flowing =
+							nodemgr->get(f.melt_id).liquid_alternative_flowing_id;
+				if (melt_kind_flowing == CONTENT_IGNORE)
+					melt_kind_flowing = melt_kind;
+				if (nb.content == liquid_kind) {
+					nb.liquid = 1;
+					if (nb.node.param2 & LIQUID_STABLE_MASK)
+						continue;
+					liquid_levels[i] =
+							nb.node.getLevel(nodemgr); // LIQUID_LEVEL_SOURCE;
+					nb.infinity = (nb.node.param2 & LIQUID_INFINITY_MASK);
+				}
+				break;
+			case LIQUID_FLOWING:
+				// if this node is not (yet) of a liquid type,
+				// choose the first liquid type we encounter
+				if (liquid_kind_flowing == CONTENT_IGNORE)
+					liquid_kind_flowing = nb.content;
+				if (liquid_kind == CONTENT_IGNORE)
+					liquid_kind = f.liquid_alternative_source_id;
+				if (liquid_kind == CONTENT_IGNORE)
+					liquid_kind = liquid_kind_flowing;
+				if (melt_kind_flowing == CONTENT_IGNORE)
+					melt_kind_flowing = f.melt_id;
+				if (melt_kind == CONTENT_IGNORE)
+					melt_kind = nodemgr->get(f.melt_id).liquid_alternative_source_id;
+				if (melt_kind == CONTENT_IGNORE)
+					melt_kind = melt_kind_flowing;
+				if (nb.content == liquid_kind_flowing) {
+					nb.liquid = 1;
+					if (nb.node.param2 & LIQUID_STABLE_MASK)
+						continue;
+					liquid_levels[i] = nb.node.getLevel(nodemgr);
+					nb.infinity = (nb.node.param2 & LIQUID_INFINITY_MASK);
+				}
+				break;
+				case LiquidType_END:
+				break;
+			}
+
+			// DUMP(i, nb.liquid, nb.infinity, (int)liquid_levels[i], f.name);
+
+			// only self, top, bottom swap
+			if (f.liquid_type && e <= 2) {
+				try {
+					nb.weight = ((ItemGroupList)f.groups)["weight"];
+					if (e == 1 && neighbors[D_BOTTOM].weight &&
+							neighbors[D_SELF].weight > neighbors[D_BOTTOM].weight) {
+						cached_map.setNode(
+								neighbors[D_SELF].pos, neighbors[D_BOTTOM].node);
+						cached_map.setNode(
+								neighbors[D_BOTTOM].pos, neighbors[D_SELF].node);
+						// must_reflow_second[neighbors[D_SELF].pos] = 1;
+						// must_reflow_second[neighbors[D_BOTTOM].pos] = 1;
+						//must_reflow_second.emplace_back(neighbors[D_SELF].pos);
+						//must_reflow_second.emplace_back(neighbors[D_BOTTOM].pos);
+						reflow(neighbors[D_BOTTOM].pos);
+						reflow(neighbors[D_BOTTOM].pos);
 #if LIQUID_DEBUG
-							infostream << "Liquid swap1" << neighbors[D_SELF].pos
-									   << nodemgr->get(neighbors[D_SELF].node).name
-									   << neighbors[D_SELF].node
-									   << " w=" << neighbors[D_SELF].weight << " VS "
-									   << neighbors[D_BOTTOM].pos
-									   << nodemgr->get(neighbors[D_BOTTOM].node).name
-									   << neighbors[D_BOTTOM].node
-									   << " w=" << neighbors[D_BOTTOM].weight
-									   << std::endl;
+						infostream << "Liquid swap1" << neighbors[D_SELF].pos
+								   << nodemgr->get(neighbors[D_SELF].node).name
+								   << neighbors[D_SELF].node
+								   << " w=" << neighbors[D_SELF].weight << " VS "
+								   << neighbors[D_BOTTOM].pos
+								   << nodemgr->get(neighbors[D_BOTTOM].node).name
+								   << neighbors[D_BOTTOM].node
+								   << " w=" << neighbors[D_BOTTOM].weight
+								   << std::endl;
 #endif
-							want_continue = true;
-							break;
-						}
-						if (e == 2 && neighbors[D_SELF].weight &&
-								neighbors[D_TOP].weight > neighbors[D_SELF].weight) {
-							cached_map.setNode(
-									neighbors[D_SELF].pos, neighbors[D_TOP].node);
-							cached_map.setNode(
-									neighbors[D_TOP].pos, neighbors[D_SELF].node);
-							// must_reflow_second[neighbors[D_SELF].pos] = 1;
-							// must_reflow_second[neighbors[D_TOP].pos] = 1;
-							//must_reflow_second.emplace_back(neighbors[D_SELF].pos);
-							//must_reflow_second.emplace_back(neighbors[D_TOP].pos);
-							reflow(neighbors[D_SELF].pos);
-							reflow(neighbors[D_TOP].pos);
+						want_continue = true;
+						break;
+					}
+					if (e == 2 && neighbors[D_SELF].weight &&
+							neighbors[D_TOP].weight > neighbors[D_SELF].weight) {
+						cached_map.setNode(
+								neighbors[D_SELF].pos, neighbors[D_TOP].node);
+						cached_map.setNode(
+								neighbors[D_TOP].pos, neighbors[D_SELF].node);
+						// must_reflow_second[neighbors[D_SELF].pos] = 1;
+						// must_reflow_second[neighbors[D_TOP].pos] = 1;
+						//must_reflow_second.emplace_back(neighbors[D_SELF].pos);
+						//must_reflow_second.emplace_back(neighbors[D_TOP].pos);
+						reflow(neighbors[D_SELF].pos);
+						reflow(neighbors[D_TOP].pos);
 #if LIQUID_DEBUG
-							infostream << "Liquid swap2" << neighbors[D_TOP].pos
-									   << nodemgr->get(neighbors[D_TOP].node).name
-									   << neighbors[D_TOP].node
-									   << " w=" << neighbors[D_TOP].weight << " VS "
-									   << neighbors[D_SELF].pos
-									   << nodemgr->get(neighbors[D_SELF].node).name
-									   << neighbors[D_SELF].node
-									   << " w=" << neighbors[D_SELF].weight << std::endl;
+						infostream << "Liquid swap2" << neighbors[D_TOP].pos
+								   << nodemgr->get(neighbors[D_TOP].node).name
+								   << neighbors[D_TOP].node
+								   << " w=" << neighbors[D_TOP].weight << " VS "
+								   << neighbors[D_SELF].pos
+								   << nodemgr->get(neighbors[D_SELF].node).name
+								   << neighbors[D_SELF].node
+								   << " w=" << neighbors[D_SELF].weight << std::endl;
 #endif
-							want_continue = true;
-							break;
-						}
-					} catch (const InvalidPositionException &e) {
-						verbosestream << "transformLiquidsReal: weight: setNode() failed:"
-									  << nb.pos << ":" << e.what() << std::endl;
-						// goto NEXT_LIQUID;
+						want_continue = true;
+						break;
 					}
+				} catch (const InvalidPositionException &e) {
+					verbosestream << "transformLiquidsReal: weight: setNode() failed:"
+								  << nb.pos << ":" << e.what() << std::endl;
+					// goto NEXT_LIQUID;
 				}
+			}
 
-				if (nb.liquid) {
-					liquid_levels_want[i] = 0;
-					++can_liquid;
-					if (nb.type == NEIGHBOR_SAME_LEVEL)
-						++can_liquid_same_level;
-				}
-				if (liquid_levels[i] > 0)
-					total_level += liquid_levels[i];
+			if (nb.liquid) {
+				liquid_levels_want[i] = 0;
+				++can_liquid;
+				if (nb.type == NEIGHBOR_SAME_LEVEL)
+					++can_liquid_same_level;
+			}
+			if (liquid_levels[i] > 0)
+				total_level += liquid_levels[i];
 
 #if LIQUID_DEBUG
-				infostream << "get node i=" << (int)i << " " << PP(nb.pos)
-						   << " c=" << nb.content << " p0=" << (int)nb.node.param0
-						   << " p1=" << (int)nb.node.param1
-						   << " p2=" << (int)nb.node.param2 << " lt="
-						   << f.liquid_type
-						   //<< " lk=" << liquid_kind << " lkf=" << liquid_kind_flowing
-						   << " l=" << nb.liquid << " inf=" << nb.infinity
-						   << " nlevel=" << (int)liquid_levels[i]
-						   << " totallevel=" << (int)total_level
-						   << " cansame=" << (int)can_liquid_same_level << " Lmax="
-						   << (int)nodemgr->get(liquid_kind_flowing).getMaxLevel()
-						   << std::endl;
+			infostream << "get node i=" << (int)i << " " << PP(nb.pos)
+					   << " c=" << nb.content << " p0=" << (int)nb.node.param0
+					   << " p1=" << (int)nb.node.param1
+					   << " p2=" << (int)nb.node.param2 << " lt="
+					   << f.liquid_type
+					   //<< " lk=" << liquid_kind << " lkf=" << liquid_kind_flowing
+					   << " l=" << nb.liquid << " inf=" << nb.infinity
+					   << " nlevel=" << (int)liquid_levels[i]
+					   << " totallevel=" << (int)total_level
+					   << " cansame=" << (int)can_liquid_same_level << " Lmax="
+					   << (int)nodemgr->get(liquid_kind_flowing).getMaxLevel()
+					   << std::endl;
 #endif
-			}
-			if (want_continue)
-				continue;
+		}
+		if (want_continue)
+			return;
 
-			if (liquid_kind == CONTENT_IGNORE || !neighbors[D_SELF].liquid ||
-					total_level <= 0)
-				continue;
+		if (liquid_kind == CONTENT_IGNORE || !neighbors[D_SELF].liquid ||
+				total_level <= 0)
+			return;
 
-			int16_t level_max = nodemgr->get(liquid_kind_flowing).getMaxLevel();
-			int16_t level_max_compressed =
-					nodemgr->get(liquid_kind_flowing).getMaxLevel(1);
-			int16_t pressure = liquid_pressure ? ((ItemGroupList)nodemgr->get(liquid_kind)
-																 .groups)["pressure"]
-											   : 0;
-			auto liquid_renewable = nodemgr->get(liquid_kind).liquid_renewable;
+		int16_t level_max = nodemgr->get(liquid_kind_flowing).getMaxLevel();
+		int16_t level_max_compressed =
+				nodemgr->get(liquid_kind_flowing).getMaxLevel(1);
+		int16_t pressure = liquid_pressure ? ((ItemGroupList)nodemgr->get(liquid_kind)
+															 .groups)["pressure"]
+										   : 0;
+		auto liquid_renewable = nodemgr->get(liquid_kind).liquid_renewable;
 #if LIQUID_DEBUG
-			s16 total_was = total_level; // debug
+		s16 total_was = total_level; // debug
 #endif
-			// viscosity = nodemgr->get(liquid_kind).viscosity;
+		// viscosity = nodemgr->get(liquid_kind).viscosity;
 
-			s16 level_avg = total_level / can_liquid;
-			if (!pressure && level_avg) {
-				level_avg = level_max;
-			}
+		s16 level_avg = total_level / can_liquid;
+		if (!pressure && level_avg) {
+			level_avg = level_max;
+		}
 
 #if LIQUID_DEBUG
-			if (debug)
-				infostream << " go: " << nodemgr->get(liquid_kind).name << " total_level="
-						   << (int)total_level
-						   //<<" total_was="<<(int)total_was
-						   << " level_max=" << (int)level_max
-						   << " level_max_compressed=" << (int)level_max_compressed
-						   << " level_avg=" << (int)level_avg
-						   << " pressure=" << (int)pressure
-						   << " can_liquid=" << (int)can_liquid
-						   << " can_liquid_same_level=" << (int)can_liquid_same_level
-						   << std::endl;
-			;
+		if (debug)
+			infostream << " go: " << nodemgr->get(liquid_kind).name << " total_level="
+					   << (int)total_level
+					   //<<" total_was="<<(int)total_was
+					   << " level_max=" << (int)level_max
+					   << " level_max_compressed=" << (int)level_max_compressed
+					   << " level_avg=" << (int)level_avg
+					   << " pressure=" << (int)pressure
+					   << " can_liquid=" << (int)can_liquid
+					   << " can_liquid_same_level=" << (int)can_liquid_same_level
+					   << std::endl;
+		;
 #endif
 
-			// fill bottom block
-			if (neighbors[D_BOTTOM].liquid) {
-				const auto bpos = getNodeBlockPos(neighbors[D_SELF].pos);
-				if (falling[bpos] <= 10 && !liquid_levels[D_BOTTOM] &&
-						((ItemGroupList)nodemgr->get(liquid_kind)
-										.groups)["falling_node"]) {
-					++falling[bpos];
-					fall_down = true;
-					node_update.emplace(neighbors[D_SELF].pos);
-					/*
-				if (m_server->getEnv().nodeUpdate(neighbors[D_SELF].pos, 2)) {
-
-					want_continue = true;
-					break;
-				} else {
-					falling[bpos] += 100;
-				}
+		// fill bottom block
+		if (neighbors[D_BOTTOM].liquid) {
+			const auto bpos = getNodeBlockPos(neighbors[D_SELF].pos);
+			if (falling[bpos] <= 10 && !liquid_levels[D_BOTTOM] &&
+					((ItemGroupList)nodemgr->get(liquid_kind)
+									.groups)["falling_node"]) {
+				++falling[bpos];
+				fall_down = true;
+				node_update.emplace(neighbors[D_SELF].pos);
+				/*
+			if (m_server->getEnv().nodeUpdate(neighbors[D_SELF].pos, 2)) {
+
+				want_continue = true;
+				break;
+			} else {
+				falling[bpos] += 100;
+			}
 */
-				}
+			}
 
-				liquid_levels_want[D_BOTTOM] = level_avg > level_max	 ? level_avg
-											   : total_level > level_max ? level_max
-																		 : total_level;
-				total_level -= liquid_levels_want[D_BOTTOM];
+			liquid_levels_want[D_BOTTOM] = level_avg > level_max	 ? level_avg
+										   : total_level > level_max ? level_max
+																	 : total_level;
+			total_level -= liquid_levels_want[D_BOTTOM];
 
-				// if (pressure && total_level && liquid_levels_want[D_BOTTOM] <
-				// level_max_compressed) {
-				//	++liquid_levels_want[D_BOTTOM];
-				//	--total_level;
-				// }
-			}
+			// if (pressure && total_level && liquid_levels_want[D_BOTTOM] <
+			// level_max_compressed) {
+			//	++liquid_levels_want[D_BOTTOM];
+			//	--total_level;
+			// }
+		}
 
-			// relax up
-			uint16_t relax_want = level_max * can_liquid_same_level;
-			if (liquid_renewable && relax &&
-					((p0.Y == water_level) ||
-							(fast_flood && p0.Y <= water_level && p0.Y > fast_flood)) &&
-					level_max > 1 && liquid_levels[D_TOP] == 0 &&
-					liquid_levels[D_BOTTOM] >= level_max &&
-					total_level >= relax_want - (can_liquid_same_level - relax) &&
-					total_level < relax_want && can_liquid_same_level >= relax + 1) {
-				regenerated += relax_want - total_level;
+		// relax up
+		uint16_t relax_want = level_max * can_liquid_same_level;
+		if (liquid_renewable && relax &&
+				((p0.Y == water_level) ||
+						(fast_flood && p0.Y <= water_level && p0.Y > fast_flood)) &&
+				level_max > 1 && liquid_levels[D_TOP] == 0 &&
+				liquid_levels[D_BOTTOM] >= level_max &&
+				total_level >= relax_want - (can_liquid_same_level - relax) &&
+				total_level < relax_want && can_liquid_same_level >= relax + 1) {
+			regenerated += relax_want - total_level;
 #if LIQUID_DEBUG
-				infostream << " relax_up: " << " total_level=" << (int)total_level
-						   << " to=> " << int(relax_want) << std::endl;
+			infostream << " relax_up: " << " total_level=" << (int)total_level
+					   << " to=> " << int(relax_want) << std::endl;
 #endif
-				total_level = relax_want;
-			}
+			total_level = relax_want;
+		}
 
-			// prevent lakes in air above unloaded blocks
-			if (liquid_levels[D_TOP] == 0 && p0.Y > water_level && level_max > 1 &&
-					!neighbors[D_BOTTOM].node && !(loopcount % 3)) {
-				--total_level;
+		// prevent lakes in air above unloaded blocks
+		if (liquid_levels[D_TOP] == 0 && p0.Y > water_level && level_max > 1 &&
+				!neighbors[D_BOTTOM].node && !(loopcount % 3)) {
+			--total_level;
 #if LIQUID_DEBUG
-				infostream << " above unloaded fix: " << " total_level="
-						   << (int)total_level << std::endl;
+			infostream << " above unloaded fix: " << " total_level="
+					   << (int)total_level << std::endl;
 #endif
-			}
-
-			// calculate self level 5 blocks
-			uint16_t want_level = level_avg > level_max ? level_avg
-								  : total_level >= level_max * can_liquid_same_level
-										  ? level_max
-										  : total_level / can_liquid_same_level;
-			total_level -= want_level * can_liquid_same_level;
+		}
 
-			/*
-				if (pressure && total_level > 0 && neighbors[D_BOTTOM].liquid) { // bottom
-		pressure +1
-					++liquid_levels_want[D_BOTTOM];
-					--total_level;
-		#if LIQUID_DEBUG
-					infostream << " bottom1 pressure+1: " << " bottom=" <<
-		(int)liquid_levels_want[D_BOTTOM] << " total_level=" << (int)total_level <<
-		std::endl; #endif
-				}
-		*/
+		// calculate self level 5 blocks
+		uint16_t want_level = level_avg > level_max ? level_avg
+							  : total_level >= level_max * can_liquid_same_level
+									  ? level_max
+									  : total_level / can_liquid_same_level;
+		total_level -= want_level * can_liquid_same_level;
+
+		/*
+			if (pressure && total_level > 0 && neighbors[D_BOTTOM].liquid) { // bottom
+	pressure +1
+				++liquid_levels_want[D_BOTTOM];
+				--total_level;
+	#if LIQUID_DEBUG
+				infostream << " bottom1 pressure+1: " << " bottom=" <<
+	(int)liquid_levels_want[D_BOTTOM] << " total_level=" << (int)total_level <<
+	std::endl; #endif
+			}
+	*/
 
-			// relax down
-			if (liquid_renewable && relax && p0.Y == water_level + 1 &&
-					liquid_levels[D_TOP] == 0 && (total_level <= 1 || !(loopcount % 2)) &&
-					level_max > 1 && liquid_levels[D_BOTTOM] >= level_max &&
-					want_level <= 0 && total_level <= (can_liquid_same_level - relax) &&
-					can_liquid_same_level >= relax + 1) {
+		// relax down
+		if (liquid_renewable && relax && p0.Y == water_level + 1 &&
+				liquid_levels[D_TOP] == 0 && (total_level <= 1 || !(loopcount % 2)) &&
+				level_max > 1 && liquid_levels[D_BOTTOM] >= level_max &&
+				want_level <= 0 && total_level <= (can_liquid_same_level - relax) &&
+				can_liquid_same_level >= relax + 1) {
 #if LIQUID_DEBUG
-				infostream << " relax_down: " << " total_level WAS=" << (int)total_level
-						   << " to => 0" << std::endl;
+			infostream << " relax_down: " << " total_level WAS=" << (int)total_level
+					   << " to => 0" << std::endl;
 #endif
-				regenerated -= total_level;
-				total_level = 0;
-			}
+			regenerated -= total_level;
+			total_level = 0;
+		}
 
-			for (uint8_t ir = D_SELF; ir < D_TOP; ++ir) { // fill only same level
-				uint8_t ii = liquid_random_map[(loopcount + loop_rand + 1) % 4][ir];
-				if (!neighbors[ii].liquid)
-					continue;
-				liquid_levels_want[ii] = want_level;
-				// if (viscosity > 1 &&
-				// (liquid_levels_want[ii]-liquid_levels[ii]>8-viscosity))
-				//  randomly place rest of divide
-				if (liquid_levels_want[ii] < level_max && total_level > 0) {
-					if (level_max > LIQUID_LEVEL_SOURCE || loopcount % 3 ||
-							liquid_levels[ii] <= 0) {
-						if (liquid_levels[ii] > liquid_levels_want[ii]) {
-							++liquid_levels_want[ii];
-							--total_level;
-						}
-					} else {
+		for (uint8_t ir = D_SELF; ir < D_TOP; ++ir) { // fill only same level
+			uint8_t ii = liquid_random_map[(loopcount + loop_rand + 1) % 4][ir];
+			if (!neighbors[ii].liquid)
+				continue;
+			liquid_levels_want[ii] = want_level;
+			// if (viscosity > 1 &&
+			// (liquid_levels_want[ii]-liquid_levels[ii]>8-viscosity))
+			//  randomly place rest of divide
+			if (liquid_levels_want[ii] < level_max && total_level > 0) {
+				if (level_max > LIQUID_LEVEL_SOURCE || loopcount % 3 ||
+						liquid_levels[ii] <= 0) {
+					if (liquid_levels[ii] > liquid_levels_want[ii]) {
 						++liquid_levels_want[ii];
 						--total_level;
 					}
-				}
-			}
-
-			for (uint8_t ir = D_SELF; ir < D_TOP; ++ir) {
-				if (total_level < 1)
-					break;
-				uint8_t ii = liquid_random_map[(loopcount + loop_rand + 2) % 4][ir];
-				if (liquid_levels_want[ii] >= 0 && liquid_levels_want[ii] < level_max) {
+				} else {
 					++liquid_levels_want[ii];
 					--total_level;
 				}
 			}
+		}
 
-			// fill top block if can
-			if (neighbors[D_TOP].liquid && total_level > 0) {
-				// infostream<<"compressing to top was="<<liquid_levels_want[D_TOP]<<"
-				// add="<<total_level<<std::endl; liquid_levels_want[D_TOP] =
-				// total_level>level_max_compressed?level_max_compressed:total_level;
-				liquid_levels_want[D_TOP] =
-						total_level > level_max ? level_max : total_level;
-				total_level -= liquid_levels_want[D_TOP];
-
-				// if (liquid_levels_want[D_TOP] && total_level && pressure) {
-				if (total_level > 0 && pressure) {
-
-					/*
-								if (total_level > 0 && neighbors[D_BOTTOM].liquid) { //
-				   bottom pressure +2
-									++liquid_levels_want[D_BOTTOM];
-									--total_level;
-								}
-				*/
-					// compressing self level while can
-					// for (u16 ir = D_SELF; ir < D_TOP; ++ir) {
-					for (uint8_t ir = D_BOTTOM; ir <= D_TOP; ++ir) {
-						if (total_level < 1)
-							break;
-						uint8_t ii =
-								liquid_random_map[(loopcount + loop_rand + 3) % 4][ir];
-						if (neighbors[ii].liquid &&
-								liquid_levels_want[ii] < level_max_compressed) {
-							++liquid_levels_want[ii];
-							--total_level;
-						}
-					}
+		for (uint8_t ir = D_SELF; ir < D_TOP; ++ir) {
+			if (total_level < 1)
+				break;
+			uint8_t ii = liquid_random_map[(loopcount + loop_rand + 2) % 4][ir];
+			if (liquid_levels_want[ii] >= 0 && liquid_levels_want[ii] < level_max) {
+				++liquid_levels_want[ii];
+				--total_level;
+			}
+		}
 
-					/*
-								if (total_level > 0 && neighbors[D_BOTTOM].liquid) { //
-				bottom pressure +2
-									++liquid_levels_want[D_BOTTOM];
-									--total_level;
-				#if LIQUID_DEBUG
-							infostream << " bottom2 pressure+1: " << " bottom=" <<
-				(int)liquid_levels_want[D_BOTTOM] << " total_level=" << (int)total_level
-				<< std::endl; #endif
-								}
-				*/
+		// fill top block if can
+		if (neighbors[D_TOP].liquid && total_level > 0) {
+			// infostream<<"compressing to top was="<<liquid_levels_want[D_TOP]<<"
+			// add="<<total_level<<std::endl; liquid_levels_want[D_TOP] =
+			// total_level>level_max_compressed?level_max_compressed:total_level;
+			liquid_levels_want[D_TOP] =
+					total_level > level_max ? level_max : total_level;
+			total_level -= liquid_levels_want[D_TOP];
+
+			// if (liquid_levels_want[D_TOP] && total_level && pressure) {
+			if (total_level > 0 && pressure) {
+
+				/*
+							if (total_level > 0 && neighbors[D_BOTTOM].liquid) { //
+			   bottom pressure +2
+								++liquid_levels_want[D_BOTTOM];
+								--total_level;
+							}
+			*/
+				// compressing self level while can
+				// for (u16 ir = D_SELF; ir < D_TOP; ++ir) {
+				for (uint8_t ir = D_BOTTOM; ir <= D_TOP; ++ir) {
+					if (total_level < 1)
+						break;
+					uint8_t ii =
+							liquid_random_map[(loopcount + loop_rand + 3) % 4][ir];
+					if (neighbors[ii].liquid &&
+							liquid_levels_want[ii] < level_max_compressed) {
+						++liquid_levels_want[ii];
+						--total_level;
+					}
 				}
+
+				/*
+							if (total_level > 0 && neighbors[D_BOTTOM].liquid) { //
+			bottom pressure +2
+								++liquid_levels_want[D_BOTTOM];
+								--total_level;
+			#if LIQUID_DEBUG
+						infostream << " bottom2 pressure+1: " << " bottom=" <<
+			(int)liquid_levels_want[D_BOTTOM] << " total_level=" << (int)total_level
+			<< std::endl; #endif
+							}
+			*/
 			}
+		}
 
-			if (pressure) {
-				if (neighbors[D_BOTTOM].liquid &&
-						liquid_levels_want[D_BOTTOM] < level_max_compressed &&
-						liquid_levels_want[D_TOP] > 0) {
-					// if (liquid_levels_want[D_BOTTOM] <= liquid_levels_want[D_TOP]) {
-					--liquid_levels_want[D_TOP];
+		if (pressure) {
+			if (neighbors[D_BOTTOM].liquid &&
+					liquid_levels_want[D_BOTTOM] < level_max_compressed &&
+					liquid_levels_want[D_TOP] > 0) {
+				// if (liquid_levels_want[D_BOTTOM] <= liquid_levels_want[D_TOP]) {
+				--liquid_levels_want[D_TOP];
+				++liquid_levels_want[D_BOTTOM];
+#if LIQUID_DEBUG
+				infostream << " bottom1 pressure+: " << " bot="
+						   << (int)liquid_levels_want[D_BOTTOM]
+						   << " slf=" << (int)liquid_levels_want[D_SELF]
+						   << " top=" << (int)liquid_levels_want[D_TOP]
+						   << " total_level=" << (int)total_level << std::endl;
+#endif
+				//}
+			} else if (neighbors[D_BOTTOM].liquid &&
+					   liquid_levels_want[D_BOTTOM] < level_max_compressed &&
+					   liquid_levels_want[D_SELF] > level_max) {
+				if (liquid_levels_want[D_BOTTOM] <= liquid_levels_want[D_SELF]) {
+					--liquid_levels_want[D_SELF];
 					++liquid_levels_want[D_BOTTOM];
 #if LIQUID_DEBUG
-					infostream << " bottom1 pressure+: " << " bot="
+					infostream << " bottom2 pressure+: " << " bot="
 							   << (int)liquid_levels_want[D_BOTTOM]
 							   << " slf=" << (int)liquid_levels_want[D_SELF]
 							   << " top=" << (int)liquid_levels_want[D_TOP]
 							   << " total_level=" << (int)total_level << std::endl;
 #endif
-					//}
-				} else if (neighbors[D_BOTTOM].liquid &&
-						   liquid_levels_want[D_BOTTOM] < level_max_compressed &&
-						   liquid_levels_want[D_SELF] > level_max) {
-					if (liquid_levels_want[D_BOTTOM] <= liquid_levels_want[D_SELF]) {
-						--liquid_levels_want[D_SELF];
-						++liquid_levels_want[D_BOTTOM];
-#if LIQUID_DEBUG
-						infostream << " bottom2 pressure+: " << " bot="
-								   << (int)liquid_levels_want[D_BOTTOM]
-								   << " slf=" << (int)liquid_levels_want[D_SELF]
-								   << " top=" << (int)liquid_levels_want[D_TOP]
-								   << " total_level=" << (int)total_level << std::endl;
-#endif
-					}
-				} else if (neighbors[D_TOP].liquid &&
-						   liquid_levels_want[D_SELF] < level_max_compressed &&
-						   liquid_levels_want[D_TOP] > level_max) {
-					if (liquid_levels_want[D_SELF] <= liquid_levels_want[D_TOP]) {
-						--liquid_levels_want[D_TOP];
-						++liquid_levels_want[D_SELF];
+				}
+			} else if (neighbors[D_TOP].liquid &&
+					   liquid_levels_want[D_SELF] < level_max_compressed &&
+					   liquid_levels_want[D_TOP] > level_max) {
+				if (liquid_levels_want[D_SELF] <= liquid_levels_want[D_TOP]) {
+					--liquid_levels_want[D_TOP];
+					++liquid_levels_want[D_SELF];
 #if LIQUID_DEBUG
-						infostream << " bottom3 pressure+: " << " bot="
-								   << (int)liquid_levels_want[D_BOTTOM]
-								   << " slf=" << (int)liquid_levels_want[D_SELF]
-								   << " top=" << (int)liquid_levels_want[D_TOP]
-								   << " total_level=" << (int)total_level << std::endl;
+					infostream << " bottom3 pressure+: " << " bot="
+							   << (int)liquid_levels_want[D_BOTTOM]
+							   << " slf=" << (int)liquid_levels_want[D_SELF]
+							   << " top=" << (int)liquid_levels_want[D_TOP]
+							   << " total_level=" << (int)total_level << std::endl;
 #endif
-					}
 				}
+			}
 
-				if (liquid_levels_want[D_TOP] > level_max && relax && total_level <= 0 &&
-						level_avg > level_max && liquid_levels_want[D_TOP] < level_avg) {
+			if (liquid_levels_want[D_TOP] > level_max && relax && total_level <= 0 &&
+					level_avg > level_max && liquid_levels_want[D_TOP] < level_avg) {
 #if LIQUID_DEBUG
-					infostream << " top pressure relax: " << " top="
-							   << (int)liquid_levels_want[D_TOP] << " to=>" << level_avg
-							   << std::endl;
+				infostream << " top pressure relax: " << " top="
+						   << (int)liquid_levels_want[D_TOP] << " to=>" << level_avg
+						   << std::endl;
 #endif
 
-					// regenerated += level_avg - liquid_levels_want[D_TOP];
-					// liquid_levels_want[D_TOP] = level_avg;
-					regenerated += 1;
-					liquid_levels_want[D_TOP] += 1;
-				}
+				// regenerated += level_avg - liquid_levels_want[D_TOP];
+				// liquid_levels_want[D_TOP] = level_avg;
+				regenerated += 1;
+				liquid_levels_want[D_TOP] += 1;
 			}
+		}
 
 #if LIQUID_DEBUG
-			if (total_level > 0)
-				infostream << " rest 1: " << " wtop=" << (int)liquid_levels_want[D_TOP]
-						   << " total_level=" << (int)total_level << std::endl;
+		if (total_level > 0)
+			infostream << " rest 1: " << " wtop=" << (int)liquid_levels_want[D_TOP]
+					   << " total_level=" << (int)total_level << std::endl;
 #endif
 
-			if (total_level > 0 && neighbors[D_TOP].liquid &&
-					liquid_levels_want[D_TOP] < level_max_compressed) {
-				int16_t add =
-						(total_level > level_max_compressed - liquid_levels_want[D_TOP])
-								? level_max_compressed - liquid_levels_want[D_TOP]
-								: total_level;
-				liquid_levels_want[D_TOP] += add;
-				total_level -= add;
-			}
+		if (total_level > 0 && neighbors[D_TOP].liquid &&
+				liquid_levels_want[D_TOP] < level_max_compressed) {
+			int16_t add =
+					(total_level > level_max_compressed - liquid_levels_want[D_TOP])
+							? level_max_compressed - liquid_levels_want[D_TOP]
+							: total_level;
+			liquid_levels_want[D_TOP] += add;
+			total_level -= add;
+		}
 
-			if (total_level > 0 && neighbors[D_SELF].liquid &&
-					liquid_levels_want[D_SELF] <
-							level_max_compressed) { // very rare, compressed only
-				int16_t add =
-						(total_level > level_max_compressed - liquid_levels_want[D_SELF])
-								? level_max_compressed - liquid_levels_want[D_SELF]
-								: total_level;
+		if (total_level > 0 && neighbors[D_SELF].liquid &&
+				liquid_levels_want[D_SELF] <
+						level_max_compressed) { // very rare, compressed only
+			int16_t add =
+					(total_level > level_max_compressed - liquid_levels_want[D_SELF])
+							? level_max_compressed - liquid_levels_want[D_SELF]
+							: total_level;
 #if LIQUID_DEBUG
-				if (total_level > 0)
-					infostream << " rest 2: " << " wself="
-							   << (int)liquid_levels_want[D_SELF]
-							   << " total_level=" << (int)total_level
-							   << " add=" << (int)add << std::endl;
+			if (total_level > 0)
+				infostream << " rest 2: " << " wself="
+						   << (int)liquid_levels_want[D_SELF]
+						   << " total_level=" << (int)total_level
+						   << " add=" << (int)add << std::endl;
 #endif
 
-				liquid_levels_want[D_SELF] += add;
-				total_level -= add;
-			}
+			liquid_levels_want[D_SELF] += add;
+			total_level -= add;
+		}
 
 #if LIQUID_DEBUG
-			if (total_level > 0)
-				infostream << " rest 3: " << " total_level=" << (int)total_level
-						   << std::endl;
+		if (total_level > 0)
+			infostream << " rest 3: " << " total_level=" << (int)total_level
+					   << std::endl;
 #endif
 
-			for (uint8_t ii = 0; ii < 7; ii++) { // infinity and cave flood optimization
-				if (neighbors[ii].infinity &&
-						liquid_levels_want[ii] < liquid_levels[ii]) {
+		for (uint8_t ii = 0; ii < 7; ii++) { // infinity and cave flood optimization
+			if (neighbors[ii].infinity &&
+					liquid_levels_want[ii] < liquid_levels[ii]) {
 #if LIQUID_DEBUG
-					infostream << " infinity: was=" << (int)ii << " = "
-							   << (int)liquid_levels_want[ii]
-							   << "  to=" << (int)liquid_levels[ii] << std::endl;
+				infostream << " infinity: was=" << (int)ii << " = "
+						   << (int)liquid_levels_want[ii]
+						   << "  to=" << (int)liquid_levels[ii] << std::endl;
 #endif
 
-					regenerated += liquid_levels[ii] - liquid_levels_want[ii];
-					liquid_levels_want[ii] = liquid_levels[ii];
-				} else if (liquid_levels_want[ii] >= 0 &&
-						   liquid_levels_want[ii] < level_max && level_max > 1 &&
-						   fast_flood && p0.Y < water_level && p0.Y > fast_flood &&
-						   initial_size >= 1000 && ii != D_TOP &&
-						   want_level >= level_max / 4 && can_liquid_same_level >= 5 &&
-						   liquid_levels[D_TOP] >= level_max) {
+				regenerated += liquid_levels[ii] - liquid_levels_want[ii];
+				liquid_levels_want[ii] = liquid_levels[ii];
+			} else if (liquid_levels_want[ii] >= 0 &&
+					   liquid_levels_want[ii] < level_max && level_max > 1 &&
+					   fast_flood && p0.Y < water_level && p0.Y > fast_flood &&
+					   initial_size >= 1000 && ii != D_TOP &&
+					   want_level >= level_max / 4 && can_liquid_same_level >= 5 &&
+					   liquid_levels[D_TOP] >= level_max) {
 #if LIQUID_DEBUG
-					infostream << " flood_fast: was=" << (int)ii << " = "
-							   << (int)liquid_levels_want[ii] << "  to=" << (int)level_max
-							   << std::endl;
+				infostream << " flood_fast: was=" << (int)ii << " = "
+						   << (int)liquid_levels_want[ii] << "  to=" << (int)level_max
+						   << std::endl;
 #endif
-					regenerated += level_max - liquid_levels_want[ii];
-					liquid_levels_want[ii] = level_max;
-				}
+				regenerated += level_max - liquid_levels_want[ii];
+				liquid_levels_want[ii] = level_max;
 			}
+		}
 
 #if LIQUID_DEBUG
-			if (total_level != 0) //|| flowed != volume)
-				infostream << " AFTER err level="
-						   << (int)total_level
-						   //<< " flowed="<<flowed<< " volume=" << volume
-						   << " max=" << (int)level_max << " wantsame=" << (int)want_level
-						   << " top=" << (int)liquid_levels_want[D_TOP]
-						   << " topwas=" << (int)liquid_levels[D_TOP]
-						   << " bot=" << (int)liquid_levels_want[D_BOTTOM]
-						   << " botwas=" << (int)liquid_levels[D_BOTTOM] << std::endl;
-
-			s16 flowed = 0; // for debug
+		if (total_level != 0) //|| flowed != volume)
+			infostream << " AFTER err level="
+					   << (int)total_level
+					   //<< " flowed="<<flowed<< " volume=" << volume
+					   << " max=" << (int)level_max << " wantsame=" << (int)want_level
+					   << " top=" << (int)liquid_levels_want[D_TOP]
+					   << " topwas=" << (int)liquid_levels[D_TOP]
+					   << " bot=" << (int)liquid_levels_want[D_BOTTOM]
+					   << " botwas=" << (int)liquid_levels[D_BOTTOM] << std::endl;
+
+		s16 flowed = 0; // for debug
 #endif
 
 #if LIQUID_DEBUG
-			if (debug)
-				infostream << " dpress=" << " bot=" << (int)liquid_levels_want[D_BOTTOM]
-						   << " slf=" << (int)liquid_levels_want[D_SELF]
-						   << " top=" << (int)liquid_levels_want[D_TOP] << std::endl;
+		if (debug)
+			infostream << " dpress=" << " bot=" << (int)liquid_levels_want[D_BOTTOM]
+					   << " slf=" << (int)liquid_levels_want[D_SELF]
+					   << " top=" << (int)liquid_levels_want[D_TOP] << std::endl;
 #endif
 
-			for (int8_t r = D_BOTTOM; r <= D_TOP; ++r) {
-				uint8_t i = liquid_random_map[(loopcount + loop_rand + 4) % 4][r];
-				if (liquid_levels_want[i] < 0 || !neighbors[i].liquid)
-					continue;
+		for (int8_t r = D_BOTTOM; r <= D_TOP; ++r) {
+			uint8_t i = liquid_random_map[(loopcount + loop_rand + 4) % 4][r];
+			if (liquid_levels_want[i] < 0 || !neighbors[i].liquid)
+				continue;
 
 #if LIQUID_DEBUG
-				if (debug)
-					infostream << " set=" << (int)i << " " << neighbors[i].pos
-							   << " want=" << (int)liquid_levels_want[i]
-							   << " was=" << (int)liquid_levels[i] << std::endl;
+			if (debug)
+				infostream << " set=" << (int)i << " " << neighbors[i].pos
+						   << " want=" << (int)liquid_levels_want[i]
+						   << " was=" << (int)liquid_levels[i] << std::endl;
 #endif
 
-				/* disabled because brokes constant volume of lava
-			u8 viscosity = nodemgr->get(liquid_kind).liquid_viscosity;
-			if (viscosity > 1 && liquid_levels_want[i] != liquid_levels[i]) {
-				// amount to gain, limited by viscosity
-				// must be at least 1 in absolute value
-				s8 level_inc = liquid_levels_want[i] - liquid_levels[i];
-				if (level_inc < -viscosity || level_inc > viscosity)
-					new_node_level = liquid_levels[i] + level_inc/viscosity;
-				else if (level_inc < 0)
-					new_node_level = liquid_levels[i] - 1;
-				else if (level_inc > 0)
-					new_node_level = liquid_levels[i] + 1;
-			} else {
-			*/
+			/* disabled because brokes constant volume of lava
+		u8 viscosity = nodemgr->get(liquid_kind).liquid_viscosity;
+		if (viscosity > 1 && liquid_levels_want[i] != liquid_levels[i]) {
+			// amount to gain, limited by viscosity
+			// must be at least 1 in absolute value
+			s8 level_inc = liquid_levels_want[i] - liquid_levels[i];
+			if (level_inc < -viscosity || level_inc > viscosity)
+				new_node_level = liquid_levels[i] + level_inc/viscosity;
+			else if (level_inc < 0)
+				new_node_level = liquid_levels[i] - 1;
+			else if (level_inc > 0)
+				new_node_level = liquid_levels[i] + 1;
+		} else {
+		*/
 
-				// last level must flow down on stairs
-				if (liquid_levels_want[i] != liquid_levels[i] &&
-						liquid_levels[D_TOP] <= 0 &&
-						(!neighbors[D_BOTTOM].liquid || level_max == 1) &&
-						liquid_levels_want[i] >= 1 && liquid_levels_want[i] <= 2) {
-					for (uint8_t ir = D_SELF + 1; ir < D_TOP; ++ir) { // only same level
-						uint8_t ii =
-								liquid_random_map[(loopcount + loop_rand + 5) % 4][ir];
-						if (neighbors[ii].liquid)
-							//must_reflow_second.emplace_back(neighbors[i].pos + liquid_flow_dirs[ii]);
-							reflow(neighbors[i].pos + liquid_flow_dirs[ii]);
-						// must_reflow_second[neighbors[i].pos + liquid_flow_dirs[ii]] = 1;
-					}
+			// last level must flow down on stairs
+			if (liquid_levels_want[i] != liquid_levels[i] &&
+					liquid_levels[D_TOP] <= 0 &&
+					(!neighbors[D_BOTTOM].liquid || level_max == 1) &&
+					liquid_levels_want[i] >= 1 && liquid_levels_want[i] <= 2) {
+				for (uint8_t ir = D_SELF + 1; ir < D_TOP; ++ir) { // only same level
+					uint8_t ii =
+							liquid_random_map[(loopcount + loop_rand + 5) % 4][ir];
+					if (neighbors[ii].liquid)
+						//must_reflow_second.emplace_back(neighbors[i].pos + liquid_flow_dirs[ii]);
+						reflow(neighbors[i].pos + liquid_flow_dirs[ii]);
+					// must_reflow_second[neighbors[i].pos + liquid_flow_dirs[ii]] = 1;
 				}
+			}
 
 #if LIQUID_DEBUG
-				if (liquid_levels_want[i] > 0)
-					flowed += liquid_levels_want[i];
+			if (liquid_levels_want[i] > 0)
+				flowed += liquid_levels_want[i];
 #endif
-				if (liquid_levels[i] == liquid_levels_want[i]) {
-					continue;
-				}
+			if (liquid_levels[i] == liquid_levels_want[i]) {
+				continue;
+			}
 
-				if (neighbors[i].drop) { // && level_max > 1 && total_level >= level_max - 1
-					node_drop.emplace(neighbors[i].pos);
-				}
+			if (neighbors[i].drop) { // && level_max > 1 && total_level >= level_max - 1
+				node_drop.emplace(neighbors[i].pos);
+			}
 
-				neighbors[i].node.setContent(liquid_kind_flowing);
-				neighbors[i].node.setLevel(nodemgr, liquid_levels_want[i], 1);
+			neighbors[i].node.setContent(liquid_kind_flowing);
+			neighbors[i].node.setLevel(nodemgr, liquid_levels_want[i], 1);
 
-				try {
-					cached_map.setNode(neighbors[i].pos, neighbors[i].node);
-				} catch (const InvalidPositionException &e) {
-					verbosestream << "transformLiquidsReal: setNode() failed:"
-								  << neighbors[i].pos << ":" << e.what() << std::endl;
-				}
-
-				// If node emits light, MapBlock requires lighting update
-				// or if node removed
-				if (!(bool)liquid_levels[i] != !(bool)liquid_levels_want[i]) {
-					v3bpos_t blockpos = getNodeBlockPos(neighbors[i].pos);
-					blocks_lighting_update.emplace(blockpos);
-				}
-				// fmtodo: make here random %2 or..
-				if (total_level < level_max * can_liquid) {
-					reflow(neighbors[i].pos);
-					//must_reflow.emplace_back(neighbors[i].pos);
-				}
+			try {
+				cached_map.setNode(neighbors[i].pos, neighbors[i].node);
+			} catch (const InvalidPositionException &e) {
+				verbosestream << "transformLiquidsReal: setNode() failed:"
+							  << neighbors[i].pos << ":" << e.what() << std::endl;
 			}
 
-			if (fall_down) {
-				//? m_server->getEnv().nodeUpdate(neighbors[D_BOTTOM].pos, 1);
+			// If node emits light, MapBlock requires lighting update
+			// or if node removed
+			if (!(bool)liquid_levels[i] != !(bool)liquid_levels_want[i]) {
+				v3bpos_t blockpos = getNodeBlockPos(neighbors[i].pos);
+				blocks_lighting_update.emplace(blockpos);
 			}
+			// fmtodo: make here random %2 or..
+			if (total_level < level_max * can_liquid) {
+				reflow(neighbors[i].pos);
+				//must_reflow.emplace_back(neighbors[i].pos);
+			}
+		}
+
+		if (fall_down) {
+			//? m_server->getEnv().nodeUpdate(neighbors[D_BOTTOM].pos, 1);
+		}
 
 #if LIQUID_DEBUG
-			// if (total_was != flowed) {
-			if (total_was > flowed) {
-				infostream << " volume changed!  flowed=" << flowed
-						   << " total_was=" << total_was << " want_level=" << want_level;
-				for (uint8_t rr = 0; rr <= 6; rr++) {
-					infostream << "  i=" << (int)rr << ",b" << (int)liquid_levels[rr]
-							   << ",a" << (int)liquid_levels_want[rr];
-				}
-				infostream << std::endl;
+		// if (total_was != flowed) {
+		if (total_was > flowed) {
+			infostream << " volume changed!  flowed=" << flowed
+					   << " total_was=" << total_was << " want_level=" << want_level;
+			for (uint8_t rr = 0; rr <= 6; rr++) {
+				infostream << "  i=" << (int)rr << ",b" << (int)liquid_levels[rr]
+						   << ",a" << (int)liquid_levels_want[rr];
 			}
+			infostream << std::endl;
+		}
 #endif
-			/* //for better relax  only same level
-		if (changed)  for (u16 ii = D_SELF + 1; ii < D_TOP; ++ii) {
-			if (!neighbors[ii].l) continue;
-			must_reflow.push_back(p0 + dirs[ii]);
-		}*/
-			// g_profiler->graphAdd("liquids", 1);
+		/* //for better relax  only same level
+	if (changed)  for (u16 ii = D_SELF + 1; ii < D_TOP; ++ii) {
+		if (!neighbors[ii].l) continue;
+		must_reflow.push_back(p0 + dirs[ii]);
+	}*/
+		// g_profiler->graphAdd("liquids", 1);
+	};
+
+	// results of all regions, merged in a fixed order
+	liquid_region_state result;
+	std::vector<liquid_region_state> regions;
+	liquid_region_state border;
+
+	if (liquid_parallel && m_server->m_jobs &&
+			transforming_liquid_local.size() >= LIQUID_PARALLEL_MIN) {
+		unordered_map_v3bpos<size_t> region_index;
+		for (size_t i = 0; i < transforming_liquid_local.size(); ++i) {
+			const auto &p = transforming_liquid_local[i];
+			if (liquid_region_border(p)) {
+				border.nodes.emplace_back(i);
+				continue;
+			}
+			const auto [it, inserted] = region_index.emplace(
+					getContainerPos(p, LIQUID_REGION_SIZE), regions.size());
+			if (inserted)
+				regions.emplace_back();
+			regions[it->second].nodes.emplace_back(i);
+		}
+
+		// idle server job workers help with the regions
+		std::vector<job_scheduler::task_func> tasks;
+		tasks.reserve(regions.size());
+		for (auto &region : regions) {
+			tasks.emplace_back([&, this] {
+				cached_map_block cached_map(this, "Liquid");
+				for (const auto i : region.nodes)
+					transform_node(region, cached_map, transforming_liquid_local[i],
+							i + 1);
+			});
 		}
+		m_server->m_jobs->run_tasks(tasks);
+
+		for (auto &region : regions)
+			result.merge(region);
+		// border nodes keep counting falling nodes of the same blocks
+		border.falling.swap(result.falling);
+	} else {
+		border.nodes.resize(transforming_liquid_local.size());
+		std::iota(border.nodes.begin(), border.nodes.end(), 0);
+	}
+
+	// Border exchange: region face nodes see all interior results
+	{
+		cached_map_block cached_map(this, "Liquid");
+		for (const auto i : border.nodes)
+			transform_node(border, cached_map, transforming_liquid_local[i], i + 1);
 	}
+	result.merge(border);
+
+	const size_t loopcount = transforming_liquid_local.size();
 	transforming_liquid_local.clear();
 	m_transforming_liquid_local_size = 0;
 
@@ -943,11 +983,11 @@ size_t ServerMap::transformLiquidsReal(Server *m_server, unsigned int max_cycle_
 
 		// m_transforming_liquid.insert(must_reflow.begin(), must_reflow.end());
 
-		//DUMP(fast_reflow.size(), must_reflow.size(), must_reflow_second.size());
+		//DUMP(result.fast_reflow.size(), result.must_reflow.size());
 		std::unordered_set<v3pos_t> uniq;
 		transforming_liquid_local.reserve(
-				must_reflow.size() + must_reflow_second.size() + fast_reflow.size() * 4);
-		for (const auto &[bp, list] : fast_reflow) {
+				result.must_reflow.size() + result.fast_reflow.size() * 4);
+		for (const auto &[bp, list] : result.fast_reflow) {
 			for (const auto &p : list) {
 				if (!uniq.contains(p))
 					transforming_liquid_local.emplace_back(p);
@@ -955,12 +995,7 @@ size_t ServerMap::transformLiquidsReal(Server *m_server, unsigned int max_cycle_
 			}
 		}
 
-		for (const auto &p : must_reflow) {
-			if (!uniq.contains(p))
-				transforming_liquid_local.emplace_back(p);
-			uniq.emplace(p);
-		}
-		for (const auto &p : must_reflow_second) {
+		for (const auto &p : result.must_reflow) {
 			if (!uniq.contains(p))
 				transforming_liquid_local.emplace_back(p);
 			uniq.emplace(p);
@@ -969,17 +1004,17 @@ size_t ServerMap::transformLiquidsReal(Server *m_server, unsigned int max_cycle_
 		m_transforming_liquid_local_size = transforming_liquid_local.size();
 	}
 
-	for (const auto &pos : node_drop) {
+	for (const auto &pos : result.node_drop) {
 		m_server->getEnv().getScriptIface()->postponed.emplace_back([=]() {
     		m_server->getEnv().getScriptIface()->node_drop(pos, 2);
 		});
 	}
 
-	for (const auto &pos : node_update) {
+	for (const auto &pos : result.node_update) {
 		m_server->getEnv().nodeUpdate(pos, 2);
 	}
 
-	for (const auto &blockpos : blocks_lighting_update) {
+	for (const auto &blockpos : result.blocks_lighting_update) {
 		auto block = getBlockNoCreateNoEx(blockpos, true); // remove true if light bugs
 		if (!block)
 			continue;
@@ -991,8 +1026,12 @@ size_t ServerMap::transformLiquidsReal(Server *m_server, unsigned int max_cycle_
 	}
 
 	g_profiler->avg("Server: liquids real processed", loopcount);
-	if (regenerated)
-		g_profiler->avg("Server: liquids regenerated", regenerated);
+	if (!regions.empty())
+		g_profiler->avg("Server: liquids real regions", regions.size());
+	if (const auto spent_us = porting::getTimeUs() - start_us; loopcount && spent_us)
+		g_profiler->avg("Server: liquids real per second", loopcount * 1000000 / spent_us);
+	if (result.regenerated)
+		g_profiler->avg("Server: liquids regenerated", result.regenerated);
 	/*
 		if (loopcount < initial_size)
 			g_profiler->add("Server: liquids queue", initial_size);
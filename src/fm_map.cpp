@@ -30,11 +30,14 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "nodedef.h"
 #include "environment.h"
 #include "emerge.h"
+#include "filesys.h"
 #include "mapgen/mg_biome.h"
 #include "gamedef.h"
 #include "reflowscan.h"
 #include "server.h"
 #include "server/ban.h"
+#include "server/fm_block_save_queue.h"
+#include "serialization.h"
 #include "servermap.h"
 #include "settings.h"
 #include "util/directiontables.h"
@@ -79,12 +82,13 @@ MapBlockPtr Map::getBlock(v3bpos_t p, bool trylock, bool nocache)
 
 	MapBlockPtr block;
 	{
+		const auto &shard = m_blocks.get_shard(p);
 		const auto lock =
-				trylock ? m_blocks.try_lock_shared_rec() : m_blocks.lock_shared_rec();
+				trylock ? shard.try_lock_shared_rec() : shard.lock_shared_rec();
 		if (!lock->owns_lock())
 			return nullptr;
-		const auto &n = m_blocks.find(p);
-		if (n == m_blocks.end())
+		const auto &n = shard.find(p);
+		if (n == shard.end())
 			return nullptr;
 		block = n->second;
 	}
@@ -126,7 +130,7 @@ MapBlockPtr Map::createBlankBlock(const v3pos_t &p)
 {
 	m_db_miss.erase(p);
 
-	const auto lock = m_blocks.lock_unique_rec();
+	const auto lock = m_blocks.get_shard(p).lock_unique_rec();
 
 	auto block = getBlock(p, false, true);
 	if (block != NULL) {
@@ -147,7 +151,7 @@ bool Map::insertBlock(MapBlockPtr block)
 
 	m_db_miss.erase(block_p);
 
-	const auto lock = m_blocks.lock_unique_rec();
+	const auto lock = m_blocks.get_shard(block_p).lock_unique_rec();
 
 	auto block2 = getBlock(block_p, false, true);
 	if (block2) {
@@ -460,17 +464,12 @@ u32 Map::timerUpdate(float uptime, float unload_timeout, s32 max_loaded_blocks,
 	u32 saved_blocks_count = 0;
 	u32 block_count_all = 0;
 
-	u32 n = 0, calls = 0;
+	u32 calls = 0;
 	const auto end_ms = porting::getTimeMs() + max_cycle_ms;
 
 	std::vector<MapBlockPtr> blocks_delete;
 	int save_started = 0;
 	{
-		const auto lock = m_blocks.try_lock_shared_rec();
-		if (!lock->owns_lock()) {
-			return m_blocks_update_last;
-		}
-
 #if !ENABLE_THREADS
 		auto lock_map = m_nothread_locker.try_lock_unique_rec();
 		if (!lock_map->owns_lock())
@@ -479,91 +478,104 @@ u32 Map::timerUpdate(float uptime, float unload_timeout, s32 max_loaded_blocks,
 
 		auto m_blocks_size = m_blocks.size();
 
-		for (const auto &ir : m_blocks) {
-			if (n++ < m_blocks_update_last) {
+		const auto start_shard = m_blocks_update_shard;
+		const auto start_n = m_blocks_update_last;
+		m_blocks_update_shard = m_blocks_update_last = 0;
+		size_t shard_index = 0;
+		bool stop = false;
+		for (const auto &shard : m_blocks.shards()) {
+			if (stop)
+				break;
+			const auto current_shard = shard_index++;
+			if (current_shard < start_shard)
 				continue;
-			} else {
-				m_blocks_update_last = 0;
-			}
-			++calls;
-
-			const auto block = ir.second;
-			if (!block) {
-				blocks_delete.emplace_back(block);
+			const auto lock = shard.try_lock_shared_rec();
+			if (!lock->owns_lock())
 				continue;
-			}
 
-			/*
-			if (block->refGet()) {
-				continue;
-			}
-			*/
+			u32 n = 0;
+			for (const auto &ir : shard) {
+				if (n++ < start_n && current_shard == start_shard)
+					continue;
+				++calls;
 
-			if (!block->isGenerated())
-#if CHECK_CLIENT_BUILD()
-				if (!block->getLodMesh(0, true))
-#endif
-				{
+				const auto block = ir.second;
+				if (!block) {
 					blocks_delete.emplace_back(block);
 					continue;
 				}
 
-			{
-				const auto lock = block->try_lock_unique_rec();
-				if (!lock->owns_lock()) {
+				/*
+				if (block->refGet()) {
 					continue;
 				}
-				if (block->getUsageTimer() > unload_timeout) { // block->refGet() <= 0 &&
-					const v3bpos_t p = block->getPos();
-					changed_blocks_for_merge.emplace(p);
-
-					// infostream<<" deleting block p="<<p<<"
-					// ustimer="<<block->getUsageTimer() <<" to="<< unload_timeout<<"
-					// inc="<<(uptime - block->m_uptime_timer_last)<<"
-					// state="<<block->getModified()<<std::endl;
-					//  Save if modified
-					if (block->getModified() != MOD_STATE_CLEAN &&
-							save_before_unloading) {
-						// modprofiler.add(block->getModifiedReasonString(), 1);
-						if (!save_started++)
-							beginSave();
-						if (!saveBlock(block.get())) {
-							continue;
-						}
-						saved_blocks_count++;
+				*/
+
+				if (!block->isGenerated())
+#if CHECK_CLIENT_BUILD()
+					if (!block->getLodMesh(0, true))
+#endif
+					{
+						blocks_delete.emplace_back(block);
+						continue;
 					}
 
-					blocks_delete.emplace_back(block);
+				{
+					const auto lock = block->try_lock_unique_rec();
+					if (!lock->owns_lock()) {
+						continue;
+					}
+					if (block->getUsageTimer() > unload_timeout) { // block->refGet() <= 0 &&
+						const v3bpos_t p = block->getPos();
+						changed_blocks_for_merge.emplace(p);
+
+						// infostream<<" deleting block p="<<p<<"
+						// ustimer="<<block->getUsageTimer() <<" to="<< unload_timeout<<"
+						// inc="<<(uptime - block->m_uptime_timer_last)<<"
+						// state="<<block->getModified()<<std::endl;
+						//  Save if modified
+						if (block->getModified() != MOD_STATE_CLEAN &&
+								save_before_unloading) {
+							// modprofiler.add(block->getModifiedReasonString(), 1);
+							if (!save_started++)
+								beginSave();
+							if (!saveBlock(block.get())) {
+								continue;
+							}
+							saved_blocks_count++;
+						}
 
-					if (unloaded_blocks)
-						unloaded_blocks->push_back(p);
+						blocks_delete.emplace_back(block);
 
-					deleted_blocks_count++;
-				} else {
-					if (!block->m_uptime_timer_last) // not very good place, but minimum
-													 // modifications
-						block->m_uptime_timer_last = uptime - 0.1;
-					block->incrementUsageTimer(uptime - block->m_uptime_timer_last);
-					block->m_uptime_timer_last = uptime;
+						if (unloaded_blocks)
+							unloaded_blocks->push_back(p);
 
-					block_count_all++;
-				}
+						deleted_blocks_count++;
+					} else {
+						if (!block->m_uptime_timer_last) // not very good place, but minimum
+														 // modifications
+							block->m_uptime_timer_last = uptime - 0.1;
+						block->incrementUsageTimer(uptime - block->m_uptime_timer_last);
+						block->m_uptime_timer_last = uptime;
 
-			} // block lock
+						block_count_all++;
+					}
 
-			if (calls > std::max(size_t(100), m_blocks_size / 10) &&
-					porting::getTimeMs() > end_ms) {
-				m_blocks_update_last = n;
-				break;
+				} // block lock
+
+				if (calls > std::max(size_t(100), m_blocks_size / 10) &&
+						porting::getTimeMs() > end_ms) {
+					m_blocks_update_shard = current_shard;
+					m_blocks_update_last = n;
+					stop = true;
+					break;
+				}
 			}
 		}
 	}
 	if (save_started)
 		endSave();
 
-	if (!calls)
-		m_blocks_update_last = 0;
-
 	for (auto &block : blocks_delete)
 		eraseBlock(block);
 
@@ -572,7 +584,8 @@ u32 Map::timerUpdate(float uptime, float unload_timeout, s32 max_loaded_blocks,
 	if (deleted_blocks_count != 0) {
 		if (m_blocks_update_last)
 			infostream << "ServerMap: timerUpdate(): Blocks processed:" << calls << "/"
-					   << m_blocks.size() << " to " << m_blocks_update_last << std::endl;
+					   << m_blocks.size() << " to " << m_blocks_update_shard << ":"
+					   << m_blocks_update_last << std::endl;
 		PrintInfo(infostream); // ServerMap/ClientMap:
 		infostream << "Unloaded " << deleted_blocks_count << "/"
 				   << (block_count_all + deleted_blocks_count) << " blocks from memory";
@@ -1615,60 +1628,76 @@ s32 ServerMap::save(ModifiedState save_level, float dedicated_server_step, bool
 
 	// Don't do anything with sqlite unless something is really saved
 	bool save_started = false;
-	u32 n = 0, calls = 0;
 	const auto end_ms = porting::getTimeMs() + u32(1000 * dedicated_server_step);
 	if (!breakable)
-		m_blocks_save_last = 0;
+		m_blocks_save_shard = m_blocks_save_last = 0;
 
 	MAP_NOTHREAD_LOCK(this);
 
 	{
-		auto lock =
-				breakable ? m_blocks.try_lock_shared_rec() : m_blocks.lock_shared_rec();
-		if (!lock->owns_lock())
-			return m_blocks_save_last;
-
-		for (const auto &[pos, block] : m_blocks) {
-			if (n++ < m_blocks_save_last)
+		const auto start_shard = m_blocks_save_shard;
+		const auto start_n = m_blocks_save_last;
+		m_blocks_save_shard = m_blocks_save_last = 0;
+		size_t shard_index = 0;
+		bool stop = false;
+		for (const auto &shard : m_blocks.shards()) {
+			if (stop)
+				break;
+			const auto current_shard = shard_index++;
+			if (current_shard < start_shard)
 				continue;
-			else
-				m_blocks_save_last = 0;
-			++calls;
-
-			if (!block)
+			auto lock =
+					breakable ? shard.try_lock_shared_rec() : shard.lock_shared_rec();
+			if (!lock->owns_lock())
 				continue;
 
-			block_count_all++;
+			u32 n = 0;
+			for (const auto &[pos, block] : shard) {
+				if (n++ < start_n && current_shard == start_shard)
+					continue;
 
-			if (block->getModified() >= (u32)save_level) {
-				// Lazy beginSave()
-				if (!save_started) {
-					beginSave();
-					save_started = true;
-				}
+				if (!block)
+					continue;
 
-				//modprofiler.add(block->getModifiedReasonString(), 1);
+				block_count_all++;
 
-				const auto lock = breakable ? block->try_lock_unique_rec()
-											: block->lock_unique_rec();
-				if (!lock->owns_lock())
-					continue;
+				if (block->getModified() >= (u32)save_level) {
+					// Lazy beginSave()
+					if (!save_started) {
+						beginSave();
+						save_started = true;
+					}
 
-				saveBlock(block.get());
-				block_count++;
-			}
-			if (breakable && porting::getTimeMs() > end_ms) {
-				m_blocks_save_last = n;
-				break;
+					//modprofiler.add(block->getModifiedReasonString(), 1);
+
+					const auto lock = breakable ? block->try_lock_unique_rec()
+												: block->lock_unique_rec();
+					if (!lock->owns_lock())
+						continue;
+
+					saveBlock(block.get());
+					block_count++;
+				}
+				if (breakable && porting::getTimeMs() > end_ms) {
+					m_blocks_save_shard = current_shard;
+					m_blocks_save_last = n;
+					stop = true;
+					break;
+				}
 			}
 		}
 	}
-	if (!calls)
-		m_blocks_save_last = 0;
 
 	if (save_started)
 		endSave();
 
+	if (m_save_queue) {
+		g_profiler->avg("Server: map save queue [blocks]", m_save_queue->size());
+		// whole save is a barrier, shutdown and /save
+		if (!breakable)
+			m_save_queue->flush();
+	}
+
 	/*
 		Only print if something happened or saved whole map
 	*/
@@ -1680,7 +1709,8 @@ s32 ServerMap::save(ModifiedState save_level, float dedicated_server_step, bool
 
 				   << " Total=" << m_blocks.size() << ".";
 		if (m_blocks_save_last)
-			infostream << " Break at " << m_blocks_save_last;
+			infostream << " Break at " << m_blocks_save_shard << ":"
+					   << m_blocks_save_last;
 		infostream
 
 				<< std::endl;
@@ -1698,6 +1728,68 @@ s32 ServerMap::save(ModifiedState save_level, float dedicated_server_step, bool
 	return m_blocks_save_last;
 }
 
+void ServerMap::initZstdDictionary()
+{
+	// Blocks saved with the dictionary need it as long as they exist
+	const auto path = m_savedir + DIR_DELIM + "map.zdict";
+	std::string dictionary;
+	if (!fs::ReadFile(path, dictionary) && g_settings->getBool("map_zstd_dictionary")) {
+		// Train on blocks spread over the whole world
+		constexpr size_t SAMPLES_MIN = 256, SAMPLES_MAX = 1000;
+		std::vector<v3bpos_t> positions;
+		m_db.dbase->listAllLoadableBlocks(positions);
+		if (positions.size() < SAMPLES_MIN) {
+			infostream << "ServerMap: " << positions.size()
+					   << " blocks are too few to train a zstd dictionary" << std::endl;
+			return;
+		}
+		std::vector<v3bpos_t> picked;
+		const auto stride = std::max<size_t>(positions.size() / SAMPLES_MAX, 1);
+		for (size_t i = 0; i < positions.size() && picked.size() < SAMPLES_MAX; i += stride)
+			picked.emplace_back(positions[i]);
+
+		std::vector<std::string> samples;
+		samples.reserve(picked.size());
+		m_db.dbase->loadBlocks(picked, [&](const v3bpos_t &pos, std::string &&blob) {
+			if (blob.empty() || u8(blob[0]) < 29)
+				return;
+			try {
+				std::istringstream is(blob.substr(1), std::ios_base::binary);
+				std::ostringstream os(std::ios_base::binary);
+				decompress(is, os, blob[0]);
+				samples.emplace_back(std::move(os).str());
+			} catch (const SerializationError &e) {
+				warningstream << "ServerMap: zstd dictionary: skipping block " << pos
+							  << ": " << e.what() << std::endl;
+			}
+		});
+
+		const auto start = porting::getTimeMs();
+		dictionary = trainZstdDictionary(samples);
+		if (dictionary.empty() || !fs::safeWriteToFile(path, dictionary)) {
+			warningstream << "ServerMap: Failed to make zstd dictionary " << path
+						  << std::endl;
+			return;
+		}
+		actionstream << "ServerMap: Trained zstd dictionary of " << dictionary.size()
+					 << " bytes on " << samples.size() << " blocks in "
+					 << porting::getTimeMs() - start << "ms" << std::endl;
+	}
+	if (dictionary.empty())
+		return;
+
+	const auto id = addZstdDictionary(dictionary);
+	if (!id) {
+		errorstream << "ServerMap: Invalid zstd dictionary " << path << std::endl;
+		return;
+	}
+	// Loaded for reading anyway, used for writing only when enabled
+	if (g_settings->getBool("map_zstd_dictionary")) {
+		m_zstd_dictionary = id;
+		m_zstd_dictionary_data = std::move(dictionary);
+	}
+}
+
 int Server::save(float dtime, float dedicated_server_step, bool breakable)
 {
 	// Save map, players and auth stuff
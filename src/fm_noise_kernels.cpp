@@ -0,0 +1,392 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_noise_kernels.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include "noise.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define NOISE_KERNELS_X86 1
+#include <immintrin.h>
+#else
+#define NOISE_KERNELS_X86 0
+#endif
+
+// Same as in noise.cpp
+#define NOISE_MAGIC_X    1619
+#define NOISE_MAGIC_Y    31337
+#define NOISE_MAGIC_Z    52591
+#define NOISE_MAGIC_SEED 1013U
+
+namespace noise_kernels
+{
+namespace
+{
+
+/*
+	Scalar reference, kept simple so that it can be auto-vectorized
+	where there is no hand written version (NEON)
+*/
+
+inline float lerp(float v0, float v1, float t)
+{
+	return v0 + (v1 - v0) * t;
+}
+
+void lattice2dScalar(float *out, s32 x0, s32 y, u32 count, s32 seed)
+{
+	for (u32 i = 0; i != count; i++)
+		out[i] = noise2d(x0 + i, y, seed);
+}
+
+void lattice3dScalar(float *out, s32 x0, s32 y, s32 z, u32 count, s32 seed)
+{
+	for (u32 i = 0; i != count; i++)
+		out[i] = noise3d(x0 + i, y, z, seed);
+}
+
+void lerp2Scalar(float *out, const float *a, const float *b, float t, u32 count)
+{
+	for (u32 i = 0; i != count; i++)
+		out[i] = lerp(a[i], b[i], t);
+}
+
+void lerp4Scalar(float *out, const float *a, const float *b, const float *c,
+		const float *d, float t, float t2, u32 count)
+{
+	for (u32 i = 0; i != count; i++)
+		out[i] = lerp(lerp(a[i], b[i], t), lerp(c[i], d[i], t), t2);
+}
+
+void accumulateScalar(float *result, const float *value, float g, u32 count,
+		bool absvalue)
+{
+	if (absvalue) {
+		for (u32 i = 0; i != count; i++)
+			result[i] += g * std::fabs(value[i]);
+	} else {
+		for (u32 i = 0; i != count; i++)
+			result[i] += g * value[i];
+	}
+}
+
+void accumulatePersistScalar(float *result, float *gmap, const float *value,
+		const float *persistence, u32 count, bool absvalue)
+{
+	if (absvalue) {
+		for (u32 i = 0; i != count; i++) {
+			result[i] += gmap[i] * std::fabs(value[i]);
+			gmap[i] *= persistence[i];
+		}
+	} else {
+		for (u32 i = 0; i != count; i++) {
+			result[i] += gmap[i] * value[i];
+			gmap[i] *= persistence[i];
+		}
+	}
+}
+
+const kernels KERNELS_SCALAR{"scalar", lattice2dScalar, lattice3dScalar,
+		lerp2Scalar, lerp4Scalar, accumulateScalar, accumulatePersistScalar};
+
+#if NOISE_KERNELS_X86
+
+/*
+	SSE4.1: 4 lanes, _mm_mullo_epi32 for the hash
+*/
+
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+
+TARGET_SSE41 inline __m128 hashToFloatSse(__m128i n)
+{
+	const __m128i mask = _mm_set1_epi32(0x7fffffff);
+	n = _mm_and_si128(n, mask);
+	n = _mm_xor_si128(_mm_srli_epi32(n, 13), n);
+	__m128i t = _mm_mullo_epi32(_mm_mullo_epi32(n, n), _mm_set1_epi32(60493));
+	t = _mm_add_epi32(t, _mm_set1_epi32(19990303));
+	t = _mm_add_epi32(_mm_mullo_epi32(n, t), _mm_set1_epi32(1376312589));
+	t = _mm_and_si128(t, mask);
+	// / 0x40000000 is exact as * 2^-30
+	return _mm_sub_ps(_mm_set1_ps(1.f),
+			_mm_mul_ps(_mm_cvtepi32_ps(t), _mm_set1_ps(1.f / 0x40000000)));
+}
+
+TARGET_SSE41 void latticeSse(float *out, s32 x0, u32 base, u32 count)
+{
+	__m128i n = _mm_add_epi32(_mm_set1_epi32(base + NOISE_MAGIC_X * (u32)x0),
+			_mm_setr_epi32(0, NOISE_MAGIC_X, 2 * NOISE_MAGIC_X, 3 * NOISE_MAGIC_X));
+	const __m128i step = _mm_set1_epi32(4 * NOISE_MAGIC_X);
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(out + i, hashToFloatSse(n));
+		n = _mm_add_epi32(n, step);
+	}
+	if (i != count) {
+		alignas(16) float tail[4];
+		_mm_store_ps(tail, hashToFloatSse(n));
+		std::memcpy(out + i, tail, (count - i) * sizeof(float));
+	}
+}
+
+TARGET_SSE41 void lattice2dSse(float *out, s32 x0, s32 y, u32 count, s32 seed)
+{
+	latticeSse(out, x0, NOISE_MAGIC_Y * (u32)y + NOISE_MAGIC_SEED * (u32)seed, count);
+}
+
+TARGET_SSE41 void lattice3dSse(float *out, s32 x0, s32 y, s32 z, u32 count, s32 seed)
+{
+	latticeSse(out, x0,
+			NOISE_MAGIC_Y * (u32)y + NOISE_MAGIC_Z * (u32)z +
+					NOISE_MAGIC_SEED * (u32)seed,
+			count);
+}
+
+TARGET_SSE41 inline __m128 lerpSse(__m128 v0, __m128 v1, __m128 t)
+{
+	return _mm_add_ps(v0, _mm_mul_ps(_mm_sub_ps(v1, v0), t));
+}
+
+TARGET_SSE41 void lerp2Sse(float *out, const float *a, const float *b, float t,
+		u32 count)
+{
+	const __m128 tt = _mm_set1_ps(t);
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(out + i, lerpSse(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i), tt));
+	lerp2Scalar(out + i, a + i, b + i, t, count - i);
+}
+
+TARGET_SSE41 void lerp4Sse(float *out, const float *a, const float *b,
+		const float *c, const float *d, float t, float t2, u32 count)
+{
+	const __m128 tt = _mm_set1_ps(t);
+	const __m128 tt2 = _mm_set1_ps(t2);
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128 p0 = lerpSse(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i), tt);
+		const __m128 p1 = lerpSse(_mm_loadu_ps(c + i), _mm_loadu_ps(d + i), tt);
+		_mm_storeu_ps(out + i, lerpSse(p0, p1, tt2));
+	}
+	lerp4Scalar(out + i, a + i, b + i, c + i, d + i, t, t2, count - i);
+}
+
+TARGET_SSE41 void accumulateSse(float *result, const float *value, float g,
+		u32 count, bool absvalue)
+{
+	const __m128 gg = _mm_set1_ps(g);
+	const __m128 abs_mask = _mm_castsi128_ps(
+			_mm_set1_epi32(absvalue ? 0x7fffffff : -1));
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128 val = _mm_and_ps(_mm_loadu_ps(value + i), abs_mask);
+		_mm_storeu_ps(result + i,
+				_mm_add_ps(_mm_loadu_ps(result + i), _mm_mul_ps(gg, val)));
+	}
+	accumulateScalar(result + i, value + i, g, count - i, absvalue);
+}
+
+TARGET_SSE41 void accumulatePersistSse(float *result, float *gmap,
+		const float *value, const float *persistence, u32 count, bool absvalue)
+{
+	const __m128 abs_mask = _mm_castsi128_ps(
+			_mm_set1_epi32(absvalue ? 0x7fffffff : -1));
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128 g = _mm_loadu_ps(gmap + i);
+		const __m128 val = _mm_and_ps(_mm_loadu_ps(value + i), abs_mask);
+		_mm_storeu_ps(result + i, _mm_add_ps(_mm_loadu_ps(result + i), _mm_mul_ps(g, val)));
+		_mm_storeu_ps(gmap + i, _mm_mul_ps(g, _mm_loadu_ps(persistence + i)));
+	}
+	accumulatePersistScalar(result + i, gmap + i, value + i, persistence + i,
+			count - i, absvalue);
+}
+
+const kernels KERNELS_SSE41{"sse4.1", lattice2dSse, lattice3dSse, lerp2Sse,
+		lerp4Sse, accumulateSse, accumulatePersistSse};
+
+/*
+	AVX2: 8 lanes
+*/
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+TARGET_AVX2 inline __m256 hashToFloatAvx2(__m256i n)
+{
+	const __m256i mask = _mm256_set1_epi32(0x7fffffff);
+	n = _mm256_and_si256(n, mask);
+	n = _mm256_xor_si256(_mm256_srli_epi32(n, 13), n);
+	__m256i t = _mm256_mullo_epi32(_mm256_mullo_epi32(n, n), _mm256_set1_epi32(60493));
+	t = _mm256_add_epi32(t, _mm256_set1_epi32(19990303));
+	t = _mm256_add_epi32(_mm256_mullo_epi32(n, t), _mm256_set1_epi32(1376312589));
+	t = _mm256_and_si256(t, mask);
+	return _mm256_sub_ps(_mm256_set1_ps(1.f),
+			_mm256_mul_ps(_mm256_cvtepi32_ps(t), _mm256_set1_ps(1.f / 0x40000000)));
+}
+
+TARGET_AVX2 void latticeAvx2(float *out, s32 x0, u32 base, u32 count)
+{
+	__m256i n = _mm256_add_epi32(_mm256_set1_epi32(base + NOISE_MAGIC_X * (u32)x0),
+			_mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+					_mm256_set1_epi32(NOISE_MAGIC_X)));
+	const __m256i step = _mm256_set1_epi32(8 * NOISE_MAGIC_X);
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		_mm256_storeu_ps(out + i, hashToFloatAvx2(n));
+		n = _mm256_add_epi32(n, step);
+	}
+	if (i != count) {
+		alignas(32) float tail[8];
+		_mm256_store_ps(tail, hashToFloatAvx2(n));
+		std::memcpy(out + i, tail, (count - i) * sizeof(float));
+	}
+}
+
+TARGET_AVX2 void lattice2dAvx2(float *out, s32 x0, s32 y, u32 count, s32 seed)
+{
+	latticeAvx2(out, x0, NOISE_MAGIC_Y * (u32)y + NOISE_MAGIC_SEED * (u32)seed, count);
+}
+
+TARGET_AVX2 void lattice3dAvx2(float *out, s32 x0, s32 y, s32 z, u32 count, s32 seed)
+{
+	latticeAvx2(out, x0,
+			NOISE_MAGIC_Y * (u32)y + NOISE_MAGIC_Z * (u32)z +
+					NOISE_MAGIC_SEED * (u32)seed,
+			count);
+}
+
+TARGET_AVX2 inline __m256 lerpAvx2(__m256 v0, __m256 v1, __m256 t)
+{
+	return _mm256_add_ps(v0, _mm256_mul_ps(_mm256_sub_ps(v1, v0), t));
+}
+
+TARGET_AVX2 void lerp2Avx2(float *out, const float *a, const float *b, float t,
+		u32 count)
+{
+	const __m256 tt = _mm256_set1_ps(t);
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(out + i,
+				lerpAvx2(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), tt));
+	lerp2Scalar(out + i, a + i, b + i, t, count - i);
+}
+
+TARGET_AVX2 void lerp4Avx2(float *out, const float *a, const float *b,
+		const float *c, const float *d, float t, float t2, u32 count)
+{
+	const __m256 tt = _mm256_set1_ps(t);
+	const __m256 tt2 = _mm256_set1_ps(t2);
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256 p0 = lerpAvx2(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), tt);
+		const __m256 p1 = lerpAvx2(_mm256_loadu_ps(c + i), _mm256_loadu_ps(d + i), tt);
+		_mm256_storeu_ps(out + i, lerpAvx2(p0, p1, tt2));
+	}
+	lerp4Scalar(out + i, a + i, b + i, c + i, d + i, t, t2, count - i);
+}
+
+TARGET_AVX2 void accumulateAvx2(float *result, const float *value, float g,
+		u32 count, bool absvalue)
+{
+	const __m256 gg = _mm256_set1_ps(g);
+	const __m256 abs_mask = _mm256_castsi256_ps(
+			_mm256_set1_epi32(absvalue ? 0x7fffffff : -1));
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256 val = _mm256_and_ps(_mm256_loadu_ps(value + i), abs_mask);
+		_mm256_storeu_ps(result + i,
+				_mm256_add_ps(_mm256_loadu_ps(result + i), _mm256_mul_ps(gg, val)));
+	}
+	accumulateScalar(result + i, value + i, g, count - i, absvalue);
+}
+
+TARGET_AVX2 void accumulatePersistAvx2(float *result, float *gmap,
+		const float *value, const float *persistence, u32 count, bool absvalue)
+{
+	const __m256 abs_mask = _mm256_castsi256_ps(
+			_mm256_set1_epi32(absvalue ? 0x7fffffff : -1));
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256 g = _mm256_loadu_ps(gmap + i);
+		const __m256 val = _mm256_and_ps(_mm256_loadu_ps(value + i), abs_mask);
+		_mm256_storeu_ps(result + i,
+				_mm256_add_ps(_mm256_loadu_ps(result + i), _mm256_mul_ps(g, val)));
+		_mm256_storeu_ps(gmap + i, _mm256_mul_ps(g, _mm256_loadu_ps(persistence + i)));
+	}
+	accumulatePersistScalar(result + i, gmap + i, value + i, persistence + i,
+			count - i, absvalue);
+}
+
+const kernels KERNELS_AVX2{"avx2", lattice2dAvx2, lattice3dAvx2, lerp2Avx2,
+		lerp4Avx2, accumulateAvx2, accumulatePersistAvx2};
+
+#endif
+
+const kernels *find(const char *name)
+{
+	if (!std::strcmp(name, KERNELS_SCALAR.name))
+		return &KERNELS_SCALAR;
+#if NOISE_KERNELS_X86
+	__builtin_cpu_init();
+	if (!std::strcmp(name, KERNELS_AVX2.name) && __builtin_cpu_supports("avx2"))
+		return &KERNELS_AVX2;
+	if (!std::strcmp(name, KERNELS_SSE41.name) && __builtin_cpu_supports("sse4.1"))
+		return &KERNELS_SSE41;
+#endif
+	return nullptr;
+}
+
+const kernels &detect()
+{
+	for (const auto *name : {"avx2", "sse4.1"})
+		if (const auto *k = find(name))
+			return *k;
+	return KERNELS_SCALAR;
+}
+
+std::atomic<const kernels *> g_forced{nullptr};
+
+} // namespace
+
+const kernels &get()
+{
+	if (const auto *forced = g_forced.load(std::memory_order_relaxed))
+		return *forced;
+	static const kernels &detected = detect();
+	return detected;
+}
+
+const kernels &scalar()
+{
+	return KERNELS_SCALAR;
+}
+
+bool use(const char *name)
+{
+	if (!name) {
+		g_forced = nullptr;
+		return true;
+	}
+	const auto *k = find(name);
+	if (k)
+		g_forced = k;
+	return k;
+}
+
+} // namespace noise_kernels
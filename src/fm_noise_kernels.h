@@ -0,0 +1,65 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+
+/*
+Inner loops of Noise::noiseMap2D/3D with SSE4.1 and AVX2 versions,
+selected at runtime by CPU support.
+
+The vector versions do the same float operations in the same order as the
+scalar code (no FMA), so results are bit-for-bit equal to the scalar
+reference as long as the compiler does not contract the scalar code itself
+(-ffp-contract=fast with -mfma); then they differ by float rounding only.
+*/
+
+namespace noise_kernels
+{
+struct kernels
+{
+	const char *name;
+
+	// out[i] = noise2d(x0 + i, y, seed)
+	void (*lattice2d)(float *out, s32 x0, s32 y, u32 count, s32 seed);
+	// out[i] = noise3d(x0 + i, y, z, seed)
+	void (*lattice3d)(float *out, s32 x0, s32 y, s32 z, u32 count, s32 seed);
+
+	// out[i] = lerp(a[i], b[i], t)
+	void (*lerp2)(float *out, const float *a, const float *b, float t, u32 count);
+	// out[i] = lerp(lerp(a[i], b[i], t), lerp(c[i], d[i], t), t2)
+	void (*lerp4)(float *out, const float *a, const float *b, const float *c,
+			const float *d, float t, float t2, u32 count);
+
+	// result[i] += g * value[i]
+	void (*accumulate)(float *result, const float *value, float g, u32 count,
+			bool absvalue);
+	// result[i] += gmap[i] * value[i], gmap[i] *= persistence[i]
+	void (*accumulatePersist)(float *result, float *gmap, const float *value,
+			const float *persistence, u32 count, bool absvalue);
+};
+
+// Best for this CPU, or the one chosen by use()
+const kernels &get();
+
+const kernels &scalar();
+
+// Force "scalar", "sse4.1" or "avx2" (benchmarks), nullptr to autodetect.
+// Returns false if not supported here.
+bool use(const char *name);
+}
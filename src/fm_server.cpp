@@ -51,44 +51,6 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "serverenvironment.h"
 #include "util/timetaker.h"
 
-ServerThreadBase::ServerThreadBase(Server *server, const std::string &name,
-		int priority) : thread_vector{name, 2}, m_server{server}
-{
-}
-
-void *ServerThreadBase::run()
-{
-	// If something wrong with init order
-	std::this_thread::sleep_for(std::chrono::milliseconds(sleep_start));
-
-	BEGIN_DEBUG_EXCEPTION_HANDLER
-
-	auto time_last = porting::getTimeMs();
-
-	while (!stopRequested()) {
-		try {
-			const auto time_now = porting::getTimeMs();
-			const auto result = step((time_now - time_last) / 1000.0);
-			time_last = time_now;
-			std::this_thread::sleep_for(
-					std::chrono::milliseconds(result ? sleep_result : sleep_nothing));
-#if !EXCEPTION_DEBUG
-		} catch (const std::exception &e) {
-			errorstream << m_name << ": exception: " << e.what() << std::endl
-						<< stacktrace() << std::endl;
-		} catch (...) {
-			errorstream << m_name << ": Unknown unhandled exception at "
-						<< __PRETTY_FUNCTION__ << ":" << __LINE__ << std::endl
-						<< stacktrace() << std::endl;
-#else
-		} catch (int) { // nothing
-#endif
-		}
-	}
-	END_DEBUG_EXCEPTION_HANDLER
-	return nullptr;
-}
-
 ServerThread::ServerThread(Server *server) : thread_vector{"Server", 40}, m_server{server}
 {
 }
@@ -183,170 +145,53 @@ void *ServerThread::run()
 
 	return NULL;
 }
-MapThread::MapThread(Server *server) : thread_vector("Map", 15), m_server(server)
-{
-}
-
-void *MapThread::run()
-{
-	auto time = porting::getTimeMs();
-	while (!stopRequested()) {
-		auto time_now = porting::getTimeMs();
-		try {
-			m_server->getEnv().getMap().getBlockCacheFlush();
-			if (!m_server->AsyncRunMapStep((time_now - time) / 1000.0f, 1))
-				std::this_thread::sleep_for(std::chrono::milliseconds(200));
-			else
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
-#if !EXCEPTION_DEBUG
-		} catch (const std::exception &e) {
-			errorstream << m_name << ": exception: " << e.what() << std::endl
-						<< stacktrace() << std::endl;
-		} catch (...) {
-			errorstream << m_name << ": Unknown unhandled exception at "
-						<< __PRETTY_FUNCTION__ << ":" << __LINE__ << std::endl
-						<< stacktrace() << std::endl;
-#else
-		} catch (int) { // nothing
-#endif
-		}
-		time = time_now;
-	}
-	// END_DEBUG_EXCEPTION_HANDLER
-	return nullptr;
-}
-
-SendFarBlocksThread::SendFarBlocksThread(Server *server) :
-		ServerThreadBase(server, "SendFarBlocks", 1)
-{
-}
-
-size_t SendFarBlocksThread::step(float dtime)
-{
-	return m_server->SendFarBlocks(dtime);
-}
-
-SendBlocksThread::SendBlocksThread(Server *server) :
-		ServerThreadBase{server, "SendBlocks", 30}
-{
-	sleep_start = 100;
-	sleep_result = 5;
-	sleep_nothing = 200;
-}
-
-size_t SendBlocksThread::step(float dtime)
-{
-	return m_server->SendBlocks(dtime);
-}
-
-LiquidThread::LiquidThread(Server *server) : thread_vector{"Liquid", 4}, m_server{server}
-{
-}
-
-void *LiquidThread::run()
-{
-	BEGIN_DEBUG_EXCEPTION_HANDLER
-
-	unsigned int max_cycle_ms = 1000;
-	while (!stopRequested()) {
-		try {
-			const auto time_start = porting::getTimeMs();
-			m_server->getEnv().getMap().getBlockCacheFlush();
-			std::map<v3bpos_t, MapBlock *> modified_blocks; // not used by fm
-			const auto processed = m_server->getEnv().getServerMap().transformLiquids(
-					modified_blocks, &m_server->getEnv(), m_server, max_cycle_ms);
-			const auto time_spend = porting::getTimeMs() - time_start;
-
-			thread_local const auto static liquid_step =
-					g_settings->getBool("liquid_step");
-			const auto sleep = (processed < 10 ? 100 : 3) +
-							   (time_spend > liquid_step ? 1 : liquid_step - time_spend);
-			std::this_thread::sleep_for(std::chrono::milliseconds(sleep));
-
-#if !EXCEPTION_DEBUG
-		} catch (const std::exception &e) {
-			errorstream << m_name << ": exception: " << e.what() << std::endl
-						<< stacktrace() << std::endl;
-		} catch (...) {
-			errorstream << m_name << ": Unknown unhandled exception at "
-						<< __PRETTY_FUNCTION__ << ":" << __LINE__ << std::endl
-						<< stacktrace() << std::endl;
-#else
-		} catch (int) { // nothing
-#endif
-		}
-	}
-	END_DEBUG_EXCEPTION_HANDLER
-	return nullptr;
-}
-
-EnvThread::EnvThread(Server *server) : thread_vector{"Env", 20}, m_server{server}
-{
-}
-
-void *EnvThread::run()
-{
-	unsigned int max_cycle_ms = 1000;
-	auto time = porting::getTimeMs();
-	while (!stopRequested()) {
-		try {
-			m_server->getEnv().getMap().getBlockCacheFlush();
-			auto ctime = porting::getTimeMs();
-			auto dtimems = ctime - time;
-			time = ctime;
-			m_server->getEnv().step(
-					dtimems / 1000.0f, m_server->m_uptime_counter->get(), max_cycle_ms);
-			std::this_thread::sleep_for(
-					std::chrono::milliseconds(dtimems > 100 ? 1 : 100 - dtimems));
-#if !EXCEPTION_DEBUG
-		} catch (const std::exception &e) {
-			errorstream << m_name << ": exception: " << e.what() << std::endl
-						<< stacktrace() << std::endl;
-		} catch (...) {
-			errorstream << m_name << ": Unknown unhandled exception at "
-						<< __PRETTY_FUNCTION__ << ":" << __LINE__ << std::endl
-						<< stacktrace() << std::endl;
-#else
-		} catch (int) { // nothing
-#endif
-		}
-	}
-	return nullptr;
-}
-
-AbmThread::AbmThread(Server *server) : thread_vector{"Abm", 20}, m_server{server}
-{
-}
-
-void *AbmThread::run()
-{
-	BEGIN_DEBUG_EXCEPTION_HANDLER
-
-	unsigned int max_cycle_ms = 10000;
-	auto time = porting::getTimeMs();
-	while (!stopRequested()) {
-		try {
-			auto ctime = porting::getTimeMs();
-			auto dtimems = ctime - time;
-			time = ctime;
-			m_server->getEnv().analyzeBlocks(dtimems / 1000.0f, max_cycle_ms);
-			std::this_thread::sleep_for(
-					std::chrono::milliseconds(dtimems > 1000 ? 100 : 1000 - dtimems));
-#if !EXCEPTION_DEBUG
-		} catch (const std::exception &e) {
-			errorstream << m_name << ": exception: " << e.what() << '\n'
-						<< stacktrace() << '\n';
-		} catch (...) {
-			errorstream << m_name << ": Unknown unhandled exception at "
-						<< __PRETTY_FUNCTION__ << ":" << __LINE__ << std::endl
-						<< stacktrace() << '\n';
-#else
-		} catch (int) { // nothing
-#endif
-		}
-	}
-	END_DEBUG_EXCEPTION_HANDLER
-	return nullptr;
+void Server::addJobs()
+{
+	m_jobs->add({.name = "Map", .priority = 15}, [this](float dtime, unsigned int) {
+		m_env->getMap().getBlockCacheFlush();
+		return AsyncRunMapStep(dtime, 1) ? 10 : 200;
+	});
+
+	m_jobs->add({.name = "SendBlocks", .priority = 30, .start_ms = 100},
+			[this](float dtime, unsigned int) {
+				m_env->getMap().getBlockCacheFlush();
+				return SendBlocks(dtime) ? 5 : 200;
+			});
+
+	m_jobs->add({.name = "SendFarBlocks", .priority = 1, .start_ms = 1000},
+			[this](float dtime, unsigned int) {
+				m_env->getMap().getBlockCacheFlush();
+				return SendFarBlocks(dtime) ? 10 : 1000;
+			});
+
+	m_jobs->add({.name = "Liquid", .priority = 4},
+			[this](float dtime, unsigned int budget_ms) -> unsigned int {
+				const auto time_start = porting::getTimeMs();
+				m_env->getMap().getBlockCacheFlush();
+				std::map<v3bpos_t, MapBlock *> modified_blocks; // not used by fm
+				const auto processed = m_env->getServerMap().transformLiquids(
+						modified_blocks, m_env, this, budget_ms);
+				const auto time_spend = porting::getTimeMs() - time_start;
+
+				static const auto liquid_step = g_settings->getBool("liquid_step");
+				return (processed < 10 ? 100 : 3) +
+					   (time_spend > liquid_step ? 1 : liquid_step - time_spend);
+			});
+
+	m_jobs->add({.name = "Env", .priority = 20},
+			[this](float dtime, unsigned int budget_ms) -> unsigned int {
+				m_env->getMap().getBlockCacheFlush();
+				m_env->step(dtime, m_uptime_counter->get(), budget_ms);
+				const unsigned int dtimems = dtime * 1000;
+				return dtimems > 100 ? 1 : 100 - dtimems;
+			});
+
+	m_jobs->add({.name = "Abm", .priority = 20, .budget_ms = 10000},
+			[this](float dtime, unsigned int budget_ms) -> unsigned int {
+				m_env->analyzeBlocks(dtime, budget_ms);
+				const unsigned int dtimems = dtime * 1000;
+				return dtimems > 1000 ? 100 : 1000 - dtimems;
+			});
 }
 
 int Server::AsyncRunMapStep(float dtime, float dedicated_server_step, bool async)
@@ -492,7 +337,13 @@ void Server::SendFreeminerInit(session_t peer_id, u16 protocol_version)
 {
 	NetworkPacket pkt(TOCLIENT_FREEMINER_INIT, 0, peer_id);
 
-	MSGPACK_PACKET_INIT((int)TOCLIENT_INIT_LEGACY, 4);
+	// Blocks for clients knowing the map zstd dictionary are compressed with it
+	const auto &dictionary = m_env->getServerMap().getZstdDictionaryData();
+	RemoteClient *client = getClientNoEx(peer_id, CS_InitDone);
+	const bool send_dictionary =
+			!dictionary.empty() && client && client->net_proto_version_fm >= 5;
+
+	MSGPACK_PACKET_INIT((int)TOCLIENT_INIT_LEGACY, send_dictionary ? 5 : 4);
 
 	Settings params;
 	m_emerge->mgparams->MapgenParams::writeParams(&params);
@@ -504,6 +355,11 @@ void Server::SendFreeminerInit(session_t peer_id, u16 protocol_version)
 
 	PACK(TOCLIENT_INIT_WEATHER, g_settings->getBool("weather"));
 
+	if (send_dictionary) {
+		PACK(TOCLIENT_INIT_MAP_ZSTD_DICTIONARY, dictionary);
+		client->net_zstd_dictionary = true;
+	}
+
 	pkt.putLongString({buffer.data(), buffer.size()});
 
 	verbosestream << "Server: Sending freeminer init to id(" << peer_id
@@ -661,16 +517,15 @@ MapDatabase *GetFarDatabase(MapDatabase *dbase, ServerMap::far_dbases_t &far_dba
 	return far_dbases[step].get();
 };
 
-MapBlockPtr loadBlockNoStore(Map *smap, MapDatabase *dbase, const v3bpos_t &bpos)
+MapBlockPtr deSerializeBlockNoStore(Map *smap, const v3bpos_t &bpos, const std::string &blob)
 {
 	try {
-		MapBlockPtr block{smap->createBlankBlockNoInsert(bpos)};
-		std::string blob;
-		dbase->loadBlock(bpos, &blob);
 		if (!blob.length()) {
 			return {};
 		}
 
+		MapBlockPtr block{smap->createBlankBlockNoInsert(bpos)};
+
 		std::istringstream is(blob, std::ios_base::binary);
 
 		u8 version = SER_FMT_VER_INVALID;
@@ -691,6 +546,18 @@ MapBlockPtr loadBlockNoStore(Map *smap, MapDatabase *dbase, const v3bpos_t &bpos
 	return {};
 }
 
+MapBlockPtr loadBlockNoStore(Map *smap, MapDatabase *dbase, const v3bpos_t &bpos)
+{
+	std::string blob;
+	try {
+		dbase->loadBlock(bpos, &blob);
+	} catch (const std::exception &ex) {
+		errorstream << "Block load fail " << bpos << " : " << ex.what() << "\n";
+		return {};
+	}
+	return deSerializeBlockNoStore(smap, bpos, blob);
+}
+
 void Server::SendBlockFm(session_t peer_id, MapBlockPtr block, u8 ver,
 		u16 net_proto_version, SerializedBlockCache *cache)
 {
@@ -722,12 +589,79 @@ void Server::SendBlockFm(session_t peer_id, MapBlockPtr block, u8 ver,
 	Send(&pkt);
 }
 
-void Server::SendBlocksFm(session_t peer_id, std::vector<MapBlockPtr> blocks, u8 ver,
-		u16 net_proto_version, SerializedBlockCache *cache)
+void Server::serializeBlockNet(
+		MapBlock *block, u8 ver, SerializedBlock &out, bool zstd_dictionary)
 {
 	thread_local const int net_compression_level =
 			rangelim(g_settings->getS16("map_compression_level_net"), -1, 9);
 
+	out.pos = block->getPos();
+	out.heat = block->heat + block->heat_add;
+	out.humidity = block->humidity + block->humidity_add;
+	out.step = block->far_step;
+	out.content_only = block->m_is_mono_block ? block->data[0].param0 : CONTENT_IGNORE;
+	out.content_only_param1 = block->data[0].param1;
+	out.content_only_param2 = block->data[0].param2;
+
+	std::ostringstream os_specific(std::ios_base::binary);
+	block->serializeNetworkSpecific(os_specific);
+	out.network_specific = os_specific.str();
+
+	const auto dictionary =
+			zstd_dictionary ? m_env->getServerMap().getZstdDictionary() : 0;
+	const serialized_block_cache::key key{
+			out.pos, out.step, ver, out.content_only != CONTENT_IGNORE, dictionary != 0};
+	const auto version = block->getModifiedVersion();
+	out.version = version;
+	if (m_serialized_block_cache)
+		out.data = m_serialized_block_cache->get(key, version);
+	if (!out.data) {
+		std::ostringstream os(std::ios_base::binary);
+		block->serialize(os, ver, false, net_compression_level, true, dictionary);
+		if (m_serialized_block_cache)
+			out.data = m_serialized_block_cache->put(key, version, os.str());
+		else
+			out.data = std::make_shared<const std::string>(os.str());
+	}
+
+	// Near blocks only, far blocks are not changed in place on the client
+	if (!m_block_snapshots || out.step || out.content_only != CONTENT_IGNORE ||
+			ver < 29)
+		return;
+	if (!m_block_snapshots->get(out.pos, version)) {
+		m_block_snapshots->put(out.pos, version,
+				std::make_shared<const std::vector<MapNode>>(block->copyNodes()));
+	}
+	for (const auto base_version : out.delta_bases) {
+		const auto base = m_block_snapshots->get(out.pos, base_version);
+		if (!base)
+			continue;
+		std::ostringstream os(std::ios_base::binary);
+		if (!block->serializeDelta(os, ver, base->data(), base->size(),
+					net_compression_level, dictionary))
+			break;
+		if (os.tellp() < std::streamoff(out.data->size()))
+			out.deltas.emplace_back(
+					base_version, std::make_shared<const std::string>(os.str()));
+	}
+}
+
+void Server::SendBlocksFm(session_t peer_id, std::vector<MapBlockPtr> blocks, u8 ver,
+		u16 net_proto_version, SerializedBlockCache *cache, bool zstd_dictionary)
+{
+	std::vector<SerializedBlock> serialized(blocks.size());
+	std::vector<const SerializedBlock *> to_send;
+	to_send.reserve(blocks.size());
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		serializeBlockNet(blocks[i].get(), ver, serialized[i], zstd_dictionary);
+		to_send.emplace_back(&serialized[i]);
+	}
+	SendBlocksFm(peer_id, to_send);
+}
+
+void Server::SendBlocksFm(
+		session_t peer_id, const std::vector<const SerializedBlock *> &blocks)
+{
 	g_profiler->add("Connection: blocks sent", 1);
 
 	MSGPACK_PACKET_INIT((int)TOCLIENT_BLOCKDATA_FM, 2);
@@ -736,23 +670,21 @@ void Server::SendBlocksFm(session_t peer_id, std::vector<MapBlockPtr> blocks, u8
 	msgpack::packer<msgpack::sbuffer> pk_blocks(&buffer_blocks);
 	pk_blocks.pack_array(blocks.size());
 
-	for (const auto &block : blocks) {
-		pk_blocks.pack_map(8);
-		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_POS, block->getPos());
-		std::ostringstream os(std::ios_base::binary);
-		block->serialize(os, ver, false, net_compression_level);
-		block->serializeNetworkSpecific(os);
-
-		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_DATA, os.str());
-		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_HEAT,
-				(weather::heat_t)(block->heat + block->heat_add));
-		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_HUMIDITY,
-				(weather::humidity_t)(block->humidity + block->humidity_add));
-		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_STEP, block->far_step);
-		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_CONTENT_ONLY,
-				block->m_is_mono_block ? block->data[0].param0 : CONTENT_IGNORE);
-		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_CONTENT_ONLY_PARAM1, block->data[0].param1);
-		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_CONTENT_ONLY_PARAM2, block->data[0].param2);
+	for (const auto *block : blocks) {
+		pk_blocks.pack_map(block->delta_base ? 10 : 9);
+		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_POS, block->pos);
+		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_DATA, *block->data);
+		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_VERSION, block->version);
+		if (block->delta_base)
+			PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_DELTA_BASE, block->delta_base);
+		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_HEAT, block->heat);
+		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_HUMIDITY, block->humidity);
+		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_STEP, block->step);
+		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_CONTENT_ONLY, block->content_only);
+		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_CONTENT_ONLY_PARAM1,
+				block->content_only_param1);
+		PACK_PK(pk_blocks, TOCLIENT_BLOCKDATA_CONTENT_ONLY_PARAM2,
+				block->content_only_param2);
 	}
 
 	PACK(TOCLIENT_BLOCKDATA_BLOCKS_DATA,
@@ -21,27 +21,11 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include "threading/job_scheduler.h"
 #include "threading/thread_vector.h"
 
 class Server;
 
-class ServerThreadBase : public thread_vector
-{
-protected:
-	Server *const m_server;
-
-public:
-	int sleep_start{1000};
-	int sleep_result{10};
-	int sleep_nothing{1000};
-
-	ServerThreadBase(
-			Server *server, const std::string &name = "Unnamed", int priority = 0);
-	void *run();
-
-	virtual size_t step(float dtime) = 0;
-};
-
 class ServerThread : public thread_vector
 {
 public:
@@ -53,65 +37,6 @@ class ServerThread : public thread_vector
 	Server *const m_server;
 };
 
-class MapThread : public thread_vector
-{
-	Server *const m_server;
-
-public:
-	MapThread(Server *server);
-
-	void *run();
-};
-
-class SendBlocksThread : public ServerThreadBase
-{
-public:
-	SendBlocksThread(Server *server);
-
-private:
-	size_t step(float dtime) override;
-};
-
-class SendFarBlocksThread : public ServerThreadBase
-{
-public:
-	//using ServerThreadBase::ServerThreadBase;
-	SendFarBlocksThread(Server *server);
-
-private:
-	size_t step(float dtime) override;
-};
-
-class LiquidThread : public thread_vector
-{
-	Server *const m_server;
-
-public:
-	LiquidThread(Server *server);
-
-	void *run();
-};
-
-class EnvThread : public thread_vector
-{
-	Server *const m_server;
-
-public:
-	EnvThread(Server *server);
-
-	void *run();
-};
-
-class AbmThread : public thread_vector
-{
-	Server *const m_server;
-
-public:
-	AbmThread(Server *server);
-
-	void *run();
-};
-
 class AbmWorldThread : public thread_vector
 {
 	Server *const m_server;
@@ -91,10 +91,10 @@ int ServerEnvironment::analyzeBlocks(float dtime, unsigned int max_cycle_ms)
 			auto lock_map = m_map->m_nothread_locker.try_lock_shared_rec();
 			if (lock_map->owns_lock())
 #endif
-			{
-				const auto lock = m_map->m_blocks.try_lock_shared_rec();
+			for (const auto &shard : m_map->m_blocks.shards()) {
+				const auto lock = shard.try_lock_shared_rec();
 				if (lock->owns_lock())
-					for (const auto &ir : m_map->m_blocks) {
+					for (const auto &ir : shard) {
 						if (!ir.second || !ir.second->abm_triggers)
 							continue;
 						m_abm_random_blocks.emplace_back(ir.first);
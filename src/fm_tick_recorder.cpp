@@ -0,0 +1,271 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_tick_recorder.h"
+
+#include <algorithm>
+#include <csignal>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include "filesys.h"
+#include "porting.h"
+
+namespace
+{
+// Limit for threads which never see a server step
+constexpr size_t MAX_THREAD_EVENTS = 1 << 20;
+
+volatile std::sig_atomic_t g_dump_requested = 0;
+
+#if !defined(_WIN32)
+void dump_signal_handler(int)
+{
+	g_dump_requested = 1;
+}
+#endif
+
+void write_json_string(std::ostream &os, const std::string &s)
+{
+	os << '"';
+	for (const char c : s) {
+		if (c == '"' || c == '\\')
+			os << '\\' << c;
+		else if (static_cast<unsigned char>(c) < 0x20)
+			os << ' ';
+		else
+			os << c;
+	}
+	os << '"';
+}
+}
+
+tick_recorder::scope::scope(const std::string &name)
+{
+	auto &recorder = tick_recorder::instance();
+	if (!recorder.enabled())
+		return;
+	m_name = recorder.intern(name);
+	++recorder.local().depth;
+	m_begin_us = porting::getTimeUs();
+}
+
+void tick_recorder::scope::stop() noexcept
+{
+	if (!m_name)
+		return;
+	const auto end_us = porting::getTimeUs();
+	auto &recorder = tick_recorder::instance();
+	auto &log = recorder.local();
+	if (log.depth)
+		--log.depth;
+	recorder.record(m_name, log.depth, m_begin_us, end_us);
+	m_name = 0;
+}
+
+tick_recorder &tick_recorder::instance()
+{
+	// Leaked: scopes can be stopped during static destruction
+	static auto *recorder = new tick_recorder();
+	return *recorder;
+}
+
+void tick_recorder::setSteps(uint32_t steps)
+{
+	m_steps = steps;
+	if (steps)
+		return;
+	const auto lock = std::lock_guard(m_threads_mutex);
+	for (const auto &log : m_threads) {
+		const auto log_lock = std::lock_guard(log->mutex);
+		log->events.clear();
+		log->events.shrink_to_fit();
+	}
+}
+
+void tick_recorder::beginStep()
+{
+	++m_step;
+}
+
+uint32_t tick_recorder::intern(const std::string &name)
+{
+	{
+		const auto lock = std::shared_lock(m_names_mutex);
+		if (const auto it = m_name_ids.find(name); it != m_name_ids.end())
+			return it->second;
+	}
+	const auto lock = std::unique_lock(m_names_mutex);
+	const auto [it, inserted] = m_name_ids.emplace(name, m_names.size());
+	if (inserted)
+		m_names.emplace_back(name);
+	return it->second;
+}
+
+tick_recorder::thread_log &tick_recorder::local()
+{
+	thread_local std::shared_ptr<thread_log> log;
+	if (!log) {
+		log = std::make_shared<thread_log>();
+		const auto lock = std::lock_guard(m_threads_mutex);
+		log->tid = m_threads.size() + 1;
+		m_threads.emplace_back(log);
+	}
+	return *log;
+}
+
+void tick_recorder::record(
+		uint32_t name, uint16_t depth, uint64_t begin_us, uint64_t end_us)
+{
+	const auto steps = m_steps.load(std::memory_order_relaxed);
+	if (!steps)
+		return;
+	const auto step = currentStep();
+	auto &log = local();
+	const auto lock = std::lock_guard(log.mutex);
+	while (!log.events.empty() && (log.events.front().step + steps <= step ||
+										  log.events.size() >= MAX_THREAD_EVENTS))
+		log.events.pop_front();
+	log.events.emplace_back(event{name, step, depth, begin_us, end_us});
+}
+
+std::vector<std::pair<uint32_t, std::vector<tick_recorder::event>>>
+tick_recorder::collect() const
+{
+	std::vector<std::pair<uint32_t, std::vector<event>>> result;
+	const auto lock = std::lock_guard(m_threads_mutex);
+	for (const auto &log : m_threads) {
+		const auto log_lock = std::lock_guard(log->mutex);
+		if (log->events.empty())
+			continue;
+		auto &events = result.emplace_back(log->tid, std::vector<event>()).second;
+		events.assign(log->events.begin(), log->events.end());
+		// Parents end after their children, order by begin for the readers
+		std::sort(events.begin(), events.end(), [](const event &a, const event &b) {
+			return a.begin_us != b.begin_us ? a.begin_us < b.begin_us
+											: a.depth < b.depth;
+		});
+	}
+	return result;
+}
+
+void tick_recorder::writeChromeTrace(std::ostream &os) const
+{
+	const auto threads = collect();
+	std::vector<std::string> names;
+	{
+		const auto lock = std::shared_lock(m_names_mutex);
+		names = m_names;
+	}
+
+	os << "{\"traceEvents\":[";
+	bool first = true;
+	for (const auto &[tid, events] : threads) {
+		os << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+		   << tid << ",\"args\":{\"name\":\"thread " << tid << "\"}}";
+		first = false;
+		for (const auto &e : events) {
+			os << ",\n{\"name\":";
+			write_json_string(os, names[e.name]);
+			os << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << e.begin_us
+			   << ",\"dur\":" << e.end_us - e.begin_us << ",\"args\":{\"step\":" << e.step
+			   << "}}";
+		}
+	}
+	os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void tick_recorder::writeCollapsed(std::ostream &os) const
+{
+	const auto threads = collect();
+	std::vector<std::string> names;
+	{
+		const auto lock = std::shared_lock(m_names_mutex);
+		names = m_names;
+	}
+	for (auto &name : names)
+		std::replace(name.begin(), name.end(), ';', ',');
+
+	// Self time in microseconds by stack
+	std::map<std::string, uint64_t> stacks;
+	struct open_scope
+	{
+		const event *e;
+		std::string path;
+		uint64_t children_us;
+	};
+	for (const auto &[tid, events] : threads) {
+		const auto root = "thread " + std::to_string(tid);
+		std::vector<open_scope> stack;
+		const auto pop = [&] {
+			const auto &top = stack.back();
+			const auto dur = top.e->end_us - top.e->begin_us;
+			stacks[top.path] += dur - std::min(dur, top.children_us);
+			stack.pop_back();
+			if (!stack.empty())
+				stack.back().children_us += dur;
+		};
+		for (const auto &e : events) {
+			// Parent must be less deep and contain this event; it can be
+			// missing if it was still running while dumping
+			while (!stack.empty() &&
+					(stack.size() > e.depth || stack.back().e->end_us < e.end_us ||
+							stack.back().e->depth >= e.depth))
+				pop();
+			auto path = (stack.empty() ? root : stack.back().path) + ";" + names[e.name];
+			stack.emplace_back(open_scope{&e, std::move(path), 0});
+		}
+		while (!stack.empty())
+			pop();
+	}
+	for (const auto &[path, us] : stacks)
+		if (us)
+			os << path << ' ' << us << '\n';
+}
+
+std::string tick_recorder::dump(const std::string &dir, const std::string &format) const
+{
+	const bool collapsed = format == "collapsed" || format == "folded";
+	if (!collapsed && !format.empty() && format != "chrome" && format != "json")
+		return {};
+	const auto path = dir + DIR_DELIM + "tick_profile_" +
+					  std::to_string(std::time(nullptr)) +
+					  (collapsed ? ".folded" : ".json");
+	std::ofstream os(path, std::ios::binary);
+	if (!os.good())
+		return {};
+	if (collapsed)
+		writeCollapsed(os);
+	else
+		writeChromeTrace(os);
+	return os.good() ? path : std::string();
+}
+
+void tick_recorder::installSignalHandler()
+{
+#if !defined(_WIN32)
+	(void)signal(SIGUSR2, dump_signal_handler);
+#endif
+}
+
+bool tick_recorder::takeDumpRequest()
+{
+	if (!g_dump_requested)
+		return false;
+	g_dump_requested = 0;
+	return true;
+}
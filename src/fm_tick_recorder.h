@@ -0,0 +1,114 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+Hierarchical timings of the last server steps, to look at a lag spike after
+it happened.
+
+Every ScopeProfiler (and tick_recorder::scope) records its begin/end time and
+nesting depth into a per-thread log while the recorder is enabled. Events
+older than the last `steps` server steps are dropped. The logs can be written
+as Chrome trace JSON (chrome://tracing, Perfetto) or as collapsed stacks for
+flamegraph.pl / speedscope.
+*/
+
+class tick_recorder
+{
+public:
+	struct event
+	{
+		uint32_t name;
+		uint32_t step;
+		uint16_t depth;
+		uint64_t begin_us, end_us;
+	};
+
+	// Records a scope into the current thread log, does nothing if disabled
+	class scope
+	{
+	public:
+		explicit scope(const std::string &name);
+		~scope() { stop(); }
+		void stop() noexcept;
+
+		scope(const scope &) = delete;
+		scope &operator=(const scope &) = delete;
+
+	private:
+		uint32_t m_name = 0;
+		uint64_t m_begin_us = 0;
+	};
+
+	static tick_recorder &instance();
+
+	// 0 disables recording and frees the logs
+	void setSteps(uint32_t steps);
+	bool enabled() const { return m_steps.load(std::memory_order_relaxed); }
+
+	// Called by the server at the beginning of each step
+	void beginStep();
+	uint32_t currentStep() const { return m_step.load(std::memory_order_relaxed); }
+
+	void writeChromeTrace(std::ostream &os) const;
+	void writeCollapsed(std::ostream &os) const;
+
+	// Write to <dir>/tick_profile_<time>.<json|folded>, returns the file path or empty
+	std::string dump(const std::string &dir, const std::string &format) const;
+
+	// SIGUSR2 requests a dump, the server checks it once per step
+	static void installSignalHandler();
+	bool takeDumpRequest();
+
+	uint32_t intern(const std::string &name);
+
+private:
+	struct thread_log
+	{
+		uint32_t tid;
+		mutable std::mutex mutex;
+		std::deque<event> events;
+		uint16_t depth = 0;
+	};
+
+	tick_recorder() = default;
+	thread_log &local();
+	void record(uint32_t name, uint16_t depth, uint64_t begin_us, uint64_t end_us);
+	std::vector<std::pair<uint32_t, std::vector<event>>> collect() const;
+
+	std::atomic_uint32_t m_steps{0};
+	std::atomic_uint32_t m_step{0};
+
+	mutable std::shared_mutex m_names_mutex;
+	std::unordered_map<std::string, uint32_t> m_name_ids;
+	std::vector<std::string> m_names{""};
+
+	mutable std::mutex m_threads_mutex;
+	std::vector<std::shared_ptr<thread_log>> m_threads;
+};
@@ -25,6 +25,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include <future>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "constants.h"
 #include "database/database.h"
 #include "irr_v3d.h"
@@ -75,29 +76,42 @@ WorldMerger::one_block_stat_t WorldMerger::merge_one_block(MapDatabase *dbase,
 	std::unordered_map<v3bpos_t, MapBlockPtr> blocks;
 	uint32_t timestamp = 0;
 	{
+		const auto add = [&](const v3bpos_t &nbpos, const MapBlockPtr &nblock) {
+			const v3pos_t rpos((nbpos.X - bpos_aligned.X) >> step,
+					(nbpos.Y - bpos_aligned.Y) >> step, (nbpos.Z - bpos_aligned.Z) >> step);
+			if (const auto ts = nblock->getActualTimestamp(); ts > timestamp)
+				timestamp = ts;
+			blocks[rpos] = nblock;
+		};
+
+		std::vector<v3bpos_t> load;
 		for (bpos_t x = 0; x < step_size; ++x)
 			for (bpos_t y = 0; y < step_size; ++y)
 				for (bpos_t z = 0; z < step_size; ++z) {
-					const v3pos_t rpos(x, y, z);
 					const v3bpos_t nbpos(bpos_aligned.X + (x << step),
 							bpos_aligned.Y + (y << step), bpos_aligned.Z + (z << step));
-					MapBlockPtr nblock;
 					if (!step) {
 						const auto block = smap->getBlock(nbpos);
 						if (block && block->isGenerated()) {
-							nblock = block;
-						}
-					}
-					if (!nblock) {
-						nblock = load_block(smap, dbase, nbpos);
-						if (!nblock || !nblock->isGenerated()) {
+							add(nbpos, block);
 							continue;
 						}
 					}
-					if (const auto ts = nblock->getActualTimestamp(); ts > timestamp)
-						timestamp = ts;
-					blocks[rpos] = nblock;
+					load.emplace_back(nbpos);
+				}
+
+		// All missing children in one database read
+		try {
+			dbase->loadBlocks(load, [&](const v3bpos_t &nbpos, std::string &&blob) {
+				const auto nblock = deSerializeBlockNoStore(smap, nbpos, blob);
+				if (nblock && nblock->isGenerated()) {
+					add(nbpos, nblock);
 				}
+			});
+		} catch (const std::exception &ex) {
+			errorstream << "Merge load fail " << bpos_aligned << " : " << ex.what()
+						<< "\n";
+		}
 	}
 
 	if (!timestamp && get_time_func) {
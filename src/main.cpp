@@ -21,6 +21,7 @@
 #include "httpfetch.h"
 #include "gameparams.h"
 #include "database/database.h"
+#include "database/database-snapshot.h"
 #include "config.h"
 #include "player.h"
 #include "porting.h"
@@ -130,6 +131,7 @@ static bool determine_subgame(GameParams *game_params);
 static bool run_dedicated_server(const GameParams &game_params, const Settings &cmd_args);
 static bool migrate_map_database(const GameParams &game_params, const Settings &cmd_args);
 static bool recompress_map_database(const GameParams &game_params, const Settings &cmd_args);
+static bool snapshot_map_database(const GameParams &game_params, const Settings &cmd_args);
 
 /**********************************************************************/
 
@@ -464,6 +466,8 @@ static void set_allowed_options(OptionList *allowed_options)
 			_("Enable ncurses interactive terminal" SERVER_ONLY))));
 	allowed_options->insert(std::make_pair("recompress", ValueSpec(VALUETYPE_FLAG,
 			_("Recompress the blocks of the given map database" SERVER_ONLY))));
+	allowed_options->insert(std::make_pair("snapshot-map", ValueSpec(VALUETYPE_FLAG,
+			_("Write the map to readonly/map.snapshot for readonly_backend = snapshot" SERVER_ONLY))));
 #if CHECK_CLIENT_BUILD()
 	allowed_options->insert(std::make_pair("address", ValueSpec(VALUETYPE_STRING,
 			_("Address to connect to ('' = local game)"))));
@@ -1251,6 +1255,9 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 	if (cmd_args.getFlag("recompress"))
 		return recompress_map_database(game_params, cmd_args);
 
+	if (cmd_args.getFlag("snapshot-map"))
+		return snapshot_map_database(game_params, cmd_args);
+
 	// Bind address
 	std::string bind_str = g_settings->get("bind_address");
 	Address bind_addr(INADDR_ANY, game_params.socket_port);
@@ -1374,14 +1381,28 @@ static bool migrate_map_database(const GameParams &game_params, const Settings &
 	}
 
 	std::string backend = world_mt.get("backend");
-	if (backend == migrate_to) {
+	// fm: leveldb to leveldb rewrites the keys in the layout of leveldb_morton_keys
+	const bool relayout = backend == migrate_to && backend == "leveldb";
+	if (backend == migrate_to && !relayout) {
 		errorstream << "Cannot migrate: new backend is same"
 			<< " as the old one" << std::endl;
 		return false;
 	}
+	const std::string relayout_dir = game_params.world_path + DIR_DELIM + "map_migrate",
+		old_map_db = game_params.world_path + DIR_DELIM + "map.db",
+		backup_map_db = old_map_db + ".old";
+	if (relayout) {
+		if (fs::PathExists(relayout_dir) || fs::PathExists(backup_map_db)) {
+			errorstream << "Cannot migrate: remove " << relayout_dir << " and "
+				<< backup_map_db << " first" << std::endl;
+			return false;
+		}
+		fs::CreateAllDirs(relayout_dir);
+	}
 
 	MapDatabase *old_db = ServerMap::createDatabase(backend, game_params.world_path, world_mt),
-		*new_db = ServerMap::createDatabase(migrate_to, game_params.world_path, world_mt);
+		*new_db = ServerMap::createDatabase(migrate_to,
+				relayout ? relayout_dir : game_params.world_path, world_mt);
 
 	u32 count = 0;
 	u64 last_update_time = 0;
@@ -1426,6 +1447,17 @@ static bool migrate_map_database(const GameParams &game_params, const Settings &
 	delete old_db;
 	delete new_db;
 
+	if (relayout) {
+		if (!fs::Rename(old_map_db, backup_map_db) ||
+				!fs::Rename(relayout_dir + DIR_DELIM + "map.db", old_map_db)) {
+			errorstream << "Failed to replace " << old_map_db << " by "
+				<< relayout_dir << DIR_DELIM << "map.db" << std::endl;
+			return false;
+		}
+		fs::DeleteSingleFileOrEmptyDirectory(relayout_dir);
+		actionstream << "Old blocks kept in " << backup_map_db << std::endl;
+	}
+
 	actionstream << "Successfully migrated " << count << " blocks" << std::endl;
 	world_mt.set("backend", migrate_to);
 	if (!world_mt.updateConfigFile(world_mt_path.c_str()))
@@ -1501,3 +1533,25 @@ static bool recompress_map_database(const GameParams &game_params, const Setting
 	actionstream << "Done, " << count << " blocks were recompressed." << std::endl;
 	return true;
 }
+
+static bool snapshot_map_database(const GameParams &game_params, const Settings &cmd_args)
+{
+	Settings world_mt;
+	const std::string world_mt_path = game_params.world_path + DIR_DELIM + "world.mt";
+
+	if (!world_mt.readConfigFile(world_mt_path.c_str())) {
+		errorstream << "Cannot read world.mt at " << world_mt_path << std::endl;
+		return false;
+	}
+	const std::string &backend = world_mt.get("backend");
+	std::unique_ptr<MapDatabase> db(
+			ServerMap::createDatabase(backend, game_params.world_path, world_mt));
+
+	const std::string readonly_dir = game_params.world_path + DIR_DELIM + "readonly";
+	fs::CreateAllDirs(readonly_dir);
+	if (!Database_Snapshot::build(db.get(), readonly_dir))
+		return false;
+
+	actionstream << "Set readonly_backend = snapshot in world.mt to use it" << std::endl;
+	return true;
+}
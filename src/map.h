@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include "threading/concurrent_sharded_unordered_map.h"
 #include "threading/concurrent_unordered_map.h"
 #include "threading/concurrent_unordered_set.h"
 #include "util/unordered_map_hash.h"
@@ -273,8 +274,9 @@ class Map : public NodeContainer
 	virtual s16 getHumidity(const v3pos_t &p, bool no_random = 0);
 
 	// from old mapsector:
+	// Lock-striped: threads working on different areas don't contend on one lock
 	using m_blocks_type =
-			concurrent_unordered_map<v3bpos_t, MapBlockPtr, v3posHash, v3posEqual>;
+			concurrent_sharded_unordered_map<v3bpos_t, MapBlockPtr, v3posHash, v3posEqual>;
 	m_blocks_type m_blocks;
 	using m_far_blocks_type =
 			concurrent_shared_unordered_map<v3bpos_t, MapBlockPtr, v3posHash, v3posEqual>;
@@ -332,7 +334,11 @@ class Map : public NodeContainer
 	void copy_27_blocks_to_vm(MapBlock *block, VoxelManipulator &vmanip);
 
 protected:
+	// Where breakable walks over m_blocks stopped: shard and position in it.
+	// Shards which were locked by others are skipped, not counted.
+	size_t m_blocks_update_shard{};
 	u32 m_blocks_update_last{};
+	size_t m_blocks_save_shard{};
 	u32 m_blocks_save_last{};
 
 public:
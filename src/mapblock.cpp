@@ -30,6 +30,8 @@
 #include "util/basic_macros.h"
 
 #include "circuit.h"
+#include "fm_block_delta.h"
+#include "fm_content_scan.h"
 
 // Like a std::unordered_map<content_t, content_t>, but faster.
 //
@@ -140,11 +142,19 @@ void MapBlock::setNode(const v3pos_t &p, const MapNode &n, bool important)
 		raiseModified(MOD_STATE_WRITE_NEEDED, light, important);
 }
 
+uint64_t MapBlock::nextModifiedVersion()
+{
+	static std::atomic_uint64_t version{0};
+	return ++version;
+}
+
 void MapBlock::raiseModified(u32 mod, modified_light light, bool important)
 {
 	static const thread_local auto save_changed_block =
 			g_settings->getBool("save_changed_block");
 
+	m_modified_version = nextModifiedVersion();
+
 		if(mod >= MOD_STATE_WRITE_NEEDED /*&& m_timestamp != BLOCK_TIMESTAMP_UNDEFINED*/) {
 			m_changed_timestamp = (unsigned int) ServerMap::time_life;
 		}
@@ -190,6 +200,27 @@ bool MapBlock::analyzeContent()
 	return true;
 }	
 
+std::vector<content_t> MapBlock::getContents()
+{
+	// version before the data, a change while scanning makes the next call rescan
+	const uint64_t version = m_modified_version;
+	{
+		const auto lock = std::lock_guard(m_contents_mutex);
+		if (m_contents_version == version)
+			return m_contents;
+	}
+	std::vector<content_t> contents;
+	{
+		const auto lock = lock_shared_rec();
+		if (data)
+			content_scan::collect(data, m_is_mono_block ? 1 : nodecount, contents);
+	}
+	const auto lock = std::lock_guard(m_contents_mutex);
+	m_contents_version = version;
+	m_contents = contents;
+	return contents;
+}
+
 const MapBlock::mesh_type empty_mesh;
 #if CHECK_CLIENT_BUILD()
 const MapBlock::mesh_type MapBlock::getLodMesh(block_step_t step, bool allow_other)
@@ -421,6 +452,7 @@ void MapBlock::copyFrom(const VoxelManipulator &src)
 	src.copyTo(data, data_area, v3pos_t(0,0,0),
 			getPosRelative(), data_size);
 	tryShrinkNodes();
+	m_modified_version = nextModifiedVersion();
 }
 
 void MapBlock::reallocate(u32 count, MapNode n)
@@ -583,7 +615,7 @@ void MapBlock::correctBlockNodeIds(const NameIdMapping *nimap, MapNode *nodes,
 	}
 }
 
-void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int compression_level)
+void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int compression_level, bool compressed, u32 zstd_dictionary)
 {
 	if (!ser_ver_supported_write(version))
 		throw VersionMismatchException("ERROR: MapBlock format not supported");
@@ -706,7 +738,13 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 
 	if (version >= 29) {
 		// now compress the whole thing
-		compress(os_raw.str(), os_compressed, version, compression_level);
+		if (compressed) {
+			compress(os_raw.str(), os_compressed, version, compression_level,
+					zstd_dictionary);
+		} else {
+			const auto raw = os_raw.view();
+			os_compressed.write(raw.data(), raw.size());
+		}
 	}
 }
 
@@ -718,6 +756,66 @@ void MapBlock::serializeNetworkSpecific(std::ostream &os)
 	writeF1000(os, humidity + humidity_add); // deprecated humidity
 }
 
+bool MapBlock::serializeDelta(std::ostream &os_compressed, u8 version, const MapNode *base,
+		size_t base_count, int compression_level, u32 zstd_dictionary)
+{
+	if (version < 29)
+		throw VersionMismatchException("ERROR: MapBlock delta needs format 29");
+
+	const auto lock = lock_shared_rec();
+	// light points are kept with the whole block only
+	if (!m_light_points.empty())
+		return false;
+
+	std::ostringstream os(std::ios_base::binary);
+	u8 flags = 0;
+	if (is_underground)
+		flags |= 0x01;
+	if (!isAir())
+		flags |= 0x02;
+	if (!m_generated)
+		flags |= 0x08;
+	writeU8(os, flags);
+	writeU16(os, m_lighting_complete);
+
+	block_delta::encode(os, base, base_count, data, m_is_mono_block ? 1 : nodecount,
+			nodecount);
+	m_node_metadata.serialize(os, version, false);
+
+	compress(os.str(), os_compressed, version, compression_level, zstd_dictionary);
+	return true;
+}
+
+void MapBlock::deSerializeDelta(std::istream &in_compressed, u8 version)
+{
+	const auto lock = lock_unique_rec();
+
+	if (version < 29)
+		throw VersionMismatchException("ERROR: MapBlock delta needs format 29");
+
+	m_modified_version = nextModifiedVersion();
+	m_is_air_expired = true;
+	expandNodesIfNeeded();
+
+	std::stringstream is(std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+	decompress(in_compressed, is, version);
+
+	const u8 flags = readU8(is);
+	is_underground = (flags & 0x01) != 0;
+	m_lighting_complete = readU16(is);
+	m_generated = (flags & 0x08) == 0;
+	m_light_points.clear();
+
+	block_delta::decode(is, data, nodecount);
+	m_node_metadata.deSerialize(is, m_gamedef->idef());
+}
+
+std::vector<MapNode> MapBlock::copyNodes()
+{
+	const auto lock = lock_shared_rec();
+	return {data, data + (m_is_mono_block ? 1 : nodecount)};
+}
+
 bool MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 {
 	const auto lock = lock_unique_rec();
@@ -727,6 +825,7 @@ bool MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 
 	TRACESTREAM(<<"MapBlock::deSerialize "<<getPos()<<std::endl);
 
+	m_modified_version = nextModifiedVersion();
 	m_is_air_expired = true;
 	expandNodesIfNeeded();
 
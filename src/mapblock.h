@@ -128,6 +128,12 @@ class MapBlock
 		return m_modified;
 	}
 
+	// Changes with every modification, unique over all blocks
+	uint64_t getModifiedVersion() const
+	{
+		return m_modified_version;
+	}
+
 /*
 	inline u32 getModifiedReason()
 	{
@@ -457,7 +463,10 @@ class MapBlock
 	// These don't write or read version by itself
 	// Set disk to true for on-disk format, false for over-the-network format
 	// Precondition: version >= SER_FMT_VER_LOWEST_WRITE
-	void serialize(std::ostream &result, u8 version, bool disk, int compression_level);
+	// compressed == false (version >= 29): leave the final compress() to the caller
+	// zstd_dictionary (version >= 29): id from addZstdDictionary, 0 for none
+	void serialize(std::ostream &result, u8 version, bool disk, int compression_level,
+			bool compressed = true, u32 zstd_dictionary = 0);
 	// If disk == true: In addition to doing other things, will add
 	// unknown blocks from id-name mapping to wndef
 	bool deSerialize(std::istream &is, u8 version, bool disk);
@@ -465,6 +474,17 @@ class MapBlock
 	void serializeNetworkSpecific(std::ostream &os);
 	void deSerializeNetworkSpecific(std::istream &is);
 
+	// fm: network form of the changes from base to this block, see fm_block_delta.h.
+	// base has nodecount nodes or 1 of a mono block. Precondition: version >= 29
+	// false if the block has data a delta does not carry, send it whole
+	bool serializeDelta(std::ostream &result, u8 version, const MapNode *base,
+			size_t base_count, int compression_level, u32 zstd_dictionary = 0);
+	// Apply a delta made against the nodes of this block
+	// @throws SerializationError
+	void deSerializeDelta(std::istream &is, u8 version);
+	// nodecount nodes or 1 of a mono block
+	std::vector<MapNode> copyNodes();
+
 //fm:
 	/*
 		Flags
@@ -480,6 +500,7 @@ class MapBlock
 	void fill(const MapNode & n) {
 		for (u32 i = 0; i < nodecount; ++i)
 			data[i] = n;
+		m_modified_version = nextModifiedVersion();
 	}
 
 	using mesh_type = std::shared_ptr<MapBlockMesh>;
@@ -521,6 +542,8 @@ class MapBlock
 		s6_mesh_complete,
 	};
 	far_status_e far_status{};
+	// Client: server block version of the data, base of TOCLIENT_BLOCKDATA_DELTA
+	uint64_t net_version{};
 	std::atomic_uint32_t far_iteration{};
 	std::atomic_bool creating_far_mesh{};
 	std::atomic_short heat{};
@@ -534,6 +557,8 @@ class MapBlock
 
 	// Last really changed time (need send to client)
 	std::atomic_uint m_changed_timestamp{};
+	static uint64_t nextModifiedVersion();
+	std::atomic_uint64_t m_modified_version{nextModifiedVersion()};
 	uint32_t m_next_analyze_timestamp{};
 	typedef std::list<abm_trigger_one> abm_triggers_type;
 	std::unique_ptr<abm_triggers_type> abm_triggers;
@@ -558,6 +583,11 @@ class MapBlock
 	//std::atomic<content_t> content_only{CONTENT_IGNORE};
 	//u8 content_only_param1{}, content_only_param2{};
 	bool analyzeContent();
+	// Distinct contents of the nodes, cached until the block is modified
+	std::vector<content_t> getContents();
+	std::mutex m_contents_mutex;
+	uint64_t m_contents_version{};
+	std::vector<content_t> m_contents;
 	std::mutex m_usage_timer_mutex;
 
 	/*
@@ -552,6 +552,15 @@ void CavesRandomWalk::carveRoute(v3f vec, float f, bool randomize_xz)
 	for (s16 z0 = d0; z0 <= d1; z0++) {
 		s16 si = rs / 2 - MYMAX(0, abs(z0) - rs / 7 - 1);
 		for (s16 x0 = -si - ps->range(0,1); x0 <= si - 1 + ps->range(0,1); x0++) {
+			// The loop condition above draws randomness, skip only the body
+			if (carve_area) {
+				const pos_t x = cp.X + x0 + of.X;
+				const pos_t z = cp.Z + z0 + of.Z;
+				if (x < carve_area->MinEdge.X || x > carve_area->MaxEdge.X ||
+						z < carve_area->MinEdge.Z || z > carve_area->MaxEdge.Z)
+					continue;
+			}
+
 			s16 maxabsxz = MYMAX(abs(x0), abs(z0));
 
 			s16 si2 = rs / 2 - MYMAX(0, maxabsxz - rs / 7 - 1);
@@ -575,6 +584,8 @@ void CavesRandomWalk::carveRoute(v3f vec, float f, bool randomize_xz)
 
 				if (!vm->m_area.contains(p))
 					continue;
+				if (carve_area && !carve_area->contains(p))
+					continue;
 
 				u32 i = vm->m_area.index(p);
 				content_t c = vm->m_data[i].getContent();
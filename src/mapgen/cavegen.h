@@ -13,6 +13,8 @@ class GenerateNotifier;
 
 class BiomeGen;
 
+class VoxelArea;
+
 /*
 	CavesNoiseIntersection is a cave digging algorithm that carves smooth,
 	web-like, continuous tunnels at points where the density of the intersection
@@ -140,6 +142,10 @@ class CavesRandomWalk
 
 	PseudoRandom *ps;
 
+	// If set, only nodes in this area are carved. The route does not depend
+	// on it, areas that split the voxel manipulator carve the same cave.
+	const VoxelArea *carve_area = nullptr;
+
 	content_t c_water_source;
 	content_t c_lava_source;
 	content_t c_ice;
@@ -23,9 +23,11 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "hgt.h"
 
+#include <chrono>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <ios>
 #include <filesystem>
@@ -54,6 +56,28 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 // Thread-local container cache definition
 thread_local hgts::ThreadLocalContainerCache hgts::tl_container_cache;
 
+namespace
+{
+// Decompressed tiles in <folder>/cache: this header, then the heights in
+// native byte order at cache_data_offset
+struct cache_header
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t side_length_x, side_length_y, side_length_x_extra;
+	uint8_t seconds_per_px_x, seconds_per_px_y;
+	uint16_t pixel_per_deg_x, pixel_per_deg_y;
+	int16_t lat, lon;
+	uint32_t count;
+};
+
+constexpr char cache_magic[4] = {'F', 'M', 'H', 'C'};
+// Reads back as another value on a machine with the other byte order
+constexpr uint16_t cache_version = 1;
+constexpr size_t cache_data_offset = 32;
+static_assert(sizeof(cache_header) <= cache_data_offset);
+}
+
 hgts::hgts(const std::string &folder) : folder{folder}
 {
 	std::error_code ec;
@@ -119,6 +143,7 @@ height::height_t hgts::get(const height_hgt::ll_t lat, const height_hgt::ll_t lo
 		auto it = layer.cache.find(tile_key);
 		if (auto cached_height = it != layer.cache.end() ? it->second.lock() : std::shared_ptr<height>{};
 		    cached_height && cached_height->ok(lat, lon)) {
+			touch(*cached_height);
 			const auto result = cached_height->get(lat, lon);
 			const auto processed_result = layer.post_process(result);
 			
@@ -162,7 +187,10 @@ height::height_t hgts::get(const height_hgt::ll_t lat, const height_hgt::ll_t lo
 					// Successfully loaded, now acquire lock to store it
 					{
 						const auto lock = std::unique_lock(mutex);
+						++clock;
+						touch(*hgt);
 						layer.container[lat_dec][lon_dec] = std::move(hgt);
+						evict(layer.container);
 					} // Lock released
 					
 					// Now get the result with a brief lock
@@ -208,6 +236,102 @@ height::height_t hgts::get(const height_hgt::ll_t lat, const height_hgt::ll_t lo
 	return 0;
 }
 
+void hgts::touch(height &tile)
+{
+	// Written only when it changes, most lookups hit the same tiles
+	const auto now = clock.load(std::memory_order_relaxed);
+	if (tile.used.load(std::memory_order_relaxed) != now)
+		tile.used.store(now, std::memory_order_relaxed);
+}
+
+// Needs the mutex. Readers keep their tiles alive through shared_ptr, the
+// thread-local caches only hold weak_ptr and load the tile again.
+void hgts::evict(std::map<int, std::map<int, std::shared_ptr<height>>> &container)
+{
+	size_t loaded = 0;
+	std::map<int, std::shared_ptr<height>> *oldest_lons = nullptr;
+	int oldest_lon = 0;
+	uint32_t oldest_used = 0;
+	for (auto &[lat, lons] : container) {
+		for (const auto &[lon, tile] : lons) {
+			// Dummies mark missing files, dropping them would download again
+			if (!tile || dynamic_cast<height_dummy *>(tile.get()))
+				continue;
+			++loaded;
+			const auto used = tile->used.load(std::memory_order_relaxed);
+			if (!oldest_lons || used < oldest_used) {
+				oldest_lons = &lons;
+				oldest_lon = lon;
+				oldest_used = used;
+			}
+		}
+	}
+	if (loaded > max_tiles && oldest_lons)
+		oldest_lons->erase(oldest_lon);
+}
+
+std::shared_ptr<height> hgts::find(
+		std::map<int, std::map<int, std::shared_ptr<height>>> &container, int lat,
+		int lon)
+{
+	const auto lock = std::unique_lock(mutex);
+	if (const auto it = container.find(lat); it != container.end())
+		if (const auto inner_it = it->second.find(lon); inner_it != it->second.end())
+			return inner_it->second;
+	return {};
+}
+
+void hgts::get_grid(double lat0, double lon0, double lat_step, double lon_step,
+		size_t n, size_t m, height::height_t *out)
+{
+	auto layers = get_layers(lat0, lon0);
+
+	// Tile of the previous point in every layer
+	struct last_tile
+	{
+		int lat = -300, lon = -300;
+		std::shared_ptr<height> tile;
+	};
+	std::vector<last_tile> last(layers.size());
+
+	for (size_t j = 0; j < m; ++j) {
+		const height::ll_t lat = lat0 + j * lat_step;
+		const int lat1 = height::lat_start(lat);
+		for (size_t i = 0; i < n; ++i) {
+			const height::ll_t lon = lon0 + i * lon_step;
+			const int lon1 = height::lon_start(lon);
+			auto &result = out[j * n + i];
+			result = 0;
+
+			// Same layer order and ranges as get()
+			bool missing = false;
+			for (size_t l = 0; l < layers.size(); ++l) {
+				const auto &layer = layers[l];
+				auto &t = last[l];
+				if (t.lat != lat1 || t.lon != lon1) {
+					t = {lat1, lon1, find(layer.container, lat1, lon1)};
+					if (t.tile)
+						touch(*t.tile);
+				}
+				if (!t.tile) {
+					// get() loads it, look it up again for the next point
+					t.lat = -300;
+					missing = true;
+					break;
+				}
+				const auto processed_result = layer.post_process(t.tile->get(lat, lon));
+				if (processed_result > layer.min_height &&
+						processed_result < layer.max_height) {
+					result = processed_result;
+					break;
+				}
+			}
+			if (missing)
+				result = get(lat, lon);
+		}
+	}
+}
+
 std::mutex height::mutex;
 
 height_hgt::height_hgt(const std::string &folder, ll_t lat, ll_t lon) : folder{folder}
@@ -249,6 +373,87 @@ bool height::ok(ll_t lat, ll_t lon)
 	return ok;
 }
 
+bool height::cache_open(const std::string &path, int lat_dec, int lon_dec)
+{
+	if (!cache.open(path))
+		return false;
+
+	cache_header header{};
+	if (cache.size() >= cache_data_offset)
+		memcpy(&header, cache.data(), sizeof(header));
+	if (cache.size() < cache_data_offset ||
+			memcmp(header.magic, cache_magic, sizeof(cache_magic)) ||
+			header.version != cache_version || header.lat != lat_dec ||
+			header.lon != lon_dec ||
+			cache.size() != cache_data_offset + header.count * sizeof(int16_t)) {
+		cache.close();
+		return false;
+	}
+
+	side_length_x = header.side_length_x;
+	side_length_y = header.side_length_y;
+	side_length_x_extra = header.side_length_x_extra;
+	seconds_per_px_x = header.seconds_per_px_x;
+	seconds_per_px_y = header.seconds_per_px_y;
+	pixel_per_deg_x = header.pixel_per_deg_x;
+	pixel_per_deg_y = header.pixel_per_deg_y;
+	data = reinterpret_cast<const int16_t *>(cache.data() + cache_data_offset);
+	heights = {};
+	lat_loaded = lat_dec;
+	lon_loaded = lon_dec;
+	return true;
+}
+
+bool height::cache_save(const std::string &path)
+{
+	cache_header header{};
+	memcpy(header.magic, cache_magic, sizeof(cache_magic));
+	header.version = cache_version;
+	header.side_length_x = side_length_x;
+	header.side_length_y = side_length_y;
+	header.side_length_x_extra = side_length_x_extra;
+	header.seconds_per_px_x = seconds_per_px_x;
+	header.seconds_per_px_y = seconds_per_px_y;
+	header.pixel_per_deg_x = pixel_per_deg_x;
+	header.pixel_per_deg_y = pixel_per_deg_y;
+	header.lat = lat_loaded;
+	header.lon = lon_loaded;
+	header.count = heights.size();
+
+	std::string head(cache_data_offset, '\0');
+	memcpy(head.data(), &header, sizeof(header));
+
+	// Renamed when complete, other workers map a whole file or none
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+	const auto tmp = path + "." +
+					 std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()) ^
+									std::chrono::steady_clock::now().time_since_epoch().count()) +
+					 ".tmp";
+	{
+		std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+		os.write(head.data(), head.size());
+		os.write(reinterpret_cast<const char *>(heights.data()),
+				heights.size() * sizeof(int16_t));
+		if (!os.good()) {
+			os.close();
+			std::filesystem::remove(tmp, ec);
+			return false;
+		}
+	}
+	std::filesystem::rename(tmp, path, ec);
+	if (ec) {
+		std::filesystem::remove(tmp, ec);
+		return false;
+	}
+
+	// Pages of the mapping are shared, the private copy is not needed anymore
+	const int lat_dec = lat_loaded, lon_dec = lon_loaded;
+	if (!cache_open(path, lat_dec, lon_dec))
+		data = heights.data();
+	return true;
+}
+
 int height::lat_start(ll_t lat_dec)
 {
 	return floor(lat_dec);
@@ -336,6 +541,11 @@ bool height_hgt::load(ll_t lat, ll_t lon)
 	std::string filefull = folder + "/" + filename;
 	// DUMP(lat_dec, lon_dec, filename, zipname, zipfull);
 
+	const auto cache_path = folder + "/cache/" + filename + ".tile";
+	if (cache_open(cache_path, lat_dec, lon_dec)) {
+		return true;
+	}
+
 	std::string srtmTile;
 	size_t filesize = 0;
 
@@ -488,8 +698,10 @@ bool height_hgt::load(ll_t lat, ll_t lon)
 		}
 		heights[i] = height;
 	}
+	data = heights.data();
 	lat_loaded = lat_dec;
 	lon_loaded = lon_dec;
+	cache_save(cache_path);
 	//DUMP("loadok", (long long)this, heights.size(), lat_loaded, lon_loaded, filesize, zipname, filename, seconds_per_px_x, get(lat_dec, lon_dec), heights[0], heights.back(), heights[side_length_x]);
 	return true;
 }
@@ -617,6 +829,7 @@ bool height_tif::load(ll_t lat, ll_t lon)
 
 					pixel_per_deg_x = (ll_t)side_length_x / tile_deg_x;
 					pixel_per_deg_y = (ll_t)side_length_y / tile_deg_y;
+					data = heights.data();
 
 					//DUMP("loadok", (long long)this, heights.size(), lat_loaded, lon_loaded, zipname, tifname, seconds_per_px_x, get(lat_dec, lon_dec));
 					//DUMP("ppd", pixel_per_deg_x, pixel_per_deg_y);
@@ -948,7 +1161,7 @@ int16_t height_hgt::read(uint16_t y, uint16_t x)
 	const int row = (side_length_x - 1) - y;
 	const int col = x;
 	const int pos = (row * side_length_y + col);
-	return heights[pos];
+	return data[pos];
 }
 
 height::height_t height::get(ll_t lat, ll_t lon)
@@ -1049,7 +1262,7 @@ int16_t height_seabed_tif::read(uint16_t y, uint16_t x)
 {
 	const int row = (side_length_y)-y;
 	const int pos = x + row * (side_length_x + 1);
-	const auto ret = heights[pos];
+	const auto ret = data[pos];
 	return ret;
 }
 
@@ -1077,6 +1290,10 @@ bool height_seabed_tif::load(height::ll_t lat, height::ll_t lon)
 	std::string lat_dir = lat_dir_buff;
 	std::string fullpath = folder + "/" + lat_dir + "/" + filename;
 
+	const auto cache_path = folder + "/cache/" + filename + ".tile";
+	if (cache_open(cache_path, lat_dec, lon_dec))
+		return true;
+
 	if (!std::filesystem::exists(fullpath)) {
 		std::error_code ec;
 		std::filesystem::create_directories(folder + "/" + lat_dir, ec);
@@ -1138,6 +1355,8 @@ bool height_seabed_tif::load(height::ll_t lat, height::ll_t lon)
 		seconds_per_px_y = tile_deg_y * 3600 / ((float)side_length_y);
 		pixel_per_deg_x = (height::ll_t)side_length_x / tile_deg_x;
 		pixel_per_deg_y = (height::ll_t)side_length_y / tile_deg_y;
+		data = heights.data();
+		cache_save(cache_path);
 
 #if HGT_DEBUG
 		DUMP("tif ok", seconds_per_px_x, side_length_x, side_length_y, seconds_per_px_x,
@@ -21,6 +21,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <atomic>
 #include <cmath>
 #include <cstdint>
 #include <functional>
@@ -32,6 +33,8 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include <unordered_map>
 #include <thread>
 
+#include "util/mapped_file.h"
+
 class height
 {
 public:
@@ -47,8 +50,15 @@ class height
 	uint16_t pixel_per_deg_x, pixel_per_deg_y;
 
 	std::vector<int16_t> heights;
+	// Loaded tile: heights or the mapped cache file
+	const int16_t *data = nullptr;
+	mapped_file cache;
 	static std::mutex mutex;
 
+	// Decompressed tile in the shared cache folder, mapped by every worker
+	bool cache_open(const std::string &path, int lat_dec, int lon_dec);
+	bool cache_save(const std::string &path);
+
 	virtual int16_t read(uint16_t y, uint16_t x) { return -30000; };
 	virtual std::string file_name(ll_t lat, ll_t lon) { return {}; };
 
@@ -59,6 +69,8 @@ class height
 	virtual bool load(ll_t lat, ll_t lon) { return true; };
 	virtual bool ok(ll_t lat, ll_t lon);
 	height_t get(ll_t lat, ll_t lon);
+	// hgts eviction stamp
+	std::atomic_uint32_t used{0};
 	static int lat_start(ll_t lat);
 	static int lon_start(ll_t lon);
 };
@@ -181,7 +193,23 @@ class hgts
 	// Get layer definitions
 	std::vector<Layer> get_layers(const height::ll_t lat, const height::ll_t lon);
 
+	// Bumped on every tile load, tiles remember the value of their last use
+	std::atomic_uint32_t clock{0};
+	void touch(height &tile);
+	void evict(std::map<int, std::map<int, std::shared_ptr<height>>> &container);
+	std::shared_ptr<height> find(
+			std::map<int, std::map<int, std::shared_ptr<height>>> &container, int lat,
+			int lon);
+
 public:
 	hgts(const std::string &folder);
 	height::height_t get(const height::ll_t lat, const height::ll_t lon);
+
+	// out[j * n + i] = get(lat0 + j * lat_step, lon0 + i * lon_step), the tiles
+	// are looked up once per run of points instead of once per point
+	void get_grid(double lat0, double lon0, double lat_step, double lon_step,
+			size_t n, size_t m, height::height_t *out);
+
+	// Loaded tiles per layer, the least recently used ones are dropped above it
+	size_t max_tiles = 64;
 };
@@ -41,7 +41,11 @@
 #include "mapgen_earth.h"
 #include "mapgen_voxel_earth.h"
 #include "mapgen_erosion.h"
+#include "mg_decoration.h"
+#include "mg_ore.h"
+#include "server.h"
 #include "serverenvironment.h"
+#include "threading/job_scheduler.h"
 
 
 const FlagDesc flagdesc_mapgen[] = {
@@ -688,15 +692,164 @@ MapgenBasic::MapgenBasic(int mapgenid, MapgenParams *params, EmergeParams *emerg
 		errorstream << "Mapgen: Mapgen alias 'mapgen_water_source' is invalid!" << std::endl;
 	if (c_river_water_source == CONTENT_IGNORE)
 		warningstream << "Mapgen: Mapgen alias 'mapgen_river_water_source' is invalid!" << std::endl;
+
+	if (g_settings->getBool("mapgen_parallel"))
+		part_size = g_settings->getS16("mapgen_part_size");
 }
 
 
+struct MapgenBasic::PartManagers
+{
+	std::unique_ptr<OreManager> oremgr;
+	std::unique_ptr<DecorationManager> decomgr;
+};
+
+
 MapgenBasic::~MapgenBasic()
 {
 	delete []heightmap;
 }
 
 
+std::vector<VoxelArea> MapgenBasic::getParts() const
+{
+	std::vector<VoxelArea> parts;
+	if (part_size <= 0 || csize.X % part_size || csize.Z % part_size ||
+			(part_size == csize.X && part_size == csize.Z) ||
+			!m_emerge->server || !m_emerge->server->m_jobs)
+		return parts;
+
+	// Ore clusters have to fit in a part
+	for (size_t i = 0; i < m_emerge->oremgr->getNumObjects(); i++)
+		if (auto ore = (Ore *)m_emerge->oremgr->getRaw(i); ore && ore->clust_size > part_size)
+			return parts;
+
+	for (pos_t z = node_min.Z; z <= node_max.Z; z += part_size)
+	for (pos_t x = node_min.X; x <= node_max.X; x += part_size)
+		parts.emplace_back(v3pos_t(x, node_min.Y, z),
+				v3pos_t(x + part_size - 1, node_max.Y, z + part_size - 1));
+	return parts;
+}
+
+
+void MapgenBasic::runParts(const std::vector<const VoxelArea *> &parts,
+	const std::function<void(PartManagers &, Mapgen &, const VoxelArea &,
+			u32 blockseed)> &place)
+{
+	// Tasks take every slots-th part, each with its own clones
+	auto &jobs = *m_emerge->server->m_jobs;
+	const size_t slots = std::min(parts.size(), jobs.getThreads());
+	while (part_managers.size() < slots) {
+		auto managers = std::make_unique<PartManagers>();
+		managers->oremgr.reset(m_emerge->oremgr->clone());
+		managers->decomgr.reset(m_emerge->decomgr->clone());
+		part_managers.emplace_back(std::move(managers));
+	}
+
+	std::vector<GenerateNotifier> notifiers(parts.size());
+	std::vector<job_scheduler::task_func> tasks;
+	for (size_t slot = 0; slot < slots; ++slot)
+		tasks.emplace_back([&, slot] {
+			std::vector<pos_t> part_heightmap;
+			std::vector<biome_t> part_biomemap;
+			for (size_t i = slot; i < parts.size(); i += slots) {
+				const VoxelArea &part = *parts[i];
+				const v3pos_t size = part.getExtent();
+
+				Mapgen view;
+				view.seed = seed;
+				view.water_level = water_level;
+				view.vm = vm;
+				view.ndef = ndef;
+				view.env = env;
+				view.csize = size;
+				view.gennotify = m_emerge->createNotifier();
+
+				// Maps of the chunk rows under the part
+				const size_t offset = (part.MinEdge.Z - node_min.Z) * csize.X +
+						(part.MinEdge.X - node_min.X);
+				if (heightmap) {
+					part_heightmap.resize(size.X * size.Z);
+					for (pos_t z = 0; z < size.Z; z++)
+						std::copy_n(heightmap + offset + z * csize.X, size.X,
+								part_heightmap.begin() + z * size.X);
+					view.heightmap = part_heightmap.data();
+				}
+				if (biomemap) {
+					part_biomemap.resize(size.X * size.Z);
+					for (pos_t z = 0; z < size.Z; z++)
+						std::copy_n(biomemap + offset + z * csize.X, size.X,
+								part_biomemap.begin() + z * size.X);
+					view.biomemap = part_biomemap.data();
+				}
+
+				place(*part_managers[slot], view, part,
+						getBlockSeed(part.MinEdge, blockseed));
+				notifiers[i] = std::move(view.gennotify);
+			}
+		});
+	jobs.run_tasks(tasks);
+
+	for (const auto &notifier : notifiers)
+		gennotify.addEvents(notifier);
+}
+
+
+void MapgenBasic::placeOres()
+{
+	const auto parts = getParts();
+	if (parts.empty()) {
+		m_emerge->oremgr->placeAllOres(this, blockseed, node_min, node_max);
+		return;
+	}
+
+	// Ores stay inside the area they are given, all parts run at once
+	std::vector<const VoxelArea *> all;
+	for (const auto &part : parts)
+		all.emplace_back(&part);
+	runParts(all, [&](PartManagers &managers, Mapgen &view, const VoxelArea &part,
+			u32 part_seed) {
+		const OreChunkPart ore_part{
+			u32(&part - parts.data()), u32(parts.size()), blockseed};
+		managers.oremgr->placeAllOres(&view, part_seed, part.MinEdge, part.MaxEdge,
+				&ore_part);
+	});
+}
+
+
+void MapgenBasic::placeDecorations()
+{
+	const auto parts = getParts();
+
+	pos_t reach = 0;
+	for (size_t i = 0; i < m_emerge->decomgr->getNumObjects(); i++)
+		if (auto deco = (Decoration *)m_emerge->decomgr->getRaw(i))
+			reach = std::max(reach, deco->getReach());
+
+	// Parts run in four rounds, in a round they are one part apart and
+	// decorations of two of them can't meet when reaching up to half of it
+	if (parts.empty() || reach > part_size / 2) {
+		m_emerge->decomgr->placeAllDecos(this, blockseed, node_min, node_max);
+		return;
+	}
+
+	for (int round = 0; round < 4; round++) {
+		std::vector<const VoxelArea *> round_parts;
+		for (const auto &part : parts) {
+			const int px = (part.MinEdge.X - node_min.X) / part_size;
+			const int pz = (part.MinEdge.Z - node_min.Z) / part_size;
+			if ((px % 2) + (pz % 2) * 2 == round)
+				round_parts.emplace_back(&part);
+		}
+		runParts(round_parts, [](PartManagers &managers, Mapgen &view,
+				const VoxelArea &part, u32 part_seed) {
+			managers.decomgr->placeAllDecos(&view, part_seed, part.MinEdge,
+					part.MaxEdge);
+		});
+	}
+}
+
+
 void MapgenBasic::generateBiomes()
 {
 	// can't generate biomes without a biome generator!
@@ -946,13 +1099,47 @@ void MapgenBasic::generateCavesRandomWalk(pos_t max_stone_y, pos_t large_cave_ym
 	if (node_min.Y > max_stone_y)
 		return;
 
+	const auto parts = getParts();
+	if (parts.empty()) {
+		carveCavesRandomWalk(max_stone_y, large_cave_ymax, nullptr, &gennotify);
+		return;
+	}
+
+	// Every task walks all caves and carves the nodes of its columns. The
+	// columns split the voxel manipulator, the outer ones reach its edges.
+	std::vector<VoxelArea> areas;
+	for (const auto &part : parts) {
+		if (part.MinEdge.Z != node_min.Z)
+			continue;
+		v3pos_t min = vm->m_area.MinEdge, max = vm->m_area.MaxEdge;
+		if (part.MinEdge.X != node_min.X)
+			min.X = part.MinEdge.X;
+		if (part.MaxEdge.X != node_max.X)
+			max.X = part.MaxEdge.X;
+		areas.emplace_back(min, max);
+	}
+
+	std::vector<job_scheduler::task_func> tasks;
+	for (size_t i = 0; i < areas.size(); i++)
+		tasks.emplace_back([&, i] {
+			carveCavesRandomWalk(max_stone_y, large_cave_ymax, &areas[i],
+					i ? nullptr : &gennotify);
+		});
+	m_emerge->server->m_jobs->run_tasks(tasks);
+}
+
+
+void MapgenBasic::carveCavesRandomWalk(pos_t max_stone_y, pos_t large_cave_ymax,
+	const VoxelArea *carve_area, GenerateNotifier *notify)
+{
 	PseudoRandom ps(blockseed + 21343);
 	// Small randomwalk caves
 	u32 num_small_caves = ps.range(small_cave_num_min, small_cave_num_max);
 
 	for (u32 i = 0; i < num_small_caves; i++) {
-		CavesRandomWalk cave(ndef, &gennotify, seed, water_level,
+		CavesRandomWalk cave(ndef, notify, seed, water_level,
 			c_water_source, c_lava_source, large_cave_flooded, biomegen);
+		cave.carve_area = carve_area;
 		cave.makeCave(vm, node_min, node_max, &ps, false, max_stone_y, heightmap);
 	}
 
@@ -965,8 +1152,9 @@ void MapgenBasic::generateCavesRandomWalk(pos_t max_stone_y, pos_t large_cave_ym
 	u32 num_large_caves = ps.range(large_cave_num_min, large_cave_num_max);
 
 	for (u32 i = 0; i < num_large_caves; i++) {
-		CavesRandomWalk cave(ndef, &gennotify, seed, water_level,
+		CavesRandomWalk cave(ndef, notify, seed, water_level,
 			c_water_source, c_lava_source, large_cave_flooded, biomegen);
+		cave.carve_area = carve_area;
 		cave.makeCave(vm, node_min, node_max, &ps, true, max_stone_y, heightmap);
 	}
 }
@@ -1129,6 +1317,13 @@ void GenerateNotifier::getEvents(
 }
 
 
+void GenerateNotifier::addEvents(const GenerateNotifier &other)
+{
+	m_notify_events.insert(m_notify_events.end(), other.m_notify_events.begin(),
+		other.m_notify_events.end());
+}
+
+
 void GenerateNotifier::clearEvents()
 {
 	m_notify_events.clear();
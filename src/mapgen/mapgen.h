@@ -15,8 +15,12 @@
 #include "nodedef.h"
 #include "util/string.h"
 #include "util/container.h"
+#include <algorithm>
+#include <functional>
+#include <memory>
 #include <utility>
 #include <set>
+#include <vector>
 
 #define MAPGEN_DEFAULT MAPGEN_V7
 #define MAPGEN_DEFAULT_NAME "v7"
@@ -87,6 +91,8 @@ class GenerateNotifier {
 	bool addDecorationEvent(v3pos_t pos, u32 deco_id);
 	bool setCustom(const std::string &key, const std::string &value);
 	void getEvents(std::map<std::string, std::vector<v3pos_t>> &map) const;
+	// Appends the events of a notifier of a part of the chunk
+	void addEvents(const GenerateNotifier &other);
 	const StringMap &getCustomData() const { return m_notify_custom; }
 	void clearEvents();
 
@@ -302,6 +308,134 @@ class Mapgen {
 	inline bool isLiquidHorizontallyFlowable(u32 vi, v3s32 em);
 };
 
+/*
+	freeminer: coarse to fine sampling for mapgens with an expensive density
+	function. The box is cut into cells of step nodes and only the cell
+	corners are evaluated. A cell whose corners are all on the same side
+	takes the value of its first corner everywhere; other cells are split
+	along their longest axis down to single nodes. Whole uniform cells end
+	up as uniform blocks, which MapBlock then stores as mono blocks.
+	Features thinner than step that fit between the corners are missed,
+	so mapgens only use it when their settings ask for it.
+*/
+template <typename T = float>
+class AdaptiveSampler
+{
+public:
+	// value(p) is the expensive function, solid(value) tells the sides apart
+	template <typename Value, typename Solid>
+	void sample(const v3pos_t &min, const v3pos_t &max, pos_t step, Value &&value,
+			Solid &&solid);
+
+	T get(const v3pos_t &p) const { return m_values[index(p)]; }
+
+	// Calls of value() during the last sample()
+	u32 evaluated = 0;
+
+private:
+	enum : u8 { UNKNOWN, GUESSED, EVALUATED };
+
+	u32 index(const v3pos_t &p) const
+	{
+		return ((p.Z - m_min.Z) * m_size.Y + (p.Y - m_min.Y)) * m_size.X +
+			   (p.X - m_min.X);
+	}
+
+	template <typename Value, typename Solid>
+	void refine(const v3pos_t &a, const v3pos_t &b, Value &value, Solid &solid);
+
+	v3pos_t m_min, m_size;
+	std::vector<T> m_values;
+	std::vector<u8> m_state;
+};
+
+template <typename T>
+template <typename Value, typename Solid>
+void AdaptiveSampler<T>::sample(const v3pos_t &min, const v3pos_t &max, pos_t step,
+		Value &&value, Solid &&solid)
+{
+	m_min = min;
+	m_size = max - min + v3pos_t(1, 1, 1);
+	const size_t volume = (size_t)m_size.X * m_size.Y * m_size.Z;
+	m_values.resize(volume);
+	m_state.assign(volume, UNKNOWN);
+	evaluated = 0;
+	step = std::max<pos_t>(step, 1);
+
+	for (pos_t z = min.Z;; z += step) {
+		const pos_t z2 = std::min<pos_t>(z + step, max.Z);
+		for (pos_t y = min.Y;; y += step) {
+			const pos_t y2 = std::min<pos_t>(y + step, max.Y);
+			for (pos_t x = min.X;; x += step) {
+				const pos_t x2 = std::min<pos_t>(x + step, max.X);
+				refine(v3pos_t(x, y, z), v3pos_t(x2, y2, z2), value, solid);
+				if (x2 >= max.X)
+					break;
+			}
+			if (y2 >= max.Y)
+				break;
+		}
+		if (z2 >= max.Z)
+			break;
+	}
+}
+
+template <typename T>
+template <typename Value, typename Solid>
+void AdaptiveSampler<T>::refine(
+		const v3pos_t &a, const v3pos_t &b, Value &value, Solid &solid)
+{
+	// Corners, every node is evaluated once even when cells share it
+	T first{};
+	bool first_solid = false, uniform = true;
+	for (int i = 0; i < 8; ++i) {
+		const v3pos_t p(i & 1 ? b.X : a.X, i & 2 ? b.Y : a.Y, i & 4 ? b.Z : a.Z);
+		const u32 n = index(p);
+		if (m_state[n] != EVALUATED) {
+			m_values[n] = value(p);
+			m_state[n] = EVALUATED;
+			++evaluated;
+		}
+		const bool s = solid(m_values[n]);
+		if (i == 0) {
+			first = m_values[n];
+			first_solid = s;
+		} else if (s != first_solid) {
+			uniform = false;
+		}
+	}
+
+	const v3pos_t size = b - a;
+	if (uniform) {
+		// Nodes evaluated by a neighbour cell keep their own value
+		for (pos_t z = a.Z; z <= b.Z; ++z)
+			for (pos_t y = a.Y; y <= b.Y; ++y) {
+				u32 n = index(v3pos_t(a.X, y, z));
+				for (pos_t x = a.X; x <= b.X; ++x, ++n) {
+					if (m_state[n] != EVALUATED) {
+						m_values[n] = first;
+						m_state[n] = GUESSED;
+					}
+				}
+			}
+		return;
+	}
+
+	// Every node is a corner already
+	if (size.X <= 1 && size.Y <= 1 && size.Z <= 1)
+		return;
+
+	v3pos_t a2 = a, b1 = b;
+	if (size.X >= size.Y && size.X >= size.Z)
+		a2.X = b1.X = a.X + size.X / 2;
+	else if (size.Y >= size.Z)
+		a2.Y = b1.Y = a.Y + size.Y / 2;
+	else
+		a2.Z = b1.Z = a.Z + size.Z / 2;
+	refine(a, b1, value, solid);
+	refine(a2, b, value, solid);
+}
+
 /*
 	MapgenBasic is a Mapgen implementation that handles basic functionality
 	the majority of conventional mapgens will probably want to use, but isn't
@@ -330,9 +464,35 @@ class MapgenBasic : public Mapgen {
 
 	virtual void generateBuildings() {};
 
+	// Ores and decorations, by parts of the chunk with mapgen_parallel
+	void placeOres();
+	void placeDecorations();
+
 protected:
 	BiomeManager *m_bmgr = nullptr;
 
+	/*
+		With mapgen_parallel ores, decorations and random walk caves are
+		split into parts of mapgen_part_size nodes along X and Z, which run
+		on the server job workers. Ores and decorations of a part are seeded
+		from its position, the result depends on the seed and the part size
+		only. Ore cluster counts are the ones of the whole chunk.
+		Random walk caves are the same as without parts.
+	*/
+	pos_t part_size = 0;
+	// Ore and decoration clones of a task, the objects keep noise buffers
+	struct PartManagers;
+	std::vector<std::unique_ptr<PartManagers>> part_managers;
+
+	// Parts of the chunk, none if it is not split
+	std::vector<VoxelArea> getParts() const;
+	// Calls place with a Mapgen of the part (maps, notifier) for every part
+	void runParts(const std::vector<const VoxelArea *> &parts,
+			const std::function<void(PartManagers &, Mapgen &, const VoxelArea &,
+					u32 blockseed)> &place);
+	void carveCavesRandomWalk(pos_t max_stone_y, pos_t large_cave_ymax,
+			const VoxelArea *carve_area, GenerateNotifier *notify);
+
 	Noise *noise_filler_depth = nullptr;
 
 public:
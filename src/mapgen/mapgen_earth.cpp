@@ -172,6 +172,8 @@ MapgenEarth::MapgenEarth(MapgenEarthParams *params_, EmergeParams *emerge) :
 		scale = {params["scale"]["x"].asDouble(), params["scale"]["y"].asDouble(),
 				params["scale"]["z"].asDouble()};
 
+	adaptive_step = params.get("adaptive_step", 0).asInt();
+
 	/* todomake test
 	static bool shown = 0;
 	if (!shown) {
@@ -219,6 +221,8 @@ MapgenEarth::MapgenEarth(MapgenEarthParams *params_, EmergeParams *emerge) :
 	if (!maps_holder) {
 		maps_holder = std::make_unique<maps_holder_t>();
 	}
+	if (params.isMember("hgt_max_tiles"))
+		maps_holder->hgt_reader.max_tiles = params["hgt_max_tiles"].asUInt();
 
 	{
 		const auto heat_img = maps_holder->data_root + "/earth_heat.png";
@@ -311,6 +315,37 @@ pos_t MapgenEarth::get_height(pos_t x, pos_t z)
 	return ceil(y / scale.Y) - center.Y;
 }
 
+void MapgenEarth::get_heights(const v2pos_t min, const v2pos_t max, std::vector<pos_t> &out)
+{
+	const size_t n = max.X - min.X + 1;
+	const size_t m = max.Y - min.Y + 1;
+	out.resize(n * m);
+
+	// pos_to_ll() for min and one column steps
+	const ll_t lon_step = scale.X / (EQUATOR_LEN / 360.0);
+	const ll_t lat_step = scale.Z / (EQUATOR_LEN / 360.0);
+	const auto lon0 = ((ll_t)min.X * scale.X) / (EQUATOR_LEN / 360.0) + center.X;
+	const auto lat0 = ((ll_t)min.Y * scale.Z) / (EQUATOR_LEN / 360.0) + center.Z;
+	const auto lon1 = lon0 + (n - 1) * lon_step;
+	const auto lat1 = lat0 + (m - 1) * lat_step;
+
+	// Outside of the globe pos_to_ll() clamps, leave that to get_height()
+	if (std::min(lat0, lat1) <= -90 || std::max(lat0, lat1) >= 90 ||
+			std::min(lon0, lon1) <= -180 || std::max(lon0, lon1) >= 180) {
+		size_t i = 0;
+		for (pos_t z = min.Y; z <= max.Y; ++z)
+			for (pos_t x = min.X; x <= max.X; ++x)
+				out[i++] = get_height(x, z);
+		return;
+	}
+
+	std::vector<height::height_t> grid(n * m);
+	maps_holder->hgt_reader.get_grid(
+			lat0, lon0, lat_step, lon_step, n, m, grid.data());
+	for (size_t i = 0; i < grid.size(); ++i)
+		out[i] = ceil(grid[i] / scale.Y) - center.Y;
+}
+
 pos_t MapgenEarth::getSpawnLevelAtPoint(v2pos_t p)
 {
 	return std::max(2, get_height(p.X, p.Y) + 2);
@@ -327,6 +362,30 @@ int MapgenEarth::generateTerrain()
 	u32 index = 0;
 	const auto em = vm->m_area.getExtent();
 
+	// Columns whose whole height is in uniform cells never look up the height
+	const bool adaptive = adaptive_step > 1;
+	if (adaptive) {
+		const pos_t size_x = node_max.X - node_min.X + 1;
+		std::vector<pos_t> heights((size_t)size_x * (node_max.Z - node_min.Z + 1));
+		std::vector<bool> have_height(heights.size());
+		sampler.sample(node_min, node_max, adaptive_step,
+				[&](const v3pos_t &p) {
+					const size_t n = (p.Z - node_min.Z) * size_x + (p.X - node_min.X);
+					if (!have_height[n]) {
+						heights[n] = get_height(p.X, p.Z);
+						have_height[n] = true;
+					}
+					return (float)(heights[n] - p.Y);
+				},
+				[](float v) { return v >= 0; });
+	}
+
+	// Whole chunk at once, the height tiles are looked up once per run
+	std::vector<pos_t> column_heights;
+	if (!adaptive)
+		get_heights(v2pos_t(node_min.X, node_min.Z), v2pos_t(node_max.X, node_max.Z),
+				column_heights);
+
 	for (pos_t z = node_min.Z; z <= node_max.Z; z++) {
 		for (pos_t x = node_min.X; x <= node_max.X; x++, index++) {
 			const auto heat =
@@ -334,10 +393,11 @@ int MapgenEarth::generateTerrain()
 							? m_emerge->env->getServerMap().updateBlockHeat(m_emerge->env,
 									  v3pos_t(x, node_max.Y, z), nullptr, &heat_cache)
 							: 0;
-			const auto height = get_height(x, z);
+			const auto height = adaptive ? 0 : column_heights[index];
 			u32 i = vm->m_area.index(x, node_min.Y, z);
 			for (pos_t y = node_min.Y; y <= node_max.Y; y++) {
-				bool underground = height >= y;
+				bool underground = adaptive ? sampler.get(v3pos_t(x, y, z)) >= 0
+											: height >= y;
 				if (underground) {
 					if (!vm->m_data[i]) {
 						vm->m_data[i] = layers_get(0, 1);
@@ -668,7 +728,7 @@ void MapgenEarth::makeChunk(BlockMakeData *data)
 
 	// Generate the registered ores
 	if (flags & MG_ORES)
-		m_emerge->oremgr->placeAllOres(this, blockseed, node_min, node_max);
+		placeOres();
 
 	// Generate dungeons
 	if (flags & MG_DUNGEONS)
@@ -676,7 +736,7 @@ void MapgenEarth::makeChunk(BlockMakeData *data)
 
 	// Generate the registered decorations
 	if (flags & MG_DECORATIONS)
-		m_emerge->decomgr->placeAllDecos(this, blockseed, node_min, node_max);
+		placeDecorations();
 
 	// Sprinkle some dust on top after everything else was generated
 	if (flags & MG_BIOMES)
@@ -25,6 +25,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include "earth/hgt.h"
 #include "mapgen/mapgen_v7.h"
@@ -107,6 +108,9 @@ class MapgenEarth : public MapgenV7
 	v3d scale{1, 1, 1};
 	v3d center{0, 0, 0};
 	bool no_layers = false;
+	// Coarse lattice step for AdaptiveSampler, 0 looks up every column
+	pos_t adaptive_step = 0;
+	AdaptiveSampler<float> sampler;
 
 	MapNode n_air, n_water, n_stone;
 
@@ -115,6 +119,8 @@ class MapgenEarth : public MapgenV7
 	const MapNode &visible_content(const v3pos_t &p, bool use_weather) override;
 
 	pos_t get_height(pos_t x, pos_t z);
+	// Heights of the columns from min to max, rows along Z
+	void get_heights(v2pos_t min, v2pos_t max, std::vector<pos_t> &out);
 	ll pos_to_ll(pos_t x, pos_t z);
 	ll pos_to_ll(const v3pos_t &p);
 	v2pos_t ll_to_pos(const ll &l);
@@ -243,14 +243,14 @@ void MapgenFlat::makeChunk(BlockMakeData *data)
 
 	// Generate the registered ores
 	if (flags & MG_ORES)
-		m_emerge->oremgr->placeAllOres(this, blockseed, node_min, node_max);
+		placeOres();
 
 	if (flags & MG_DUNGEONS)
 		generateDungeons(stone_surface_max_y);
 
 	// Generate the registered decorations
 	if (flags & MG_DECORATIONS)
-		m_emerge->decomgr->placeAllDecos(this, blockseed, node_min, node_max);
+		placeDecorations();
 
 	// Sprinkle some dust on top after everything else was generated
 	if (flags & MG_BIOMES)
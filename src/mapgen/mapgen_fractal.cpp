@@ -239,7 +239,7 @@ void MapgenFractal::makeChunk(BlockMakeData *data)
 
 	// Generate the registered ores
 	if (flags & MG_ORES)
-		m_emerge->oremgr->placeAllOres(this, blockseed, node_min, node_max);
+		placeOres();
 
 	// Generate dungeons
 	if (flags & MG_DUNGEONS)
@@ -247,7 +247,7 @@ void MapgenFractal::makeChunk(BlockMakeData *data)
 
 	// Generate the registered decorations
 	if (flags & MG_DECORATIONS)
-		m_emerge->decomgr->placeAllDecos(this, blockseed, node_min, node_max);
+		placeDecorations();
 
 	// Sprinkle some dust on top after everything else was generated
 	if (flags & MG_BIOMES)
@@ -21,11 +21,14 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "servermap.h"
 
+#include <algorithm>
 #include <cmath>
 #include <functional>
 #include <cstdint>
+#include <vector>
 
 #include "mapgen_math.h"
+#include "mapgen_math_fractal.h"
 #include "voxel.h"
 #include "mapblock.h"
 #include "mapnode.h"
@@ -86,104 +89,6 @@ z: [-2.0 , 2.0]
 
 */
 
-inline double mandelbox(double x, double y, double z, double d, int nn = 10, int seed = 1)
-{
-	int s = 7;
-	x *= s;
-	y *= s;
-	z *= s;
-	d *= s;
-
-	double posX = x;
-	double posY = y;
-	double posZ = z;
-
-	double dr = 1.0;
-	double r = 0.0;
-
-	double scale = 2;
-
-	double minRadius2 = 0.25;
-	double fixedRadius2 = 1;
-
-	for (int n = 0; n < nn; n++) {
-		// Reflect
-		if (x > 1.0)
-			x = 2.0 - x;
-		else if (x < -1.0)
-			x = -2.0 - x;
-		if (y > 1.0)
-			y = 2.0 - y;
-		else if (y < -1.0)
-			y = -2.0 - y;
-		if (z > 1.0)
-			z = 2.0 - z;
-		else if (z < -1.0)
-			z = -2.0 - z;
-
-		// Sphere Inversion
-		double r2 = x * x + y * y + z * z;
-
-		if (r2 < minRadius2) {
-			x = x * fixedRadius2 / minRadius2;
-			y = y * fixedRadius2 / minRadius2;
-			z = z * fixedRadius2 / minRadius2;
-			dr = dr * fixedRadius2 / minRadius2;
-		} else if (r2 < fixedRadius2) {
-			x = x * fixedRadius2 / r2;
-			y = y * fixedRadius2 / r2;
-			z = z * fixedRadius2 / r2;
-			fixedRadius2 *= fixedRadius2 / r2;
-		}
-
-		x = x * scale + posX;
-		y = y * scale + posY;
-		z = z * scale + posZ;
-		dr *= scale;
-	}
-	r = sqrt(x * x + y * y + z * z);
-	return ((r / fabs(dr)) < d);
-}
-
-inline double mengersponge(
-		double x, double y, double z, double d, int MI = 10, int seed = 1)
-{
-	double r = x * x + y * y + z * z;
-	double scale = 3;
-	int i = 0;
-
-	for (i = 0; i < MI && r < 9; i++) {
-		x = fabs(x);
-		y = fabs(y);
-		z = fabs(z);
-
-		if (x - y < 0) {
-			double x1 = y;
-			y = x;
-			x = x1;
-		}
-		if (x - z < 0) {
-			double x1 = z;
-			z = x;
-			x = x1;
-		}
-		if (y - z < 0) {
-			double y1 = z;
-			z = y;
-			y = y1;
-		}
-
-		x = scale * x - 1 * (scale - 1);
-		y = scale * y - 1 * (scale - 1);
-		z = scale * z;
-
-		if (z > 0.5 * 1 * (scale - 1))
-			z -= 1 * (scale - 1);
-		r = x * x + y * y + z * z;
-	}
-	return ((sqrt(r)) * pow(scale, (-i)) < d);
-}
-
 inline double sphere(double x, double y, double z, double d, int ITR = 1, int seed = 1)
 {
 	return v3f(x, y, z).getLength() < d;
@@ -337,6 +242,7 @@ MapgenMath::MapgenMath(MapgenMathParams *params_, EmergeParams *emerge) :
 	iterations = params.get("N", 15).asInt();	   //10;
 
 	result_max = params.get("result_max", 1.0).asDouble();
+	adaptive_step = params.get("adaptive_step", 0).asInt();
 
 	internal = 0;
 	func = &sphere;
@@ -344,7 +250,8 @@ MapgenMath::MapgenMath(MapgenMathParams *params_, EmergeParams *emerge) :
 	//if (params["generator"].empty()) params["generator"] = "mandelbox";
 	if (params["generator"].asString() == "mengersponge") {
 		internal = 1;
-		func = &mengersponge;
+		func = &mapgen_math::mengersponge;
+		func_batch = &mapgen_math::mengersponge_batch;
 		size = params.get("size", (MAX_MAP_GENERATION_LIMIT - 1000) / 2).asDouble();
 		//scale = params.get("scale", 1.0 / size).asDouble();
 		iterations = params.get("N", 13).asInt();
@@ -353,7 +260,8 @@ MapgenMath::MapgenMath(MapgenMathParams *params_, EmergeParams *emerge) :
 			center = v3f(-size / 3, -size / 3, -size / 3);
 	} else if (params["generator"].asString() == "mandelbox") {
 		internal = 1;
-		func = &mandelbox;
+		func = &mapgen_math::mandelbox;
+		func_batch = &mapgen_math::mandelbox_batch;
 		iterations = params.get("N", 15).asInt();
 		size = params.get("size", 1000).asDouble();
 		//scale = params.get("scale", 1.0 / size).asDouble();
@@ -636,13 +544,19 @@ MapNode MapgenMath::layers_get(float value, float max)
 	return layers_node[layer_index];
 }
 
-std::pair<bool, double> MapgenMath::calc_point(pos_t x, pos_t y, pos_t z)
+v3f MapgenMath::to_fractal(pos_t x, pos_t y, pos_t z) const
 {
 	v3f vec = (v3f(x, y, z) - center) * scale;
 	if (invert_xy)
 		std::swap(vec.X, vec.Y);
 	if (invert_yz)
 		std::swap(vec.Y, vec.Z);
+	return vec;
+}
+
+std::pair<bool, double> MapgenMath::calc_point(pos_t x, pos_t y, pos_t z)
+{
+	const v3f vec = to_fractal(x, y, z);
 	double d = 0;
 #if USE_MANDELBULBER
 	if (!internal)
@@ -655,6 +569,66 @@ std::pair<bool, double> MapgenMath::calc_point(pos_t x, pos_t y, pos_t z)
 	return {(!invert && d > 0) || (invert && d == 0), d};
 }
 
+void MapgenMath::calc_column(pos_t x, pos_t y, pos_t z, u32 count, double *out)
+{
+	if (!func_batch) {
+		for (u32 i = 0; i < count; ++i)
+			out[i] = calc_point(x, y + i, z).second;
+		return;
+	}
+
+	batch_x.resize(count);
+	batch_y.resize(count);
+	batch_z.resize(count);
+	for (u32 i = 0; i < count; ++i) {
+		const v3f vec = to_fractal(x, y + i, z);
+		batch_x[i] = vec.X;
+		batch_y[i] = vec.Y;
+		batch_z[i] = vec.Z;
+	}
+	func_batch(batch_x.data(), batch_y.data(), batch_z.data(), count, scale.X,
+			iterations, out);
+}
+
+bool MapgenMath::calc_uniform(const v3pos_t &min, const v3pos_t &max, double &d)
+{
+	if (!internal)
+		return false;
+
+	// to_fractal is monotonic on every axis, so the corners bound the box
+	v3f lo = to_fractal(min.X, min.Y, min.Z), hi = lo;
+	for (int i = 1; i < 8; ++i) {
+		const v3f c = to_fractal(i & 1 ? max.X : min.X, i & 2 ? max.Y : min.Y,
+				i & 4 ? max.Z : min.Z);
+		lo = v3f(std::min(lo.X, c.X), std::min(lo.Y, c.Y), std::min(lo.Z, c.Z));
+		hi = v3f(std::max(hi.X, c.X), std::max(hi.Y, c.Y), std::max(hi.Z, c.Z));
+	}
+	const auto near2 = [](double l, double h) {
+		return l > 0 ? l * l : (h < 0 ? h * h : 0.0);
+	};
+	const auto far2 = [](double l, double h) { return std::max(l * l, h * h); };
+	const double min_r2 = near2(lo.X, hi.X) + near2(lo.Y, hi.Y) + near2(lo.Z, hi.Z);
+	const double max_r2 = far2(lo.X, hi.X) + far2(lo.Y, hi.Y) + far2(lo.Z, hi.Z);
+
+	if (func == &mapgen_math::mengersponge) {
+		if (mapgen_math::mengersponge_empty(min_r2, scale.X)) {
+			d = 0;
+			return true;
+		}
+	} else if (func == &sphere) {
+		// sphere() uses a float length, keep away from the surface
+		if (std::sqrt(min_r2) > scale.X * (1 + 1e-5)) {
+			d = 0;
+			return true;
+		}
+		if (std::sqrt(max_r2) < scale.X * (1 - 1e-5)) {
+			d = 1;
+			return true;
+		}
+	}
+	return false;
+}
+
 bool MapgenMath::visible(const v3pos_t &p)
 {
 	const auto [have, d] = calc_point(p.X, p.Y, p.Z);
@@ -690,8 +664,32 @@ int MapgenMath::generateTerrain()
 	*/
 #endif
 
+	const pos_t y_start = node_min.Y - y_oversize_down;
+	const u32 y_count = node_max.Y + y_oversize_up - y_start + 1;
+	std::vector<double> column(y_count);
+	double uniform_d = 0;
+	const bool uniform = calc_uniform(v3pos_t(node_min.X, y_start, node_min.Z),
+			v3pos_t(node_max.X, node_max.Y + y_oversize_up, node_max.Z), uniform_d);
+	if (uniform)
+		std::fill(column.begin(), column.end(), uniform_d);
+
+	const bool adaptive = !uniform && adaptive_step > 1;
+	if (adaptive)
+		sampler.sample(v3pos_t(node_min.X, y_start, node_min.Z),
+				v3pos_t(node_max.X, node_max.Y + y_oversize_up, node_max.Z),
+				adaptive_step,
+				[this](const v3pos_t &p) { return calc_point(p.X, p.Y, p.Z).second; },
+				[this](double d) { return (!invert && d > 0) || (invert && d == 0); });
+
 	for (pos_t z = node_min.Z; z <= node_max.Z; z++) {
 		for (pos_t x = node_min.X; x <= node_max.X; x++) {
+			if (adaptive) {
+				for (u32 i = 0; i < y_count; ++i)
+					column[i] = sampler.get(v3pos_t(x, y_start + i, z));
+			} else if (!uniform) {
+				calc_column(x, y_start, z, y_count, column.data());
+			}
+
 			const auto heat =
 					m_emerge->env->m_use_weather
 							? m_emerge->env->getServerMap().updateBlockHeat(m_emerge->env,
@@ -705,7 +703,7 @@ int MapgenMath::generateTerrain()
 					//cache_index++
 			) {
 				//for (pos_t y = node_min.Y - y_oversize_down; y <= node_max.Y + y_oversize_up; y++, index3d += ystride) {
-				auto [have, d] = calc_point(x, y, z);
+				const double d = column[y - y_start];
 				if ((!invert && d > 0) || (invert && d == 0)) {
 					if (!vm->m_data[vi]) {
 						//vm->m_data[i] = (y > water_level + biome->filler) ?
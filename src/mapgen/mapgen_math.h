@@ -21,10 +21,13 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <vector>
+
 #include "config.h"
 #include "irr_v3d.h"
 #include "mapgen/mapgen.h"
 #include "mapgen/mapgen_v7.h"
+#include "mapgen/mapgen_math_fractal.h"
 #include "json/json.h"
 
 #if USE_MANDELBULBER
@@ -75,12 +78,25 @@ class MapgenMath : public MapgenV7
 	double distance;
 	double result_max;
 	bool no_layers = false;
+	// Coarse lattice step for AdaptiveSampler, 0 evaluates every node
+	pos_t adaptive_step = 0;
 
 	MapNode n_air, n_water, n_stone;
 
 	double (*func)(double, double, double, double, int, int);
+	// Same as func for many points at once, null if there is none
+	mapgen_math::batch_func func_batch = nullptr;
 	MapNode layers_get(float value, float max);
+	v3f to_fractal(pos_t x, pos_t y, pos_t z) const;
 	std::pair<bool, double> calc_point(pos_t x, pos_t y, pos_t z);
+	// Values of calc_point for count nodes going up from (x, y, z)
+	void calc_column(pos_t x, pos_t y, pos_t z, u32 count, double *out);
+	// True if calc_point is provably the same value d in the whole box
+	bool calc_uniform(const v3pos_t &min, const v3pos_t &max, double &d);
 	bool visible(const v3pos_t &p) override;
 	bool surface_2d() override { return false; };
+
+private:
+	std::vector<double> batch_x, batch_y, batch_z;
+	AdaptiveSampler<double> sampler;
 };
@@ -0,0 +1,358 @@
+/*
+mapgen_math_fractal.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mapgen_math_fractal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace mapgen_math
+{
+
+double mandelbox(double x, double y, double z, double d, int nn, int seed)
+{
+	int s = 7;
+	x *= s;
+	y *= s;
+	z *= s;
+	d *= s;
+
+	double posX = x;
+	double posY = y;
+	double posZ = z;
+
+	double dr = 1.0;
+	double r = 0.0;
+
+	double scale = 2;
+
+	double minRadius2 = 0.25;
+	double fixedRadius2 = 1;
+
+	for (int n = 0; n < nn; n++) {
+		// Reflect
+		if (x > 1.0)
+			x = 2.0 - x;
+		else if (x < -1.0)
+			x = -2.0 - x;
+		if (y > 1.0)
+			y = 2.0 - y;
+		else if (y < -1.0)
+			y = -2.0 - y;
+		if (z > 1.0)
+			z = 2.0 - z;
+		else if (z < -1.0)
+			z = -2.0 - z;
+
+		// Sphere Inversion
+		double r2 = x * x + y * y + z * z;
+
+		if (r2 < minRadius2) {
+			x = x * fixedRadius2 / minRadius2;
+			y = y * fixedRadius2 / minRadius2;
+			z = z * fixedRadius2 / minRadius2;
+			dr = dr * fixedRadius2 / minRadius2;
+		} else if (r2 < fixedRadius2) {
+			x = x * fixedRadius2 / r2;
+			y = y * fixedRadius2 / r2;
+			z = z * fixedRadius2 / r2;
+			fixedRadius2 *= fixedRadius2 / r2;
+		}
+
+		x = x * scale + posX;
+		y = y * scale + posY;
+		z = z * scale + posZ;
+		dr *= scale;
+	}
+	r = sqrt(x * x + y * y + z * z);
+	return ((r / fabs(dr)) < d);
+}
+
+double mengersponge(double x, double y, double z, double d, int MI, int seed)
+{
+	double r = x * x + y * y + z * z;
+	double scale = 3;
+	int i = 0;
+
+	for (i = 0; i < MI && r < 9; i++) {
+		x = fabs(x);
+		y = fabs(y);
+		z = fabs(z);
+
+		if (x - y < 0) {
+			double x1 = y;
+			y = x;
+			x = x1;
+		}
+		if (x - z < 0) {
+			double x1 = z;
+			z = x;
+			x = x1;
+		}
+		if (y - z < 0) {
+			double y1 = z;
+			z = y;
+			y = y1;
+		}
+
+		x = scale * x - 1 * (scale - 1);
+		y = scale * y - 1 * (scale - 1);
+		z = scale * z;
+
+		if (z > 0.5 * 1 * (scale - 1))
+			z -= 1 * (scale - 1);
+		r = x * x + y * y + z * z;
+	}
+	return ((sqrt(r)) * pow(scale, (-i)) < d);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+
+/*
+	Generic vectors, the width has to match the registers or the compiler
+	splits them up: 2 lanes for SSE2 and NEON, 4 for AVX2 (picked at runtime).
+	Helpers take vectors by reference: 4 lanes passed by value outside the
+	AVX2 functions would change the ABI (-Wpsabi).
+*/
+template <u32 LANES>
+struct lanes
+{
+	typedef double vdouble __attribute__((vector_size(LANES * sizeof(double))));
+	typedef s64 vmask __attribute__((vector_size(LANES * sizeof(s64))));
+};
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+// Copies a group of points into lanes, repeating the first one past count
+template <u32 LANES, class V>
+ALWAYS_INLINE void load_lanes(V &v, const double *in, u32 base, u32 count)
+{
+	for (u32 l = 0; l < LANES; l++)
+		v[l] = in[base + (base + l < count ? l : 0)];
+}
+
+template <class V, class M>
+ALWAYS_INLINE void vabs(V &v)
+{
+	v = (V)((M)v & INT64_MAX);
+}
+
+template <class V>
+ALWAYS_INLINE void reflect(V &v)
+{
+	v = v > 1.0 ? 2.0 - v : (v < -1.0 ? -2.0 - v : v);
+}
+
+template <u32 LANES>
+ALWAYS_INLINE void mandelbox_lanes(const double *in_x, const double *in_y,
+		const double *in_z, u32 count, double d, int nn, double *out)
+{
+	using V = typename lanes<LANES>::vdouble;
+	using M = typename lanes<LANES>::vmask;
+
+	const int s = 7;
+	d *= s;
+
+	const double scale = 2;
+	V minRadius2 = {}, one = {};
+	minRadius2 += 0.25;
+	one += 1.0;
+
+	for (u32 base = 0; base < count; base += LANES) {
+		V x, y, z;
+		load_lanes<LANES>(x, in_x, base, count);
+		load_lanes<LANES>(y, in_y, base, count);
+		load_lanes<LANES>(z, in_z, base, count);
+		x *= s;
+		y *= s;
+		z *= s;
+		const V posX = x, posY = y, posZ = z;
+		V dr = one;
+		V fixedRadius2 = one;
+
+		for (int n = 0; n < nn; n++) {
+			reflect(x);
+			reflect(y);
+			reflect(z);
+
+			const V r2 = x * x + y * y + z * z;
+			const M inner = r2 < minRadius2;
+			const M outer = ~inner & (r2 < fixedRadius2);
+
+			// x * 1 / 1 is exact, lanes outside both spheres keep their value
+			const V mul = (inner | outer) ? fixedRadius2 : one;
+			const V div = inner ? minRadius2 : (outer ? r2 : one);
+			x = x * mul / div;
+			y = y * mul / div;
+			z = z * mul / div;
+			dr = dr * (inner ? fixedRadius2 : one) / (inner ? minRadius2 : one);
+			fixedRadius2 = outer ? fixedRadius2 * (fixedRadius2 / r2) : fixedRadius2;
+
+			x = x * scale + posX;
+			y = y * scale + posY;
+			z = z * scale + posZ;
+			dr *= scale;
+		}
+
+		const u32 used = std::min(LANES, count - base);
+		for (u32 l = 0; l < used; l++) {
+			const double r = sqrt(x[l] * x[l] + y[l] * y[l] + z[l] * z[l]);
+			out[base + l] = (r / fabs(dr[l])) < d;
+		}
+	}
+}
+
+template <u32 LANES>
+ALWAYS_INLINE void mengersponge_lanes(const double *in_x, const double *in_y,
+		const double *in_z, u32 count, double d, int MI, double *out)
+{
+	using V = typename lanes<LANES>::vdouble;
+	using M = typename lanes<LANES>::vmask;
+
+	const double scale = 3;
+
+	// pow(scale, -i) for every possible iteration count
+	std::vector<double> shrink(std::max(MI, 0) + 1);
+	for (int i = 0; i < (int)shrink.size(); i++)
+		shrink[i] = pow(scale, (-i));
+
+	for (u32 base = 0; base < count; base += LANES) {
+		V x, y, z;
+		load_lanes<LANES>(x, in_x, base, count);
+		load_lanes<LANES>(y, in_y, base, count);
+		load_lanes<LANES>(z, in_z, base, count);
+		V r = x * x + y * y + z * z;
+		M iter = {};
+
+		// A lane stops once r leaves the radius, r does not change after that
+		for (int i = 0; i < MI; i++) {
+			const M active = r < 9.0;
+			bool any = false;
+			for (u32 l = 0; l < LANES; l++)
+				any |= active[l] != 0;
+			if (!any)
+				break;
+
+			V vx = x, vy = y, vz = z, t;
+			vabs<V, M>(vx);
+			vabs<V, M>(vy);
+			vabs<V, M>(vz);
+			M swap;
+
+			swap = vx - vy < 0.0;
+			t = vx;
+			vx = swap ? vy : vx;
+			vy = swap ? t : vy;
+			swap = vx - vz < 0.0;
+			t = vx;
+			vx = swap ? vz : vx;
+			vz = swap ? t : vz;
+			swap = vy - vz < 0.0;
+			t = vy;
+			vy = swap ? vz : vy;
+			vz = swap ? t : vz;
+
+			vx = scale * vx - 1 * (scale - 1);
+			vy = scale * vy - 1 * (scale - 1);
+			vz = scale * vz;
+			vz = vz > 0.5 * 1 * (scale - 1) ? vz - 1 * (scale - 1) : vz;
+
+			x = active ? vx : x;
+			y = active ? vy : y;
+			z = active ? vz : z;
+			r = active ? vx * vx + vy * vy + vz * vz : r;
+			iter -= active;
+		}
+
+		const u32 used = std::min(LANES, count - base);
+		for (u32 l = 0; l < used; l++)
+			out[base + l] = (sqrt(r[l])) * shrink[iter[l]] < d;
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+TARGET_AVX2 void mandelbox_avx2(const double *x, const double *y, const double *z,
+		u32 count, double d, int nn, double *out)
+{
+	mandelbox_lanes<4>(x, y, z, count, d, nn, out);
+}
+
+TARGET_AVX2 void mengersponge_avx2(const double *x, const double *y,
+		const double *z, u32 count, double d, int MI, double *out)
+{
+	mengersponge_lanes<4>(x, y, z, count, d, MI, out);
+}
+
+static const bool have_avx2 = __builtin_cpu_supports("avx2");
+#else
+static const bool have_avx2 = false;
+#endif
+
+void mandelbox_batch(const double *x, const double *y, const double *z, u32 count,
+		double d, int nn, double *out)
+{
+#ifdef TARGET_AVX2
+	if (have_avx2)
+		return mandelbox_avx2(x, y, z, count, d, nn, out);
+#endif
+	mandelbox_lanes<2>(x, y, z, count, d, nn, out);
+}
+
+void mengersponge_batch(const double *x, const double *y, const double *z,
+		u32 count, double d, int MI, double *out)
+{
+#ifdef TARGET_AVX2
+	if (have_avx2)
+		return mengersponge_avx2(x, y, z, count, d, MI, out);
+#endif
+	mengersponge_lanes<2>(x, y, z, count, d, MI, out);
+}
+
+#else
+
+void mandelbox_batch(const double *x, const double *y, const double *z, u32 count,
+		double d, int nn, double *out)
+{
+	for (u32 i = 0; i < count; i++)
+		out[i] = mandelbox(x[i], y[i], z[i], d, nn);
+}
+
+void mengersponge_batch(const double *x, const double *y, const double *z,
+		u32 count, double d, int MI, double *out)
+{
+	for (u32 i = 0; i < count; i++)
+		out[i] = mengersponge(x[i], y[i], z[i], d, MI);
+}
+
+#endif
+
+bool mengersponge_empty(double min_r2, double d)
+{
+	// Nothing is iterated: the result is sqrt(r) < d with sqrt(r) >= 3.
+	// The margin covers rounding of the caller's bound.
+	return min_r2 >= 9 * (1 + 1e-9) && d <= 3;
+}
+
+} // namespace mapgen_math
@@ -0,0 +1,53 @@
+/*
+mapgen_math_fractal.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+
+/*
+	Built in fractals of the math mapgen.
+
+	The batch versions evaluate groups of points in vector registers (AVX2
+	when the CPU has it) with selects instead of branches. They use the same
+	operations in the same order as the per point functions and give the
+	same results.
+*/
+namespace mapgen_math
+{
+
+double mandelbox(double x, double y, double z, double d, int nn = 10, int seed = 1);
+double mengersponge(double x, double y, double z, double d, int MI = 10, int seed = 1);
+
+// out[i] = f(x[i], y[i], z[i], d, n)
+using batch_func = void (*)(const double *x, const double *y, const double *z,
+		u32 count, double d, int n, double *out);
+
+void mandelbox_batch(const double *x, const double *y, const double *z, u32 count,
+		double d, int nn, double *out);
+void mengersponge_batch(const double *x, const double *y, const double *z,
+		u32 count, double d, int MI, double *out);
+
+// True when mengersponge() is 0 for every point with squared distance from the
+// origin of at least min_r2: the iteration does not start there.
+bool mengersponge_empty(double min_r2, double d);
+
+} // namespace mapgen_math
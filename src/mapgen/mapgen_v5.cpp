@@ -264,7 +264,7 @@ void MapgenV5::makeChunk(BlockMakeData *data)
 
 	// Generate the registered ores
 	if (flags & MG_ORES)
-		m_emerge->oremgr->placeAllOres(this, blockseed, node_min, node_max);
+		placeOres();
 
 	// Generate dungeons and desert temples
 	if (flags & MG_DUNGEONS)
@@ -272,7 +272,7 @@ void MapgenV5::makeChunk(BlockMakeData *data)
 
 	// Generate the registered decorations
 	if (flags & MG_DECORATIONS)
-		m_emerge->decomgr->placeAllDecos(this, blockseed, node_min, node_max);
+		placeDecorations();
 
 	// Sprinkle some dust on top after everything else was generated
 	if (flags & MG_BIOMES)
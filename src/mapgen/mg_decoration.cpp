@@ -451,6 +451,15 @@ size_t DecoSchematic::generate(MMVManip *vm, PcgRandom *pr, v3pos_t p, bool ceil
 	return 1;
 }
 
+
+pos_t DecoSchematic::getReach() const
+{
+	if (!schematic)
+		return 1;
+	// Any rotation and centering, and the spawnby neighbours
+	return std::max<pos_t>(1, std::max(schematic->size.X, schematic->size.Z) - 1);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ObjDef *DecoLSystem::clone() const
 {
@@ -47,6 +47,9 @@ class Decoration : public ObjDef, public NodeResolver {
 	void placeDeco(Mapgen *mg, u32 blockseed, v3pos_t nmin, v3pos_t nmax);
 
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3pos_t p, bool ceiling) = 0;
+	// Horizontal distance from the placement position of the nodes generate()
+	// reads or writes
+	virtual pos_t getReach() const { return 1; }
 
 	u32 flags = 0;
 	int mapseed = 0;
@@ -91,6 +94,7 @@ class DecoSchematic : public Decoration {
 	virtual ~DecoSchematic();
 
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3pos_t p, bool ceiling);
+	virtual pos_t getReach() const;
 
 	Rotation rotation;
 	Schematic *schematic = nullptr;
@@ -103,6 +107,8 @@ class DecoLSystem : public Decoration {
 	ObjDef *clone() const;
 
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3pos_t p, bool ceiling);
+	// Trees have no bound
+	virtual pos_t getReach() const { return MAX_MAP_GENERATION_LIMIT; }
 
 	// In case it gets cloned it uses the same tree def.
 	std::shared_ptr<treegen::TreeDef> tree_def;
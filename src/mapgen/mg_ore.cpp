@@ -28,17 +28,20 @@ OreManager::OreManager(IGameDef *gamedef) :
 }
 
 
-size_t OreManager::placeAllOres(Mapgen *mg, u32 blockseed, v3pos_t nmin, v3pos_t nmax)
+size_t OreManager::placeAllOres(Mapgen *mg, u32 blockseed, v3pos_t nmin, v3pos_t nmax,
+	const OreChunkPart *part)
 {
 	size_t nplaced = 0;
+	OreChunkPart ore_part = part ? *part : OreChunkPart{};
 
 	for (size_t i = 0; i != m_objects.size(); i++) {
 		Ore *ore = (Ore *)m_objects[i];
 		if (!ore)
 			continue;
 
-		nplaced += ore->placeOre(mg, blockseed, nmin, nmax);
+		nplaced += ore->placeOre(mg, blockseed, nmin, nmax, part ? &ore_part : nullptr);
 		blockseed++;
+		ore_part.chunkseed++;
 	}
 
 	return nplaced;
@@ -79,7 +82,8 @@ void Ore::resolveNodeNames()
 }
 
 
-size_t Ore::placeOre(Mapgen *mg, u32 blockseed, v3pos_t nmin, v3pos_t nmax)
+size_t Ore::placeOre(Mapgen *mg, u32 blockseed, v3pos_t nmin, v3pos_t nmax,
+	const OreChunkPart *part)
 {
 	if (nmin.Y > y_max || nmax.Y < y_min)
 		return 0;
@@ -91,12 +95,38 @@ size_t Ore::placeOre(Mapgen *mg, u32 blockseed, v3pos_t nmin, v3pos_t nmax)
 
 	nmin.Y = actual_ymin;
 	nmax.Y = actual_ymax;
+	m_part = part;
 	generate(mg->vm, mg->seed, blockseed, nmin, nmax, mg->biomemap);
+	m_part = nullptr;
 
 	return 1;
 }
 
 
+u32 Ore::getClusterCount(PcgRandom &pr, u32 volume, bool scarce_chance) const
+{
+	if (!m_part) {
+		u32 count = volume / clust_scarcity;
+		if (scarce_chance && clust_scarcity > volume &&
+				1 >= pr.range(0, clust_scarcity / volume))
+			count = 1;
+		return count;
+	}
+
+	// Same for every part of the chunk
+	PcgRandom chunk_pr(m_part->chunkseed);
+	const u32 chunk_volume = volume * m_part->count;
+	u32 count = chunk_volume / clust_scarcity;
+	if (scarce_chance && clust_scarcity > chunk_volume &&
+			1 >= chunk_pr.range(0, clust_scarcity / chunk_volume))
+		count = 1;
+
+	// Shares differ by one at most, a chunk random order decides which get more
+	const u64 i = (m_part->index + chunk_pr.next()) % m_part->count;
+	return (i + 1) * count / m_part->count - i * count / m_part->count;
+}
+
+
 void Ore::cloneTo(Ore *def) const
 {
 	ObjDef::cloneTo(def);
@@ -140,10 +170,7 @@ void OreScatter::generate(MMVManip *vm, int mapseed, u32 blockseed,
 				 (nmax.Z - nmin.Z + 1);
 	u32 csize     = clust_size;
 	u32 cvolume    = csize * csize * csize;
-	u32 nclusters = volume / clust_scarcity;
-
-	if (clust_scarcity > volume && 1 >= pr.range(0, clust_scarcity/volume))
-		nclusters = 1;
+	u32 nclusters = getClusterCount(pr, volume, true);
 
 	for (u32 i = 0; i != nclusters; i++) {
 		int x0 = pr.range(nmin.X, nmax.X - csize + 1);
@@ -362,7 +389,7 @@ void OreBlob::generate(MMVManip *vm, int mapseed, u32 blockseed,
 				 (nmax.Y - nmin.Y + 1) *
 				 (nmax.Z - nmin.Z + 1);
 	u32 csize  = clust_size;
-	u32 nblobs = volume / clust_scarcity;
+	u32 nblobs = getClusterCount(pr, volume, false);
 
 	if (!noise)
 		noise = new Noise(&np, mapseed, csize, csize, csize);
@@ -36,6 +36,16 @@ enum OreType {
 
 extern const FlagDesc flagdesc_ore[];
 
+// A chunk placed in parts, see MapgenBasic::placeOres. Scatter and blob ores
+// place the cluster count of the whole chunk, shared out to the parts.
+struct OreChunkPart
+{
+	u32 index;
+	u32 count;
+	// Seed of the ore for the whole chunk
+	u32 chunkseed;
+};
+
 class Ore : public ObjDef, public NodeResolver {
 public:
 	const bool needs_noise;
@@ -59,12 +69,19 @@ class Ore : public ObjDef, public NodeResolver {
 
 	virtual void resolveNodeNames();
 
-	size_t placeOre(Mapgen *mg, u32 blockseed, v3pos_t nmin, v3pos_t nmax);
+	size_t placeOre(Mapgen *mg, u32 blockseed, v3pos_t nmin, v3pos_t nmax,
+		const OreChunkPart *part = nullptr);
 	virtual void generate(MMVManip *vm, int mapseed, u32 blockseed,
 		v3pos_t nmin, v3pos_t nmax, biome_t *biomemap) = 0;
 
 protected:
 	void cloneTo(Ore *def) const;
+
+	// Clusters to place in volume, draws from pr as before for whole chunks
+	u32 getClusterCount(PcgRandom &pr, u32 volume, bool scarce_chance) const;
+
+	// Set while placing a part
+	const OreChunkPart *m_part = nullptr;
 };
 
 class OreScatter : public Ore {
@@ -179,7 +196,8 @@ class OreManager : public ObjDefManager {
 
 	void clear();
 
-	size_t placeAllOres(Mapgen *mg, u32 blockseed, v3pos_t nmin, v3pos_t nmax);
+	size_t placeAllOres(Mapgen *mg, u32 blockseed, v3pos_t nmin, v3pos_t nmax,
+		const OreChunkPart *part = nullptr);
 
 private:
 	OreManager() {};
@@ -162,7 +162,10 @@ void ConnectionEnet::processCommand(ConnectionCommandPtr c)
 		return;
 	case CONNCMD_SEND:
 		dout_con << getDesc() << " processing CONNCMD_SEND" << std::endl;
-		send(c->peer_id, c->channelnum, c->data, c->reliable);
+		if (c->payload)
+			send(c->peer_id, c->channelnum, c->payload, c->reliable);
+		else
+			send(c->peer_id, c->channelnum, c->data, c->reliable);
 		return;
 	case CONNCMD_SEND_TO_ALL:
 		dout_con << getDesc() << " processing CONNCMD_SEND_TO_ALL" << std::endl;
@@ -414,6 +417,34 @@ void ConnectionEnet::send(
 	}
 }
 
+void ConnectionEnet::send(u16 peer_id, u8 channelnum, packet_buffer payload, bool reliable)
+{
+	assert(channelnum < CHANNEL_COUNT);
+
+	if (m_peers.find(peer_id) == m_peers.end())
+		return;
+	ENetPeer *peer = getPeer(peer_id);
+	if (!peer) {
+		deletePeer(peer_id, false);
+		return;
+	}
+
+	const auto size = payload.size();
+	ENetPacket *packet = enet_packet_create(payload.data(), size,
+			ENET_PACKET_FLAG_NO_ALLOCATE | (reliable ? ENET_PACKET_FLAG_RELIABLE : 0));
+	if (!packet)
+		return;
+	packet->userData = payload.release();
+	packet->freeCallback = [](ENetPacket *packet) {
+		packet_buffer::adopt(packet->userData);
+	};
+	if (enet_peer_send(peer, channelnum, packet) < 0) {
+		infostream << "enet_peer_send failed peer=" << peer_id << " reliable=" << reliable
+				   << " size=" << size << std::endl;
+		enet_packet_destroy(packet);
+	}
+}
+
 ENetPeer *ConnectionEnet::getPeer(u16 peer_id)
 {
 	auto node = m_peers.find(peer_id);
@@ -568,7 +599,7 @@ void ConnectionEnet::Send(
 {
 	assert(channelnum < CHANNEL_COUNT); // Pre-condition
 
-	putCommand(con::ConnectionCommand::send(peer_id, channelnum, pkt, reliable));
+	putCommand(con::ConnectionCommand::send(peer_id, channelnum, pkt->forge(), reliable));
 }
 
 void ConnectionEnet::Send(
@@ -85,6 +85,8 @@ class ConnectionEnet final : public IConnection, public thread_vector
 	void disconnect();
 	void sendToAll(u8 channelnum, SharedBuffer<u8> data, bool reliable);
 	void send(u16 peer_id, u8 channelnum, SharedBuffer<u8> data, bool reliable);
+	// Without a copy, enet holds a reference until the packet is sent
+	void send(u16 peer_id, u8 channelnum, packet_buffer payload, bool reliable);
 
 protected:
 	ENetPeer *getPeer(u16 peer_id);
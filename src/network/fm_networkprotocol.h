@@ -7,7 +7,10 @@
 #include "../msgpack_fix.h"
 #include "../config.h"
 
-#define CLIENT_PROTOCOL_VERSION_FM 3
+// 4: blocks of TOCLIENT_BLOCKDATAS_FM are acked with TOSERVER_GOTBLOCKS
+// 5: TOCLIENT_INIT_MAP_ZSTD_DICTIONARY, blocks of TOCLIENT_BLOCKDATAS_FM may use it
+// 6: TOCLIENT_BLOCKDATA_VERSION and TOCLIENT_BLOCKDATA_DELTA in TOCLIENT_BLOCKDATAS_FM
+#define CLIENT_PROTOCOL_VERSION_FM 6
 #define SERVER_PROTOCOL_VERSION_FM 0
 
 enum
@@ -25,6 +28,8 @@ enum
 	TOCLIENT_INIT_PROTOCOL_VERSION_FM,
 	TOCLIENT_INIT_WEATHER,
 	TOCLIENT_INIT_GAMEID,
+	// std::string zstd dictionary of map blocks, see addZstdDictionary
+	TOCLIENT_INIT_MAP_ZSTD_DICTIONARY,
 };
 
 #define TOCLIENT_BLOCKDATA_FM 0x12
@@ -40,6 +45,12 @@ enum
 	TOCLIENT_BLOCKDATA_CONTENT_ONLY,
 	TOCLIENT_BLOCKDATA_CONTENT_ONLY_PARAM1,
 	TOCLIENT_BLOCKDATA_CONTENT_ONLY_PARAM2,
+	// u64 server block version
+	TOCLIENT_BLOCKDATA_VERSION,
+	// u64 base version, instead of TOCLIENT_BLOCKDATA_DATA: MapBlock::serializeDelta()
+	// output against the base. A client without the base version sends
+	// TOSERVER_DELETEDBLOCKS to get the whole block.
+	TOCLIENT_BLOCKDATA_DELTA_BASE,
 };
 
 enum
@@ -0,0 +1,95 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_packet_buffer.h"
+
+#include <new>
+
+// size class of buffers not pooled
+static constexpr uint8_t UNPOOLED = 0xff;
+
+static uint8_t sizeClass(size_t size)
+{
+	size_t shift = packet_buffer_pool::MIN_SHIFT;
+	while ((size_t(1) << shift) < size) {
+		if (++shift > packet_buffer_pool::MAX_SHIFT)
+			return UNPOOLED;
+	}
+	return shift - packet_buffer_pool::MIN_SHIFT;
+}
+
+packet_buffer packet_buffer::make(size_t size)
+{
+	packet_buffer buffer;
+	buffer.m_block = packet_buffer_pool::instance().take(size);
+	return buffer;
+}
+
+void packet_buffer::drop()
+{
+	if (m_block && m_block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		packet_buffer_pool::instance().give(m_block);
+	m_block = nullptr;
+}
+
+packet_buffer_pool &packet_buffer_pool::instance()
+{
+	// never destroyed: buffers are released by connection threads until exit
+	static auto *pool = new packet_buffer_pool;
+	return *pool;
+}
+
+packet_buffer::header *packet_buffer_pool::take(size_t size)
+{
+	const auto cls = sizeClass(size);
+	packet_buffer::header *block = nullptr;
+	if (cls != UNPOOLED) {
+		auto &c = m_classes[cls];
+		const auto lock = std::lock_guard(c.mutex);
+		if (!c.free.empty()) {
+			block = c.free.back();
+			c.free.pop_back();
+		}
+	}
+	if (block) {
+		++m_reuses;
+	} else {
+		const size_t capacity = cls == UNPOOLED ? size : size_t(1) << (cls + MIN_SHIFT);
+		block = static_cast<packet_buffer::header *>(
+				::operator new(sizeof(packet_buffer::header) + capacity));
+		new (block) packet_buffer::header{};
+		block->size_class = cls;
+		++m_allocations;
+	}
+	block->refs.store(1, std::memory_order_relaxed);
+	block->size = size;
+	return block;
+}
+
+void packet_buffer_pool::give(packet_buffer::header *block)
+{
+	if (block->size_class != UNPOOLED) {
+		auto &c = m_classes[block->size_class];
+		const auto lock = std::lock_guard(c.mutex);
+		if (c.free.size() < FREE_MAX) {
+			c.free.emplace_back(block);
+			return;
+		}
+	}
+	block->~header();
+	::operator delete(block);
+}
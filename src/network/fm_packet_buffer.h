@@ -0,0 +1,131 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/*
+Reference counted byte buffers for the wire form of packets, taken from and
+returned to a pool of power of two size classes. A packet broadcast to many
+peers is forged once and its buffer is shared by the send queues of all
+connection backends; enet sends it without a copy.
+
+The reference count is atomic, a buffer can be released from any thread.
+Contents must not change once the buffer is shared.
+*/
+
+class packet_buffer
+{
+public:
+	packet_buffer() = default;
+	packet_buffer(const packet_buffer &other) : m_block{other.m_block} { grab(); }
+	packet_buffer(packet_buffer &&other) noexcept : m_block{other.m_block}
+	{
+		other.m_block = nullptr;
+	}
+	packet_buffer &operator=(packet_buffer other) noexcept
+	{
+		std::swap(m_block, other.m_block);
+		return *this;
+	}
+	~packet_buffer() { drop(); }
+
+	// Uninitialized buffer of size bytes
+	static packet_buffer make(size_t size);
+
+	uint8_t *data() { return m_block ? reinterpret_cast<uint8_t *>(m_block + 1) : nullptr; }
+	const uint8_t *data() const
+	{
+		return m_block ? reinterpret_cast<const uint8_t *>(m_block + 1) : nullptr;
+	}
+	size_t size() const { return m_block ? m_block->size : 0; }
+	explicit operator bool() const { return m_block; }
+
+	// Hand the reference over to C code (a free callback) and take it back
+	void *release()
+	{
+		auto *block = m_block;
+		m_block = nullptr;
+		return block;
+	}
+	static packet_buffer adopt(void *released)
+	{
+		packet_buffer buffer;
+		buffer.m_block = static_cast<header *>(released);
+		return buffer;
+	}
+
+private:
+	friend class packet_buffer_pool;
+
+	struct alignas(16) header
+	{
+		std::atomic_uint32_t refs;
+		uint32_t size;
+		uint8_t size_class;
+	};
+
+	void grab()
+	{
+		if (m_block)
+			m_block->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+	void drop();
+
+	header *m_block = nullptr;
+};
+
+class packet_buffer_pool
+{
+public:
+	// Size classes of 64 B to 64 KiB, bigger buffers are not pooled
+	static constexpr size_t MIN_SHIFT = 6;
+	static constexpr size_t MAX_SHIFT = 16;
+	// Free buffers kept per size class
+	static constexpr size_t FREE_MAX = 256;
+
+	static packet_buffer_pool &instance();
+
+	// Buffers taken from the heap and from the free lists
+	uint64_t allocations() const { return m_allocations.load(std::memory_order_relaxed); }
+	uint64_t reuses() const { return m_reuses.load(std::memory_order_relaxed); }
+
+private:
+	friend class packet_buffer;
+
+	packet_buffer_pool() = default;
+
+	packet_buffer::header *take(size_t size);
+	void give(packet_buffer::header *block);
+
+	struct size_class
+	{
+		std::mutex mutex;
+		std::vector<packet_buffer::header *> free;
+	};
+
+	std::array<size_class, MAX_SHIFT - MIN_SHIFT + 1> m_classes;
+	std::atomic_uint64_t m_allocations{0};
+	std::atomic_uint64_t m_reuses{0};
+};
@@ -611,6 +611,17 @@ ConnectionCommandPtr ConnectionCommand::send(
 	return c;
 }
 
+ConnectionCommandPtr ConnectionCommand::send(
+		session_t peer_id, u8 channelnum, const packet_buffer &payload, bool reliable)
+{
+	auto c = create(CONNCMD_SEND);
+	c->peer_id = peer_id;
+	c->channelnum = channelnum;
+	c->reliable = reliable;
+	c->payload = payload;
+	return c;
+}
+
 ConnectionCommandPtr ConnectionCommand::ack(session_t peer_id, u8 channelnum, const Buffer<u8> &data)
 {
 	auto c = create(CONCMD_ACK);
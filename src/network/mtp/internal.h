@@ -5,6 +5,7 @@
 #pragma once
 
 #include "network/mtp/impl.h"
+#include "network/fm_packet_buffer.h"
 
 #include "util/numeric.h"
 
@@ -343,7 +344,10 @@ struct ConnectionCommand
 	DISABLE_CLASS_COPY(ConnectionCommand);
 
 	//fm:
+	// Shared wire form of the packet instead of data, see NetworkPacket::forge()
+	packet_buffer payload;
 	static ConnectionCommandPtr send(session_t peer_id, u8 channelnum, SharedBuffer<u8> data, bool reliable);
+	static ConnectionCommandPtr send(session_t peer_id, u8 channelnum, const packet_buffer &payload, bool reliable);
 
 	static ConnectionCommandPtr serve(Address address);
 	static ConnectionCommandPtr connect(Address address);
@@ -48,6 +48,7 @@ void NetworkPacket::putRawPacket(const u8 *data, u32 datasize, session_t peer_id
 
 void NetworkPacket::clear()
 {
+	m_forged = {};
 	m_data.clear();
 	m_datasize = 0;
 	m_read_offset = 0;
@@ -593,6 +594,18 @@ Buffer<u8> NetworkPacket::oldForgePacket()
 	return sb;
 }
 
+const packet_buffer &NetworkPacket::forge()
+{
+	if (m_forged || m_command == 0)
+		return m_forged;
+
+	m_forged = packet_buffer::make(m_datasize + 2);
+	writeU16(m_forged.data(), m_command);
+	if (m_datasize > 0)
+		memcpy(m_forged.data() + 2, m_data.data(), m_datasize);
+	return m_forged;
+}
+
 //freeminer:
 bool parse_msgpack_packet(const char *data, u32 datasize, MsgpackPacket *packet, int *command, msgpack::unpacked &msg) {
 	try {
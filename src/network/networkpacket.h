@@ -14,6 +14,7 @@
 
 // fm:
 #include "fm_networkprotocol.h"
+#include "fm_packet_buffer.h"
 #include "../util/msgpack_serialize.h"
 
 class MsgpackPacketSafe;
@@ -179,12 +180,18 @@ class NetworkPacket
 	// ^ this comment has been here for 7 years
 	Buffer<u8> oldForgePacket();
 
+	// fm: Wire form like oldForgePacket(), made once until the packet changes and
+	// shared by all sends of it
+	const packet_buffer &forge();
+
 private:
 	void checkReadOffset(u32 from_offset, u32 field_size) const;
 
 	// resize data buffer for writing
 	inline void checkDataSize(u32 field_size)
 	{
+		if (m_forged)
+			m_forged = {};
 		if (m_read_offset + field_size > m_datasize) {
 			m_datasize = m_read_offset + field_size;
 			m_data.resize(m_datasize);
@@ -203,6 +210,7 @@ class NetworkPacket
 	std::shared_ptr<msgpack::unpacked> packet_unpacked;
 	int packet_unpack();
 private:
+	packet_buffer m_forged;
 	// ==
 
 	u16 m_proto_ver = 0;
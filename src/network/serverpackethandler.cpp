@@ -425,7 +425,6 @@ void Server::handleCommand_ClientReady(NetworkPacket* pkt)
 
 void Server::handleCommand_GotBlocks(NetworkPacket* pkt)
 {
-#if NOTUSED
 	if (pkt->getSize() < 1)
 		return;
 
@@ -445,12 +444,20 @@ void Server::handleCommand_GotBlocks(NetworkPacket* pkt)
 	if (!client)
 		return;
 
-	for (u16 i = 0; i < count; i++) {
-		v3bpos_t p;
-		*pkt >> p;
-		client->GotBlock(p);
+	// Acks drive the send window and the block delta bases, blocks are marked
+	// sent when sending
+	count = std::min<size_t>(
+			count, pkt->getRemainingBytes() / sizeof_v3pos(pkt->getProtoVer()));
+	const auto rtt_ms = client->m_send_window.acked(count, porting::getTimeMs());
+	if (rtt_ms >= 0)
+		m_block_send_latency->observe(rtt_ms / 1000);
+	if (client->net_proto_version_fm >= 6) {
+		for (u16 i = 0; i < count; i++) {
+			v3bpos_t p;
+			*pkt >> p;
+			client->m_block_versions.acked(p);
+		}
 	}
-#endif
 }
 
 void Server::process_PlayerPos(RemotePlayer *player, PlayerSAO *playersao,
@@ -31,6 +31,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "util/string.h"
 #include "exceptions.h"
 #include "log_types.h"
+#include "fm_noise_kernels.h"
 
 #define NOISE_MAGIC_X    1619
 #define NOISE_MAGIC_Y    31337
@@ -507,6 +508,32 @@ void Noise::resizeNoiseBuf(bool is3d)
 }
 
 
+void Noise::lerpLatticeRows(float u, float step_x, bool eased, u32 nlx, u32 nrows)
+{
+	row_u.resize(sx);
+	row_x.resize(sx);
+	u32 noisex = 0;
+	for (u32 i = 0; i != sx; i++) {
+		row_x[i] = noisex;
+		row_u[i] = eased ? easeCurve(u) : u;
+
+		u += step_x;
+		if (u >= 1.0) {
+			u -= 1.0;
+			noisex++;
+		}
+	}
+
+	row_lerp.resize((size_t)nrows * sx);
+	for (u32 r = 0; r != nrows; r++) {
+		const float *line = &noise_buf[r * nlx];
+		float *out = &row_lerp[(size_t)r * sx];
+		for (u32 i = 0; i != sx; i++)
+			out[i] = linearInterpolation(line[row_x[i]], line[row_x[i] + 1], row_u[i]);
+	}
+}
+
+
 /*
  * NB:  This algorithm is not optimal in terms of space complexity.  The entire
  * integer lattice of noise points could be done as 2 lines instead, and for 3D,
@@ -524,8 +551,8 @@ void Noise::valueMap2D(
 		float step_x, float step_y,
 		s32 seed)
 {
-	float v00, v01, v10, v11, u, v, orig_u;
-	u32 index, i, j, noisex, noisey;
+	float u, v;
+	u32 j, noisey;
 	u32 nlx, nly;
 	s32 x0, y0;
 
@@ -534,41 +561,22 @@ void Noise::valueMap2D(
 	y0 = std::floor(y);
 	u = x - (float)x0;
 	v = y - (float)y0;
-	orig_u = u;
+
+	const auto &kernels = noise_kernels::get();
 
 	//calculate noise point lattice
 	nlx = (u32)(u + sx * step_x) + 2;
 	nly = (u32)(v + sy * step_y) + 2;
-	index = 0;
 	for (j = 0; j != nly; j++)
-		for (i = 0; i != nlx; i++)
-			noise_buf[index++] = noise2d(x0 + i, y0 + j, seed);
+		kernels.lattice2d(&noise_buf[idx(0, j)], x0, y0 + j, nlx, seed);
 
 	//calculate interpolations
-	index  = 0;
+	lerpLatticeRows(u, step_x, eased, nlx, nly);
 	noisey = 0;
 	for (j = 0; j != sy; j++) {
-		v00 = noise_buf[idx(0, noisey)];
-		v10 = noise_buf[idx(1, noisey)];
-		v01 = noise_buf[idx(0, noisey + 1)];
-		v11 = noise_buf[idx(1, noisey + 1)];
-
-		u = orig_u;
-		noisex = 0;
-		for (i = 0; i != sx; i++) {
-			value_buf[index++] =
-				biLinearInterpolation(v00, v10, v01, v11, u, v, eased);
-
-			u += step_x;
-			if (u >= 1.0) {
-				u -= 1.0;
-				noisex++;
-				v00 = v10;
-				v01 = v11;
-				v10 = noise_buf[idx(noisex + 1, noisey)];
-				v11 = noise_buf[idx(noisex + 1, noisey + 1)];
-			}
-		}
+		kernels.lerp2(&value_buf[j * sx],
+			&row_lerp[noisey * sx], &row_lerp[(noisey + 1) * sx],
+			eased ? easeCurve(v) : v, sx);
 
 		v += step_y;
 		if (v >= 1.0) {
@@ -586,10 +594,8 @@ void Noise::valueMap3D(
 		float step_x, float step_y, float step_z,
 		s32 seed)
 {
-	float v000, v010, v100, v110;
-	float v001, v011, v101, v111;
-	float u, v, w, orig_u, orig_v;
-	u32 index, i, j, k, noisex, noisey, noisez;
+	float u, v, w, orig_v;
+	u32 index, j, k, noisey, noisez;
 	u32 nlx, nly, nlz;
 	s32 x0, y0, z0;
 
@@ -601,59 +607,34 @@ void Noise::valueMap3D(
 	u = x - (float)x0;
 	v = y - (float)y0;
 	w = z - (float)z0;
-	orig_u = u;
 	orig_v = v;
 
+	const auto &kernels = noise_kernels::get();
+
 	//calculate noise point lattice
 	nlx = (u32)(u + sx * step_x) + 2;
 	nly = (u32)(v + sy * step_y) + 2;
 	nlz = (u32)(w + sz * step_z) + 2;
-	index = 0;
 	for (k = 0; k != nlz; k++)
 		for (j = 0; j != nly; j++)
-			for (i = 0; i != nlx; i++)
-				noise_buf[index++] = noise3d(x0 + i, y0 + j, z0 + k, seed);
+			kernels.lattice3d(&noise_buf[idx(0, j, k)], x0, y0 + j, z0 + k, nlx, seed);
 
 	//calculate interpolations
+	lerpLatticeRows(u, step_x, eased, nlx, nly * nlz);
 	index  = 0;
-	noisey = 0;
 	noisez = 0;
 	for (k = 0; k != sz; k++) {
+		const float w_eased = eased ? easeCurve(w) : w;
 		v = orig_v;
 		noisey = 0;
 		for (j = 0; j != sy; j++) {
-			v000 = noise_buf[idx(0, noisey,     noisez)];
-			v100 = noise_buf[idx(1, noisey,     noisez)];
-			v010 = noise_buf[idx(0, noisey + 1, noisez)];
-			v110 = noise_buf[idx(1, noisey + 1, noisez)];
-			v001 = noise_buf[idx(0, noisey,     noisez + 1)];
-			v101 = noise_buf[idx(1, noisey,     noisez + 1)];
-			v011 = noise_buf[idx(0, noisey + 1, noisez + 1)];
-			v111 = noise_buf[idx(1, noisey + 1, noisez + 1)];
-
-			u = orig_u;
-			noisex = 0;
-			for (i = 0; i != sx; i++) {
-				value_buf[index++] = triLinearInterpolation(
-					v000, v100, v010, v110,
-					v001, v101, v011, v111,
-					u, v, w,
-					eased);
-
-				u += step_x;
-				if (u >= 1.0) {
-					u -= 1.0;
-					noisex++;
-					v000 = v100;
-					v010 = v110;
-					v100 = noise_buf[idx(noisex + 1, noisey,     noisez)];
-					v110 = noise_buf[idx(noisex + 1, noisey + 1, noisez)];
-					v001 = v101;
-					v011 = v111;
-					v101 = noise_buf[idx(noisex + 1, noisey,     noisez + 1)];
-					v111 = noise_buf[idx(noisex + 1, noisey + 1, noisez + 1)];
-				}
-			}
+			kernels.lerp4(&value_buf[index],
+				&row_lerp[(noisez * nly + noisey) * sx],
+				&row_lerp[(noisez * nly + noisey + 1) * sx],
+				&row_lerp[((noisez + 1) * nly + noisey) * sx],
+				&row_lerp[((noisez + 1) * nly + noisey + 1) * sx],
+				eased ? easeCurve(v) : v, w_eased, sx);
+			index += sx;
 
 			v += step_y;
 			if (v >= 1.0) {
@@ -760,27 +741,11 @@ float *Noise::noiseMap3D(float x, float y, float z, float *persistence_map)
 void Noise::updateResults(float g, float *gmap,
 	const float *persistence_map, size_t bufsize)
 {
-	// This looks very ugly, but it is 50-70% faster than having
-	// conditional statements inside the loop
-	if (np.flags & NOISE_FLAG_ABSVALUE) {
-		if (persistence_map) {
-			for (size_t i = 0; i != bufsize; i++) {
-				result[i] += gmap[i] * std::fabs(value_buf[i]);
-				gmap[i] *= persistence_map[i];
-			}
-		} else {
-			for (size_t i = 0; i != bufsize; i++)
-				result[i] += g * std::fabs(value_buf[i]);
-		}
-	} else {
-		if (persistence_map) {
-			for (size_t i = 0; i != bufsize; i++) {
-				result[i] += gmap[i] * value_buf[i];
-				gmap[i] *= persistence_map[i];
-			}
-		} else {
-			for (size_t i = 0; i != bufsize; i++)
-				result[i] += g * value_buf[i];
-		}
-	}
+	const auto &kernels = noise_kernels::get();
+	const bool absvalue = np.flags & NOISE_FLAG_ABSVALUE;
+	if (persistence_map)
+		kernels.accumulatePersist(result, gmap, value_buf, persistence_map, bufsize,
+				absvalue);
+	else
+		kernels.accumulate(result, value_buf, g, bufsize, absvalue);
 }
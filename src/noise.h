@@ -24,6 +24,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <atomic>
+#include <vector>
 
 #include "constants.h"
 #include "irr_v3d.h"
@@ -231,6 +232,13 @@ class Noise {
 	void resizeNoiseBuf(bool is3d);
 	void updateResults(float g, float *gmap, const float *persistence_map,
 			size_t bufsize);
+	// Interpolates each of the nrows lattice lines of noise_buf along x,
+	// leaving sx values per line in row_lerp
+	void lerpLatticeRows(float u, float step_x, bool eased, u32 nlx, u32 nrows);
+
+	std::vector<float> row_u;
+	std::vector<u32> row_x;
+	std::vector<float> row_lerp;
 
 };
 
@@ -52,7 +52,7 @@ static void paging(u32 length, u32 page, u32 pagecount, u32 &minindex, u32 &maxi
 ScopeProfiler::ScopeProfiler(Profiler *profiler, const std::string &name,
 		ScopeProfilerType type, TimePrecision prec) :
 	m_profiler(profiler),
-	m_name(name), m_type(type), m_precision(prec)
+	m_name(name), m_type(type), m_precision(prec), m_tick(name)
 {
 	m_name.append(" [").append(TimePrecision_units[prec]).append("]");
 	m_time1 = porting::getTime(prec);
@@ -60,6 +60,8 @@ ScopeProfiler::ScopeProfiler(Profiler *profiler, const std::string &name,
 
 void ScopeProfiler::stop() noexcept
 {
+	m_tick.stop();
+
 	if (!m_profiler)
 		return;
 
@@ -14,6 +14,7 @@
 #include "threading/mutex_auto_lock.h"
 #include "util/timetaker.h"
 #include "util/basic_macros.h"
+#include "fm_tick_recorder.h"
 
 // Global profiler
 class Profiler;
@@ -140,6 +141,7 @@ class ScopeProfiler
 	u64 m_time1;
 	ScopeProfilerType m_type;
 	TimePrecision m_precision;
+	tick_recorder::scope m_tick;
 };
 
 
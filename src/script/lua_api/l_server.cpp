@@ -10,6 +10,7 @@
 #include "content/mods.h" // ModSpec
 #include "cpp_api/s_base.h"
 #include "cpp_api/s_security.h"
+#include "fm_tick_recorder.h"
 #include "filesys.h"
 #include "log.h"
 #include "lua_api/l_internal.h"
@@ -56,6 +57,27 @@ int ModApiServer::l_get_server_max_lag(lua_State *L)
 	return 1;
 }
 
+// dump_tick_profile([format])
+int ModApiServer::l_dump_tick_profile(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	const std::string format = luaL_optstring(L, 1, "chrome");
+	auto &recorder = tick_recorder::instance();
+	if (!recorder.enabled()) {
+		lua_pushnil(L);
+		lua_pushstring(L, "tick_recorder_steps is 0");
+		return 2;
+	}
+	const auto path = recorder.dump(getServer(L)->getWorldPath(), format);
+	if (path.empty()) {
+		lua_pushnil(L);
+		lua_pushstring(L, "cannot write profile");
+		return 2;
+	}
+	lua_pushstring(L, path.c_str());
+	return 1;
+}
+
 // print(text)
 int ModApiServer::l_print(lua_State *L)
 {
@@ -686,6 +708,7 @@ void ModApiServer::Initialize(lua_State *L, int top)
 	API_FCT(get_server_status);
 	API_FCT(get_server_uptime);
 	API_FCT(get_server_max_lag);
+	API_FCT(dump_tick_profile);
 	API_FCT(get_mod_data_path);
 	API_FCT(get_worldpath);
 	API_FCT(is_singleplayer);
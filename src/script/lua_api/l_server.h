@@ -21,6 +21,9 @@ class ModApiServer : public ModApiBase
 	// get_server_max_lag()
 	static int l_get_server_max_lag(lua_State *L);
 
+	// dump_tick_profile([format])
+	static int l_dump_tick_profile(lua_State *L);
+
 	// get_worldpath()
 	static int l_get_worldpath(lua_State *L);
 
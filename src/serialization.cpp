@@ -8,7 +8,11 @@
 
 #include <zlib.h>
 #include <zstd.h>
+#include <zdict.h>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include <sstream>
 
@@ -188,13 +192,97 @@ struct ZSTD_Deleter {
 	}
 };
 
-void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level)
+// freeminer: registered dictionaries, never removed so the pointers stay valid
+namespace
+{
+struct ZstdDictionary
+{
+	std::string data;
+	ZSTD_DDict *ddict = nullptr;
+	// digested for compression once per level
+	std::map<int, ZSTD_CDict *> cdicts;
+
+	~ZstdDictionary()
+	{
+		ZSTD_freeDDict(ddict);
+		for (const auto &[level, cdict] : cdicts)
+			ZSTD_freeCDict(cdict);
+	}
+};
+
+std::mutex g_zstd_dictionaries_mutex;
+std::unordered_map<u32, std::unique_ptr<ZstdDictionary>> g_zstd_dictionaries;
+
+const ZSTD_CDict *getZstdCDict(u32 id, int level)
+{
+	std::lock_guard<std::mutex> lock(g_zstd_dictionaries_mutex);
+	const auto it = g_zstd_dictionaries.find(id);
+	if (it == g_zstd_dictionaries.end())
+		throw SerializationError("compressZstd: unknown dictionary");
+	auto &dict = *it->second;
+	auto &cdict = dict.cdicts[level];
+	if (!cdict)
+		cdict = ZSTD_createCDict(dict.data.data(), dict.data.size(), level);
+	return cdict;
+}
+
+const ZSTD_DDict *getZstdDDict(u32 id)
+{
+	std::lock_guard<std::mutex> lock(g_zstd_dictionaries_mutex);
+	const auto it = g_zstd_dictionaries.find(id);
+	return it == g_zstd_dictionaries.end() ? nullptr : it->second->ddict;
+}
+} // namespace
+
+std::string trainZstdDictionary(const std::vector<std::string> &samples, size_t max_size)
+{
+	std::string joined;
+	std::vector<size_t> sizes;
+	sizes.reserve(samples.size());
+	for (const auto &sample : samples) {
+		joined += sample;
+		sizes.emplace_back(sample.size());
+	}
+	std::string dictionary(max_size, '\0');
+	const size_t ret = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(),
+			joined.data(), sizes.data(), sizes.size());
+	if (ZDICT_isError(ret)) {
+		infostream << "trainZstdDictionary: " << ZDICT_getErrorName(ret) << std::endl;
+		return {};
+	}
+	dictionary.resize(ret);
+	return dictionary;
+}
+
+u32 addZstdDictionary(std::string_view dictionary)
+{
+	const u32 id = ZDICT_getDictID(dictionary.data(), dictionary.size());
+	if (!id)
+		return 0;
+	std::lock_guard<std::mutex> lock(g_zstd_dictionaries_mutex);
+	auto &dict = g_zstd_dictionaries[id];
+	if (dict)
+		return id;
+	dict = std::make_unique<ZstdDictionary>();
+	dict->data = dictionary;
+	dict->ddict = ZSTD_createDDict(dict->data.data(), dict->data.size());
+	if (!dict->ddict) {
+		g_zstd_dictionaries.erase(id);
+		return 0;
+	}
+	return id;
+}
+
+void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level,
+		u32 dictionary)
 {
 	// reusing the context is recommended for performance
 	// it will be destroyed when the thread ends
 	thread_local std::unique_ptr<ZSTD_CStream, ZSTD_Deleter> stream(ZSTD_createCStream());
 
 	ZSTD_initCStream(stream.get(), level);
+	// the dictionary carries the level, nullptr drops one of the previous call
+	ZSTD_CCtx_refCDict(stream.get(), dictionary ? getZstdCDict(dictionary, level) : nullptr);
 
 	const size_t bufsize = 16384;
 	char output_buffer[bufsize];
@@ -243,6 +331,7 @@ void decompressZstd(std::istream &is, std::ostream &os)
 
 	ZSTD_outBuffer output = { output_buffer, bufsize, 0 };
 	ZSTD_inBuffer input = { input_buffer, 0, 0 };
+	bool header = true;
 	size_t ret;
 	do
 	{
@@ -254,6 +343,17 @@ void decompressZstd(std::istream &is, std::ostream &os)
 				throw SerializationError("decompressZstd: data ended too early");
 		}
 
+		// freeminer: the frame header names its dictionary
+		if (header) {
+			header = false;
+			if (const u32 id = ZSTD_getDictID_fromFrame(input_buffer, input.size)) {
+				const auto *ddict = getZstdDDict(id);
+				if (!ddict)
+					throw SerializationError("decompressZstd: unknown dictionary");
+				ZSTD_DCtx_refDDict(stream.get(), ddict);
+			}
+		}
+
 		ret = ZSTD_decompressStream(stream.get(), &output, &input);
 		if (ZSTD_isError(ret)) {
 			dstream << ZSTD_getErrorName(ret) << std::endl;
@@ -274,12 +374,13 @@ void decompressZstd(std::istream &is, std::ostream &os)
 	}
 }
 
-void compress(const u8 *data, u32 size, std::ostream &os, u8 version, int level)
+void compress(const u8 *data, u32 size, std::ostream &os, u8 version, int level,
+		u32 dictionary)
 {
 	if(version >= 29)
 	{
 		// map the zlib levels [0,9] to [1,10]. -1 becomes 0 which indicates the default (currently 3)
-		compressZstd(data, size, os, level + 1);
+		compressZstd(data, size, os, level + 1, dictionary);
 		return;
 	}
 
@@ -6,7 +6,9 @@
 
 #include "irrlichttypes.h"
 #include <iostream>
+#include <string>
 #include <string_view>
+#include <vector>
 
 /*
 	Map format serialization version
@@ -84,18 +86,34 @@ inline void compressZlib(std::string_view data, std::ostream &os, int level = 2)
 }
 void decompressZlib(std::istream &is, std::ostream &os, size_t limit = 0);
 
-void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level = 2);
-inline void compressZstd(std::string_view data, std::ostream &os, int level = 2)
+// dictionary: id from addZstdDictionary, 0 for none
+void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level = 2,
+		u32 dictionary = 0);
+inline void compressZstd(std::string_view data, std::ostream &os, int level = 2,
+		u32 dictionary = 0)
 {
-	compressZstd(reinterpret_cast<const u8*>(data.data()), data.size(), os, level);
+	compressZstd(reinterpret_cast<const u8*>(data.data()), data.size(), os, level, dictionary);
 }
+// Frames compressed with a dictionary need it added before
 void decompressZstd(std::istream &is, std::ostream &os);
 
+// freeminer: zstd dictionaries for map blocks
+// Train on samples, empty if they are too few or too small
+std::string trainZstdDictionary(const std::vector<std::string> &samples,
+		size_t max_size = 64 * 1024);
+// Use the dictionary for compression and decompression, returns its id or 0 if invalid.
+// Dictionaries live until exit, adding the same one again returns the same id.
+u32 addZstdDictionary(std::string_view dictionary);
+
 // These choose between zstd, zlib and a self-made one according to version
-void compress(const u8 *data, u32 size, std::ostream &os, u8 version, int level = 2);
-inline void compress(std::string_view data, std::ostream &os, u8 version, int level = 2)
+// dictionary is used only with version >= 29
+void compress(const u8 *data, u32 size, std::ostream &os, u8 version, int level = 2,
+		u32 dictionary = 0);
+inline void compress(std::string_view data, std::ostream &os, u8 version, int level = 2,
+		u32 dictionary = 0)
 {
-	compress(reinterpret_cast<const u8*>(data.data()), data.size(), os, version, level);
+	compress(reinterpret_cast<const u8*>(data.data()), data.size(), os, version, level,
+			dictionary);
 }
 void decompress(std::istream &is, std::ostream &os, u8 version);
 
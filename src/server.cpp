@@ -71,6 +71,8 @@
 
 #include <iostream>
 #include <queue>
+#include <deque>
+#include <tuple>
 #include <algorithm>
 #include <sstream>
 #include <csignal>
@@ -85,6 +87,7 @@
 #include "msgpack_fix.h"
 #include <sys/types.h>
 #include "fm_server.h"
+#include "fm_tick_recorder.h"
 #if !MINETEST_PROTO
 #include "network/fm_serverpacketsender.cpp"
 #endif
@@ -377,6 +380,10 @@ Server::Server(
 			"minetest_core_map_edit_events",
 			"Number of map edit events");
 
+	m_block_send_latency = m_metrics_backend->addHistogram(
+			"minetest_core_block_send_latency",
+			"Time from sending blocks to a client until it acks them (in seconds)");
+
 	m_lag_gauge->set(g_settings->getFloat("dedicated_server_step"));
 
 	m_path_mod_data = porting::path_user + DIR_DELIM "mod_data";
@@ -525,13 +532,26 @@ void Server::init()
 	// Create emerge manager
 	m_emerge = std::make_unique<EmergeManager>(this, m_metrics_backend.get());
 
+	{
+		size_t job_threads = g_settings->getU16("server_job_threads");
+		if (!job_threads)
+			// without more_threads the pool only helps the main thread
+			job_threads = m_more_threads
+								  ? std::max<size_t>(Thread::getNumberOfProcessors(), 6)
+								  : 1;
+		m_jobs = std::make_unique<job_scheduler>(
+				"ServerJobs", job_threads, m_metrics_backend.get());
+	}
+	if (const size_t cache_mb = g_settings->getU32("serialized_block_cache_size"))
+		m_serialized_block_cache = std::make_unique<serialized_block_cache>(cache_mb << 20);
+	if (const size_t cache_mb = g_settings->getU32("block_delta_cache_size"))
+		m_block_snapshots = std::make_unique<block_snapshots>(cache_mb << 20);
+	if (const auto steps = g_settings->getU32("tick_recorder_steps")) {
+		tick_recorder::instance().setSteps(steps);
+		tick_recorder::installSignalHandler();
+	}
 	if (m_more_threads) {
-		m_map_thread =  std::make_unique<MapThread>(this);
-		m_sendblocks_thead = std::make_unique<SendBlocksThread>(this);
-		m_sendfarblocks_thead = std::make_unique<SendFarBlocksThread>(this);
-		m_liquid = std::make_unique<LiquidThread>(this);
-		m_env_thread = std::make_unique<EnvThread>(this);
-		m_abm_thread = std::make_unique<AbmThread>(this);
+		addJobs();
 		m_abm_world_thread = std::make_unique<AbmWorldThread>(this);
 		m_world_merge_thread = std::make_unique<WorldMergeThread>(this);
 	}
@@ -684,18 +704,7 @@ void Server::start()
 	// Start thread
 	//fmtodo: test need restart?
 	m_thread->restart();
-	if (m_map_thread)
-		m_map_thread->restart();
-	if (m_sendblocks_thead)
-		m_sendblocks_thead->restart();
-	if (m_sendfarblocks_thead)
-		m_sendfarblocks_thead->restart();
-	if (m_liquid)
-		m_liquid->restart();
-	if(m_env_thread)
-		m_env_thread->restart();
-	if(m_abm_thread)
-		m_abm_thread->restart();
+	m_jobs->restart(m_jobs->getThreads());
 	if(m_abm_world_thread)
 		m_abm_world_thread->restart();
 	if(m_world_merge_thread)
@@ -811,43 +820,23 @@ void Server::stop()
 	// Stop threads (set run=false first so both start stopping)
 	m_thread->stop();
 
-	if (m_liquid)
-		m_liquid->stop();
-	if (m_sendblocks_thead)
-		m_sendblocks_thead->stop();
-	if (m_sendfarblocks_thead)
-		m_sendfarblocks_thead->stop();
-	if (m_map_thread)
-		m_map_thread->stop();
-	if(m_abm_thread)
-		m_abm_thread->stop();
+	if (m_jobs)
+		m_jobs->stop();
 	if(m_abm_world_thread)
 		m_abm_world_thread->stop();
 	if(m_world_merge_thread)
 		m_world_merge_thread->stop();
-	if(m_env_thread)
-		m_env_thread->stop();
 
 
 	m_thread->wait();
 
 
-	if (m_liquid)
-		m_liquid->join();
-	if (m_sendblocks_thead)
-		m_sendblocks_thead->join();
-	if (m_sendfarblocks_thead)
-		m_sendfarblocks_thead->join();
-	if (m_map_thread)
-		m_map_thread->join();
-	if(m_abm_thread)
-		m_abm_thread->join();
+	if (m_jobs)
+		m_jobs->join();
 	if(m_abm_world_thread)
 		m_abm_world_thread->join();
 	if(m_world_merge_thread)
 		m_world_merge_thread->join();
-	if(m_env_thread)
-		m_env_thread->join();
 
 	infostream<<"Server: Threads stopped"<<std::endl;
 }
@@ -875,12 +864,23 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 	ZoneScoped;
 	auto framemarker = FrameMarker("Server::AsyncRunStep()-frame").started();
 
+	auto &recorder = tick_recorder::instance();
+	if (recorder.takeDumpRequest()) {
+		for (const auto format : {"chrome", "collapsed"}) {
+			const auto path = recorder.dump(m_path_world, format);
+			actionstream << "Tick profile written to "
+						 << (path.empty() ? "(failed)" : path) << std::endl;
+		}
+	}
+	recorder.beginStep();
+	tick_recorder::scope tick_scope("Server step");
+
 	if (!m_async_fatal_error.get().empty()) {
 		infostream << "Refusing server step in error state" << std::endl;
 		return;
 	}
 
-	if (!m_sendblocks_thead)
+	if (!m_more_threads)
 	{
 		TimeTaker timer_step("Server step: SendBlocks");
 		// Send blocks to clients
@@ -1171,50 +1171,69 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 		{
 			ClientInterface::AutoLock clientlock(m_clients);
 			const auto &clients = m_clients.getClientList();
-			// Route data to every client
-#if MINETEST_PROTO
-			std::string reliable_data, unreliable_data;
-#endif
-			const auto uptime = getUptime();
-			for (const auto &client : clients) {
+
+			// Per client buffers, filled by going through the peers which
+			// know each object instead of checking every object for every client
+			struct RoutedMessages
+			{
+				RemoteClient *client;
+				PlayerSAO *player;
 #if MINETEST_PROTO
-				reliable_data.clear();
-				unreliable_data.clear();
+				std::string reliable_data, unreliable_data;
 #else
-				ActiveObjectMessages reliable_data;
-				ActiveObjectMessages unreliable_data;
+				ActiveObjectMessages reliable_data, unreliable_data;
 #endif
-				//RemoteClient *client = client_it.second;
-				PlayerSAO *player = getPlayerSAO(client.second->peer_id);
-				// Go through all objects in message buffer
-				for (const auto &buffered_message : buffered_messages) {
-					// If object does not exist or is not known by client, skip it
-					u16 id = buffered_message.first;
-					ServerActiveObject *sao = m_env->getActiveObject(id);
-					if (!sao || client.second->m_known_objects.find(id) == client.second->m_known_objects.end())
-						continue;
+			};
+			std::unordered_map<session_t, RoutedMessages> routed;
+			routed.reserve(clients.size());
+			for (const auto &client : clients) {
+				routed.emplace(client.first,
+						RoutedMessages{client.second.get(),
+								getPlayerSAO(client.second->peer_id), {}, {}});
+			}
+			// reused for every object
+			std::vector<RoutedMessages *> targets;
+
+			const auto uptime = getUptime();
+			// Go through all objects in message buffer
+			for (const auto &buffered_message : buffered_messages) {
+				// If object does not exist, skip it
+				u16 id = buffered_message.first;
+				ServerActiveObject *sao = m_env->getActiveObject(id);
+				if (!sao)
+					continue;
+
+				// Get message list of object
+				std::vector<ActiveObjectMessage>* list = buffered_message.second;
+
+				// only collect under the lock, the client checks lock more
+				targets.clear();
+				sao->forEachKnownBy([&](u16 peer_id) {
+					if (const auto it = routed.find(peer_id); it != routed.end())
+						targets.emplace_back(&it->second);
+				});
+				for (auto *target : targets) {
+					auto &[client, player, reliable_data, unreliable_data] = *target;
 
-					// Get message list of object
-					std::vector<ActiveObjectMessage>* list = buffered_message.second;
 					// Go through every message
 					for (const ActiveObjectMessage &aom : *list) {
 						// Send position updates to players who do not see the attachment
 						if (aom.datastring[0] == AO_CMD_UPDATE_POSITION) {
-							if (sao->getId() == player->getId())
+							if (!player || sao->getId() == player->getId())
 								continue;
 
 							// Do not send position updates for attached players
 							// as long the parent is known to the client
 							ServerActiveObject *parent = sao->getParent();
-							if (parent && client.second->m_known_objects.find(parent->getId()) !=
-									client.second->m_known_objects.end())
+							if (parent && client->m_known_objects.find(parent->getId()) !=
+									client->m_known_objects.end())
 								continue;
 
 							// Limit position packets for far objects
 							constexpr static auto max_seconds_skip = 30;
 							auto &[last_time, last_dist] =
-									client.second->m_objects_last_pos_sent[id];
-						
+									client->m_objects_last_pos_sent[id];
+
 							if (aom.skip_by_pos && last_time && last_time + max_seconds_skip > uptime) {
 								int32_t dist = aom.skip_by_pos.value().getDistanceFrom(
 														player->getBasePosition()) /
@@ -1257,16 +1276,19 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 #endif
 					}
 				}
-				/*
-					reliable_data and unreliable_data are now ready.
-					Send them.
-				*/
-				if (!reliable_data.empty()) {
-					SendActiveObjectMessages(client.second->peer_id, reliable_data);
+			}
+
+			/*
+				reliable_data and unreliable_data are now ready.
+				Send them, one packet of each kind per client.
+			*/
+			for (const auto &[peer_id, messages] : routed) {
+				if (!messages.reliable_data.empty()) {
+					SendActiveObjectMessages(peer_id, messages.reliable_data);
 				}
 
-				if (!unreliable_data.empty()) {
-					SendActiveObjectMessages(client.second->peer_id, unreliable_data, false);
+				if (!messages.unreliable_data.empty()) {
+					SendActiveObjectMessages(peer_id, messages.unreliable_data, false);
 				}
 			}
 		}
@@ -2623,8 +2645,11 @@ void Server::SendActiveObjectRemoveAdd(RemoteClient *client, PlayerSAO *playersa
 
 		// Remove from known objects
 		client->m_known_objects.erase(id);
-		if (obj && obj->m_known_by_count > 0)
-			obj->m_known_by_count--;
+		if (obj) {
+			obj->removeKnownBy(client->peer_id);
+			if (obj->m_known_by_count > 0)
+				obj->m_known_by_count--;
+		}
 	}
 
 	// Note: Do yet NOT stop or remove object-attached sounds where the object goes out
@@ -2658,6 +2683,7 @@ void Server::SendActiveObjectRemoveAdd(RemoteClient *client, PlayerSAO *playersa
 		// Add to known objects
 		client->m_known_objects.insert(id);
 		obj->m_known_by_count++;
+		obj->addKnownBy(client->peer_id);
 	}
 
 #if MINETEST_PROTO
@@ -2967,6 +2993,20 @@ void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
 		(*cache)[{block->getPos(), ver}] = std::move(s);
 }
 
+void Server::SendBlockDataNoLock(session_t peer_id, const SerializedBlock &block,
+		u16 net_proto_version)
+{
+	NetworkPacket pkt(TOCLIENT_BLOCKDATA,
+			sizeof_v3pos(net_proto_version) + block.data->size() +
+					block.network_specific.size(),
+			peer_id, net_proto_version);
+	pkt << block.pos;
+	pkt.putRawString(*block.data);
+	pkt.putRawString(block.network_specific);
+	pkt << block.step;
+	Send(&pkt);
+}
+
 #endif
 
 int Server::SendBlocks(float dtime)
@@ -2976,7 +3016,7 @@ int Server::SendBlocks(float dtime)
 	std::vector<PrioritySortedBlockTransfer> queue;
 
 	int total = 0;
-	u32 total_sending = 0, unique_clients = 0;
+	const auto now_ms = porting::getTimeMs();
 
 	{
 		ScopeProfiler sp2(g_profiler, "Server::SendBlocks(): Collect list");
@@ -2993,19 +3033,19 @@ int Server::SendBlocks(float dtime)
 			if (!client)
 				continue;
 
-			//total_sending += client->getSendingCount();
-			const auto old_count = queue.size();
+			client->m_send_window.update(now_ms);
 			if (client->net_proto_version_fm) {
 				total += client->GetNextBlocksFm(m_env, m_emerge.get(), dtime, queue,
 						m_uptime_counter->get() + m_env->m_game_time_start, max_ms);
 			} else {
 				total += client->GetNextBlocks(m_env, m_emerge.get(), dtime, queue, max_ms);
 			}
-			//total_sending += queue.size();
-			unique_clients += queue.size() > old_count ? 1 : 0;
 		}
 	}
 
+	if (queue.empty())
+		return total;
+
 	// Sort.
 	// Lowest priority number comes first.
 	// Lowest is most important.
@@ -3013,49 +3053,126 @@ int Server::SendBlocks(float dtime)
 
 	ClientInterface::AutoLock clientlock(m_clients);
 
-	// Maximal total count calculation
-	// The per-client block sends is halved with the maximal online users
-	u32 max_blocks_to_send = (m_env->getPlayerCount() + g_settings->getU32("max_users")) *
-		g_settings->getU32("max_simultaneous_block_sends_per_client") / 4 + 1;
+	/*
+		Serialize and compress every selected block once per serialization
+		version on the job workers, then send each client its blocks batched
+	*/
+	struct peer_blocks
+	{
+		RemoteClient *client;
+		std::vector<const SerializedBlock *> blocks;
+	};
+	std::vector<SerializedBlock> serialized;
+	std::unordered_map<std::pair<v3bpos_t, u16>, size_t, SBCHash> serialized_index;
+	// in priority order of the first block of each peer
+	std::vector<peer_blocks> peers;
+	std::unordered_map<session_t, size_t> peers_index;
+	// peer, serialized, delta base version
+	std::vector<std::tuple<size_t, size_t, uint64_t>> to_send;
 
-	ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Send to clients");
-	Map &map = m_env->getMap();
+	for (const PrioritySortedBlockTransfer &block_to_send : queue) {
+		RemoteClient *client = m_clients.lockedGetClientNoEx(block_to_send.peer_id,
+				CS_Active);
+		if (!client)
+			continue;
 
-	SerializedBlockCache cache, *cache_ptr = nullptr;
-	if (unique_clients > 1) {
-		// caching is pointless with a single client
-		cache_ptr = &cache;
+		const auto [peer, peer_new] =
+				peers_index.emplace(block_to_send.peer_id, peers.size());
+		if (peer_new)
+			peers.push_back({client, {}});
+		// serialization version, bit 8 for the map zstd dictionary
+		const u16 form = client->serialization_version |
+						 (client->net_zstd_dictionary ? 0x100 : 0);
+		const auto [block, block_new] = serialized_index.emplace(
+				std::make_pair(block_to_send.pos, form), serialized.size());
+		if (block_new)
+			serialized.emplace_back().pos = block_to_send.pos;
+		uint64_t delta_base = 0;
+		if (m_block_snapshots && client->net_proto_version_fm >= 6) {
+			delta_base = client->m_block_versions.get(block_to_send.pos);
+			auto &bases = serialized[block->second].delta_bases;
+			if (delta_base && !CONTAINS(bases, delta_base))
+				bases.emplace_back(delta_base);
+		}
+		to_send.emplace_back(peer->second, block->second, delta_base);
 	}
 
-	for (const PrioritySortedBlockTransfer &block_to_send : queue) {
-/*
-		if (total_sending >= max_blocks_to_send)
-			break;
-*/
+	{
+		ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Serialize");
+		std::vector<job_scheduler::task_func> tasks;
+		tasks.reserve(serialized_index.size());
+		for (const auto &[key, index] : serialized_index) {
+			tasks.emplace_back([this, &serialized, pos = key.first, form = key.second,
+										index = index]() {
 #if !ENABLE_THREADS
-		const auto lock = m_env->getServerMap().m_nothread_locker.lock_shared_rec();
+				const auto nothread_lock =
+						m_env->getServerMap().m_nothread_locker.lock_shared_rec();
 #endif
+				const auto block = m_env->getMap().getBlock(pos);
+				if (!block)
+					return;
+				const auto lock = block->try_lock_shared_rec();
+				if (!lock->owns_lock())
+					return;
+				serializeBlockNet(block.get(), form & 0xff, serialized[index], form & 0x100);
+			});
+		}
+		m_jobs->run_tasks(tasks);
+	}
+	if (m_serialized_block_cache) {
+		g_profiler->avg("Server: serialized block cache [MB]",
+				m_serialized_block_cache->bytes() >> 20);
+	}
 
-		MapBlock *block = map.getBlockNoCreateNoEx(block_to_send.pos);
-		if (!block)
-			continue;
+	ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Send to clients");
 
-		RemoteClient *client = m_clients.lockedGetClientNoEx(block_to_send.peer_id,
-				CS_Active);
-		if (!client)
+	// serialized with data replaced by a delta, stable addresses
+	std::deque<SerializedBlock> deltas;
+	for (const auto &[peer, index, delta_base] : to_send) {
+		const auto &block = serialized[index];
+		if (!block.data)
 			continue;
-
-		{
-		const auto lock = block->try_lock_shared_rec();
-		if (!lock->owns_lock())
+		const auto delta = std::find_if(block.deltas.begin(), block.deltas.end(),
+				[&](const auto &d) { return d.first == delta_base; });
+		if (!delta_base || delta == block.deltas.end()) {
+			peers[peer].blocks.emplace_back(&block);
 			continue;
-
-		SendBlockNoLock(block_to_send.peer_id, block, client->serialization_version,
-				client->net_proto_version, cache_ptr);
 		}
-
-		client->SentBlock(block_to_send.pos, m_uptime_counter->get() + m_env->m_game_time_start);
-		//total_sending++;
+		auto &block_delta = deltas.emplace_back();
+		block_delta.pos = block.pos;
+		block_delta.data = delta->second;
+		block_delta.heat = block.heat;
+		block_delta.humidity = block.humidity;
+		block_delta.step = block.step;
+		block_delta.version = block.version;
+		block_delta.delta_base = delta_base;
+		peers[peer].blocks.emplace_back(&block_delta);
+	}
+	g_profiler->add("Server: block deltas sent", deltas.size());
+
+	// Blocks per TOCLIENT_BLOCKDATAS_FM packet
+	constexpr size_t BLOCKDATAS_BATCH_MAX = 32;
+	const auto uptime = m_uptime_counter->get() + m_env->m_game_time_start;
+	for (const auto &[client, blocks] : peers) {
+		if (blocks.empty())
+			continue;
+		if (client->net_proto_version_fm >= 4) {
+			for (size_t i = 0; i < blocks.size(); i += BLOCKDATAS_BATCH_MAX) {
+				SendBlocksFm(client->peer_id,
+						{blocks.begin() + i,
+								blocks.begin() +
+										std::min(blocks.size(), i + BLOCKDATAS_BATCH_MAX)});
+			}
+		} else {
+			for (const auto *block : blocks)
+				SendBlockDataNoLock(client->peer_id, *block, client->net_proto_version);
+		}
+		for (const auto *block : blocks) {
+			client->SentBlock(block->pos, uptime);
+			if (client->net_proto_version_fm >= 6 && !block->step)
+				client->m_block_versions.sent(block->pos, block->version);
+		}
+		client->m_send_window.sent(blocks.size(), now_ms);
 	}
 	return total;
 }
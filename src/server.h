@@ -14,6 +14,7 @@
 
 #include "irr_v3d.h"
 #include "map.h"
+#include "fm_weather.h"
 #include "hud_element.h" // HudElementStat
 #include "gamedef.h"
 #include "content/subgames.h"
@@ -22,6 +23,8 @@
 #include "util/basic_macros.h"
 #include "util/metricsbackend.h"
 #include "server/clientiface.h"
+#include "server/fm_block_snapshots.h"
+#include "server/fm_serialized_block_cache.h"
 #include "threading/ordered_mutex.h"
 #include "translation.h"
 #include "sound_spec.h"
@@ -44,12 +47,7 @@
 #include <unordered_set>
 class Circuit;
 class Stat;
-class MapThread;
-class SendBlocksThread;
-class SendFarBlocksThread;
-class LiquidThread;
-class EnvThread;
-class AbmThread;
+class job_scheduler;
 class AbmWorldThread;
 class WorldMergeThread;
 class MapgenVoxelEarth;
@@ -862,8 +860,45 @@ friend MapgenVoxelEarth;
 	void SendActiveObjectMessages(
 			session_t peer_id, const ActiveObjectMessages &datas, bool reliable = true);
 public:
+	// Wire form of a block, made once per send round for all clients
+	struct SerializedBlock
+	{
+		v3bpos_t pos;
+		// serialize() output, nullptr if the block was not serialized
+		serialized_block_cache::data_ptr data;
+		// serializeNetworkSpecific() output, TOCLIENT_BLOCKDATA only
+		std::string network_specific;
+		weather::heat_t heat{};
+		weather::humidity_t humidity{};
+		block_step_t step{};
+		content_t content_only{CONTENT_IGNORE};
+		u8 content_only_param1{};
+		u8 content_only_param2{};
+		// MapBlock::getModifiedVersion() of data
+		uint64_t version{};
+		// Versions clients have, to make deltas against
+		std::vector<uint64_t> delta_bases;
+		// serializeDelta() output per base, when smaller than data
+		std::vector<std::pair<uint64_t, serialized_block_cache::data_ptr>> deltas;
+		// data is a delta against this version, 0 for the whole block
+		uint64_t delta_base{};
+	};
+	// Block should be locked, the compressed data comes from m_serialized_block_cache
+	// when the block did not change since its last serialization
+	// zstd_dictionary: compress with the map dictionary, see RemoteClient::net_zstd_dictionary
+	void serializeBlockNet(
+			MapBlock *block, u8 ver, SerializedBlock &out, bool zstd_dictionary = false);
+	std::unique_ptr<serialized_block_cache> m_serialized_block_cache;
+	// Bases of block deltas, nullptr if disabled
+	std::unique_ptr<block_snapshots> m_block_snapshots;
+
 	void SendBlockFm(session_t peer_id, MapBlockPtr block, u8 ver, u16 net_proto_version, SerializedBlockCache *cache = nullptr);
-	void SendBlocksFm(session_t peer_id, std::vector<MapBlockPtr> blocks, u8 ver, u16 net_proto_version, SerializedBlockCache *cache = nullptr);
+	void SendBlocksFm(session_t peer_id, std::vector<MapBlockPtr> blocks, u8 ver, u16 net_proto_version, SerializedBlockCache *cache = nullptr, bool zstd_dictionary = false);
+	// One TOCLIENT_BLOCKDATAS_FM packet
+	void SendBlocksFm(session_t peer_id, const std::vector<const SerializedBlock *> &blocks);
+	// One TOCLIENT_BLOCKDATA packet
+	void SendBlockDataNoLock(session_t peer_id, const SerializedBlock &block,
+			u16 net_proto_version);
 private:
 
 	float m_liquid_send_timer{};
@@ -893,12 +928,10 @@ friend MapgenVoxelEarth;
 
 	Stat stat;
 
-	std::unique_ptr<MapThread> m_map_thread;
-	std::unique_ptr<SendBlocksThread> m_sendblocks_thead;
-	std::unique_ptr<SendFarBlocksThread> m_sendfarblocks_thead;
-	std::unique_ptr<LiquidThread> m_liquid;
-	std::unique_ptr<EnvThread> m_env_thread;
-	std::unique_ptr<AbmThread> m_abm_thread;
+	// Map, SendBlocks, SendFarBlocks, Liquid, Env and Abm loops with more_threads,
+	// also runs parallel parts of them
+	std::unique_ptr<job_scheduler> m_jobs;
+	void addJobs();
 	std::unique_ptr<AbmWorldThread> m_abm_world_thread;
 	std::unique_ptr<WorldMergeThread> m_world_merge_thread;
 	// ==
@@ -927,6 +960,7 @@ friend MapgenVoxelEarth;
 	MetricCounterPtr m_packet_recv_counter;
 	MetricCounterPtr m_packet_recv_processed_counter;
 	MetricCounterPtr m_map_edit_event_counter;
+	MetricHistogramPtr m_block_send_latency;
 
 	// Particles to send this server step
 	// [playername] = list of params, empty playername for broadcast
@@ -943,6 +977,8 @@ friend MapgenVoxelEarth;
 MapDatabase *GetFarDatabase(MapDatabase *dbase, Map::far_dbases_t &far_dbases,
 		const std::string &savedir, block_step_t step);
 MapBlockPtr loadBlockNoStore(Map *smap, MapDatabase *dbase, const v3bpos_t &pos);
+// Block from database blob, not inserted into smap
+MapBlockPtr deSerializeBlockNoStore(Map *smap, const v3bpos_t &pos, const std::string &blob);
 // ==
 
 
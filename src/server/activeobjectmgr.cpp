@@ -63,6 +63,8 @@ void ActiveObjectMgr::clearIf(const std::function<bool(const ServerActiveObjectP
 			return;
 		for (const auto &id : objects_to_remove) {
 			m_active_objects.remove(id);
+			m_spatial_index.remove(id);
+			m_players.erase(id);
 		}
 		objects_to_remove.clear();
 	}
@@ -154,8 +156,11 @@ bool ActiveObjectMgr::registerObject(std::shared_ptr<ServerActiveObject> obj)
 	}
 
 	auto obj_id = obj->getId();
+	const bool is_player = obj->getType() == ACTIVEOBJECT_TYPE_PLAYER;
 	m_active_objects.put(obj_id, std::move(obj));
 	m_spatial_index.insert(pos.toArray(), obj_id);
+	if (is_player)
+		m_players.insert(obj_id);
 
 #if !NDEBUG
 	auto new_size = m_active_objects.size();
@@ -182,6 +187,7 @@ void ActiveObjectMgr::removeObject(u16 id)
 				<< "id=" << id << " not found" << std::endl;
 	} else {
 		m_spatial_index.remove(id);
+		m_players.erase(id);
 	}
 }
 
@@ -205,18 +211,16 @@ void ActiveObjectMgr::updateObjectPos(u16 id, v3opos_t pos)
 	// HACK defensively only update if we already know the object,
 	// otherwise we're still waiting to be inserted into the index
 	// (or have already been removed).
-	if (m_active_objects.get(id)){
+	if (m_active_objects.get(id)) {
 		m_spatial_index.update(pos.toArray(), id);
 	}
 }
 
-#if 0
-
-void ActiveObjectMgr::getObjectsInsideRadius(v3f pos, float radius,
+void ActiveObjectMgr::getObjectsInsideRadius(v3opos_t pos, float radius,
 		std::vector<ServerActiveObjectPtr> &result,
 		std::function<bool(const ServerActiveObjectPtr &obj)> include_obj_cb)
 {
-	float r_squared = radius * radius;
+	opos_t r_squared = radius * radius;
 	m_spatial_index.rangeQuery((pos - v3opos_t(radius)).toArray(), (pos + v3opos_t(radius)).toArray(), [&](auto objPos, u16 id) {
 		if (v3opos_t(objPos).getDistanceFromSQ(pos) > r_squared)
 			return;
@@ -242,44 +246,6 @@ void ActiveObjectMgr::getObjectsInArea(const aabb3o &box,
 	});
 }
 
-#endif
-
-// Wait for fix ^ and delete:
-void ActiveObjectMgr::getObjectsInsideRadius(v3opos_t pos, float radius,
-		std::vector<ServerActiveObjectPtr> &result,
-		std::function<bool(const ServerActiveObjectPtr &obj)> include_obj_cb)
-{
-	float r2 = radius * radius;
-	for (const auto &activeObject : m_active_objects.iter()) {
-		const auto obj = activeObject.second;
-		if (!obj)
-			continue;
-		const auto &objectpos = obj->getBasePosition();
-		if (objectpos.getDistanceFromSQ(pos) > r2)
-			continue;
-
-		if (!include_obj_cb || include_obj_cb(obj))
-			result.push_back(obj);
-	}
-}
-
-void ActiveObjectMgr::getObjectsInArea(const aabb3o &box,
-		std::vector<ServerActiveObjectPtr> &result,
-		std::function<bool(const ServerActiveObjectPtr &obj)> include_obj_cb)
-{
-	for (auto &activeObject : m_active_objects.iter()) {
-		const auto obj = activeObject.second;
-		if (!obj)
-			continue;
-		const auto &objectpos = obj->getBasePosition();
-		if (!box.isPointInside(objectpos))
-			continue;
-
-		if (!include_obj_cb || include_obj_cb(obj))
-			result.push_back(obj);
-	}
-}
-
 void ActiveObjectMgr::getAddedActiveObjectsAroundPos(
 		v3opos_t player_pos, const std::string &player_name,
 		f32 radius, f32 player_radius,
@@ -297,28 +263,48 @@ void ActiveObjectMgr::getAddedActiveObjectsAroundPos(
 	}
 #endif
 
+	/*
+		Take the candidates from the spatial index instead of going through
+		the whole object list: players (their radius can be unlimited) and
+		objects in the cube around player_pos.
+	*/
+	std::vector<u16> candidates;
+	{
+		const auto lock = m_players.lock_shared_rec();
+		candidates.assign(m_players.full_type::begin(), m_players.full_type::end());
+	}
+	const auto players_count = candidates.size();
+	m_spatial_index.rangeQuery((player_pos - v3opos_t(radius)).toArray(),
+			(player_pos + v3opos_t(radius)).toArray(),
+			[&](auto, u16 id) { candidates.emplace_back(id); });
+
 	int count = 0;
 	/*
-		Go through the object list,
+		Go through the candidates,
 		- discard removed/deactivated objects,
 		- discard objects that are too far away,
 		- discard objects that are found in current_objects,
 		- discard objects that are not observed by the player.
 		- add remaining objects to added_objects
 	*/
-	for (auto &ao_it : m_active_objects.iter()) {
-		u16 id = ao_it.first;
+	for (size_t i = 0; i < candidates.size(); ++i) {
+		const u16 id = candidates[i];
 
 		// Get object
-		ServerActiveObject *object = ao_it.second.get();
+		const auto object = m_active_objects.get(id);
 		if (!object)
 			continue;
 
 		if (object->isGone())
 			continue;
 
+		const bool is_player = object->getType() == ACTIVEOBJECT_TYPE_PLAYER;
+		// Players near the position are in both lists
+		if (is_player && i >= players_count)
+			continue;
+
 		f32 distance_f = object->getBasePosition().getDistanceFrom(player_pos);
-		if (object->getType() == ACTIVEOBJECT_TYPE_PLAYER) {
+		if (is_player) {
 			// Discard if too far
 			if (distance_f > player_radius && player_radius != 0)
 				continue;
@@ -336,7 +322,7 @@ void ActiveObjectMgr::getAddedActiveObjectsAroundPos(
 		added_objects.push_back(id);
 
 		if (++count > 10 && !current_objects.empty())
-			break;   
+			break;
 	}
 }
 
@@ -12,11 +12,15 @@
 #include "../activeobjectmgr.h"
 #include "serveractiveobject.h"
 #include "util/k_d_tree.h"
+#include "threading/concurrent_set.h"
+
+class TestServerActiveObjectMgr;
 
 namespace server
 {
 class ActiveObjectMgr final : public ::ActiveObjectMgr<ServerActiveObject>
 {
+	friend class ::TestServerActiveObjectMgr;
 //fm:
 public:
 	void deferDelete(const ServerActiveObjectPtr& obj);
@@ -50,32 +54,8 @@ class ActiveObjectMgr final : public ::ActiveObjectMgr<ServerActiveObject>
 			std::vector<u16> &added_objects);
 
 private:
-	// k_d_tree::DynamicKdTrees<3, f32, u16> m_spatial_index;
-
-	// tmp:
-	template <uint8_t Dim, class Component, class Id>
-	class FakeDynamicKdTrees
-	{
-		using Tree = k_d_tree::KdTree<Dim, Component, Id>;
-
-	public:
-		using Point = typename Tree::Point;
-
-		void insert(const std::array<Component, Dim> &point, Id id) {}
-
-		void remove(Id id) {}
-
-		void update(const Point &newPos, Id id) {}
-
-		template <typename F>
-		void rangeQuery(const Point &min, const Point &max, const F &cb) const
-		{
-		}
-
-		size_t size() const { return 0; }
-	};
-
-	FakeDynamicKdTrees<3, opos_t, u16> m_spatial_index;
-	// ===
+	k_d_tree::DynamicKdTrees<3, opos_t, u16> m_spatial_index;
+	// fm: ids of player objects, their send range can be unlimited
+	concurrent_set<u16> m_players;
 };
 } // namespace server
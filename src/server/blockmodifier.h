@@ -107,6 +107,11 @@ class ABMHandler
 	std::list<std::vector<ActiveABM> *> m_aabms_list;
 	bool m_aabms_empty{true};
 
+	// fm: per content_t, blocks without any m_active content are skipped
+	std::vector<bool> m_active;
+	std::vector<int> m_hot;
+	std::vector<bool> m_water;
+
 public:
 	ABMHandler(std::vector<ABMWithState> &abms,
 		float dtime_s, ServerEnvironment *env,
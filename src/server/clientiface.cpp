@@ -58,6 +58,10 @@ const char *ClientInterface::state2Name(ClientState state)
 
 RemoteClient::RemoteClient() :
 	serialization_version(SER_FMT_VER_INVALID),
+	m_send_window(std::max<u16>(1,
+			g_settings->getU16("max_simultaneous_block_sends_per_client")),
+		std::max<u16>(1,
+			g_settings->getU16("max_simultaneous_block_sends_per_client")) * 8),
 	m_pending_serialization_version(SER_FMT_VER_INVALID),
 	m_max_simul_sends(std::max<u16>(1,
 		g_settings->getU16("max_simultaneous_block_sends_per_client"))),
@@ -122,8 +126,8 @@ int RemoteClient::GetNextBlocks (
 	if (!sao)
 		return 0;
 
-	// Won't send anything if already sending
-	if (m_blocks_sending.size() >= m_max_simul_sends) {
+	// Won't send anything if the send window is full
+	if (!m_send_window.available()) {
 		//infostream<<"Not sending any blocks, Queue full."<<std::endl;
 		return 0;
 	}
@@ -151,7 +155,7 @@ int RemoteClient::GetNextBlocks (
 	if (sao->getCameraInverted())
 		camera_dir = -camera_dir;
 
-	u16 max_simul_sends_usually = m_max_simul_sends;
+	u32 max_simul_sends_usually = m_send_window.limit();
 
 	/*
 		Decrease send rate if player is building stuff.
@@ -162,13 +166,14 @@ int RemoteClient::GetNextBlocks (
 	m_time_from_building += dtime;
 	if (m_time_from_building < m_min_time_from_building) {
 		max_simul_sends_usually *= LIMITED_BLOCK_SENDS_FACTOR;
-		max_simul_sends_usually = MYMAX(1, max_simul_sends_usually);
+		max_simul_sends_usually = MYMAX(1u, max_simul_sends_usually);
 	}
 
 	/*
 		Number of blocks sending + number of blocks selected for sending
 	*/
-	u32 num_blocks_selected = m_blocks_sending.size();
+	const u32 num_blocks_sending = m_send_window.inFlight();
+	u32 num_blocks_selected = num_blocks_sending;
 
 	/*
 		next time d will be continued from the d from which the nearest
@@ -271,10 +276,10 @@ int RemoteClient::GetNextBlocks (
 				Also, don't send blocks that are already flying.
 			*/
 
-			u16 max_simul_dynamic = max_simul_sends_usually;
+			u32 max_simul_dynamic = max_simul_sends_usually;
 			// If block is very close, allow full maximum
 			if (d <= BLOCK_ALWAYS_SEND_MAX_D)
-				max_simul_dynamic = m_max_simul_sends;
+				max_simul_dynamic = std::max<u32>(m_send_window.limit(), m_max_simul_sends);
 
 			/*
 				Do not go over max mapgen limit
@@ -417,7 +422,7 @@ int RemoteClient::GetNextBlocks (
 		// if the distance has changed, clear the occlusion cache
 		m_blocks_occ.clear();
 	}
-	return num_blocks_selected;
+	return num_blocks_selected - num_blocks_sending;
 }
 
 /*
@@ -486,6 +491,7 @@ void RemoteClient::SetBlocksNotSent(const std::vector<v3bpos_t> &blocks, bool lo
 
 void RemoteClient::SetBlockDeleted(const v3bpos_t & p) {
 	m_blocks_sent.erase(p);
+	m_block_versions.erase(p);
 }
 
 void RemoteClient::notifyEvent(ClientStateEvent event)
@@ -938,7 +944,10 @@ void ClientInterface::DeleteClient(session_t peer_id)
 		// Get object
 		ServerActiveObject* obj = m_env->getActiveObject(id, true);
 
-		if(obj && obj->m_known_by_count > 0)
+		if (!obj)
+			continue;
+		obj->removeKnownBy(peer_id);
+		if (obj->m_known_by_count > 0)
 			obj->m_known_by_count--;
 	}
 	}
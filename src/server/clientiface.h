@@ -13,6 +13,8 @@
 #include "util/unordered_map_hash.h"
 #include <atomic>
 #include "msgpack_fix.h"
+#include "server/fm_block_send_window.h"
+#include "server/fm_block_snapshots.h"
 
 
 #include "irr_v3d.h"                   // for irrlicht datatypes
@@ -235,6 +237,8 @@ class RemoteClient
 
 	// fm:
 	u16 net_proto_version_fm{};
+	// got the map zstd dictionary with TOCLIENT_FREEMINER_INIT
+	bool net_zstd_dictionary{};
 	//std::atomic_int m_nearest_unsent_reset {0};
 	std::atomic_uint wanted_range{10};
 	std::atomic_bool range_all{};
@@ -259,6 +263,10 @@ class RemoteClient
 	std::mutex far_blocks_requested_mutex;
 	int GetNextBlocksFm(ServerEnvironment *env, EmergeManager *emerge, float dtime,
 			std::vector<PrioritySortedBlockTransfer> &dest, double m_uptime, u64 max_ms);
+	// Blocks on the wire, acked by GOTBLOCKS
+	block_send_window m_send_window;
+	// Near block versions the client has, bases of block deltas
+	block_client_versions m_block_versions;
 	uint32_t SendFarBlocks(const int32_t uptime);
 	// ==
 
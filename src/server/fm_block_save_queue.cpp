@@ -0,0 +1,240 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_block_save_queue.h"
+
+#include <sstream>
+#include <vector>
+
+#include "database/database.h"
+#include "log.h"
+#include "porting.h"
+#include "profiler.h"
+#include "serialization.h"
+#include "servermap.h"
+
+block_save_queue::block_save_queue(MapDatabaseAccessor &db, size_t threads,
+		size_t max_queued, int compression_level, MetricsBackend *mb,
+		u32 zstd_dictionary) :
+		thread_vector{"MapSave", 0},
+		m_db{db}, m_max_queued{std::max<size_t>(max_queued, 1)},
+		m_compression_level{compression_level}, m_zstd_dictionary{zstd_dictionary}
+{
+	m_queued_gauge = mb->addGauge(
+			"minetest_map_save_queue_blocks", "Number of blocks waiting to be written");
+	m_stall_counter = mb->addCounter("minetest_map_save_stall_time",
+			"Time spent waiting for a full save queue (in microseconds)");
+	m_batch_counter = mb->addCounter(
+			"minetest_map_save_batches", "Number of save queue transactions");
+	m_failed_counter = mb->addCounter(
+			"minetest_map_save_failed_blocks", "Number of failed block writes, they are retried");
+	start(std::max<size_t>(threads, 1) + 1);
+}
+
+block_save_queue::~block_save_queue()
+{
+	// the threads still empty the queue, failing batches are not retried forever
+	{
+		const auto lock = std::lock_guard(m_mutex);
+		request_stop = true;
+	}
+	m_changed.notify_all();
+	flush();
+	join();
+}
+
+void block_save_queue::push(v3bpos_t pos, u8 version, std::string &&raw)
+{
+	auto lock = std::unique_lock(m_mutex);
+	if (const auto it = m_index.find(pos); it != m_index.end() && !it->second->taken) {
+		it->second->version = version;
+		it->second->raw = std::move(raw);
+		return;
+	}
+
+	// backpressure
+	if (m_next_seq - m_written_seq >= m_max_queued) {
+		const auto start_us = porting::getTimeUs();
+		m_changed.wait(lock, [&] { return m_next_seq - m_written_seq < m_max_queued; });
+		m_stall_counter->increment(porting::getTimeUs() - start_us);
+	}
+
+	auto i = std::make_shared<item>();
+	i->pos = pos;
+	i->version = version;
+	i->seq = m_next_seq++;
+	i->raw = std::move(raw);
+	m_index[pos] = i;
+	m_compress.emplace_back(std::move(i));
+	m_queued_gauge->set(m_next_seq - m_written_seq);
+	lock.unlock();
+	m_changed.notify_all();
+}
+
+bool block_save_queue::get(v3bpos_t pos, std::string &data)
+{
+	item copy;
+	{
+		const auto lock = std::lock_guard(m_mutex);
+		const auto it = m_index.find(pos);
+		if (it == m_index.end())
+			return false;
+		if (!it->second->data.empty()) {
+			data = it->second->data;
+			return true;
+		}
+		copy.version = it->second->version;
+		copy.raw = it->second->raw;
+	}
+	compressItem(copy, data);
+	return true;
+}
+
+void block_save_queue::flush()
+{
+	auto lock = std::unique_lock(m_mutex);
+	const auto seq = m_next_seq;
+	m_changed.wait(lock, [&] { return m_written_seq >= seq; });
+}
+
+size_t block_save_queue::size()
+{
+	const auto lock = std::lock_guard(m_mutex);
+	return m_next_seq - m_written_seq;
+}
+
+void block_save_queue::compressItem(const item &i, std::string &data) const
+{
+	std::ostringstream os(std::ios_base::binary);
+	os.write(reinterpret_cast<const char *>(&i.version), 1);
+	compress(i.raw, os, i.version, m_compression_level, m_zstd_dictionary);
+	data = os.str();
+}
+
+void *block_save_queue::run()
+{
+	if (m_next_role++)
+		compressLoop();
+	else
+		writeLoop();
+	return nullptr;
+}
+
+void block_save_queue::compressLoop()
+{
+	auto lock = std::unique_lock(m_mutex);
+	while (true) {
+		m_changed.wait(lock, [&] { return request_stop || !m_compress.empty(); });
+		if (m_compress.empty())
+			return;
+		auto i = std::move(m_compress.front());
+		m_compress.pop_front();
+		i->taken = true;
+		lock.unlock();
+
+		std::string data;
+		compressItem(*i, data);
+
+		lock.lock();
+		i->data = std::move(data);
+		m_compressed.emplace(i->seq, std::move(i));
+		m_changed.notify_all();
+	}
+}
+
+void block_save_queue::writeLoop()
+{
+	std::vector<item_ptr> batch;
+	std::vector<std::pair<v3bpos_t, std::string_view>> blocks;
+	int stop_retries = 0;
+	auto lock = std::unique_lock(m_mutex);
+	while (true) {
+		// in push() order: wait for the oldest one
+		m_changed.wait(lock, [&] {
+			return (request_stop && m_written_seq == m_next_seq) ||
+				   (!m_compressed.empty() &&
+						   m_compressed.begin()->first == m_written_seq);
+		});
+		if (m_compressed.empty())
+			return;
+		for (auto it = m_compressed.begin(); it != m_compressed.end() &&
+											 it->first == m_written_seq + batch.size() &&
+											 batch.size() < WRITE_BATCH_MAX;) {
+			batch.emplace_back(std::move(it->second));
+			it = m_compressed.erase(it);
+		}
+		lock.unlock();
+
+		size_t failed = 0;
+		{
+			ScopeProfiler sp(g_profiler, "Map save queue: write batch", SPT_AVG,
+					PRECISION_MICRO);
+			blocks.clear();
+			for (const auto &i : batch)
+				blocks.emplace_back(i->pos, i->data);
+			MutexAutoLock dblock(m_db.mutex);
+			bool in_transaction = false;
+			try {
+				m_db.dbase->beginSave();
+				in_transaction = true;
+				if (!m_db.dbase->saveBlocks(blocks))
+					failed = batch.size();
+				in_transaction = false;
+				m_db.dbase->endSave();
+			} catch (const std::exception &e) {
+				errorstream << "Map save queue: failed to write " << batch.size()
+							<< " blocks: " << e.what() << std::endl;
+				failed = batch.size();
+			}
+			// a throwing write leaves the transaction open, the next
+			// beginSave() would fail forever. The batch is written again.
+			if (in_transaction) {
+				try {
+					m_db.dbase->endSave();
+				} catch (const std::exception &e) {
+					errorstream << "Map save queue: failed to end transaction: "
+								<< e.what() << std::endl;
+				}
+			}
+		}
+		m_batch_counter->increment();
+		if (failed)
+			m_failed_counter->increment(failed);
+
+		lock.lock();
+		if (failed) {
+			if (!request_stop || ++stop_retries <= STOP_RETRY_MAX) {
+				// keep it in order, newer data of the blocks is pushed after it
+				for (auto &i : batch)
+					m_compressed.emplace(i->seq, std::move(i));
+				batch.clear();
+				m_changed.wait_for(lock, retry_interval, [&] { return request_stop.load(); });
+				continue;
+			}
+			errorstream << "Map save queue: giving up writing " << batch.size()
+						<< " blocks" << std::endl;
+		}
+		for (const auto &i : batch) {
+			if (const auto it = m_index.find(i->pos); it != m_index.end() && it->second == i)
+				m_index.erase(it);
+		}
+		m_written_seq += batch.size();
+		batch.clear();
+		m_queued_gauge->set(m_next_seq - m_written_seq);
+		m_changed.notify_all();
+	}
+}
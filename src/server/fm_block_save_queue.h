@@ -0,0 +1,121 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "irr_v3d.h"
+#include "threading/thread_vector.h"
+#include "util/metricsbackend.h"
+
+struct MapDatabaseAccessor;
+
+/*
+Write-behind saving of blocks.
+
+The saving thread hands over the uncompressed disk form of a block
+(MapBlock::serialize with compressed = false), worker threads compress it,
+one writer thread commits batches in one database transaction, in the order
+of push(). A block pushed again before a worker took it is replaced.
+
+Reads of the database must look into the queue first, see
+MapDatabaseAccessor::loadBlock. push() waits while max_queued blocks are
+not written yet.
+
+A batch that failed to write stays queued and is written again after
+retry_interval. On destruction it is given up after a few more tries.
+*/
+
+class block_save_queue : public thread_vector
+{
+public:
+	// threads: compressing threads, the writer is one more
+	// zstd_dictionary: see addZstdDictionary
+	block_save_queue(MapDatabaseAccessor &db, size_t threads, size_t max_queued,
+			int compression_level, MetricsBackend *mb, u32 zstd_dictionary = 0);
+	~block_save_queue();
+
+	void push(v3bpos_t pos, u8 version, std::string &&raw);
+
+	// Disk form of the newest not written data of pos, false if none
+	bool get(v3bpos_t pos, std::string &data);
+
+	// Wait until everything pushed before is written
+	void flush();
+
+	// Blocks pushed and not written yet
+	size_t size();
+
+	void *run() override;
+
+	std::chrono::milliseconds retry_interval{1000};
+
+private:
+	struct item
+	{
+		v3bpos_t pos;
+		u8 version;
+		uint64_t seq;
+		// taken by a worker, raw does not change anymore
+		bool taken = false;
+		std::string raw;
+		// disk form: version and compressed raw
+		std::string data;
+	};
+	using item_ptr = std::shared_ptr<item>;
+
+	static constexpr size_t WRITE_BATCH_MAX = 256;
+	// tries of a failing batch while stopping
+	static constexpr int STOP_RETRY_MAX = 3;
+
+	void compressItem(const item &i, std::string &data) const;
+	void compressLoop();
+	void writeLoop();
+
+	MapDatabaseAccessor &m_db;
+	const size_t m_max_queued;
+	const int m_compression_level;
+	const u32 m_zstd_dictionary;
+
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	// waiting for a worker
+	std::deque<item_ptr> m_compress;
+	// compressed, waiting for the writer, by seq
+	std::map<uint64_t, item_ptr> m_compressed;
+	// newest not written item of every pos
+	std::unordered_map<v3bpos_t, item_ptr> m_index;
+	uint64_t m_next_seq = 0;
+	// all seq below are written
+	uint64_t m_written_seq = 0;
+	std::atomic_size_t m_next_role{0};
+
+	MetricGaugePtr m_queued_gauge;
+	MetricCounterPtr m_stall_counter;
+	MetricCounterPtr m_batch_counter;
+	MetricCounterPtr m_failed_counter;
+};
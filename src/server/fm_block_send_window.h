@@ -0,0 +1,226 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+/*
+Adaptive count of blocks on the wire to one client.
+
+A block is in flight from sending until the client acks it with GOTBLOCKS.
+Acks come about in send order, so the age of the oldest unacked send is
+an RTT sample which includes queueing in the reliable channel too.
+
+Acks grow the window while the RTT stays near the lowest RTT seen:
+by every acked block below the threshold, by about one block per window
+of acked blocks above it. A grown RTT means blocks queue up on the way,
+the window shrinks by a quarter, at most once per RTT. The window never
+gets much over what the measured ack rate delivers in an RTT.
+Without acks for a few RTTs the blocks in flight are taken as lost.
+A client which does not ack for a while after its first send is not
+limited and its sends are not tracked, until it acks.
+*/
+
+class block_send_window
+{
+public:
+	static constexpr uint32_t MIN = 4;
+	// No acks for this long after the first send: the client does not ack
+	static constexpr uint64_t NO_ACKS_MS = 5000;
+	static constexpr uint64_t LOST_MIN_MS = 1000;
+	// RTT over 2 * min RTT + this means queueing
+	static constexpr uint64_t RTT_SLACK_MS = 20;
+	static constexpr uint64_t RATE_PERIOD_MS = 1000;
+
+	explicit block_send_window(uint32_t initial = 32, uint32_t max = 512) :
+			m_max{std::max(max, MIN)}, m_window(std::clamp(initial, MIN, m_max)),
+			m_threshold(m_max)
+	{
+	}
+
+	// Blocks allowed on the wire
+	uint32_t limit() const
+	{
+		const auto lock = std::lock_guard(m_mutex);
+		return m_no_acks ? m_max : m_window;
+	}
+
+	uint32_t inFlight() const
+	{
+		const auto lock = std::lock_guard(m_mutex);
+		return m_no_acks ? 0 : m_in_flight;
+	}
+
+	// Blocks which can be sent now
+	uint32_t available() const
+	{
+		const auto lock = std::lock_guard(m_mutex);
+		if (m_no_acks)
+			return m_max;
+		return m_in_flight < uint32_t(m_window) ? uint32_t(m_window) - m_in_flight : 0;
+	}
+
+	// Smoothed RTT in ms, 0 before the first ack
+	float rtt() const
+	{
+		const auto lock = std::lock_guard(m_mutex);
+		return m_rtt;
+	}
+
+	// Acked blocks per second while the window was in use
+	float ackRate() const
+	{
+		const auto lock = std::lock_guard(m_mutex);
+		return m_ack_rate;
+	}
+
+	void sent(uint32_t count, uint64_t now_ms)
+	{
+		if (!count)
+			return;
+		const auto lock = std::lock_guard(m_mutex);
+		if (!m_first_send_ms)
+			m_first_send_ms = now_ms;
+		if (m_no_acks)
+			return;
+		m_in_flight += count;
+		m_sends.push_back({count, now_ms});
+	}
+
+	// Returns the RTT sample in ms, negative if the ack did not match a send
+	float acked(uint32_t count, uint64_t now_ms)
+	{
+		const auto lock = std::lock_guard(m_mutex);
+		m_acked_total += count;
+		m_last_ack_ms = now_ms;
+		// late first ack: window control from now on, the acked blocks were not tracked
+		if (m_no_acks) {
+			m_no_acks = false;
+			return -1;
+		}
+		// duplicate acks of resent blocks or acks of blocks taken as lost
+		count = std::min(count, m_in_flight);
+		if (!count)
+			return -1;
+		m_in_flight -= count;
+		m_rate_acks += count;
+
+		float sample = 0;
+		for (auto left = count; left && !m_sends.empty();) {
+			auto &front = m_sends.front();
+			const auto take = std::min(left, front.count);
+			front.count -= take;
+			left -= take;
+			sample = now_ms - front.sent_ms;
+			if (!front.count)
+				m_sends.pop_front();
+		}
+		m_rtt = m_have_rtt ? (m_rtt * 7 + sample) / 8 : sample;
+		m_min_rtt = m_have_rtt ? std::min(m_min_rtt, sample) : sample;
+		m_have_rtt = true;
+
+		if (m_rtt > m_min_rtt * 2 + RTT_SLACK_MS) {
+			if (now_ms - m_last_decrease_ms > m_rtt) {
+				m_window = std::max<float>(MIN, m_window * 0.75f);
+				m_threshold = m_window;
+				m_last_decrease_ms = now_ms;
+			}
+		} else if (m_window < m_threshold) {
+			m_window += count;
+		} else {
+			m_window += count / m_window;
+		}
+		m_window = std::min<float>(m_window, m_max);
+		return sample;
+	}
+
+	// Call once per send round before asking for available()
+	void update(uint64_t now_ms)
+	{
+		const auto lock = std::lock_guard(m_mutex);
+		if (!m_acked_total && m_first_send_ms &&
+				now_ms - m_first_send_ms > NO_ACKS_MS && !m_no_acks) {
+			m_no_acks = true;
+			m_in_flight = 0;
+			m_sends.clear();
+		}
+		if (m_no_acks)
+			return;
+
+		if (m_in_flight && !m_sends.empty()) {
+			const auto last_ms = std::max(m_last_ack_ms, m_sends.front().sent_ms);
+			if (now_ms - last_ms > std::max<float>(LOST_MIN_MS, m_rtt * 4)) {
+				m_in_flight = 0;
+				m_sends.clear();
+				m_threshold = std::max<float>(MIN, m_window / 2);
+				m_window = MIN;
+			}
+		}
+
+		if (m_in_flight * 2 >= m_window)
+			m_rate_window_used = true;
+		if (!m_rate_start_ms) {
+			m_rate_start_ms = now_ms;
+		} else if (now_ms - m_rate_start_ms >= RATE_PERIOD_MS) {
+			if (m_rate_window_used) {
+				const float rate = m_rate_acks * 1000.0f / (now_ms - m_rate_start_ms);
+				m_ack_rate = m_ack_rate > 0 ? (m_ack_rate + rate) / 2 : rate;
+			}
+			m_rate_start_ms = now_ms;
+			m_rate_acks = 0;
+			m_rate_window_used = false;
+		}
+
+		// Bandwidth-delay product with headroom
+		if (m_ack_rate > 0 && m_rtt > 0) {
+			const float bdp = m_ack_rate * m_rtt / 1000.0f;
+			m_window = std::min<float>(m_window, std::max<float>(MIN, bdp * 4 + MIN));
+		}
+	}
+
+private:
+	struct send
+	{
+		uint32_t count;
+		uint64_t sent_ms;
+	};
+
+	mutable std::mutex m_mutex;
+	const uint32_t m_max;
+	float m_window;
+	float m_threshold;
+	uint32_t m_in_flight = 0;
+	std::deque<send> m_sends;
+
+	bool m_have_rtt = false;
+	float m_rtt = 0;
+	float m_min_rtt = 0;
+	uint64_t m_first_send_ms = 0;
+	uint64_t m_last_ack_ms = 0;
+	uint64_t m_last_decrease_ms = 0;
+	uint64_t m_acked_total = 0;
+	bool m_no_acks = false;
+
+	uint64_t m_rate_start_ms = 0;
+	uint32_t m_rate_acks = 0;
+	bool m_rate_window_used = false;
+	float m_ack_rate = 0;
+};
@@ -0,0 +1,134 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_block_snapshots.h"
+
+static size_t nodesBytes(const block_snapshots::nodes_ptr &nodes)
+{
+	return nodes->size() * sizeof(MapNode);
+}
+
+block_snapshots::block_snapshots(size_t budget_bytes) :
+		m_shard_budget{budget_bytes / SHARDS}
+{
+}
+
+void block_snapshots::erase(shard &s, std::list<entry>::iterator it)
+{
+	s.bytes -= it->bytes;
+	m_bytes -= it->bytes;
+	s.index.erase(it->pos);
+	s.lru.erase(it);
+}
+
+block_snapshots::nodes_ptr block_snapshots::get(const v3bpos_t &pos, uint64_t version)
+{
+	auto &s = getShard(pos);
+	const auto lock = std::lock_guard(s.mutex);
+	const auto it = s.index.find(pos);
+	if (it == s.index.end())
+		return {};
+	for (const auto &[v, nodes] : it->second->versions) {
+		if (v == version) {
+			s.lru.splice(s.lru.begin(), s.lru, it->second);
+			return nodes;
+		}
+	}
+	return {};
+}
+
+void block_snapshots::put(const v3bpos_t &pos, uint64_t version, nodes_ptr nodes)
+{
+	const auto size = nodesBytes(nodes);
+	if (size > m_shard_budget)
+		return;
+
+	auto &s = getShard(pos);
+	const auto lock = std::lock_guard(s.mutex);
+	auto it = s.index.find(pos);
+	if (it == s.index.end()) {
+		s.lru.push_front({.pos = pos, .versions = {}, .bytes = 0});
+		it = s.index.emplace(pos, s.lru.begin()).first;
+	} else {
+		s.lru.splice(s.lru.begin(), s.lru, it->second);
+	}
+	auto &e = *it->second;
+	for (const auto &v : e.versions)
+		if (v.first == version)
+			return;
+	e.versions.emplace_back(version, std::move(nodes));
+	e.bytes += size;
+	s.bytes += size;
+	m_bytes += size;
+	if (e.versions.size() > VERSIONS) {
+		const auto dropped = nodesBytes(e.versions.front().second);
+		e.versions.pop_front();
+		e.bytes -= dropped;
+		s.bytes -= dropped;
+		m_bytes -= dropped;
+	}
+	while (s.bytes > m_shard_budget)
+		erase(s, std::prev(s.lru.end()));
+}
+
+void block_snapshots::clear()
+{
+	for (auto &s : m_shards) {
+		const auto lock = std::lock_guard(s.mutex);
+		m_bytes -= s.bytes;
+		s.bytes = 0;
+		s.index.clear();
+		s.lru.clear();
+	}
+}
+
+void block_client_versions::sent(const v3bpos_t &pos, uint64_t version)
+{
+	const auto lock = std::lock_guard(m_mutex);
+	m_versions[pos].sent.emplace_back(version);
+}
+
+void block_client_versions::acked(const v3bpos_t &pos)
+{
+	const auto lock = std::lock_guard(m_mutex);
+	const auto it = m_versions.find(pos);
+	if (it == m_versions.end() || it->second.sent.empty())
+		return;
+	it->second.acked = it->second.sent.front();
+	it->second.sent.pop_front();
+}
+
+uint64_t block_client_versions::get(const v3bpos_t &pos)
+{
+	const auto lock = std::lock_guard(m_mutex);
+	const auto it = m_versions.find(pos);
+	if (it == m_versions.end() || !it->second.sent.empty())
+		return 0;
+	return it->second.acked;
+}
+
+void block_client_versions::erase(const v3bpos_t &pos)
+{
+	const auto lock = std::lock_guard(m_mutex);
+	m_versions.erase(pos);
+}
+
+void block_client_versions::clear()
+{
+	const auto lock = std::lock_guard(m_mutex);
+	m_versions.clear();
+}
@@ -0,0 +1,116 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "irr_v3d.h"
+#include "mapnode.h"
+
+/*
+Nodes of the last sent versions of blocks, the bases of block deltas
+(TOCLIENT_BLOCKDATA_DELTA). A mono block is kept as one node.
+
+VERSIONS versions are kept per block, least recently used blocks are dropped
+over the memory budget. Lock-striped like serialized_block_cache.
+*/
+
+class block_snapshots
+{
+public:
+	using nodes_ptr = std::shared_ptr<const std::vector<MapNode>>;
+
+	static constexpr size_t VERSIONS = 4;
+
+	explicit block_snapshots(size_t budget_bytes);
+
+	// Nodes of the block version or nullptr
+	nodes_ptr get(const v3bpos_t &pos, uint64_t version);
+	// Store nodes of the block version, drops the oldest version over VERSIONS
+	void put(const v3bpos_t &pos, uint64_t version, nodes_ptr nodes);
+	void clear();
+
+	size_t bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+
+private:
+	struct entry
+	{
+		v3bpos_t pos;
+		// oldest first
+		std::deque<std::pair<uint64_t, nodes_ptr>> versions;
+		size_t bytes = 0;
+	};
+
+	static constexpr size_t SHARDS = 16;
+
+	struct shard
+	{
+		std::mutex mutex;
+		// most recently used first
+		std::list<entry> lru;
+		std::unordered_map<v3bpos_t, std::list<entry>::iterator> index;
+		size_t bytes = 0;
+	};
+
+	shard &getShard(const v3bpos_t &pos)
+	{
+		return m_shards[std::hash<v3bpos_t>()(pos) % SHARDS];
+	}
+	void erase(shard &s, std::list<entry>::iterator it);
+
+	const size_t m_shard_budget;
+	std::array<shard, SHARDS> m_shards;
+	std::atomic_size_t m_bytes{0};
+};
+
+/*
+Block versions a client has, per block: the last acked (TOSERVER_GOTBLOCKS)
+and the sent ones waiting for ack, in send order. The connection is reliable
+and ordered, so acks come in the same order.
+*/
+
+class block_client_versions
+{
+public:
+	void sent(const v3bpos_t &pos, uint64_t version);
+	void acked(const v3bpos_t &pos);
+	// Version the client has for sure: the last acked one while no newer is on
+	// the way, else 0
+	uint64_t get(const v3bpos_t &pos);
+	void erase(const v3bpos_t &pos);
+	void clear();
+
+private:
+	struct versions
+	{
+		uint64_t acked = 0;
+		std::deque<uint64_t> sent;
+	};
+
+	std::mutex m_mutex;
+	std::unordered_map<v3bpos_t, versions> m_versions;
+};
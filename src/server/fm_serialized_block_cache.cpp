@@ -0,0 +1,81 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_serialized_block_cache.h"
+
+serialized_block_cache::serialized_block_cache(size_t budget_bytes) :
+		m_shard_budget{budget_bytes / SHARDS}
+{
+}
+
+void serialized_block_cache::erase(shard &s, std::list<entry>::iterator it)
+{
+	s.bytes -= it->data->size();
+	m_bytes -= it->data->size();
+	s.index.erase(it->k);
+	s.lru.erase(it);
+}
+
+serialized_block_cache::data_ptr serialized_block_cache::get(
+		const key &k, uint64_t version)
+{
+	auto &s = getShard(k);
+	const auto lock = std::lock_guard(s.mutex);
+	const auto it = s.index.find(k);
+	if (it == s.index.end() || it->second->version != version) {
+		++m_misses;
+		return {};
+	}
+	s.lru.splice(s.lru.begin(), s.lru, it->second);
+	++m_hits;
+	return it->second->data;
+}
+
+serialized_block_cache::data_ptr serialized_block_cache::put(
+		const key &k, uint64_t version, std::string &&data)
+{
+	auto ptr = std::make_shared<const std::string>(std::move(data));
+	if (ptr->size() > m_shard_budget)
+		return ptr;
+
+	auto &s = getShard(k);
+	const auto lock = std::lock_guard(s.mutex);
+	if (const auto it = s.index.find(k); it != s.index.end()) {
+		// other thread was faster with a newer version
+		if (it->second->version > version)
+			return ptr;
+		erase(s, it->second);
+	}
+	s.lru.push_front({k, version, ptr});
+	s.index.emplace(k, s.lru.begin());
+	s.bytes += ptr->size();
+	m_bytes += ptr->size();
+	while (s.bytes > m_shard_budget)
+		erase(s, std::prev(s.lru.end()));
+	return ptr;
+}
+
+void serialized_block_cache::clear()
+{
+	for (auto &s : m_shards) {
+		const auto lock = std::lock_guard(s.mutex);
+		m_bytes -= s.bytes;
+		s.bytes = 0;
+		s.index.clear();
+		s.lru.clear();
+	}
+}
@@ -0,0 +1,115 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "irr_v3d.h"
+
+/*
+Compressed network form of blocks, shared by all clients and send rounds.
+
+An entry is valid for one block version (MapBlock::getModifiedVersion(),
+changed by raiseModified), a newer version replaces it. Least recently used
+entries are dropped over the memory budget. Lock-striped, the budget is
+split between the stripes.
+*/
+
+class serialized_block_cache
+{
+public:
+	struct key
+	{
+		v3bpos_t pos;
+		// far blocks of every step are separate blocks
+		block_step_t step;
+		// serialization version
+		u8 ver;
+		// sent as content only, see TOCLIENT_BLOCKDATA_CONTENT_ONLY
+		bool content_only;
+		// compressed with the map zstd dictionary
+		bool zstd_dictionary;
+
+		bool operator==(const key &other) const
+		{
+			return pos == other.pos && step == other.step && ver == other.ver &&
+				   content_only == other.content_only &&
+				   zstd_dictionary == other.zstd_dictionary;
+		}
+	};
+
+	using data_ptr = std::shared_ptr<const std::string>;
+
+	explicit serialized_block_cache(size_t budget_bytes);
+
+	// Data of the block version or nullptr
+	data_ptr get(const key &k, uint64_t version);
+	// Store data of the block version, replaces older versions
+	data_ptr put(const key &k, uint64_t version, std::string &&data);
+	void clear();
+
+	size_t bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+	uint64_t hits() const { return m_hits.load(std::memory_order_relaxed); }
+	uint64_t misses() const { return m_misses.load(std::memory_order_relaxed); }
+
+private:
+	struct key_hash
+	{
+		size_t operator()(const key &k) const
+		{
+			return std::hash<v3bpos_t>()(k.pos) ^ (size_t(k.step) << 16) ^
+				   (size_t(k.ver) << 8) ^ size_t(k.content_only) ^
+				   (size_t(k.zstd_dictionary) << 1);
+		}
+	};
+
+	struct entry
+	{
+		key k;
+		uint64_t version;
+		data_ptr data;
+	};
+
+	static constexpr size_t SHARDS = 16;
+
+	struct shard
+	{
+		std::mutex mutex;
+		// most recently used first
+		std::list<entry> lru;
+		std::unordered_map<key, std::list<entry>::iterator, key_hash> index;
+		size_t bytes = 0;
+	};
+
+	shard &getShard(const key &k) { return m_shards[key_hash()(k) % SHARDS]; }
+	void erase(shard &s, std::list<entry>::iterator it);
+
+	const size_t m_shard_budget;
+	std::array<shard, SHARDS> m_shards;
+	std::atomic_size_t m_bytes{0};
+	std::atomic_uint64_t m_hits{0};
+	std::atomic_uint64_t m_misses{0};
+};
@@ -8,6 +8,7 @@
 #include "constants.h" // BS
 #include "util/serialize.h"
 #include "serverenvironment.h"
+#include <algorithm>
 
 Queue<ActiveObjectMessage> dummy_queue;
 
@@ -152,3 +153,16 @@ bool ServerActiveObject::isEffectivelyObservedBy(const std::string &player_name)
 	auto effective_observers = getEffectiveObservers();
 	return !effective_observers || effective_observers->count(player_name) > 0;
 }
+
+void ServerActiveObject::addKnownBy(u16 peer_id)
+{
+	std::lock_guard<std::mutex> lock(m_known_by_mutex);
+	if (std::find(m_known_by.begin(), m_known_by.end(), peer_id) == m_known_by.end())
+		m_known_by.emplace_back(peer_id);
+}
+
+void ServerActiveObject::removeKnownBy(u16 peer_id)
+{
+	std::lock_guard<std::mutex> lock(m_known_by_mutex);
+	std::erase(m_known_by, peer_id);
+}
@@ -47,6 +47,24 @@ class ServerActiveObject : public ActiveObject
 public:
 	float m_uptime_last = 0;
 	Queue<ActiveObjectMessage> & m_messages_out;
+
+	// Peers which know about this object, changed together with m_known_by_count.
+	// Object messages are routed by this list instead of checking every client.
+	void addKnownBy(u16 peer_id);
+	void removeKnownBy(u16 peer_id);
+	// f(peer_id) runs under the lock of the list: it must not lock anything
+	// which is held while calling addKnownBy()/removeKnownBy()
+	template <class F>
+	void forEachKnownBy(F &&f) const
+	{
+		std::lock_guard<std::mutex> lock(m_known_by_mutex);
+		for (const auto peer_id : m_known_by)
+			f(peer_id);
+	}
+
+private:
+	std::vector<u16> m_known_by;
+	mutable std::mutex m_known_by_mutex;
 // ===
 
 
@@ -216,6 +216,9 @@ ServerEnvironment::ServerEnvironment(std::unique_ptr<ServerMap> map,
 	m_step_time_counter = mb->addCounter(
 		"minetest_env_step_time", "Time spent in environment step (in microseconds)");
 
+	m_abm_step_histogram = mb->addHistogram(
+		"minetest_env_abm_step_duration", "Duration of ABM passes over active blocks (in seconds)");
+
 	m_active_block_gauge = mb->addGauge(
 		"minetest_env_active_blocks", "Number of active blocks");
 
@@ -1240,6 +1243,7 @@ void ServerEnvironment::step(float dtime, double uptime, unsigned int max_cycle_
 
 	if (m_active_block_abm_last || m_active_block_modifier_interval.step(dtime, m_cache_abm_interval)) {
 		ScopeProfiler sp(g_profiler, "SEnv: modify in blocks avg per interval", SPT_AVG);
+		MetricHistogramTimer abm_timer(m_abm_step_histogram);
 		TimeTaker timer("modify in active blocks per interval");
 		timer.start();
 
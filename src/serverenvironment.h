@@ -518,6 +518,7 @@ class ServerEnvironment final : public Environment
 
 	// Environment metrics
 	MetricCounterPtr m_step_time_counter;
+	MetricHistogramPtr m_abm_step_histogram;
 	MetricGaugePtr m_active_block_gauge;
 	MetricGaugePtr m_active_object_gauge;
 
@@ -28,6 +28,7 @@
 #include "serverenvironment.h"
 #include "database/database.h"
 #include "database/database-dummy.h"
+#include "database/database-snapshot.h"
 #include "database/database-sqlite3.h"
 #include "script/scripting_server.h"
 #if USE_LEVELDB
@@ -39,6 +40,7 @@
 #if USE_POSTGRESQL
 #include "database/database-postgresql.h"
 #endif
+#include "server/fm_block_save_queue.h"
 
 /*
 	Helpers
@@ -47,11 +49,39 @@
 void MapDatabaseAccessor::loadBlock(v3bpos_t blockpos, std::string &ret)
 {
 	ret.clear();
+	if (save_queue && save_queue->get(blockpos, ret))
+		return;
 	dbase->loadBlock(blockpos, &ret);
 	if (ret.empty() && dbase_ro)
 		dbase_ro->loadBlock(blockpos, &ret);
 }
 
+void MapDatabaseAccessor::loadBlocks(std::span<const v3bpos_t> positions,
+		const MapDatabase::load_callback &callback)
+{
+	std::vector<v3bpos_t> rest;
+	std::string data;
+	for (const auto &pos : positions) {
+		if (save_queue && save_queue->get(pos, data))
+			callback(pos, std::move(data));
+		else
+			rest.push_back(pos);
+		data.clear();
+	}
+	if (!dbase_ro) {
+		dbase->loadBlocks(rest, callback);
+		return;
+	}
+	std::vector<v3bpos_t> missing;
+	dbase->loadBlocks(rest, [&](const v3bpos_t &pos, std::string &&block) {
+		if (block.empty())
+			missing.push_back(pos);
+		else
+			callback(pos, std::move(block));
+	});
+	dbase_ro->loadBlocks(missing, callback);
+}
+
 /*
 	ServerMap
 */
@@ -104,9 +134,25 @@ ServerMap::ServerMap(const std::string &savedir, IGameDef *gamedef,
 		"minetest_map_saved_blocks", "Number of blocks saved");
 	m_loaded_blocks_gauge = mb->addGauge(
 		"minetest_map_loaded_blocks", "Number of loaded blocks");
+	m_save_time_histogram = mb->addHistogram(
+		"minetest_map_save_duration", "Duration of map save passes (in seconds)");
+	m_block_miss_histogram = mb->addHistogram(
+		"minetest_map_block_miss_duration",
+		"Synchronous database loads of blocks not in memory (in seconds)");
+	m_liquid_cycle_histogram = mb->addHistogram(
+		"minetest_map_liquid_cycle_duration", "Duration of liquid transform cycles (in seconds)");
 
 	m_map_compression_level = rangelim(g_settings->getS16("map_compression_level_disk"), -1, 9);
 
+	initZstdDictionary();
+
+	if (const auto threads = g_settings->getU16("map_save_threads")) {
+		m_save_queue = std::make_unique<block_save_queue>(m_db, threads,
+				g_settings->getU32("map_save_queue_size"), m_map_compression_level, mb,
+				m_zstd_dictionary);
+		m_db.save_queue = m_save_queue.get();
+	}
+
 	try {
 		// If directory exists, check contents and load if possible
 		if (fs::PathExists(m_savedir)) {
@@ -172,6 +218,10 @@ ServerMap::~ServerMap()
 
 	m_emerge->resetMap();
 
+	// writes the rest
+	m_db.save_queue = nullptr;
+	m_save_queue.reset();
+
 	{
 		MutexAutoLock dblock(m_db.mutex);
 		delete m_db.dbase;
@@ -580,6 +630,8 @@ void ServerMap::reportMetrics(u64 save_time_us, u32 saved_blocks, u32 all_blocks
 	m_loaded_blocks_gauge->set(all_blocks);
 	m_save_time_counter->increment(save_time_us);
 	m_save_count_counter->increment(saved_blocks);
+	if (saved_blocks)
+		m_save_time_histogram->observe(save_time_us / 1e6);
 }
 
 #if 0 
@@ -668,9 +720,11 @@ void ServerMap::listAllLoadableBlocks(std::vector<v3bpos_t> &dst)
 void ServerMap::listAllLoadedBlocks(std::vector<v3bpos_t> &dst)
 {
 
-	const auto lock = m_blocks.lock_shared_rec();
-	for (const auto &i : m_blocks) {
-		dst.emplace_back(i.second->getPos());
+	for (const auto &shard : m_blocks.shards()) {
+		const auto lock = shard.lock_shared_rec();
+		for (const auto &i : shard) {
+			dst.emplace_back(i.second->getPos());
+		}
 	}
 
 /*
@@ -728,9 +782,14 @@ MapDatabase *ServerMap::createDatabase(
 #endif
 	else if (name == "dummy")
 		db = new Database_Dummy();
+	else if (name == "snapshot")
+		db = new Database_Snapshot(savedir);
 #if USE_LEVELDB
-	else if (name == "leveldb")
-		db = new Database_LevelDB(savedir);
+	else if (name == "leveldb") {
+		bool morton_keys = false;
+		conf.getBoolNoEx("leveldb_morton_keys", morton_keys);
+		db = new Database_LevelDB(savedir, morton_keys);
+	}
 #endif
 #if USE_REDIS
 	else if (name == "redis")
@@ -755,12 +814,17 @@ MapDatabase *ServerMap::createDatabase(
 
 void ServerMap::beginSave()
 {
+	// the queue writer makes its own transactions
+	if (m_save_queue)
+		return;
 	MutexAutoLock dblock(m_db.mutex);
 	m_db.dbase->beginSave();
 }
 
 void ServerMap::endSave()
 {
+	if (m_save_queue)
+		return;
 	MutexAutoLock dblock(m_db.mutex);
 	m_db.dbase->endSave();
 }
@@ -769,12 +833,25 @@ bool ServerMap::saveBlock(MapBlock *block)
 {
 	changed_blocks_for_merge.emplace(block->getPos());
 
+	if (m_save_queue) {
+		if (!block->isGenerated())
+			return true;
+		// compressed and written by the queue threads
+		const u8 version = SER_FMT_VER_HIGHEST_WRITE;
+		std::ostringstream o(std::ios_base::binary);
+		block->serialize(o, version, true, m_map_compression_level, false);
+		m_save_queue->push(block->getPos(), version, std::move(o).str());
+		block->resetModified();
+		return true;
+	}
+
 	// FIXME: serialization happens under mutex
 	MutexAutoLock dblock(m_db.mutex);
-	return saveBlock(block, m_db.dbase, m_map_compression_level);
+	return saveBlock(block, m_db.dbase, m_map_compression_level, m_zstd_dictionary);
 }
 
-bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db, int compression_level)
+bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db, int compression_level,
+		u32 zstd_dictionary)
 {
 	auto p3d = block->getPos();
 
@@ -792,7 +869,7 @@ bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db, int compression_leve
 	*/
 	std::ostringstream o(std::ios_base::binary);
 	o.write((char*) &version, 1);
-	block->serialize(o, version, true, compression_level);
+	block->serialize(o, version, true, compression_level, true, zstd_dictionary);
 
 	// FIXME: zero copy possible in c++20 or with custom rdbuf
 	bool ret = db->saveBlock(p3d, o.str());
@@ -888,6 +965,7 @@ MapBlockPtr ServerMap::loadBlock(const std::string &blob, v3bpos_t p3d, bool sav
 
 MapBlockPtr ServerMap::loadBlock(v3bpos_t blockpos)
 {
+	MetricHistogramTimer miss_timer(m_block_miss_histogram);
 	std::string data;
 
 	if (m_map_loading_enabled)
@@ -906,8 +984,30 @@ MapBlockPtr ServerMap::loadBlock(v3bpos_t blockpos)
 	return getBlock(blockpos);
 }
 
+void ServerMap::loadBlocks(std::span<const v3bpos_t> positions)
+{
+	if (!m_map_loading_enabled)
+		return;
+
+	std::vector<std::pair<v3bpos_t, std::string>> blobs;
+	{
+		ScopeProfiler sp(g_profiler, "ServerMap: load blocks - sync (sum)");
+		MutexAutoLock dblock(m_db.mutex);
+		m_db.loadBlocks(positions, [&](const v3bpos_t &pos, std::string &&block) {
+			if (!block.empty())
+				blobs.emplace_back(pos, std::move(block));
+		});
+	}
+
+	for (const auto &[pos, blob] : blobs)
+		loadBlock(blob, pos);
+}
+
 bool ServerMap::deleteBlock(v3bpos_t blockpos)
 {
+	// a queued write would bring it back
+	if (m_save_queue)
+		m_save_queue->flush();
 	MutexAutoLock dblock(m_db.mutex);
 	if (!m_db.dbase->deleteBlock(blockpos))
 		return false;
@@ -1398,6 +1498,9 @@ size_t ServerMap::transformLiquids(std::map<v3pos_t, MapBlock*> &modified_blocks
 	    , Server *m_server, unsigned int max_cycle_ms
 	)
 {
+	MetricHistogramTimer cycle_timer(
+			transforming_liquid_size() ? m_liquid_cycle_histogram.get() : nullptr);
+
 	// process the whole queue at most once, to rate-limit
 	u32 liquid_loop_max = std::min<u32>(m_transforming_liquid.size(), g_settings->getS32("liquid_loop_max"));
 
@@ -11,7 +11,9 @@
 
 #include <vector>
 #include <memory>
+#include <span>
 
+#include "database/database.h"
 #include "map.h"
 #include "util/container.h" // UniqueQueue
 #include "util/metricsbackend.h" // ptr typedefs
@@ -26,6 +28,7 @@ class EmergeManager;
 class ServerEnvironment;
 struct BlockMakeData;
 class MetricsBackend;
+class block_save_queue;
 
 // TODO: this could wrap all calls to MapDatabase, including locking
 struct MapDatabaseAccessor {
@@ -35,10 +38,16 @@ struct MapDatabaseAccessor {
 	MapDatabase *dbase = nullptr;
 	/// Fallback database for read operations
 	MapDatabase *dbase_ro = nullptr;
+	/// fm: blocks not written yet, read before dbase
+	block_save_queue *save_queue = nullptr;
 
 	/// Load a block, taking dbase_ro into account.
 	/// @note call locked
 	void loadBlock(v3bpos_t blockpos, std::string &ret);
+	/// fm: loadBlock for many blocks, see MapDatabase::loadBlocks
+	/// @note call locked
+	void loadBlocks(std::span<const v3bpos_t> positions,
+			const MapDatabase::load_callback &callback);
 };
 
 /*
@@ -199,13 +208,16 @@ class ServerMap : public Map
 	MapgenParams *getMapgenParams();
 
 	bool saveBlock(MapBlock *block) override;
-	static bool saveBlock(MapBlock *block, MapDatabase *db, int compression_level = -1);
+	static bool saveBlock(MapBlock *block, MapDatabase *db, int compression_level = -1,
+			u32 zstd_dictionary = 0);
 
 	// Load block in a synchronous fashion
 	MapBlockPtr loadBlock(v3bpos_t p);
 	/// Load a block that was already read from disk. Used by EmergeManager.
 	/// @return non-null block (but can be blank)
 	MapBlockPtr loadBlock(const std::string &blob, v3bpos_t p, bool save_after_load=false);
+	// fm: load blocks not in memory with one database read
+	void loadBlocks(std::span<const v3bpos_t> positions);
 
 	// Helper for deserializing blocks from disk
 	// @throws SerializationError
@@ -275,6 +287,17 @@ class ServerMap : public Map
 
 	int m_map_compression_level;
 
+	// fm: see map_zstd_dictionary, id from addZstdDictionary or 0
+	void initZstdDictionary();
+	u32 m_zstd_dictionary = 0;
+	std::string m_zstd_dictionary_data;
+public:
+	// For writing blocks, 0 if not enabled
+	u32 getZstdDictionary() const { return m_zstd_dictionary; }
+	// Sent to clients
+	const std::string &getZstdDictionaryData() const { return m_zstd_dictionary_data; }
+private:
+
 	concurrent_set<v3bpos_t> m_chunks_in_progress;
 
 	// used by deleteBlock() and deleteDetachedBlocks()
@@ -296,9 +319,14 @@ class ServerMap : public Map
 public:
 	MapDatabaseAccessor m_db;
 private:
+	// fm: write-behind saving, see map_save_threads
+	std::unique_ptr<block_save_queue> m_save_queue;
 
 	// Map metrics
 	MetricGaugePtr m_loaded_blocks_gauge;
 	MetricCounterPtr m_save_time_counter;
 	MetricCounterPtr m_save_count_counter;
+	MetricHistogramPtr m_save_time_histogram;
+	MetricHistogramPtr m_block_miss_histogram;
+	MetricHistogramPtr m_liquid_cycle_histogram;
 };
@@ -135,4 +135,67 @@ SECTION("random operations") {
 	}
 }
 
+SECTION("upsert and unknown remove") {
+	k_d_tree::DynamicKdTrees<3, u16, u16> kds;
+	kds.insert({1, 1, 1}, 1);
+	kds.insert({2, 2, 2}, 1); // same id: moves the point
+	kds.remove(2); // unknown id
+	CHECK(kds.size() == 1);
+	size_t found = 0;
+	kds.rangeQuery({0, 0, 0}, {1, 1, 1}, [&](auto, u16) { ++found; });
+	CHECK(found == 0);
+	kds.rangeQuery({2, 2, 2}, {2, 2, 2}, [&](auto, u16 id) {
+		CHECK(id == 1);
+		++found;
+	});
+	CHECK(found == 1);
+}
+
+SECTION("many updates") {
+	PseudoRandom pr(Catch::getSeed());
+
+	ObjectVector<3, f32, u16> objvec;
+	k_d_tree::DynamicKdTrees<3, f32, u16> kds;
+
+	const auto randPos = [&]() {
+		std::array<f32, 3> point;
+		for (uint8_t d = 0; d < 3; ++d)
+			point[d] = pr.range(-1000, 1000);
+		return point;
+	};
+
+	for (u16 id = 1; id <= 5000; ++id) {
+		const auto point = randPos();
+		objvec.insert(point, id);
+		kds.insert(point, id);
+	}
+
+	// Move every object a few times, as moving mobs do every step
+	for (int step = 0; step < 5; ++step) {
+		for (u16 id = 1; id <= 5000; ++id) {
+			const auto point = randPos();
+			objvec.update(point, id);
+			kds.update(point, id);
+		}
+	}
+	CHECK(kds.size() == 5000);
+
+	for (int i = 0; i < 100; ++i) {
+		std::array<f32, 3> min, max;
+		for (uint8_t d = 0; d < 3; ++d) {
+			min[d] = pr.range(-1500, 1500);
+			max[d] = min[d] + pr.range(1, 2500);
+		}
+		std::unordered_set<u16> expected_ids;
+		objvec.rangeQuery(min, max, [&](auto _, u16 id) {
+			expected_ids.insert(id);
+		});
+		kds.rangeQuery(min, max, [&](auto point, u16 id) {
+			CHECK(expected_ids.count(id) == 1);
+			expected_ids.erase(id);
+		});
+		CHECK(expected_ids.empty());
+	}
+}
+
 }
@@ -54,6 +54,15 @@ class TestServerActiveObjectMgr {
 		ids.clear();
 	}
 
+	void clearIf(const std::function<bool(const ServerActiveObjectPtr &, u16)> &cb)
+	{
+		saomgr.clearIf(cb);
+		ids.erase(std::remove_if(ids.begin(), ids.end(),
+				[&](u16 id) { return !saomgr.getActiveObject(id); }), ids.end());
+	}
+
+	size_t spatialIndexSize() const { return saomgr.m_spatial_index.size(); }
+
 	ServerActiveObjectPtr getActiveObject(u16 id)
 	{
 		return saomgr.getActiveObject(id);
@@ -277,6 +286,24 @@ SECTION("get added active objects around pos") {
 	saomgr.clear();
 }
 
+SECTION("clear if") {
+	TestServerActiveObjectMgr saomgr;
+	for (int i = 0; i < 100; ++i)
+		REQUIRE(saomgr.registerObject(std::make_unique<MockServerActiveObject>(
+				nullptr, v3opos_t(i, 0, 0))));
+	REQUIRE(saomgr.spatialIndexSize() == 100);
+
+	saomgr.clearIf([](const ServerActiveObjectPtr &obj, u16 id) {
+		return obj->getBasePosition().X < 60;
+	});
+	REQUIRE(saomgr.spatialIndexSize() == 40);
+	saomgr.compareObjectsInArea(aabb3o(v3opos_t(-10), v3opos_t(200)));
+
+	saomgr.clearIf([](const ServerActiveObjectPtr &obj, u16 id) { return true; });
+	REQUIRE(saomgr.empty());
+	REQUIRE(saomgr.spatialIndexSize() == 0);
+}
+
 SECTION("spatial index") {
 	TestServerActiveObjectMgr saomgr;
 	std::mt19937 gen(0xABCDEF);
@@ -0,0 +1,217 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "concurrent_sharded_unordered_map.h"
+#include "mpmc_queue.h"
+
+/*
+Priority queue of items by key where adding a queued key merges into the
+queued item instead of queueing it twice.
+
+Keys wait in BUCKETS lock-free mpmc_queue's, bucket 0 is popped first.
+Items live in a lock-striped index by key, so add() and pop() of different
+keys rarely meet on a lock, and nobody holds a lock of the whole queue.
+A key can wait in several buckets, the first one popped takes the item and
+the others are skipped.
+
+A popped key is in flight until done(key): it is not popped again meanwhile.
+A key re-added while in flight gets a new item which is parked, not queued,
+and done() queues it, so pop() never has to step over busy keys.
+*/
+
+template <class Key, class T, size_t BUCKETS = 16, class Hash = std::hash<Key>,
+		size_t BUCKET_CAPACITY = 1024>
+class coalescing_priority_queue
+{
+	struct entry
+	{
+		// T{} while in flight without a new item
+		T value{};
+		bool in_flight = false;
+		// bucket of a parked item
+		size_t bucket = 0;
+	};
+
+	using index_type = concurrent_sharded_unordered_map<Key, entry, Hash>;
+	using shard_type = typename index_type::shard_type;
+	using full_type = typename index_type::full_type;
+
+public:
+	/*
+	Queue a new item for key in bucket (clamped to the last one), or merge into
+	the queued item of the key.
+	make() returns the new item, T{} for nothing to queue, it runs without
+	locks. If another thread queued the key meanwhile the made item is merged
+	away: merge() runs for the queued item and drop(T &) gets the made one.
+	merge(T &) updates the queued item under the lock of the key's index
+	shard, if it returns true the key is queued in bucket too, to raise the
+	priority of the item.
+	Returns true if a new item was queued.
+	*/
+	template <class Make, class Merge, class Drop>
+	bool add(const Key &key, size_t bucket, Make &&make, Merge &&merge, Drop &&drop)
+	{
+		bucket = std::min(bucket, BUCKETS - 1);
+		auto &shard = m_index.get_shard(key);
+		if (mergeQueued(shard, key, bucket, merge))
+			return false;
+
+		T value = make();
+		if (value == T{})
+			return false;
+
+		bool queue = false;
+		{
+			const auto lock = shard.lock_unique_rec();
+			auto it = shard.full_type::find(key);
+			if (it != shard.full_type::end() && it->second.value != T{}) {
+				queue = mergeLocked(it->second, bucket, merge);
+			} else {
+				if (it == shard.full_type::end())
+					it = shard.full_type::emplace(key, entry{}).first;
+				it->second.value = std::move(value);
+				it->second.bucket = bucket;
+				queue = !it->second.in_flight;
+				++m_size;
+				value = T{};
+			}
+		}
+		if (queue)
+			m_buckets[bucket].push(key);
+		if (value != T{}) {
+			drop(value);
+			return false;
+		}
+		return true;
+	}
+
+	// Pop the item of the lowest bucket, its key is in flight until done()
+	bool pop(T &value)
+	{
+		for (size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+			for (Key key; m_buckets[bucket].try_pop(key);) {
+				auto &shard = m_index.get_shard(key);
+				const auto lock = shard.lock_unique_rec();
+				const auto it = shard.full_type::find(key);
+				// taken from another bucket, removed by filter() or parked
+				if (it == shard.full_type::end() || it->second.in_flight ||
+						it->second.value == T{})
+					continue;
+				value = std::move(it->second.value);
+				it->second.value = T{};
+				it->second.in_flight = true;
+				--m_size;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Finish a popped key, queue its parked item
+	void done(const Key &key)
+	{
+		size_t bucket = BUCKETS;
+		{
+			auto &shard = m_index.get_shard(key);
+			const auto lock = shard.lock_unique_rec();
+			const auto it = shard.full_type::find(key);
+			if (it == shard.full_type::end())
+				return;
+			if (it->second.value == T{}) {
+				shard.full_type::erase(it);
+				return;
+			}
+			it->second.in_flight = false;
+			bucket = it->second.bucket;
+		}
+		m_buckets[bucket].push(key);
+	}
+
+	// Remove queued items for which keep(T &) returns false
+	template <class Keep>
+	void filter(Keep &&keep)
+	{
+		for (auto &shard : m_index.shards()) {
+			const auto lock = shard.lock_unique_rec();
+			for (auto it = shard.full_type::begin(); it != shard.full_type::end();) {
+				auto &e = it->second;
+				if (e.value == T{} || keep(e.value)) {
+					++it;
+					continue;
+				}
+				e.value = T{};
+				--m_size;
+				if (e.in_flight)
+					++it;
+				else
+					it = shard.full_type::erase(it);
+			}
+		}
+	}
+
+	// Queued items, approximate while other threads add or pop
+	size_t size() const { return m_size.load(std::memory_order_relaxed); }
+	bool empty() const { return !size(); }
+
+private:
+	template <class Merge>
+	bool mergeQueued(shard_type &shard, const Key &key, size_t bucket, Merge &merge)
+	{
+		bool queue = false;
+		{
+			const auto lock = shard.lock_unique_rec();
+			const auto it = shard.full_type::find(key);
+			if (it == shard.full_type::end() || it->second.value == T{})
+				return false;
+			queue = mergeLocked(it->second, bucket, merge);
+		}
+		if (queue)
+			m_buckets[bucket].push(key);
+		return true;
+	}
+
+	// Returns true if the key has to be queued in bucket
+	template <class Merge>
+	static bool mergeLocked(entry &e, size_t bucket, Merge &merge)
+	{
+		if constexpr (std::is_same_v<decltype(merge(e.value)), bool>) {
+			if (!merge(e.value))
+				return false;
+			if (!e.in_flight)
+				return true;
+			// parked, done() queues it
+			e.bucket = std::min(e.bucket, bucket);
+			return false;
+		} else {
+			merge(e.value);
+			return false;
+		}
+	}
+
+	std::array<mpmc_queue<Key, BUCKET_CAPACITY>, BUCKETS> m_buckets;
+	index_type m_index;
+	std::atomic_size_t m_size{0};
+};
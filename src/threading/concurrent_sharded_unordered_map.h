@@ -0,0 +1,246 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "concurrent_unordered_map.h"
+
+/*
+Lock-striped map: keys are spread by hash over 2^SHARD_BITS independent
+concurrent_unordered_map shards, each with its own lock.
+
+Single key operations only lock the shard of that key.
+Long walks should go shard by shard via shards() and lock one shard at a time,
+so other threads are blocked only on that shard.
+lock_*_rec() lock all shards (in index order) for the rare whole-map users,
+plain begin()/end() iterate over all shards and expect such a lock to be held.
+*/
+
+class sharded_lock
+{
+public:
+	template <class Shards, class LockShard>
+	sharded_lock(const Shards &shards, const LockShard &lock_shard)
+	{
+		for (const auto &shard : shards) {
+			auto lock = lock_shard(shard);
+			if (!lock->owns_lock()) {
+				owns = false;
+				unlock();
+				return;
+			}
+			locks.emplace_back(std::move(lock));
+		}
+	}
+
+	bool owns_lock() const { return owns; }
+
+	void unlock()
+	{
+		// release in reverse order of locking
+		while (!locks.empty())
+			locks.pop_back();
+	}
+
+private:
+	bool owns = true;
+	std::vector<std::shared_ptr<void>> locks;
+};
+
+template <class LOCKER, class Key, class T, class Hash = std::hash<Key>,
+		class Pred = std::equal_to<Key>, uint8_t SHARD_BITS = 6>
+class concurrent_sharded_unordered_map_
+{
+public:
+	using shard_type = concurrent_unordered_map_<LOCKER, Key, T, Hash, Pred>;
+	using full_type = typename shard_type::full_type;
+	using key_type = Key;
+	using mapped_type = T;
+	using value_type = typename shard_type::value_type;
+	using size_type = typename shard_type::size_type;
+	static constexpr size_t SHARDS = size_t(1) << SHARD_BITS;
+	using shards_type = std::array<shard_type, SHARDS>;
+	using lock_type = sharded_lock;
+
+	template <class Shards, class InnerIterator, class Value>
+	class iterator_
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Value;
+		using difference_type = std::ptrdiff_t;
+		using pointer = Value *;
+		using reference = Value &;
+
+		iterator_() = default;
+		iterator_(Shards *shards, size_t shard) : shards(shards), shard(shard)
+		{
+			if (shard < SHARDS)
+				it = full(shard).begin();
+			skipEmpty();
+		}
+
+		reference operator*() const { return *it; }
+		pointer operator->() const { return &*it; }
+		iterator_ &operator++()
+		{
+			++it;
+			skipEmpty();
+			return *this;
+		}
+		bool operator==(const iterator_ &other) const
+		{
+			return shard == other.shard && (shard == SHARDS || it == other.it);
+		}
+		bool operator!=(const iterator_ &other) const { return !(*this == other); }
+
+	private:
+		auto &full(size_t i) const
+		{
+			return static_cast<std::conditional_t<std::is_const_v<Shards>,
+					const full_type &, full_type &>>((*shards)[i]);
+		}
+
+		void skipEmpty()
+		{
+			while (shard < SHARDS && it == full(shard).end()) {
+				if (++shard < SHARDS)
+					it = full(shard).begin();
+			}
+		}
+
+		Shards *shards = nullptr;
+		size_t shard = SHARDS;
+		InnerIterator it{};
+	};
+
+	using iterator = iterator_<shards_type, typename full_type::iterator, value_type>;
+	using const_iterator = iterator_<const shards_type,
+			typename full_type::const_iterator, const value_type>;
+
+	static size_t shard_index(const Key &k)
+	{
+		// Fibonacci hashing: spread weak position hashes over all shards
+		return (static_cast<uint64_t>(Hash{}(k)) * 0x9E3779B97F4A7C15ULL) >>
+			   (64 - SHARD_BITS);
+	}
+
+	shard_type &get_shard(const Key &k) { return m_shards[shard_index(k)]; }
+	const shard_type &get_shard(const Key &k) const { return m_shards[shard_index(k)]; }
+
+	shards_type &shards() { return m_shards; }
+	const shards_type &shards() const { return m_shards; }
+
+	//! Copy of the value, nothing if not found
+	mapped_type get(const Key &k) const
+	{
+		const auto &shard = get_shard(k);
+		const auto lock = shard.lock_shared_rec();
+		if (const auto it = shard.full_type::find(k); it != shard.full_type::end())
+			return it->second;
+		return {};
+	}
+
+	bool contains(const Key &k) const { return get_shard(k).contains(k); }
+
+	template <class V>
+	bool insert_or_assign(const Key &k, V &&v)
+	{
+		auto &shard = get_shard(k);
+		const auto lock = shard.lock_unique_rec();
+		const bool inserted =
+				shard.full_type::insert_or_assign(k, std::forward<V>(v)).second;
+		if (inserted)
+			++m_size;
+		return inserted;
+	}
+
+	template <class V>
+	bool emplace(const Key &k, V &&v)
+	{
+		auto &shard = get_shard(k);
+		const auto lock = shard.lock_unique_rec();
+		const bool inserted = shard.full_type::emplace(k, std::forward<V>(v)).second;
+		if (inserted)
+			++m_size;
+		return inserted;
+	}
+
+	size_type erase(const Key &k)
+	{
+		auto &shard = get_shard(k);
+		const auto lock = shard.lock_unique_rec();
+		const auto erased = shard.full_type::erase(k);
+		m_size -= erased;
+		return erased;
+	}
+
+	void clear()
+	{
+		for (auto &shard : m_shards) {
+			const auto lock = shard.lock_unique_rec();
+			m_size -= shard.full_type::size();
+			shard.full_type::clear();
+		}
+	}
+
+	size_type size() const { return m_size; }
+	bool empty() const { return !m_size; }
+
+	std::unique_ptr<lock_type> lock_unique_rec() const
+	{
+		return std::make_unique<lock_type>(
+				m_shards, [](const shard_type &s) { return s.lock_unique_rec(); });
+	}
+	std::unique_ptr<lock_type> try_lock_unique_rec() const
+	{
+		return std::make_unique<lock_type>(
+				m_shards, [](const shard_type &s) { return s.try_lock_unique_rec(); });
+	}
+	std::unique_ptr<lock_type> lock_shared_rec() const
+	{
+		return std::make_unique<lock_type>(
+				m_shards, [](const shard_type &s) { return s.lock_shared_rec(); });
+	}
+	std::unique_ptr<lock_type> try_lock_shared_rec() const
+	{
+		return std::make_unique<lock_type>(
+				m_shards, [](const shard_type &s) { return s.try_lock_shared_rec(); });
+	}
+
+	iterator begin() { return iterator(&m_shards, 0); }
+	iterator end() { return iterator(&m_shards, SHARDS); }
+	const_iterator begin() const { return const_iterator(&m_shards, 0); }
+	const_iterator end() const { return const_iterator(&m_shards, SHARDS); }
+
+private:
+	shards_type m_shards;
+	std::atomic<size_type> m_size{0};
+};
+
+template <class Key, class T, class Hash = std::hash<Key>,
+		class Pred = std::equal_to<Key>, uint8_t SHARD_BITS = 6>
+using concurrent_sharded_unordered_map =
+		concurrent_sharded_unordered_map_<locker<>, Key, T, Hash, Pred, SHARD_BITS>;
@@ -0,0 +1,294 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "job_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include "debug/stacktrace.h"
+#include "fm_porting.h"
+#include "log.h"
+#include "porting.h"
+#include "profiler.h"
+
+namespace
+{
+// Longest sleep of an idle worker, bounds stop latency too
+constexpr uint64_t WAIT_MAX_US = 100 * 1000;
+constexpr uint64_t REPORT_EVERY_US = 5 * 1000 * 1000;
+
+thread_local job_scheduler *current_scheduler = nullptr;
+thread_local size_t current_queue = 0;
+thread_local int current_priority = 0;
+// OS priority of the worker, follows the priority of the job it runs
+thread_local int current_os_priority = 0;
+}
+
+job_scheduler::job_scheduler(
+		const std::string &name, size_t threads, MetricsBackend *metrics) :
+		thread_vector{name, 0},
+		m_metrics{metrics}
+{
+	for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+		m_queues.emplace_back(std::make_unique<worker_queue>());
+}
+
+job_scheduler::~job_scheduler()
+{
+	join();
+}
+
+void job_scheduler::add(const job_config &config, const step_func &step)
+{
+	auto &j = m_jobs.emplace_back(std::make_unique<job>());
+	j->config = config;
+	j->step = step;
+	j->last_us = porting::getTimeUs();
+	j->due_us = j->last_us + config.start_ms * 1000;
+	if (m_metrics) {
+		j->cpu_share_gauge = m_metrics->addGauge("minetest_core_server_job_cpu_share",
+				"Share of server job workers time used by a job",
+				{{"job", config.name}});
+		j->over_budget_counter = m_metrics->addCounter(
+				"minetest_core_server_job_over_budget",
+				"Job steps which took longer than their time budget",
+				{{"job", config.name}});
+	}
+	const auto lock = std::lock_guard(m_waiting_mutex);
+	m_waiting.emplace_back(j.get());
+}
+
+void job_scheduler::push(size_t queue, work &&w)
+{
+	auto &q = *m_queues[queue];
+	{
+		const auto lock = std::lock_guard(q.mutex);
+		const auto it = std::find_if(q.queue.begin(), q.queue.end(),
+				[&](const work &other) { return other.priority < w.priority; });
+		q.queue.insert(it, std::move(w));
+	}
+	++m_queued;
+	// a worker between its checks and wait_for_work() holds the mutex
+	{
+		const auto lock = std::lock_guard(m_waiting_mutex);
+	}
+	m_waiting_cv.notify_all();
+}
+
+bool job_scheduler::pop(size_t queue, work &w)
+{
+	auto &q = *m_queues[queue];
+	const auto lock = std::lock_guard(q.mutex);
+	if (q.queue.empty())
+		return false;
+	w = std::move(q.queue.front());
+	q.queue.pop_front();
+	--m_queued;
+	return true;
+}
+
+bool job_scheduler::steal(size_t queue, work &w)
+{
+	for (size_t i = 1; i < m_queues.size(); ++i)
+		if (pop((queue + i) % m_queues.size(), w))
+			return true;
+	return false;
+}
+
+bool job_scheduler::takeDue(size_t queue, work &w)
+{
+	std::vector<job *> due;
+	{
+		const auto now = porting::getTimeUs();
+		const auto lock = std::lock_guard(m_waiting_mutex);
+		for (auto it = m_waiting.begin(); it != m_waiting.end();) {
+			if ((*it)->due_us > now) {
+				++it;
+				continue;
+			}
+			due.emplace_back(*it);
+			it = m_waiting.erase(it);
+		}
+	}
+	if (due.empty())
+		return false;
+
+	std::sort(due.begin(), due.end(), [](const job *a, const job *b) {
+		return a->config.priority > b->config.priority;
+	});
+	w = {.periodic = due.front(), .batch = {}, .priority = due.front()->config.priority};
+	// the rest goes where idle workers can steal it
+	for (size_t i = 1; i < due.size(); ++i)
+		push(queue, {.periodic = due[i], .batch = {}, .priority = due[i]->config.priority});
+	return true;
+}
+
+void job_scheduler::task_batch::help()
+{
+	for (size_t i; (i = next++) < size;) {
+		try {
+			(*tasks)[i]();
+		} catch (...) {
+			const auto lock = std::lock_guard(error_mutex);
+			if (!error)
+				error = std::current_exception();
+		}
+		++done;
+		done.notify_all();
+	}
+}
+
+void job_scheduler::execute(size_t queue, work &w)
+{
+	if (w.batch) {
+		w.batch->help();
+		return;
+	}
+
+	auto &j = *w.periodic;
+	const auto start_us = porting::getTimeUs();
+	const float dtime = (start_us - j.last_us) / 1000000.0f;
+	j.last_us = start_us;
+	current_priority = j.config.priority;
+	// as the dedicated thread of the job had before
+	if (j.config.priority && j.config.priority != current_os_priority) {
+		porting::setThreadPriority(j.config.priority);
+		current_os_priority = j.config.priority;
+	}
+
+	unsigned int delay_ms = 1000;
+	try {
+		delay_ms = j.step(dtime, j.config.budget_ms);
+#if !EXCEPTION_DEBUG
+	} catch (const std::exception &e) {
+		errorstream << j.config.name << ": exception: " << e.what() << std::endl
+					<< stacktrace() << std::endl;
+	} catch (...) {
+		errorstream << j.config.name << ": Unknown unhandled exception at "
+					<< __PRETTY_FUNCTION__ << ":" << __LINE__ << std::endl
+					<< stacktrace() << std::endl;
+#else
+	} catch (int) { // nothing
+#endif
+	}
+
+	const auto end_us = porting::getTimeUs();
+	j.busy_us += end_us - start_us;
+	if (end_us - start_us > j.config.budget_ms * 1000ULL) {
+		g_profiler->add("Server: job over budget " + j.config.name, 1);
+		if (j.over_budget_counter)
+			j.over_budget_counter->increment();
+	}
+
+	if (!delay_ms) {
+		push(queue, {.periodic = &j, .batch = {}, .priority = j.config.priority});
+		return;
+	}
+	j.due_us = end_us + delay_ms * 1000ULL;
+	{
+		const auto lock = std::lock_guard(m_waiting_mutex);
+		m_waiting.emplace_back(&j);
+	}
+	m_waiting_cv.notify_all();
+}
+
+void job_scheduler::wait_for_work()
+{
+	auto lock = std::unique_lock(m_waiting_mutex);
+	if (m_queued)
+		return;
+	const auto now = porting::getTimeUs();
+	uint64_t wake = now + WAIT_MAX_US;
+	for (const auto *j : m_waiting)
+		wake = std::min(wake, j->due_us);
+	if (wake <= now)
+		return;
+	m_waiting_cv.wait_for(lock, std::chrono::microseconds(wake - now));
+}
+
+void job_scheduler::reportMetrics(uint64_t now_us)
+{
+	auto last = m_report_us.load();
+	if (now_us - last < REPORT_EVERY_US ||
+			!m_report_us.compare_exchange_strong(last, now_us))
+		return;
+	if (!last)
+		return;
+
+	const double total_us = double(now_us - last) * m_queues.size();
+	for (auto &j : m_jobs) {
+		const uint64_t busy = j->busy_us;
+		const auto share = (busy - j->busy_reported_us) / total_us;
+		j->busy_reported_us = busy;
+		if (j->cpu_share_gauge)
+			j->cpu_share_gauge->set(share);
+	}
+}
+
+void *job_scheduler::run()
+{
+	BEGIN_DEBUG_EXCEPTION_HANDLER
+
+	const size_t queue = m_next_queue++ % m_queues.size();
+	current_scheduler = this;
+	current_queue = queue;
+	++m_workers;
+
+	while (!stopRequested()) {
+		work w;
+		if (pop(queue, w) || steal(queue, w) || takeDue(queue, w))
+			execute(queue, w);
+		else
+			wait_for_work();
+		reportMetrics(porting::getTimeUs());
+	}
+
+	--m_workers;
+	current_scheduler = nullptr;
+
+	END_DEBUG_EXCEPTION_HANDLER
+	return nullptr;
+}
+
+void job_scheduler::run_tasks(std::vector<task_func> &tasks)
+{
+	if (tasks.empty())
+		return;
+
+	auto batch = std::make_shared<task_batch>();
+	batch->tasks = &tasks;
+	batch->size = tasks.size();
+
+	// queued leftovers of a finished batch are harmless: nothing left to take
+	if (tasks.size() > 1 && m_workers) {
+		const bool worker = current_scheduler == this;
+		const size_t queue = worker ? current_queue : 0;
+		const int priority = worker ? current_priority : 0;
+		// one entry per helper, every entry works until the batch is empty
+		const auto helpers = std::min(tasks.size(), m_queues.size()) - (worker ? 1 : 0);
+		for (size_t i = 0; i < helpers; ++i)
+			push(queue, {.periodic = nullptr, .batch = batch, .priority = priority});
+	}
+
+	batch->help();
+
+	for (size_t done; (done = batch->done) < batch->size;)
+		batch->done.wait(done);
+
+	if (batch->error)
+		std::rethrow_exception(batch->error);
+}
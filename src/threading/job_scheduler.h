@@ -0,0 +1,146 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "thread_vector.h"
+#include "util/metricsbackend.h"
+
+/*
+Work-stealing scheduler for the periodic server loops (jobs) and for short
+parallel tasks spawned by them.
+
+A job is a step function which returns the delay in ms until its next run.
+A job never runs on two workers at once, but any worker can run it:
+each worker takes work from its own queue first, then steals from the
+other queues, then picks due jobs (highest priority first) and hands the
+rest to its queue where idle workers can steal them.
+
+run_tasks() splits work into tasks which idle workers steal while the caller
+works on the same batch, so a backlogged job borrows otherwise idle cores.
+
+Busy time of every job is reported as share of all workers time through
+the metrics backend.
+*/
+
+class job_scheduler : public thread_vector
+{
+public:
+	// Returns the delay in ms until the next run
+	using step_func = std::function<unsigned int(float dtime, unsigned int budget_ms)>;
+	using task_func = std::function<void()>;
+
+	struct job_config
+	{
+		std::string name;
+		// Of due jobs higher priority runs first,
+		// also the OS priority of the worker while it runs the job
+		int priority = 0;
+		// Time budget of one step, passed to the step, longer steps are counted
+		unsigned int budget_ms = 1000;
+		// Delay of the first run
+		unsigned int start_ms = 0;
+	};
+
+	job_scheduler(const std::string &name, size_t threads,
+			MetricsBackend *metrics = nullptr);
+	~job_scheduler();
+
+	// Call before start
+	void add(const job_config &config, const step_func &step);
+
+	// Run all tasks, on idle workers and the calling thread; returns when all are done.
+	// Rethrows the first exception of a task.
+	void run_tasks(std::vector<task_func> &tasks);
+
+	size_t getThreads() const { return m_queues.size(); }
+	void *run() override;
+
+private:
+	struct job
+	{
+		job_config config;
+		step_func step;
+		uint64_t due_us = 0;
+		uint64_t last_us = 0;
+		std::atomic_uint64_t busy_us{0};
+		uint64_t busy_reported_us = 0;
+		MetricGaugePtr cpu_share_gauge;
+		MetricCounterPtr over_budget_counter;
+	};
+
+	struct task_batch
+	{
+		std::vector<task_func> *tasks = nullptr;
+		size_t size = 0;
+		std::atomic_size_t next{0};
+		std::atomic_size_t done{0};
+		std::mutex error_mutex;
+		std::exception_ptr error;
+
+		// Run tasks of the batch until none left
+		void help();
+	};
+
+	struct work
+	{
+		job *periodic = nullptr;
+		std::shared_ptr<task_batch> batch;
+		int priority = 0;
+	};
+
+	struct worker_queue
+	{
+		std::mutex mutex;
+		// sorted by priority, highest first
+		std::deque<work> queue;
+	};
+
+	void push(size_t queue, work &&w);
+	bool pop(size_t queue, work &w);
+	bool steal(size_t queue, work &w);
+	bool takeDue(size_t queue, work &w);
+	void execute(size_t queue, work &w);
+	void wait_for_work();
+	void reportMetrics(uint64_t now_us);
+
+	MetricsBackend *m_metrics;
+	std::vector<std::unique_ptr<job>> m_jobs;
+	std::vector<std::unique_ptr<worker_queue>> m_queues;
+	std::atomic_size_t m_next_queue{0};
+	// running workers
+	std::atomic_size_t m_workers{0};
+	// work items in all queues
+	std::atomic_size_t m_queued{0};
+
+	// jobs waiting for their time
+	std::mutex m_waiting_mutex;
+	std::condition_variable m_waiting_cv;
+	std::vector<job *> m_waiting;
+
+	std::atomic_uint64_t m_report_us{0};
+};
@@ -0,0 +1,153 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/*
+Multi producer multi consumer queue.
+
+Fast path is a bounded lock-free ring (D. Vyukov's sequence per cell),
+producers and consumers only race on one atomic each.
+When the ring is full, items go to a mutex guarded overflow deque, so push never
+fails; consumers look there after the ring is empty. Order is FIFO as long as
+the ring does not overflow.
+*/
+
+template <class T, size_t CAPACITY = 4096>
+class mpmc_queue
+{
+	static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0,
+			"CAPACITY must be a power of two");
+
+public:
+	mpmc_queue() : m_cells{std::make_unique<std::array<cell, CAPACITY>>()}
+	{
+		for (size_t i = 0; i < CAPACITY; ++i)
+			(*m_cells)[i].seq.store(i, std::memory_order_relaxed);
+	}
+	mpmc_queue(const mpmc_queue &) = delete;
+	mpmc_queue &operator=(const mpmc_queue &) = delete;
+
+	template <class V>
+	void push(V &&value)
+	{
+		++m_size;
+		if (try_push_ring(std::forward<V>(value)))
+			return;
+		const auto lock = std::lock_guard(m_overflow_mutex);
+		m_overflow.emplace_back(std::forward<V>(value));
+		++m_overflow_size;
+	}
+
+	bool try_pop(T &value)
+	{
+		if (try_pop_ring(value) || try_pop_overflow(value)) {
+			--m_size;
+			return true;
+		}
+		return false;
+	}
+
+	// Approximate while other threads push or pop
+	size_t size() const { return m_size.load(std::memory_order_relaxed); }
+	bool empty() const { return !size(); }
+
+private:
+	struct cell
+	{
+		std::atomic_size_t seq;
+		T value;
+	};
+
+	template <class V>
+	bool try_push_ring(V &&value)
+	{
+		auto pos = m_enqueue_pos.load(std::memory_order_relaxed);
+		for (;;) {
+			auto &c = (*m_cells)[pos & (CAPACITY - 1)];
+			const auto seq = c.seq.load(std::memory_order_acquire);
+			const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+			if (diff == 0) {
+				if (m_enqueue_pos.compare_exchange_weak(
+							pos, pos + 1, std::memory_order_relaxed)) {
+					c.value = std::forward<V>(value);
+					c.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+				return false; // full
+			} else {
+				pos = m_enqueue_pos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool try_pop_ring(T &value)
+	{
+		auto pos = m_dequeue_pos.load(std::memory_order_relaxed);
+		for (;;) {
+			auto &c = (*m_cells)[pos & (CAPACITY - 1)];
+			const auto seq = c.seq.load(std::memory_order_acquire);
+			const auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+			if (diff == 0) {
+				if (m_dequeue_pos.compare_exchange_weak(
+							pos, pos + 1, std::memory_order_relaxed)) {
+					value = std::move(c.value);
+					c.value = T{};
+					c.seq.store(pos + CAPACITY, std::memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+				return false; // empty
+			} else {
+				pos = m_dequeue_pos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool try_pop_overflow(T &value)
+	{
+		if (!m_overflow_size.load(std::memory_order_acquire))
+			return false;
+		const auto lock = std::lock_guard(m_overflow_mutex);
+		if (m_overflow.empty())
+			return false;
+		value = std::move(m_overflow.front());
+		m_overflow.pop_front();
+		--m_overflow_size;
+		return true;
+	}
+
+	static constexpr size_t CACHE_LINE = 64;
+
+	std::unique_ptr<std::array<cell, CAPACITY>> m_cells;
+	alignas(CACHE_LINE) std::atomic_size_t m_enqueue_pos{0};
+	alignas(CACHE_LINE) std::atomic_size_t m_dequeue_pos{0};
+	alignas(CACHE_LINE) std::atomic_size_t m_size{0};
+
+	std::atomic_size_t m_overflow_size{0};
+	std::mutex m_overflow_mutex;
+	std::deque<T> m_overflow;
+};
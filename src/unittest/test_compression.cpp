@@ -10,6 +10,7 @@
 #include "serialization.h"
 #include "nodedef.h"
 #include "noise.h"
+#include "util/serialize.h"
 
 class TestCompression : public TestBase {
 public:
@@ -22,6 +23,7 @@ class TestCompression : public TestBase {
 	void testZlibCompression();
 	void testZlibLargeData();
 	void testZstdLargeData();
+	void testZstdDictionary();
 	void testZlibLimit();
 	void _testZlibLimit(u32 size, u32 limit);
 };
@@ -34,6 +36,7 @@ void TestCompression::runTests(IGameDef *gamedef)
 	TEST(testZlibCompression);
 	TEST(testZlibLargeData);
 	TEST(testZstdLargeData);
+	TEST(testZstdDictionary);
 	TEST(testZlibLimit);
 }
 
@@ -196,6 +199,83 @@ void TestCompression::testZstdLargeData()
 	}
 }
 
+// Something like an uncompressed version 29 map block
+static std::string makeBlockLikeData(u32 seed)
+{
+	PseudoRandom pr(seed);
+	std::ostringstream os(std::ios::binary);
+	writeU8(os, 0x08);
+	writeU16(os, 0xffff);
+	writeU32(os, pr.next());
+	writeU8(os, 0);
+	const char *names[] = {"air", "default:stone", "default:dirt",
+			"default:dirt_with_grass", "default:stone_with_coal", "default:water_source"};
+	writeU16(os, 6);
+	for (u16 i = 0; i < 6; i++) {
+		writeU16(os, i);
+		os << serializeString16(names[i]);
+	}
+	writeU8(os, 2);
+	writeU8(os, 2);
+	// stone below a surface at a random height, some ores
+	const int surface = pr.range(0, 15);
+	for (int i = 0; i < 4096; i++) {
+		const int y = i / 16 % 16;
+		u16 c = y > surface ? 0 : y == surface ? 3 : y > surface - 3 ? 2 : 1;
+		if (c == 1 && pr.range(0, 30) == 0)
+			c = 4;
+		writeU16(os, c);
+	}
+	for (int i = 0; i < 4096; i++)
+		writeU8(os, i / 16 % 16 > surface ? 0xff : 0);
+	for (int i = 0; i < 4096; i++)
+		writeU8(os, 0);
+	// no metadata, static objects and timers
+	writeU8(os, 0);
+	writeU8(os, 0);
+	writeU16(os, 0);
+	writeU8(os, 10);
+	writeU16(os, 0);
+	return os.str();
+}
+
+void TestCompression::testZstdDictionary()
+{
+	std::vector<std::string> samples;
+	for (u32 i = 0; i < 200; i++)
+		samples.emplace_back(makeBlockLikeData(i));
+	const auto dictionary = trainZstdDictionary(samples, 16 * 1024);
+	UASSERT(!dictionary.empty());
+	const u32 id = addZstdDictionary(dictionary);
+	UASSERT(id != 0);
+	UASSERTEQ(u32, addZstdDictionary(dictionary), id);
+	UASSERTEQ(u32, addZstdDictionary("not a dictionary"), 0);
+
+	const auto data = makeBlockLikeData(1000);
+	const auto roundtrip = [&](u32 dict) {
+		std::ostringstream os(std::ios::binary);
+		compress(data, os, 29, -1, dict);
+		std::istringstream is(os.str(), std::ios::binary);
+		std::ostringstream out(std::ios::binary);
+		decompress(is, out, 29);
+		UASSERT(out.str() == data);
+		return os.str().size();
+	};
+	// in turns, a dictionary must not stick to the reused contexts
+	const auto plain_size = roundtrip(0);
+	const auto dict_size = roundtrip(id);
+	UASSERTEQ(size_t, roundtrip(0), plain_size);
+	UASSERT(dict_size < plain_size);
+
+	// other levels have their own digested dictionary
+	std::ostringstream os(std::ios::binary);
+	compressZstd(data, os, 9, id);
+	std::istringstream is(os.str(), std::ios::binary);
+	std::ostringstream out(std::ios::binary);
+	decompressZstd(is, out);
+	UASSERT(out.str() == data);
+}
+
 void TestCompression::testZlibLimit()
 {
 	// edge cases
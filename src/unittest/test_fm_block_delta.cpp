@@ -0,0 +1,185 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include <sstream>
+
+#include "exceptions.h"
+#include "fm_block_delta.h"
+#include "server/fm_block_snapshots.h"
+
+class TestFmBlockDelta : public TestBase
+{
+public:
+	TestFmBlockDelta() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestFmBlockDelta"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testRoundTrip();
+	void testMono();
+	void testMalformed();
+	void testSnapshots();
+	void testClientVersions();
+};
+
+static TestFmBlockDelta g_test_instance;
+
+static constexpr size_t NODES = 4096;
+
+void TestFmBlockDelta::runTests(IGameDef *gamedef)
+{
+	TEST(testRoundTrip);
+	TEST(testMono);
+	TEST(testMalformed);
+	TEST(testSnapshots);
+	TEST(testClientVersions);
+}
+
+static std::string encode(const std::vector<MapNode> &base, const std::vector<MapNode> &now)
+{
+	std::ostringstream os(std::ios_base::binary);
+	block_delta::encode(os, base.data(), base.size(), now.data(), now.size(), NODES);
+	return os.str();
+}
+
+static std::vector<MapNode> decode(std::vector<MapNode> nodes, const std::string &delta)
+{
+	std::istringstream is(delta, std::ios_base::binary);
+	block_delta::decode(is, nodes.data(), NODES);
+	return nodes;
+}
+
+void TestFmBlockDelta::testRoundTrip()
+{
+	std::vector<MapNode> base(NODES);
+	for (size_t i = 0; i < NODES; ++i)
+		base[i] = MapNode(i % 7, i % 16, 0);
+
+	// nothing changed
+	UASSERTEQ(size_t, encode(base, base).size(), 3);
+
+	// scattered changes: list
+	auto now = base;
+	for (size_t i = 0; i < NODES; i += 500)
+		now[i].param2 = 3;
+	auto delta = encode(base, now);
+	UASSERTEQ(int, delta[0], block_delta::FORM_LIST);
+	UASSERT(decode(base, delta) == now);
+
+	// bulk edit: runs
+	now = base;
+	for (size_t i = 1000; i < 1300; ++i)
+		now[i] = MapNode(CONTENT_AIR);
+	delta = encode(base, now);
+	UASSERTEQ(int, delta[0], block_delta::FORM_RUNS);
+	UASSERT(delta.size() < 300 * 6);
+	UASSERT(decode(base, delta) == now);
+}
+
+void TestFmBlockDelta::testMono()
+{
+	const std::vector<MapNode> air{MapNode(CONTENT_AIR)};
+	std::vector<MapNode> now(NODES, MapNode(CONTENT_AIR));
+	now[17] = MapNode(5);
+
+	// dug into a mono block
+	const auto delta = encode(air, now);
+	UASSERT(decode(std::vector<MapNode>(NODES, air[0]), delta) == now);
+
+	// to a mono block
+	const auto back = encode(now, air);
+	UASSERT(decode(now, back) == std::vector<MapNode>(NODES, air[0]));
+}
+
+void TestFmBlockDelta::testMalformed()
+{
+	std::vector<MapNode> nodes(NODES);
+	const auto throws = [&](const std::string &delta) {
+		try {
+			decode(nodes, delta);
+		} catch (const SerializationError &) {
+			return true;
+		}
+		return false;
+	};
+	// run out of block
+	UASSERT(throws(std::string("\x00\x00\x01\x0f\xff\x00\x02", 7) + std::string(8, '\0')));
+	// index out of block
+	UASSERT(throws(std::string("\x01\x00\x01\x10\x00", 5) + std::string(4, '\0')));
+	// truncated
+	UASSERT(throws(std::string("\x01\x00\x02\x00\x01", 5)));
+	UASSERT(throws(std::string("\x05\x00\x00", 3)));
+}
+
+void TestFmBlockDelta::testSnapshots()
+{
+	block_snapshots snapshots(1 << 20);
+	const v3bpos_t pos{1, 2, 3};
+	const auto nodes = [](size_t count) {
+		return std::make_shared<const std::vector<MapNode>>(count);
+	};
+
+	UASSERT(!snapshots.get(pos, 1));
+	for (uint64_t v = 1; v <= block_snapshots::VERSIONS + 1; ++v)
+		snapshots.put(pos, v, nodes(v == 1 ? 1 : NODES));
+	// the oldest is dropped
+	UASSERT(!snapshots.get(pos, 1));
+	UASSERT(snapshots.get(pos, 2) && snapshots.get(pos, 2)->size() == NODES);
+	UASSERTEQ(size_t, snapshots.bytes(),
+			block_snapshots::VERSIONS * NODES * sizeof(MapNode));
+
+	snapshots.clear();
+	UASSERT(!snapshots.get(pos, 2));
+	UASSERTEQ(size_t, snapshots.bytes(), 0);
+
+	// 16 shards of one block
+	block_snapshots small(16 * NODES * sizeof(MapNode));
+	for (bpos_t i = 0; i < 100; ++i)
+		small.put({i, 0, 0}, 1, nodes(NODES));
+	UASSERT(small.bytes() <= 16 * NODES * sizeof(MapNode));
+	UASSERT(small.get({99, 0, 0}, 1));
+}
+
+void TestFmBlockDelta::testClientVersions()
+{
+	block_client_versions versions;
+	const v3bpos_t pos{1, 2, 3};
+
+	UASSERTEQ(uint64_t, versions.get(pos), 0);
+	versions.sent(pos, 5);
+	// on the way
+	UASSERTEQ(uint64_t, versions.get(pos), 0);
+	versions.acked(pos);
+	UASSERTEQ(uint64_t, versions.get(pos), 5);
+
+	versions.sent(pos, 7);
+	versions.sent(pos, 9);
+	versions.acked(pos);
+	UASSERTEQ(uint64_t, versions.get(pos), 0);
+	versions.acked(pos);
+	UASSERTEQ(uint64_t, versions.get(pos), 9);
+
+	// acks of unknown blocks are ignored
+	versions.acked({0, 0, 0});
+	versions.acked(pos);
+	UASSERTEQ(uint64_t, versions.get(pos), 9);
+
+	versions.erase(pos);
+	UASSERTEQ(uint64_t, versions.get(pos), 0);
+}
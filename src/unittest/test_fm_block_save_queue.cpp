@@ -0,0 +1,208 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include <atomic>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include "database/database.h"
+#include "serialization.h"
+#include "server/fm_block_save_queue.h"
+#include "servermap.h"
+
+namespace
+{
+// Records writes in order
+class RecordingDatabase : public MapDatabase
+{
+public:
+	std::vector<std::pair<v3bpos_t, std::string>> writes;
+	int transactions = 0;
+	bool in_transaction = false;
+
+	void beginSave() override
+	{
+		UASSERT(!in_transaction);
+		in_transaction = true;
+	}
+	void endSave() override
+	{
+		UASSERT(in_transaction);
+		in_transaction = false;
+		++transactions;
+	}
+	bool saveBlock(const v3bpos_t &pos, std::string_view data) override
+	{
+		UASSERT(in_transaction);
+		if (throw_writes) {
+			--throw_writes;
+			throw std::runtime_error("write failed");
+		}
+		if (fail_writes) {
+			--fail_writes;
+			return false;
+		}
+		writes.emplace_back(pos, data);
+		return true;
+	}
+
+	// the next writes fail, unlimited if negative
+	std::atomic_int fail_writes{0};
+	// the next writes throw, like SQLite on a failed step
+	std::atomic_int throw_writes{0};
+	void loadBlock(const v3bpos_t &pos, std::string *block) override {}
+	bool deleteBlock(const v3bpos_t &pos) override { return true; }
+	void listAllLoadableBlocks(std::vector<v3bpos_t> &dst) override {}
+};
+
+std::string uncompress(const std::string &data)
+{
+	std::istringstream is(data.substr(1), std::ios_base::binary);
+	std::ostringstream os(std::ios_base::binary);
+	decompress(is, os, data[0]);
+	return os.str();
+}
+}
+
+class TestFmBlockSaveQueue : public TestBase
+{
+public:
+	TestFmBlockSaveQueue() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestFmBlockSaveQueue"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testWriteBehind();
+	void testFailedWrite();
+};
+
+static TestFmBlockSaveQueue g_test_instance;
+
+void TestFmBlockSaveQueue::runTests(IGameDef *gamedef)
+{
+	TEST(testWriteBehind);
+	TEST(testFailedWrite);
+}
+
+void TestFmBlockSaveQueue::testWriteBehind()
+{
+	RecordingDatabase db;
+	MapDatabaseAccessor accessor;
+	accessor.dbase = &db;
+	MetricsBackend metrics;
+	const u8 version = SER_FMT_VER_HIGHEST_WRITE;
+
+	std::vector<std::string> expected(100);
+	{
+		// small queue: push waits for the writer
+		block_save_queue queue(accessor, 3, 8, -1, &metrics);
+		for (bpos_t i = 0; i < 100; ++i) {
+			expected[i] = std::string(1000 + i, 'a' + i % 26);
+			queue.push({i, 0, 0}, version, std::string(expected[i]));
+		}
+		// newer data of the same block is written last
+		expected[5] = "newer";
+		queue.push({5, 0, 0}, version, std::string(expected[5]));
+
+		std::string data;
+		if (queue.get({5, 0, 0}, data))
+			UASSERT(uncompress(data) == "newer");
+
+		queue.flush();
+		UASSERTEQ(size_t, queue.size(), 0);
+		UASSERT(!queue.get({5, 0, 0}, data));
+	}
+
+	UASSERT(!db.in_transaction);
+	UASSERTEQ(size_t, db.writes.size(), 101);
+	UASSERT(db.transactions >= 1);
+	for (bpos_t i = 0; i < 100; ++i) {
+		UASSERT(db.writes[i].first == v3bpos_t(i, 0, 0));
+		if (i != 5)
+			UASSERT(uncompress(db.writes[i].second) == expected[i]);
+	}
+	UASSERT(db.writes[100].first == v3bpos_t(5, 0, 0));
+	UASSERT(uncompress(db.writes[100].second) == "newer");
+}
+
+void TestFmBlockSaveQueue::testFailedWrite()
+{
+	RecordingDatabase db;
+	MapDatabaseAccessor accessor;
+	accessor.dbase = &db;
+	MetricsBackend metrics;
+	const u8 version = SER_FMT_VER_HIGHEST_WRITE;
+
+	{
+		block_save_queue queue(accessor, 1, 8, -1, &metrics);
+		queue.retry_interval = std::chrono::milliseconds(1);
+		db.fail_writes = 5;
+		for (bpos_t i = 0; i < 10; ++i)
+			queue.push({i, 0, 0}, version, std::to_string(i));
+
+		// written again until the database takes them
+		queue.flush();
+		UASSERTEQ(int, db.fail_writes, 0);
+		UASSERTEQ(size_t, queue.size(), 0);
+	}
+	UASSERT(!db.in_transaction);
+	std::vector<bool> written(10);
+	for (const auto &[pos, data] : db.writes) {
+		UASSERT(pos.X >= 0 && pos.X < 10);
+		UASSERT(uncompress(data) == std::to_string(pos.X));
+		written[pos.X] = true;
+	}
+	for (bpos_t i = 0; i < 10; ++i)
+		UASSERT(written[i]);
+
+	// a throwing write still ends the transaction
+	db.writes.clear();
+	{
+		block_save_queue queue(accessor, 1, 8, -1, &metrics);
+		queue.retry_interval = std::chrono::milliseconds(1);
+		db.throw_writes = 3;
+		for (bpos_t i = 0; i < 10; ++i)
+			queue.push({i, 0, 0}, version, std::to_string(i));
+		queue.flush();
+		UASSERTEQ(int, db.throw_writes, 0);
+	}
+	UASSERT(!db.in_transaction);
+	written.assign(10, false);
+	for (const auto &[pos, data] : db.writes)
+		written[pos.X] = true;
+	for (bpos_t i = 0; i < 10; ++i)
+		UASSERT(written[i]);
+
+	// still readable from the queue while the database fails
+	db.writes.clear();
+	db.fail_writes = -1;
+	{
+		block_save_queue queue(accessor, 1, 8, -1, &metrics);
+		queue.retry_interval = std::chrono::milliseconds(1);
+		queue.push({1, 2, 3}, version, "kept");
+		std::string data;
+		for (int i = 0; i < 10; ++i) {
+			UASSERT(queue.get({1, 2, 3}, data));
+			UASSERT(uncompress(data) == "kept");
+		}
+		UASSERTEQ(size_t, queue.size(), 1);
+		// given up on destruction
+	}
+	UASSERT(db.writes.empty());
+}
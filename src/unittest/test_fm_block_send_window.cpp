@@ -0,0 +1,148 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include "server/fm_block_send_window.h"
+
+class TestFmBlockSendWindow : public TestBase
+{
+public:
+	TestFmBlockSendWindow() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestFmBlockSendWindow"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testGrowOnAcks();
+	void testShrinkOnQueueing();
+	void testLost();
+	void testNoAcks();
+};
+
+static TestFmBlockSendWindow g_test_instance;
+
+void TestFmBlockSendWindow::runTests(IGameDef *gamedef)
+{
+	TEST(testGrowOnAcks);
+	TEST(testShrinkOnQueueing);
+	TEST(testLost);
+	TEST(testNoAcks);
+}
+
+void TestFmBlockSendWindow::testGrowOnAcks()
+{
+	block_send_window window(8, 64);
+	uint64_t now = 1000;
+	window.update(now);
+	UASSERTEQ(uint32_t, window.available(), 8);
+
+	window.sent(8, now);
+	UASSERTEQ(uint32_t, window.available(), 0);
+	UASSERTEQ(uint32_t, window.inFlight(), 8);
+
+	now += 10;
+	window.acked(8, now);
+	UASSERTEQ(uint32_t, window.inFlight(), 0);
+	UASSERT(window.rtt() == 10);
+	// slow start: every acked block adds one
+	UASSERTEQ(uint32_t, window.limit(), 16);
+
+	for (int i = 0; i < 10; ++i) {
+		window.sent(window.available(), now);
+		now += 10;
+		window.acked(window.inFlight(), now);
+	}
+	UASSERTEQ(uint32_t, window.limit(), 64);
+
+	// duplicate acks change nothing
+	window.acked(10, now);
+	UASSERTEQ(uint32_t, window.inFlight(), 0);
+	UASSERTEQ(uint32_t, window.limit(), 64);
+}
+
+void TestFmBlockSendWindow::testShrinkOnQueueing()
+{
+	block_send_window window(32, 64);
+	uint64_t now = 1000;
+	window.sent(16, now);
+	now += 10;
+	window.acked(16, now);
+	const auto grown = window.limit();
+
+	// acks come much later than the lowest RTT
+	for (int i = 0; i < 20; ++i) {
+		window.sent(window.available(), now);
+		now += 200;
+		window.acked(window.inFlight(), now);
+	}
+	UASSERT(window.rtt() > 100);
+	UASSERT(window.limit() < grown);
+	UASSERT(window.limit() >= block_send_window::MIN);
+}
+
+void TestFmBlockSendWindow::testLost()
+{
+	block_send_window window(16, 64);
+	uint64_t now = 1000;
+	window.sent(4, now);
+	now += 10;
+	window.acked(4, now);
+
+	window.sent(16, now);
+	window.update(now + 500);
+	UASSERTEQ(uint32_t, window.inFlight(), 16);
+
+	now += block_send_window::LOST_MIN_MS + 1;
+	window.update(now);
+	UASSERTEQ(uint32_t, window.inFlight(), 0);
+	UASSERTEQ(uint32_t, window.limit(), block_send_window::MIN);
+
+	// late acks of lost blocks
+	window.acked(16, now);
+	UASSERTEQ(uint32_t, window.inFlight(), 0);
+}
+
+void TestFmBlockSendWindow::testNoAcks()
+{
+	block_send_window window(8, 64);
+	uint64_t now = 1000;
+	window.sent(8, now);
+	window.update(now + 10);
+	UASSERTEQ(uint32_t, window.available(), 0);
+
+	now += block_send_window::NO_ACKS_MS + 1;
+	window.update(now);
+	UASSERTEQ(uint32_t, window.available(), 64);
+	UASSERTEQ(uint32_t, window.inFlight(), 0);
+
+	// sends are not tracked meanwhile
+	for (int i = 0; i < 1000; ++i) {
+		window.sent(64, ++now);
+		window.update(now);
+	}
+	UASSERTEQ(uint32_t, window.inFlight(), 0);
+
+	// a late ack turns the window on again
+	UASSERT(window.acked(8, ++now) < 0);
+	UASSERTEQ(uint32_t, window.limit(), 8);
+	window.sent(8, ++now);
+	window.update(now);
+	UASSERTEQ(uint32_t, window.inFlight(), 8);
+	UASSERTEQ(uint32_t, window.available(), 0);
+	UASSERT(window.acked(8, now + 50) >= 0);
+	UASSERTEQ(uint32_t, window.inFlight(), 0);
+}
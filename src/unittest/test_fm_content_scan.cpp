@@ -0,0 +1,82 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include <algorithm>
+#include "fm_content_scan.h"
+
+class TestFmContentScan : public TestBase
+{
+public:
+	TestFmContentScan() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestFmContentScan"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testCollect();
+	void testMatch();
+};
+
+static TestFmContentScan g_test_instance;
+
+void TestFmContentScan::runTests(IGameDef *gamedef)
+{
+	TEST(testCollect);
+	TEST(testMatch);
+}
+
+void TestFmContentScan::testCollect()
+{
+	std::vector<content_t> contents;
+
+	// runs of any length, tails not a multiple of the vector width
+	std::vector<MapNode> data(4099, MapNode(5, 1, 2));
+	data[3] = MapNode(7);
+	data[4000] = MapNode(9, 5, 5);
+	data[4098] = MapNode(11);
+	for (size_t i = 100; i < 300; ++i)
+		data[i] = MapNode(i % 3 + 20);
+
+	content_scan::collect(data.data(), data.size(), contents);
+	UASSERT(contents == std::vector<content_t>({5, 7, 21, 22, 20, 9, 11}));
+
+	// nothing left over between calls
+	content_scan::collect(data.data(), 3, contents);
+	UASSERT(contents == std::vector<content_t>({5}));
+	content_scan::collect(data.data(), 0, contents);
+	UASSERT(contents.empty());
+}
+
+void TestFmContentScan::testMatch()
+{
+	std::vector<MapNode> data(4096 + 5);
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = MapNode(i * 7919 % 13, i % 256, 0);
+
+	const std::vector<content_t> values{3, 11, 1000};
+	std::vector<uint64_t> mask((data.size() + 63) / 64, ~uint64_t{});
+	content_scan::match(data.data(), data.size(), values.data(), values.size(), mask.data());
+	for (size_t i = 0; i < data.size(); ++i) {
+		const bool expected = std::find(values.begin(), values.end(),
+									  data[i].param0) != values.end();
+		UASSERTEQ(bool, bool(mask[i / 64] >> (i % 64) & 1), expected);
+	}
+
+	content_scan::match(data.data(), data.size(), values.data(), 0, mask.data());
+	UASSERT(std::all_of(mask.begin(), mask.end(), [](uint64_t w) { return !w; }));
+}
@@ -0,0 +1,123 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "test.h"
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
+#include "mapgen/earth/hgt.h"
+
+class TestFmHgtCache : public TestBase
+{
+public:
+	TestFmHgtCache() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestFmHgtCache"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testCacheLoad();
+	void testGetGrid();
+
+	std::string dir;
+};
+
+static TestFmHgtCache g_test_instance;
+
+void TestFmHgtCache::runTests(IGameDef *gamedef)
+{
+	dir = getTestTempDirectory() + DIR_DELIM + "hgt_cache";
+	std::filesystem::remove_all(dir);
+
+	TEST(testCacheLoad);
+	TEST(testGetGrid);
+
+	std::filesystem::remove_all(dir);
+}
+
+namespace
+{
+// 30" tile filled in memory and written to the cache like a downloaded one,
+// all heights above sea level so the seabed layer is never asked
+class test_tile : public height_hgt
+{
+public:
+	test_tile(const std::string &folder, int lat, int lon) :
+			height_hgt(folder, lat, lon)
+	{
+		const uint16_t side = 121;
+		side_length_x = side_length_y = side;
+		seconds_per_px_x = 3600 / (side - side_length_x_extra);
+		seconds_per_px_y = ceil(3600 / (float)side);
+		pixel_per_deg_x = pixel_per_deg_y = side;
+
+		heights.resize(side * side);
+		for (size_t i = 0; i < heights.size(); ++i)
+			heights[i] = 100 + (i % side) * 7 + (i / side) * 3 + (lat + lon) * 11;
+		data = heights.data();
+		lat_loaded = lat;
+		lon_loaded = lon;
+
+		char name[100];
+		std::snprintf(name, sizeof(name), "%c%02d%c%03d.hgt", lat >= 0 ? 'N' : 'S',
+				abs(lat), lon >= 0 ? 'E' : 'W', abs(lon));
+		saved = cache_save(folder + "/cache/" + name + ".tile");
+	}
+
+	bool saved = false;
+};
+} // namespace
+
+void TestFmHgtCache::testCacheLoad()
+{
+	test_tile tile(dir, 10, 20);
+	UASSERT(tile.saved);
+
+	// Mapped from the cache, nothing to download
+	height_hgt loaded(dir, 10.5, 20.5);
+	UASSERT(loaded.load(10.5, 20.5));
+	for (float lat = 10.01; lat < 11; lat += 0.097)
+		for (float lon = 20.01; lon < 21; lon += 0.113)
+			UASSERTEQ(float, loaded.get(lat, lon), tile.get(lat, lon));
+}
+
+void TestFmHgtCache::testGetGrid()
+{
+	UASSERT(test_tile(dir, 10, 20).saved);
+	UASSERT(test_tile(dir, 10, 21).saved);
+
+	// Across the border of the two tiles
+	const double lat0 = 10.2, lon0 = 20.9, step = 0.003;
+	const size_t n = 70, m = 20;
+
+	for (const size_t max_tiles : {64, 1}) {
+		hgts reader(dir);
+		reader.max_tiles = max_tiles;
+		std::vector<height::height_t> grid(n * m);
+		reader.get_grid(lat0, lon0, step, step, n, m, grid.data());
+		for (size_t j = 0; j < m; ++j)
+			for (size_t i = 0; i < n; ++i) {
+				const height::ll_t lat = lat0 + j * step;
+				const height::ll_t lon = lon0 + i * step;
+				UASSERTEQ(float, grid[j * n + i], reader.get(lat, lon));
+				UASSERT(grid[j * n + i] > 0);
+			}
+	}
+}
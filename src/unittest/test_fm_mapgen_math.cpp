@@ -0,0 +1,149 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "test.h"
+
+#include <cmath>
+#include <vector>
+
+#include "mapgen/mapgen.h"
+#include "mapgen/mapgen_math_fractal.h"
+#include "noise.h"
+
+class TestFmMapgenMath : public TestBase
+{
+public:
+	TestFmMapgenMath() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestFmMapgenMath"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testMandelboxBatch();
+	void testMengerspongeBatch();
+	void testMengerspongeEmpty();
+	void testAdaptiveSampler();
+};
+
+static TestFmMapgenMath g_test_instance;
+
+void TestFmMapgenMath::runTests(IGameDef *gamedef)
+{
+	TEST(testMandelboxBatch);
+	TEST(testMengerspongeBatch);
+	TEST(testMengerspongeEmpty);
+	TEST(testAdaptiveSampler);
+}
+
+namespace
+{
+struct points
+{
+	std::vector<double> x, y, z;
+
+	// A column through the fractal plus random points, not a multiple of the lanes
+	points(double extent, u32 count)
+	{
+		PcgRandom rand(1337);
+		for (u32 i = 0; i < count; ++i) {
+			if (i < count / 2) {
+				x.push_back(0.1 * extent);
+				y.push_back(extent * (2.0 * i / count - 0.5));
+				z.push_back(-0.2 * extent);
+			} else {
+				x.push_back(extent * (rand.next() / (double)U32_MAX * 2 - 1));
+				y.push_back(extent * (rand.next() / (double)U32_MAX * 2 - 1));
+				z.push_back(extent * (rand.next() / (double)U32_MAX * 2 - 1));
+			}
+		}
+	}
+};
+} // namespace
+
+void TestFmMapgenMath::testMandelboxBatch()
+{
+	const points p(0.5, 1003);
+	const double d = 0.001;
+	std::vector<double> out(p.x.size(), -1);
+	mapgen_math::mandelbox_batch(
+			p.x.data(), p.y.data(), p.z.data(), p.x.size(), d, 15, out.data());
+
+	u32 solid = 0;
+	for (size_t i = 0; i < p.x.size(); ++i) {
+		UASSERTEQ(double, out[i], mapgen_math::mandelbox(p.x[i], p.y[i], p.z[i], d, 15));
+		solid += out[i] > 0;
+	}
+	// Both solid and empty points were checked
+	UASSERT(solid > 0 && solid < p.x.size());
+}
+
+void TestFmMapgenMath::testMengerspongeBatch()
+{
+	const points p(2.0, 1003);
+	const double d = 0.001;
+	std::vector<double> out(p.x.size(), -1);
+	mapgen_math::mengersponge_batch(
+			p.x.data(), p.y.data(), p.z.data(), p.x.size(), d, 13, out.data());
+
+	u32 solid = 0;
+	for (size_t i = 0; i < p.x.size(); ++i) {
+		UASSERTEQ(double, out[i],
+				mapgen_math::mengersponge(p.x[i], p.y[i], p.z[i], d, 13));
+		solid += out[i] > 0;
+	}
+	UASSERT(solid > 0 && solid < p.x.size());
+}
+
+void TestFmMapgenMath::testMengerspongeEmpty()
+{
+	UASSERT(!mapgen_math::mengersponge_empty(8.0, 0.001));
+	UASSERT(!mapgen_math::mengersponge_empty(16.0, 4.0));
+	UASSERT(mapgen_math::mengersponge_empty(9.1, 0.001));
+
+	// Everything beyond the bound really is empty
+	const points p(100.0, 301);
+	for (size_t i = 0; i < p.x.size(); ++i) {
+		const double r2 = p.x[i] * p.x[i] + p.y[i] * p.y[i] + p.z[i] * p.z[i];
+		if (mapgen_math::mengersponge_empty(r2, 0.001))
+			UASSERTEQ(double, mapgen_math::mengersponge(p.x[i], p.y[i], p.z[i], 0.001, 13), 0);
+	}
+}
+
+void TestFmMapgenMath::testAdaptiveSampler()
+{
+	// A plane is never missed: corners on one side mean the whole cell is
+	const auto value = [](const v3pos_t &p) { return 0.3f * p.X - p.Y + 0.5f * p.Z + 5; };
+	const auto solid = [](float v) { return v >= 0; };
+	const v3pos_t min(-40, -41, -40), max(39, 40, 39);
+
+	AdaptiveSampler<float> sampler;
+	sampler.sample(min, max, 8, value, solid);
+	for (pos_t z = min.Z; z <= max.Z; ++z)
+		for (pos_t y = min.Y; y <= max.Y; ++y)
+			for (pos_t x = min.X; x <= max.X; ++x) {
+				const v3pos_t p(x, y, z);
+				UASSERTEQ(bool, solid(sampler.get(p)), solid(value(p)));
+			}
+	UASSERT(sampler.evaluated < 80 * 82 * 80 / 4);
+
+	// A box thinner than the step between lattice points disappears
+	sampler.sample(v3pos_t(0, 0, 0), v3pos_t(16, 16, 16), 16,
+			[](const v3pos_t &p) { return p == v3pos_t(8, 8, 8) ? 1.0f : -1.0f; },
+			solid);
+	UASSERT(!solid(sampler.get(v3pos_t(8, 8, 8))));
+	UASSERTEQ(u32, sampler.evaluated, 8);
+}
@@ -0,0 +1,105 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "util/metricsbackend.h"
+
+class TestFmMetricHistogram : public TestBase
+{
+public:
+	TestFmMetricHistogram() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestFmMetricHistogram"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testQuantile();
+	void testThreads();
+	void testTimer();
+};
+
+static TestFmMetricHistogram g_test_instance;
+
+void TestFmMetricHistogram::runTests(IGameDef *gamedef)
+{
+	TEST(testQuantile);
+	TEST(testThreads);
+	TEST(testTimer);
+}
+
+void TestFmMetricHistogram::testQuantile()
+{
+	MetricsBackend metrics;
+	auto histogram = metrics.addHistogram("test", "", {1, 2, 4, 8});
+	UASSERTEQ(uint64_t, histogram->getCount(), 0);
+	UASSERTEQ(double, histogram->getQuantile(0.5), 0);
+
+	// 90 fast, 10 slow
+	for (int i = 0; i < 90; ++i)
+		histogram->observe(0.5);
+	for (int i = 0; i < 10; ++i)
+		histogram->observe(6);
+	UASSERTEQ(uint64_t, histogram->getCount(), 100);
+	UASSERT(std::fabs(histogram->getSum() - 105) < 1e-9);
+
+	// Interpolated inside the bucket
+	UASSERT(histogram->getQuantile(0.45) > 0.4 && histogram->getQuantile(0.45) < 0.6);
+	UASSERT(histogram->getQuantile(0.5) <= 1);
+	UASSERT(histogram->getQuantile(0.99) > 4 && histogram->getQuantile(0.99) <= 8);
+
+	// Over the last bound: reported as the last bound
+	histogram->observe(100);
+	UASSERTEQ(double, histogram->getQuantile(1), 8);
+}
+
+void TestFmMetricHistogram::testThreads()
+{
+	MetricsBackend metrics;
+	auto histogram = metrics.addHistogram("test", "");
+	constexpr int THREADS = 8, PER_THREAD = 10000;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < THREADS; ++t)
+		threads.emplace_back([&] {
+			for (int i = 0; i < PER_THREAD; ++i)
+				histogram->observe(0.001);
+		});
+	for (auto &thread : threads)
+		thread.join();
+	UASSERTEQ(uint64_t, histogram->getCount(), THREADS * PER_THREAD);
+	UASSERT(std::fabs(histogram->getSum() - THREADS * PER_THREAD * 0.001) < 1e-6);
+}
+
+void TestFmMetricHistogram::testTimer()
+{
+	MetricsBackend metrics;
+	auto histogram = metrics.addHistogram("test", "");
+	{
+		MetricHistogramTimer timer(histogram);
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		timer.stop();
+		// stopped: once only
+	}
+	{
+		MetricHistogramTimer timer(nullptr);
+	}
+	UASSERTEQ(uint64_t, histogram->getCount(), 1);
+	UASSERT(histogram->getSum() >= 0.002 && histogram->getSum() < 1);
+}
@@ -0,0 +1,112 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "network/fm_packet_buffer.h"
+#include "network/networkpacket.h"
+
+class TestFmPacketBuffer : public TestBase
+{
+public:
+	TestFmPacketBuffer() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestFmPacketBuffer"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testPool();
+	void testRelease();
+	void testForge();
+};
+
+static TestFmPacketBuffer g_test_instance;
+
+void TestFmPacketBuffer::runTests(IGameDef *gamedef)
+{
+	TEST(testPool);
+	TEST(testRelease);
+	TEST(testForge);
+}
+
+void TestFmPacketBuffer::testPool()
+{
+	auto &pool = packet_buffer_pool::instance();
+	const u8 *data = nullptr;
+	{
+		auto buffer = packet_buffer::make(1000);
+		UASSERTEQ(size_t, buffer.size(), 1000);
+		memset(buffer.data(), 1, buffer.size());
+		data = buffer.data();
+
+		auto copy = buffer;
+		UASSERT(copy.data() == data);
+	}
+	// same size class, same memory
+	const auto allocations = pool.allocations();
+	auto buffer = packet_buffer::make(600);
+	UASSERT(buffer.data() == data);
+	UASSERTEQ(uint64_t, pool.allocations(), allocations);
+
+	// not pooled
+	auto big = packet_buffer::make(1 << 20);
+	UASSERTEQ(size_t, big.size(), 1 << 20);
+
+	UASSERT(!packet_buffer());
+	UASSERTEQ(size_t, packet_buffer().size(), 0);
+}
+
+void TestFmPacketBuffer::testRelease()
+{
+	auto buffer = packet_buffer::make(100);
+	auto *released = packet_buffer(buffer).release();
+
+	// released from other threads
+	std::vector<std::thread> threads;
+	std::vector<packet_buffer> copies(8, buffer);
+	for (auto &copy : copies)
+		threads.emplace_back([&copy] { copy = {}; });
+	threads.emplace_back([released] { packet_buffer::adopt(released); });
+	for (auto &thread : threads)
+		thread.join();
+
+	UASSERTEQ(size_t, buffer.size(), 100);
+}
+
+void TestFmPacketBuffer::testForge()
+{
+	NetworkPacket pkt(0x123, 0);
+	pkt << u32(0xdeadbeef);
+
+	const auto old = pkt.oldForgePacket();
+	const auto forged = pkt.forge();
+	UASSERTEQ(size_t, forged.size(), old.getSize());
+	UASSERT(!memcmp(forged.data(), *old, old.getSize()));
+
+	// made once
+	UASSERT(pkt.forge().data() == forged.data());
+
+	// changed packet, the shared buffer stays
+	pkt << u8(7);
+	UASSERTEQ(size_t, pkt.forge().size(), forged.size() + 1);
+	UASSERT(pkt.forge().data() != forged.data());
+	UASSERTEQ(int, forged.data()[2], 0xde);
+}
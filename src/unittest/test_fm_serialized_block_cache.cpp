@@ -0,0 +1,90 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include "server/fm_serialized_block_cache.h"
+
+class TestFmSerializedBlockCache : public TestBase
+{
+public:
+	TestFmSerializedBlockCache() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestFmSerializedBlockCache"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testVersions();
+	void testBudget();
+};
+
+static TestFmSerializedBlockCache g_test_instance;
+
+void TestFmSerializedBlockCache::runTests(IGameDef *gamedef)
+{
+	TEST(testVersions);
+	TEST(testBudget);
+}
+
+void TestFmSerializedBlockCache::testVersions()
+{
+	serialized_block_cache cache(1 << 20);
+	const serialized_block_cache::key key{{1, 2, 3}, 0, 29, false, false};
+
+	UASSERT(!cache.get(key, 1));
+	cache.put(key, 1, "v1");
+	UASSERT(cache.get(key, 1) && *cache.get(key, 1) == "v1");
+
+	// modified block
+	UASSERT(!cache.get(key, 2));
+	cache.put(key, 2, "v2");
+	UASSERT(!cache.get(key, 1));
+	UASSERT(*cache.get(key, 2) == "v2");
+	UASSERTEQ(size_t, cache.bytes(), 2);
+
+	// older version does not replace newer
+	cache.put(key, 1, "v1");
+	UASSERT(*cache.get(key, 2) == "v2");
+
+	// other step, serialization version, form and dictionary are other entries
+	UASSERT(!cache.get({{1, 2, 3}, 1, 29, false, false}, 2));
+	UASSERT(!cache.get({{1, 2, 3}, 0, 28, false, false}, 2));
+	UASSERT(!cache.get({{1, 2, 3}, 0, 29, true, false}, 2));
+	UASSERT(!cache.get({{1, 2, 3}, 0, 29, false, true}, 2));
+
+	cache.clear();
+	UASSERT(!cache.get(key, 2));
+	UASSERTEQ(size_t, cache.bytes(), 0);
+}
+
+void TestFmSerializedBlockCache::testBudget()
+{
+	// 16 shards of 1000 bytes
+	serialized_block_cache cache(16 * 1000);
+	for (bpos_t i = 0; i < 1000; ++i)
+		cache.put({{i, 0, 0}, 0, 29, false, false}, 1, std::string(100, 'x'));
+	UASSERT(cache.bytes() <= 16 * 1000);
+	UASSERT(cache.bytes() > 0);
+
+	// the most recent ones stay
+	UASSERT(cache.get({{999, 0, 0}, 0, 29, false, false}, 1));
+	UASSERT(!cache.get({{0, 0, 0}, 0, 29, false, false}, 1));
+
+	// too big for the cache, still returned
+	const auto big = cache.put({{0, 0, 0}, 0, 29, false, false}, 1, std::string(2000, 'x'));
+	UASSERT(big && big->size() == 2000);
+	UASSERT(!cache.get({{0, 0, 0}, 0, 29, false, false}, 1));
+}
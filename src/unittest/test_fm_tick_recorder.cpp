@@ -0,0 +1,131 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "fm_tick_recorder.h"
+
+class TestFmTickRecorder : public TestBase
+{
+public:
+	TestFmTickRecorder() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestFmTickRecorder"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testDisabled();
+	void testNested();
+	void testSteps();
+};
+
+static TestFmTickRecorder g_test_instance;
+
+void TestFmTickRecorder::runTests(IGameDef *gamedef)
+{
+	TEST(testDisabled);
+	TEST(testNested);
+	TEST(testSteps);
+	tick_recorder::instance().setSteps(0);
+}
+
+static size_t count(const std::string &s, const std::string &what)
+{
+	size_t n = 0;
+	for (auto pos = s.find(what); pos != std::string::npos; pos = s.find(what, pos + 1))
+		++n;
+	return n;
+}
+
+static std::string chrome()
+{
+	std::ostringstream os;
+	tick_recorder::instance().writeChromeTrace(os);
+	return os.str();
+}
+
+static void busy(int us)
+{
+	std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void TestFmTickRecorder::testDisabled()
+{
+	auto &recorder = tick_recorder::instance();
+	recorder.setSteps(0);
+	{
+		tick_recorder::scope s("test_disabled");
+	}
+	UASSERT(!recorder.enabled());
+	UASSERTEQ(size_t, count(chrome(), "test_disabled"), 0);
+}
+
+void TestFmTickRecorder::testNested()
+{
+	auto &recorder = tick_recorder::instance();
+	recorder.setSteps(10);
+	recorder.beginStep();
+	{
+		tick_recorder::scope outer("test_outer");
+		busy(1000);
+		{
+			tick_recorder::scope inner("test_inner \"q\"");
+			busy(2000);
+		}
+		tick_recorder::scope early("test_early");
+		early.stop();
+	}
+
+	const auto json = chrome();
+	UASSERTEQ(size_t, count(json, "\"test_outer\""), 1);
+	UASSERTEQ(size_t, count(json, "\"test_inner \\\"q\\\"\""), 1);
+	UASSERTEQ(size_t, count(json, "\"test_early\""), 1);
+
+	std::ostringstream os;
+	recorder.writeCollapsed(os);
+	const auto folded = os.str();
+	UASSERT(folded.find(";test_outer;test_inner \"q\" ") != std::string::npos);
+
+	// Self time of outer does not include the inner scope
+	const auto line = folded.find(";test_outer ");
+	UASSERT(line != std::string::npos);
+	const auto self_us = std::stoull(folded.substr(line + 12));
+	UASSERT(self_us >= 900 && self_us < 2000);
+}
+
+void TestFmTickRecorder::testSteps()
+{
+	auto &recorder = tick_recorder::instance();
+	recorder.setSteps(0);
+	recorder.setSteps(2);
+	for (int i = 0; i < 5; ++i) {
+		recorder.beginStep();
+		tick_recorder::scope s("test_step");
+	}
+	// Only the last steps are kept
+	UASSERTEQ(size_t, count(chrome(), "\"test_step\""), 2);
+
+	std::thread([] {
+		tick_recorder::scope s("test_thread");
+	}).join();
+	const auto json = chrome();
+	UASSERTEQ(size_t, count(json, "\"test_thread\""), 1);
+	UASSERT(count(json, "\"thread_name\"") >= 2);
+}
@@ -20,10 +20,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "test.h"
 
 #include <cstdio>
+#include <thread>
 #include <unordered_set>
 #include <unordered_map>
 #include "mapblock.h"
 #include "dummymap.h"
+#include "fm_cached_map_block.h"
 
 class TestMap : public TestBase
 {
@@ -37,6 +39,7 @@ class TestMap : public TestBase
 	void testForEachNodeInArea(IGameDef *gamedef);
 	void testForEachNodeInAreaBlank(IGameDef *gamedef);
 	void testForEachNodeInAreaEmpty(IGameDef *gamedef);
+	void testCachedMapBlock(IGameDef *gamedef);
 };
 
 static TestMap g_test_instance;
@@ -47,6 +50,7 @@ void TestMap::runTests(IGameDef *gamedef)
 	TEST(testForEachNodeInArea, gamedef);
 	TEST(testForEachNodeInAreaBlank, gamedef);
 	TEST(testForEachNodeInAreaEmpty, gamedef);
+	TEST(testCachedMapBlock, gamedef);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -170,3 +174,66 @@ void TestMap::testForEachNodeInAreaEmpty(IGameDef *gamedef)
 		return true;
 	});
 }
+
+void TestMap::testCachedMapBlock(IGameDef *gamedef)
+{
+	DummyMap map(gamedef, v3bpos_t(-2, -2, -2), v3bpos_t(2, 2, 2));
+
+	cached_map_block cache(&map, "Test");
+
+	// whole 3x3x3 neighbourhood stays cached
+	for (int pass = 0; pass < 2; ++pass)
+		for (bpos_t z = -1; z <= 1; ++z)
+		for (bpos_t y = -1; y <= 1; ++y)
+		for (bpos_t x = -1; x <= 1; ++x) {
+			MapBlock *block = cache.getBlock({x, y, z});
+			UASSERT(block);
+			UASSERT(block->getPos() == v3bpos_t(x, y, z));
+		}
+	UASSERTEQ(u32, cache.misses(), cached_map_block::WAYS);
+	UASSERTEQ(u32, cache.hits(), cached_map_block::WAYS);
+
+	// one more block evicts the least recently used one
+	UASSERT(cache.getBlock({2, 2, 2}));
+	UASSERT(cache.getBlock({1, 1, 1}));
+	UASSERT(cache.getBlock({-1, -1, -1}));
+	UASSERTEQ(u32, cache.misses(), cached_map_block::WAYS + 2);
+
+	// not loaded
+	UASSERT(!cache.getBlock({5, 5, 5}));
+	UASSERT(cache.getNode({100, 100, 100}).getContent() == CONTENT_IGNORE);
+
+	// nodes go to the right block, across block borders
+	const v3pos_t p1(MAP_BLOCKSIZE - 1, 0, 0), p2(MAP_BLOCKSIZE, 0, 0),
+			p3(-1, -1, -1);
+	cache.setNode(p1, MapNode(t_CONTENT_STONE));
+	cache.setNode(p2, MapNode(t_CONTENT_WATER));
+	cache.setNode(p3, MapNode(t_CONTENT_LAVA));
+	UASSERT(cache.getNode(p1).getContent() == t_CONTENT_STONE);
+	UASSERT(cache.getNode(p2).getContent() == t_CONTENT_WATER);
+	UASSERT(cache.getNode(p3).getContent() == t_CONTENT_LAVA);
+
+	// cached blocks are held locked
+	MapBlock *block = cache.getBlock(getNodeBlockPos(p1));
+	bool locked = false;
+	std::thread([&] { locked = block->try_lock_unique_rec()->owns_lock(); }).join();
+	UASSERT(!locked);
+	cache.clear();
+	std::thread([&] { locked = block->try_lock_unique_rec()->owns_lock(); }).join();
+	UASSERT(locked);
+	UASSERT(map.getNode(p1).getContent() == t_CONTENT_STONE);
+	UASSERT(map.getNode(p2).getContent() == t_CONTENT_WATER);
+
+	// a busy block is not waited for with try_lock
+	{
+		const auto lock = block->lock_unique_rec();
+		bool busy = false;
+		MapBlock *got = nullptr;
+		std::thread([&] {
+			cached_map_block other(&map, "Test");
+			got = other.getBlock(block->getPos(), true, &busy);
+		}).join();
+		UASSERT(!got);
+		UASSERT(busy);
+	}
+}
@@ -6,10 +6,13 @@
 
 #include "test.h"
 
+#include <algorithm>
 #include <functional>
+#include <map>
 #include <memory>
 #include <optional>
 #include "database/database-dummy.h"
+#include "database/database-snapshot.h"
 #include "database/database-sqlite3.h"
 #if USE_LEVELDB
 #include "database/database-leveldb.h"
@@ -72,6 +75,8 @@ class TestMapDatabase : public TestBase
 	void testLoad();
 	void testList(int expect);
 	void testRemove();
+	void testBatch();
+	void testSnapshot(const std::string &test_dir);
 	void testPositionEncoding();
 
 private:
@@ -92,6 +97,7 @@ void TestMapDatabase::runTests(IGameDef *gamedef)
 	sanity_check(!test_data.empty());
 
 	TEST(testPositionEncoding);
+	TEST(testSnapshot, test_dir);
 
 	rawstream << "-------- Dummy" << std::endl;
 
@@ -145,6 +151,7 @@ void TestMapDatabase::runTestsForCurrentDB()
 	TEST(testList, 1);
 	TEST(testRemove);
 	TEST(testList, 0);
+	TEST(testBatch);
 }
 
 void TestMapDatabase::testSave()
@@ -197,6 +204,70 @@ void TestMapDatabase::testRemove()
 	//UASSERT(!db->deleteBlock({1, 2, 4}));
 }
 
+void TestMapDatabase::testBatch()
+{
+	auto *db = provider->get();
+
+	// a column with a gap and one apart
+	const v3bpos_t saved[] = {{5, 1, 5}, {5, 2, 5}, {5, 4, 5}, {-7, 0, 3}};
+	std::vector<std::pair<v3bpos_t, std::string_view>> batch;
+	for (const auto &p : saved)
+		batch.emplace_back(p, test_data);
+	db->beginSave();
+	UASSERT(db->saveBlocks(batch));
+	db->endSave();
+
+	const v3bpos_t wanted[] = {{5, 4, 5}, {5, 1, 5}, {5, 3, 5}, {5, 2, 5},
+			{-7, 0, 3}, {0, 0, 0}};
+	std::map<v3bpos_t, std::string> loaded;
+	db->loadBlocks(wanted, [&](const v3bpos_t &pos, std::string &&block) {
+		UASSERT(loaded.emplace(pos, std::move(block)).second);
+	});
+	UASSERTEQ(size_t, loaded.size(), std::size(wanted));
+	for (const auto &p : saved)
+		UASSERT(loaded[p] == test_data);
+	UASSERT(loaded[v3bpos_t(5, 3, 5)].empty());
+	UASSERT(loaded[v3bpos_t(0, 0, 0)].empty());
+
+	for (const auto &p : saved)
+		UASSERT(db->deleteBlock(p));
+}
+
+void TestMapDatabase::testSnapshot(const std::string &test_dir)
+{
+	Database_Dummy source;
+	const v3bpos_t saved[] = {{0, 0, 0}, {1, 2, 3}, {-1, -2, -3}, {100, -5, 7}};
+	for (const auto &p : saved)
+		source.saveBlock(p, test_data + std::to_string(p.X));
+
+	UASSERT(Database_Snapshot::build(&source, test_dir));
+	Database_Snapshot db(test_dir);
+	UASSERTEQ(size_t, db.size(), std::size(saved));
+
+	std::string dest;
+	for (const auto &p : saved) {
+		db.loadBlock(p, &dest);
+		UASSERT(dest == test_data + std::to_string(p.X));
+	}
+	db.loadBlock({1, 2, 4}, &dest);
+	UASSERT(dest.empty());
+
+	size_t found = 0;
+	db.loadBlocks(saved, [&](const v3bpos_t &pos, std::string &&block) {
+		UASSERT(block == test_data + std::to_string(pos.X));
+		++found;
+	});
+	UASSERTEQ(size_t, found, std::size(saved));
+
+	std::vector<v3bpos_t> list;
+	db.listAllLoadableBlocks(list);
+	UASSERTEQ(size_t, list.size(), std::size(saved));
+	for (const auto &p : saved)
+		UASSERT(std::find(list.begin(), list.end(), p) != list.end());
+
+	UASSERT(!db.saveBlock({5, 5, 5}, test_data));
+}
+
 void TestMapDatabase::testPositionEncoding()
 {
 	auto db = std::make_unique<Database_Dummy>();
@@ -223,4 +294,26 @@ void TestMapDatabase::testPositionEncoding()
 	UASSERT(db->getIntegerAsBlock(0x7FF7FF7FF) == v3bpos_t(2047, 2047, 2047))
 	UASSERT(db->getIntegerAsBlock(-0x800800800) == v3bpos_t(-2048, -2048, -2048))
 	UASSERT(db->getIntegerAsBlock(-0x314e3807b) == v3bpos_t(-123, 456, -789))
+
+	// Morton keys round trip, and an aligned cube is one key range
+	const v3bpos_t morton_pp[] = {{0, 0, 0}, {1, 0, 0}, {-1, -1, -1},
+			{2047, -2048, 5}, {-123, 456, -789}};
+	v3bpos_t back;
+	for (const auto &p : morton_pp) {
+		UASSERT(db->getMortonKeyAsBlock(db->getBlockAsMortonKey(p), back))
+		UASSERT(back == p)
+	}
+	UASSERT(!db->getMortonKeyAsBlock(db->getBlockAsString({1, 2, 3}), back))
+	UASSERT(db->getBlockAsMortonKey({-1, 0, 0}) < db->getBlockAsMortonKey({0, 0, 0}))
+	std::vector<std::string> cube, outside;
+	for (bpos_t x = 4; x < 8; ++x)
+		for (bpos_t y = -4; y < 0; ++y)
+			for (bpos_t z = 8; z < 12; ++z)
+				cube.push_back(db->getBlockAsMortonKey({x, y, z}));
+	for (const auto &p : {v3bpos_t(3, -2, 9), v3bpos_t(8, -2, 9), v3bpos_t(5, 0, 9),
+			v3bpos_t(5, -5, 9), v3bpos_t(5, -2, 7), v3bpos_t(5, -2, 12)})
+		outside.push_back(db->getBlockAsMortonKey(p));
+	const auto [min, max] = std::minmax_element(cube.begin(), cube.end());
+	for (const auto &key : outside)
+		UASSERT(key < *min || key > *max)
 }
@@ -6,6 +6,13 @@
 
 #include <atomic>
 #include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "irr_v3d.h"
+#include "threading/coalescing_priority_queue.h"
+#include "threading/job_scheduler.h"
+#include "threading/mpmc_queue.h"
 #include "threading/semaphore.h"
 #include "threading/thread.h"
 
@@ -19,6 +26,9 @@ class TestThreading : public TestBase {
 	void testStartStopWait();
 	void testAtomicSemaphoreThread();
 	void testTLS();
+	void testJobScheduler();
+	void testMpmcQueue();
+	void testCoalescingPriorityQueue();
 };
 
 static TestThreading g_test_instance;
@@ -28,6 +38,9 @@ void TestThreading::runTests(IGameDef *gamedef)
 	TEST(testStartStopWait);
 	TEST(testAtomicSemaphoreThread);
 	TEST(testTLS);
+	TEST(testJobScheduler);
+	TEST(testMpmcQueue);
+	TEST(testCoalescingPriorityQueue);
 }
 
 class SimpleTestThread : public Thread {
@@ -227,3 +240,163 @@ void TestThreading::testTLS()
 		}
 	}
 }
+
+void TestThreading::testJobScheduler()
+{
+	job_scheduler jobs("TestJobs", 4);
+
+	// not running: tasks run inline
+	std::vector<job_scheduler::task_func> tasks;
+	std::atomic_int sum{0};
+	for (int i = 1; i <= 100; ++i)
+		tasks.emplace_back([&, i] { sum += i; });
+	jobs.run_tasks(tasks);
+	UASSERTEQ(int, sum, 5050);
+
+	std::atomic_int steps{0}, running{0}, overlapped{0}, nested_sum{0};
+	jobs.add({.name = "Test", .priority = 1}, [&](float, unsigned int) {
+		if (running++)
+			++overlapped;
+		// parallel tasks spawned from a job
+		std::vector<job_scheduler::task_func> nested;
+		for (int i = 0; i < 10; ++i)
+			nested.emplace_back([&] { ++nested_sum; });
+		jobs.run_tasks(nested);
+		--running;
+		++steps;
+		return 0u;
+	});
+	jobs.restart(jobs.getThreads());
+
+	sum = 0;
+	jobs.run_tasks(tasks);
+	UASSERTEQ(int, sum, 5050);
+
+	bool thrown = false;
+	std::vector<job_scheduler::task_func> failing(10, [] {});
+	failing[5] = [] { throw std::runtime_error("task"); };
+	try {
+		jobs.run_tasks(failing);
+	} catch (const std::runtime_error &) {
+		thrown = true;
+	}
+	UASSERT(thrown);
+
+	for (int i = 0; i < 1000 && steps < 10; ++i)
+		sleep_ms(10);
+	jobs.join();
+
+	UASSERT(steps >= 10);
+	UASSERTEQ(int, overlapped, 0);
+	UASSERTEQ(int, nested_sum, steps * 10);
+}
+
+void TestThreading::testMpmcQueue()
+{
+	// overflows the ring
+	mpmc_queue<int, 4> queue;
+	for (int i = 0; i < 10; ++i)
+		queue.push(i);
+	UASSERTEQ(size_t, queue.size(), 10);
+	int sum = 0;
+	for (int v; queue.try_pop(v);)
+		sum += v;
+	UASSERTEQ(int, sum, 45);
+	UASSERT(queue.empty());
+
+	mpmc_queue<int, 64> shared;
+	std::atomic_int popped{0}, popped_sum{0};
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&] {
+			for (int i = 1; i <= 1000; ++i)
+				shared.push(i);
+		});
+		threads.emplace_back([&] {
+			while (popped < 4000) {
+				int v;
+				if (shared.try_pop(v)) {
+					popped_sum += v;
+					++popped;
+				}
+			}
+		});
+	}
+	for (auto &thread : threads)
+		thread.join();
+	UASSERTEQ(int, popped_sum, 4 * 500500);
+}
+
+void TestThreading::testCoalescingPriorityQueue()
+{
+	coalescing_priority_queue<v3bpos_t, int *, 4> queue;
+	int items[4] = {};
+	int dropped = 0;
+	const auto drop = [&](int *) { ++dropped; };
+	const auto add = [&](v3bpos_t p, size_t bucket, int *item) {
+		return queue.add(p, bucket, [&] { return item; }, [](int *q) { ++*q; }, drop);
+	};
+
+	UASSERT(add({1, 0, 0}, 3, &items[0]));
+	UASSERT(add({2, 0, 0}, 1, &items[1]));
+	UASSERT(add({3, 0, 0}, 10, &items[2])); // last bucket
+	// merged into the queued item
+	UASSERT(!add({1, 0, 0}, 0, nullptr));
+	UASSERTEQ(int, items[0], 1);
+	UASSERTEQ(size_t, queue.size(), 3);
+
+	// nothing to queue
+	UASSERT(!queue.add({4, 0, 0}, 0, [] { return (int *)nullptr; }, [](int *) {}, drop));
+
+	// queued by someone else while the item was made: merged, the made one dropped
+	UASSERT(!queue.add({5, 0, 0}, 0,
+			[&] {
+				UASSERT(add({5, 0, 0}, 0, &items[3]));
+				return &items[2];
+			},
+			[](int *q) { ++*q; }, drop));
+	UASSERTEQ(int, items[3], 1);
+	UASSERTEQ(int, dropped, 1);
+
+	int *item = nullptr;
+	UASSERT(queue.pop(item));
+	UASSERT(item == &items[3]);
+	queue.done({5, 0, 0});
+	UASSERT(queue.pop(item));
+	UASSERT(item == &items[1]);
+
+	// re-added while in flight is parked until done()
+	UASSERT(add({2, 0, 0}, 0, &items[1]));
+	UASSERTEQ(size_t, queue.size(), 3);
+	UASSERT(queue.pop(item));
+	UASSERT(item == &items[0]);
+	queue.done({2, 0, 0});
+	UASSERT(queue.pop(item));
+	UASSERT(item == &items[1]);
+	queue.done({1, 0, 0});
+	queue.done({2, 0, 0});
+
+	// re-added after done is a new item
+	UASSERT(add({1, 0, 0}, 0, &items[0]));
+	queue.filter([&](int *q) { return q != &items[2]; });
+	UASSERTEQ(size_t, queue.size(), 1);
+	UASSERT(queue.pop(item));
+	UASSERT(item == &items[0]);
+	queue.done({1, 0, 0});
+	UASSERT(!queue.pop(item));
+	UASSERT(queue.empty());
+
+	// a merge can raise the item to a lower bucket
+	UASSERT(add({1, 0, 0}, 1, &items[0]));
+	UASSERT(add({2, 0, 0}, 3, &items[1]));
+	UASSERT(!queue.add({2, 0, 0}, 0, [] { return (int *)nullptr; }, [](int *) { return true; }, drop));
+	UASSERT(queue.pop(item));
+	UASSERT(item == &items[1]);
+	UASSERT(queue.pop(item));
+	UASSERT(item == &items[0]);
+	// the key left in the old bucket is skipped
+	UASSERT(!queue.pop(item));
+	UASSERT(queue.empty());
+	queue.done({1, 0, 0});
+	queue.done({2, 0, 0});
+}
@@ -4,8 +4,11 @@
 #pragma once
 
 #include <mutex>
+#include <shared_mutex>
 
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
 #include <cstdint>
 #include <unordered_map>
@@ -27,39 +30,39 @@ This lets you then split the indices sorted by the other axes,
 while preserving the sorted order.
 
 This however only gives us a static spatial index.
-To make it dynamic, we keep a "forest" of k-d-trees of sizes of successive powers of two.
-When we insert a new tree, we check whether there already is a k-d-tree of the same size.
-If this is the case, we merge with that tree, giving us a tree of twice the size,
-and so on, until we find a free size.
-
-This means our "forest" corresponds to a bit pattern,
-where a set bit means a non-empty tree.
-Inserting a point is equivalent to incrementing this bit pattern.
-
-To handle deletions, we simply mark the appropriate point as deleted using another bitset.
-When more than half the points have been deleted,
-we shrink the structure by removing all deleted points.
-This is equivalent to shifting down the "bit pattern" by one.
+To make it dynamic, we keep a "forest" of k-d-trees in size classes:
+the tree in slot i holds between 2^i and 2^(i+1)-1 points.
+Trees are laid out as implicit complete binary trees,
+so they can have any size, not just powers of two.
+
+New points first go into a small unsorted pool which is scanned linearly by queries.
+Once the pool is full, it is built into a tree in one batch and "planted":
+If the slot of its size class is taken, we merge with that tree,
+giving us a tree of the next size class, and so on, until we find a free slot.
+Updating a point that is still in the pool is done in place.
+
+To handle deletions, we simply mark the appropriate point as deleted ("tombstone").
+When at least half the points of a tree have been deleted,
+that tree alone is compacted: it is rebuilt from its live points
+and planted again in the (smaller) slot matching its new size.
 
 There are plenty variations that could be explored:
 
-* Keeping a small amount of points in a small pool to make updates faster -
-  avoid building and querying small k-d-trees.
-  This might be useful if the overhead for small sizes hurts performance.
 * Keeping fewer trees to make queries faster, at the expense of updates.
-* More eagerly removing entries marked as deleted (for example, on merge).
 * Replacing the array-backed structure with a structure of dynamically allocated nodes.
   This would make it possible to "let trees get out of shape".
-* Shrinking the structure currently sorts the live points by all axes,
+* Compacting a tree currently sorts the live points by all axes,
   not leveraging the existing presorting of the subsets.
-  Cleverly done filtering followed by sorted merges should enable linear time.
+  Cleverly done filtering should enable linear time.
 * A special ray proximity query could be implemented. This is tricky however.
 */
 
 namespace k_d_tree
 {
 
-using Idx = uint16_t;
+// 32 bit since trees may contain up to twice as many points (including tombstones)
+// as there are live ids, which would overflow 16 bit indices for u16 ids.
+using Idx = uint32_t;
 
 // We use size_t for sizes (but not for indices)
 // to make sure there are no wraparounds when we approach the limit.
@@ -147,12 +150,12 @@ class SortedIndices
 		Idx pivot;
 	};
 
-	//! Splits the sorted indices in the middle along the specified axis,
+	//! Splits the sorted indices after the first left_n indices along the specified axis,
 	//! partitioning them into left (<=), the pivot, and right (>=).
-	SplitResult split(uint8_t axis, std::vector<bool> &markers) const
+	SplitResult split(uint8_t axis, size_t left_n, std::vector<bool> &markers) const
 	{
+		assert(left_n < indices.size());
 		const auto begin = indices.begin(axis);
-		Idx left_n = indices.size() / 2;
 		const auto mid = begin + left_n;
 
 		// Mark all points to be partitioned left
@@ -274,6 +277,7 @@ class KdTree
 		, ids(nullptr)
 		, tree(nullptr)
 		, deleted()
+		, n_deleted(0)
 	{}
 
 	//! Build a tree containing just a single point
@@ -282,6 +286,7 @@ class KdTree
 		, ids(std::make_unique<Id[]>(1))
 		, tree(std::make_unique<Idx[]>(1))
 		, deleted(1)
+		, n_deleted(0)
 	{
 		tree[0] = 0;
 		ids[0] = id;
@@ -293,14 +298,17 @@ class KdTree
 		, ids(std::make_unique<Id[]>(n))
 		, tree(std::make_unique<Idx[]>(n))
 		, deleted(n)
+		, n_deleted(0)
 	{
 		std::copy(ids, ids + n, this->ids.get());
-		init(0, 0, items.indices);
+		if (n > 0)
+			init(0, 0, items.indices);
 	}
 
-	//! Merge two trees. Both trees are assumed to have a power of two size.
+	//! Merge two trees, keeping the points marked as deleted.
 	KdTree(const KdTree &a, const KdTree &b)
 		: items(a.items, b.items)
+		, n_deleted(a.n_deleted + b.n_deleted)
 	{
 		tree = std::make_unique<Idx[]>(cap());
 		ids = std::make_unique<Id[]>(cap());
@@ -325,6 +333,26 @@ class KdTree
 	{
 		assert(!deleted[internalIdx]);
 		deleted[internalIdx] = true;
+		++n_deleted;
+	}
+
+	//! Build a new tree from the points not marked as deleted
+	KdTree compacted() const
+	{
+		const size_t n = size();
+		const auto live_ids = std::make_unique<Id[]>(n);
+		Points<Dim, Component> live_points(n);
+		size_t i = 0;
+		foreach([&](Idx _, const Point &point, Id id) {
+			live_points.setPoint(static_cast<Idx>(i), point);
+			live_ids[i] = id;
+			++i;
+		});
+		assert(i == n);
+		std::array<Component const *, Dim> point_ptrs;
+		for (uint8_t d = 0; d < Dim; ++d)
+			point_ptrs[d] = live_points.begin(d);
+		return KdTree(n, live_ids.get(), point_ptrs);
 	}
 
 	template<class F>
@@ -340,11 +368,29 @@ class KdTree
 	//! Capacity, not size, since some items may be marked as deleted
 	size_t cap() const { return items.size(); }
 
+	//! Number of points not marked as deleted
+	size_t size() const { return cap() - n_deleted; }
+
+	size_t deletedCount() const { return n_deleted; }
+
 private:
-	void init(Idx root, uint8_t axis, const SortedIndices<Dim> &sorted)
+	//! Size of the left subtree of an implicit complete binary tree with n nodes,
+	//! such that the children 2i+1 and 2i+2 of any node i stay below n.
+	static size_t leftSize(size_t n)
+	{
+		if (n <= 1)
+			return 0;
+		const size_t height = std::bit_width(n) - 1;
+		const size_t half_level = size_t(1) << (height - 1);
+		const size_t last_level = n - ((size_t(1) << height) - 1);
+		return (half_level - 1) + std::min(last_level, half_level);
+	}
+
+	// Note: root is of type size_t to avoid issues with wraparound
+	void init(size_t root, uint8_t axis, const SortedIndices<Dim> &sorted)
 	{
 		// Temporarily abuse "deleted" marks as left/right marks
-		const auto split = sorted.split(axis, deleted);
+		const auto split = sorted.split(axis, leftSize(sorted.size()), deleted);
 		tree[root] = split.pivot;
 		const auto next_axis = (axis + 1) % Dim;
 		if (!split.left.empty())
@@ -386,6 +432,7 @@ class KdTree
 	std::unique_ptr<Id[]> ids;
 	std::unique_ptr<Idx[]> tree;
 	std::vector<bool> deleted;
+	size_t n_deleted;
 };
 
 template<uint8_t Dim, class Component, class Id>
@@ -393,145 +440,181 @@ class DynamicKdTrees
 {
 	using Tree = KdTree<Dim, Component, Id>;
 
+	static constexpr uint8_t IN_POOL = UINT8_MAX;
+	struct Entry {
+		//! Slot in trees, or IN_POOL
+		uint8_t tree_idx;
+		//! Index in the tree or in the pool
+		Idx in_tree;
+	};
+
 public:
 	using Point = typename Tree::Point;
 
-	void insert(const std::array<Component, Dim> &point, Id id)
+	//! Number of points collected in the pool before they are built into a tree
+	static constexpr size_t POOL_SIZE = 64;
+
+	//! Inserting an id which is already present moves it instead
+	void insert(const Point &point, Id id)
 	{
-		Tree tree(point, id);
-		const std::scoped_lock guard{mutex};
-		for (uint8_t tree_idx = 0;; ++tree_idx) {
-			if (tree_idx == trees.size()) {
-				trees.push_back(std::move(tree));
-				updateDelEntries(tree_idx);
-				break;
-			}
-			// Can we use a free slot to "plant" the tree?
-			if (trees[tree_idx].cap() == 0) {
-				trees[tree_idx] = std::move(tree);
-				updateDelEntries(tree_idx);
-				break;
-			}
-			tree = Tree(tree, trees[tree_idx]);
-			trees[tree_idx] = std::move(Tree());
-		}
-		++n_entries;
+		const std::unique_lock lock{mutex};
+		set(point, id);
 	}
 
+	//! Removing an unknown id is a no-op
 	void remove(Id id)
 	{
-		const std::scoped_lock guard{mutex};
-		const auto it = del_entries.find(id);
-		assert(it != del_entries.end());
-		trees.at(it->second.tree_idx).remove(it->second.in_tree);
-		del_entries.erase(it);
-		++deleted;
-		if (deleted >= (n_entries+1)/2) // "shift out" the last tree
-			shrink_to_half();
+		const std::unique_lock lock{mutex};
+		const auto it = entries.find(id);
+		if (it == entries.end())
+			return;
+		const auto entry = it->second;
+		entries.erase(it);
+		removeEntry(entry);
 	}
 
 	void update(const Point &newPos, Id id)
 	{
-		remove(id);
-		insert(newPos, id);
+		const std::unique_lock lock{mutex};
+		set(newPos, id);
 	}
 
 	template<typename F>
 	void rangeQuery(const Point &min, const Point &max,
 			const F &cb) const
 	{
-		std::vector<std::pair<std::array<Component, Dim>, Id>> resv;
+		// Collect results first: the callback may well modify this index
+		std::vector<std::pair<Point, Id>> resv;
 		{
 			const auto cbc = [&resv](const auto &p, const auto &id) {
 				resv.emplace_back(p, id);
 			};
-			const std::unique_lock lock{mutex, std::try_to_lock};
-			if (!lock.owns_lock()) {
-				return;
+			const std::shared_lock lock{mutex};
+			for (const auto &[point, id] : pool) {
+				if (isInside(point, min, max))
+					cbc(point, id);
 			}
 			for (const auto &tree : trees)
 				tree.rangeQuery(min, max, cbc);
 		}
 		for (const auto &res : resv)
 			cb(res.first, res.second);
-		return;
-
-		for (const auto &tree : trees)
-			tree.rangeQuery(min, max, cb);
 	}
 
 	size_t size() const
 	{
-		return n_entries - deleted;
+		const std::shared_lock lock{mutex};
+		return entries.size();
 	}
 
 private:
+	static bool isInside(const Point &point, const Point &min, const Point &max)
+	{
+		for (uint8_t d = 0; d < Dim; ++d)
+			if (point[d] < min[d] || point[d] > max[d])
+				return false;
+		return true;
+	}
 
-	void updateDelEntries(uint8_t tree_idx)
+	//! Slot of the tree with the given capacity
+	static size_t sizeClass(size_t cap)
 	{
-		trees[tree_idx].foreach([&](Idx in_tree_idx, auto _, Id id) {
-			del_entries[id] = {tree_idx, in_tree_idx};
-		});
+		assert(cap > 0);
+		return std::bit_width(cap) - 1;
 	}
 
-	// Shrink to half the size, equivalent to shifting down the "bit pattern".
-	void shrink_to_half()
+	void set(const Point &point, Id id)
 	{
-		assert(n_entries >= deleted);
-		assert(n_entries - deleted == (n_entries >> 1));
-		n_entries -= deleted;
-		deleted = 0;
-		// Reset map, freeing memory (instead of clearing)
-		del_entries = std::unordered_map<Id, DelEntry>();
+		const auto it = entries.find(id);
+		if (it != entries.end()) {
+			if (it->second.tree_idx == IN_POOL) {
+				pool[it->second.in_tree].first = point;
+				return;
+			}
+			const auto entry = it->second;
+			entries.erase(it);
+			removeEntry(entry);
+		}
+		entries[id] = {IN_POOL, static_cast<Idx>(pool.size())};
+		pool.emplace_back(point, id);
+		if (pool.size() >= POOL_SIZE)
+			flushPool();
+	}
 
-		// Collect all live points and corresponding IDs.
-		const auto live_ids = std::make_unique<Id[]>(n_entries);
-		Points<Dim, Component> live_points(n_entries);
-		size_t i = 0;
-		for (const auto &tree : trees) {
-			tree.foreach([&](Idx _, auto point, Id id) {
-				assert(i < n_entries);
-				live_points.setPoint(static_cast<Idx>(i), point);
-				live_ids[i] = id;
-				++i;
-			});
+	void removeEntry(const Entry &entry)
+	{
+		if (entry.tree_idx == IN_POOL) {
+			if (entry.in_tree + 1 != pool.size()) {
+				pool[entry.in_tree] = pool.back();
+				entries[pool[entry.in_tree].second].in_tree = entry.in_tree;
+			}
+			pool.pop_back();
+			return;
 		}
-		assert(i == n_entries);
+		auto &tree = trees.at(entry.tree_idx);
+		tree.remove(entry.in_tree);
+		if (2 * tree.deletedCount() >= tree.cap())
+			compact(entry.tree_idx);
+	}
 
-		// Construct a new forest.
-		// The "tree pattern" will effectively just be shifted down by one.
-		auto id_ptr = live_ids.get();
+	//! Build the pool into a tree in one batch
+	void flushPool()
+	{
+		const size_t n = pool.size();
+		const auto pool_ids = std::make_unique<Id[]>(n);
+		Points<Dim, Component> pool_points(n);
+		for (size_t i = 0; i < n; ++i) {
+			pool_points.setPoint(static_cast<Idx>(i), pool[i].first);
+			pool_ids[i] = pool[i].second;
+		}
 		std::array<Component const *, Dim> point_ptrs;
-		size_t n = 1;
 		for (uint8_t d = 0; d < Dim; ++d)
-			point_ptrs[d] = live_points.begin(d);
-		for (uint8_t tree_idx = 0; tree_idx < trees.size() - 1; ++tree_idx, n *= 2) {
-			Tree tree;
-			// If there was a tree at the next position, there should be
-			// a tree at this position after shifting the pattern.
-			if (trees[tree_idx+1].cap() > 0) {
-				tree = std::move(Tree(n, id_ptr, point_ptrs));
-				id_ptr += n;
-				for (uint8_t d = 0; d < Dim; ++d)
-					point_ptrs[d] += n;
-			}
-			trees[tree_idx] = std::move(tree);
-			updateDelEntries(tree_idx);
+			point_ptrs[d] = pool_points.begin(d);
+		pool.clear();
+		plant(Tree(n, pool_ids.get(), point_ptrs));
+	}
+
+	//! Rebuild a tree of which at least half the points are tombstones
+	void compact(size_t tree_idx)
+	{
+		Tree tree = trees[tree_idx].compacted();
+		trees[tree_idx] = Tree();
+		if (tree.cap() > 0)
+			plant(std::move(tree));
+		while (!trees.empty() && trees.back().cap() == 0)
+			trees.pop_back();
+	}
+
+	//! Put a tree into the slot of its size class, merging with occupants
+	void plant(Tree tree)
+	{
+		size_t tree_idx = sizeClass(tree.cap());
+		while (tree_idx < trees.size() && trees[tree_idx].cap() > 0) {
+			tree = Tree(tree, trees[tree_idx]);
+			trees[tree_idx] = Tree();
+			tree_idx = sizeClass(tree.cap());
 		}
-		trees.pop_back(); // "shift out" tree with the most elements
+		if (tree_idx >= trees.size())
+			trees.resize(tree_idx + 1);
+		trees[tree_idx] = std::move(tree);
+		updateEntries(tree_idx);
+	}
+
+	void updateEntries(size_t tree_idx)
+	{
+		trees[tree_idx].foreach([&](Idx in_tree_idx, auto _, Id id) {
+			entries[id] = {static_cast<uint8_t>(tree_idx), in_tree_idx};
+		});
 	}
+
 	// This could even use an array instead of a vector,
 	// since the number of trees is guaranteed to be logarithmic in the max of Idx
 	std::vector<Tree> trees;
-	struct DelEntry {
-		uint8_t tree_idx;
-		Idx in_tree;
-	};
-	std::unordered_map<Id, DelEntry> del_entries;
-	size_t n_entries = 0;
-	size_t deleted = 0;
+	std::vector<std::pair<Point, Id>> pool;
+
+	std::unordered_map<Id, Entry> entries;
 
-	mutable std::mutex mutex;
+	mutable std::shared_mutex mutex;
 };
 
 } // end namespace k_d_tree
\ No newline at end of file
@@ -0,0 +1,54 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Whole file mapped read-only, pages are shared with other processes mapping
+// the same file through the page cache
+class mapped_file
+{
+public:
+	mapped_file() = default;
+	~mapped_file() { close(); }
+
+	mapped_file(const mapped_file &) = delete;
+	mapped_file &operator=(const mapped_file &) = delete;
+
+	/// @return false if the file can't be opened or mapped
+	bool open(const std::string &path);
+	void close();
+
+	bool isOpen() const { return m_data; }
+	const uint8_t *data() const { return m_data; }
+	size_t size() const { return m_size; }
+	std::string_view view(size_t offset, size_t size) const
+	{
+		return {reinterpret_cast<const char *>(m_data) + offset, size};
+	}
+
+private:
+	const uint8_t *m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void *m_mapping = nullptr;
+#endif
+};
@@ -3,9 +3,17 @@
 // Copyright (C) 2013-2020 Minetest core developers team
 
 #include "metricsbackend.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include "porting.h"
 #include "util/thread.h"
 #if USE_PROMETHEUS
+#include <limits>
+#include <prometheus/collectable.h>
 #include <prometheus/exposer.h>
+#include <prometheus/metric_family.h>
 #include <prometheus/registry.h>
 #include <prometheus/counter.h>
 #include <prometheus/gauge.h>
@@ -72,6 +80,127 @@ class SimpleMetricGauge : public MetricGauge
 	double m_gauge;
 };
 
+/*
+	Histogram with lock-free buckets. Every thread writes into its own shard
+	(threads are spread over SHARDS), shards are summed when read.
+*/
+class SimpleMetricHistogram : public MetricHistogram
+{
+public:
+	SimpleMetricHistogram(const std::vector<double> &buckets) : m_bounds(buckets)
+	{
+		std::sort(m_bounds.begin(), m_bounds.end());
+		for (auto &shard : m_shards)
+			shard.counts = std::make_unique<std::atomic<uint64_t>[]>(m_bounds.size() + 1);
+	}
+
+	virtual ~SimpleMetricHistogram() {}
+
+	void observe(double value) override
+	{
+		const size_t bucket =
+				std::lower_bound(m_bounds.begin(), m_bounds.end(), value) - m_bounds.begin();
+		auto &shard = m_shards[shardIndex()];
+		shard.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+		auto sum = shard.sum.load(std::memory_order_relaxed);
+		while (!shard.sum.compare_exchange_weak(
+				sum, sum + value, std::memory_order_relaxed))
+			;
+	}
+
+	uint64_t getCount() const override
+	{
+		uint64_t count = 0;
+		for (const auto c : getBucketCounts())
+			count += c;
+		return count;
+	}
+
+	double getSum() const override
+	{
+		double sum = 0;
+		for (const auto &shard : m_shards)
+			sum += shard.sum.load(std::memory_order_relaxed);
+		return sum;
+	}
+
+	double getQuantile(double q) const override
+	{
+		const auto counts = getBucketCounts();
+		uint64_t total = 0;
+		for (const auto c : counts)
+			total += c;
+		if (!total || m_bounds.empty())
+			return 0;
+		const double rank = std::clamp(q, 0.0, 1.0) * total;
+		uint64_t cumulative = 0;
+		for (size_t i = 0; i < counts.size(); ++i) {
+			if (cumulative + counts[i] < rank || !counts[i]) {
+				cumulative += counts[i];
+				continue;
+			}
+			// +Inf bucket: the highest known bound
+			if (i == m_bounds.size())
+				return m_bounds.back();
+			const double lower = i ? m_bounds[i - 1] : std::min(0.0, m_bounds[0]);
+			return lower + (m_bounds[i] - lower) * (rank - cumulative) / counts[i];
+		}
+		return m_bounds.back();
+	}
+
+	// Not cumulative, last one is +Inf
+	std::vector<uint64_t> getBucketCounts() const
+	{
+		std::vector<uint64_t> counts(m_bounds.size() + 1);
+		for (const auto &shard : m_shards)
+			for (size_t i = 0; i < counts.size(); ++i)
+				counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+		return counts;
+	}
+
+	const std::vector<double> &getBounds() const { return m_bounds; }
+
+private:
+	static constexpr size_t SHARDS = 16;
+
+	static size_t shardIndex()
+	{
+		static std::atomic_size_t next{0};
+		thread_local const size_t index = next++ % SHARDS;
+		return index;
+	}
+
+	struct alignas(64) Shard
+	{
+		std::unique_ptr<std::atomic<uint64_t>[]> counts;
+		std::atomic<double> sum{0};
+	};
+
+	std::vector<double> m_bounds;
+	std::array<Shard, SHARDS> m_shards;
+};
+
+std::vector<double> MetricHistogram::latencyBuckets()
+{
+	std::vector<double> buckets;
+	for (double bound = 0.00005; bound < 15; bound *= 2)
+		buckets.emplace_back(bound);
+	return buckets;
+}
+
+MetricHistogramTimer::MetricHistogramTimer(MetricHistogram *histogram) :
+		m_histogram(histogram), m_start_us(histogram ? porting::getTimeUs() : 0)
+{
+}
+
+void MetricHistogramTimer::stop()
+{
+	if (!m_histogram)
+		return;
+	m_histogram->observe((porting::getTimeUs() - m_start_us) / 1e6);
+	m_histogram = nullptr;
+}
+
 MetricCounterPtr MetricsBackend::addCounter(
 		const std::string &name, const std::string &help_str, Labels labels)
 {
@@ -84,6 +213,12 @@ MetricGaugePtr MetricsBackend::addGauge(
 	return std::make_shared<SimpleMetricGauge>();
 }
 
+MetricHistogramPtr MetricsBackend::addHistogram(const std::string &name,
+		const std::string &help_str, const std::vector<double> &buckets, Labels labels)
+{
+	return std::make_shared<SimpleMetricHistogram>(buckets);
+}
+
 /* Prometheus backend */
 
 #if USE_PROMETHEUS
@@ -144,14 +279,79 @@ class PrometheusMetricGauge : public MetricGauge
 	prometheus::Gauge &m_gauge;
 };
 
+/*
+	prometheus::Histogram locks on every Observe, so the histograms are kept
+	as SimpleMetricHistogram and converted when scraped.
+*/
+class PrometheusHistogramCollectable : public prometheus::Collectable
+{
+public:
+	void add(const std::string &name, const std::string &help_str,
+			MetricsBackend::Labels labels,
+			std::shared_ptr<SimpleMetricHistogram> histogram)
+	{
+		MutexAutoLock lock(m_mutex);
+		m_histograms.push_back({name, help_str, {labels.begin(), labels.end()},
+				std::move(histogram)});
+	}
+
+	std::vector<prometheus::MetricFamily> Collect() const override
+	{
+		MutexAutoLock lock(m_mutex);
+		std::vector<prometheus::MetricFamily> families;
+		for (const auto &h : m_histograms) {
+			auto it = std::find_if(families.begin(), families.end(),
+					[&](const auto &f) { return f.name == h.name; });
+			if (it == families.end()) {
+				families.emplace_back();
+				it = std::prev(families.end());
+				it->name = h.name;
+				it->help = h.help;
+				it->type = prometheus::MetricType::Histogram;
+			}
+			prometheus::ClientMetric metric;
+			for (const auto &[label, value] : h.labels)
+				metric.label.push_back({label, value});
+			const auto counts = h.histogram->getBucketCounts();
+			const auto &bounds = h.histogram->getBounds();
+			uint64_t cumulative = 0;
+			for (size_t i = 0; i < counts.size(); ++i) {
+				cumulative += counts[i];
+				prometheus::ClientMetric::Bucket bucket;
+				bucket.cumulative_count = cumulative;
+				bucket.upper_bound = i < bounds.size()
+						? bounds[i] : std::numeric_limits<double>::infinity();
+				metric.histogram.bucket.push_back(bucket);
+			}
+			metric.histogram.sample_count = cumulative;
+			metric.histogram.sample_sum = h.histogram->getSum();
+			it->metric.push_back(std::move(metric));
+		}
+		return families;
+	}
+
+private:
+	struct Entry
+	{
+		std::string name, help;
+		std::vector<std::pair<std::string, std::string>> labels;
+		std::shared_ptr<SimpleMetricHistogram> histogram;
+	};
+
+	mutable std::mutex m_mutex;
+	std::vector<Entry> m_histograms;
+};
+
 class PrometheusMetricsBackend : public MetricsBackend
 {
 public:
 	PrometheusMetricsBackend(const std::string &addr) :
 			MetricsBackend(), m_exposer(std::make_unique<prometheus::Exposer>(addr)),
-			m_registry(std::make_shared<prometheus::Registry>())
+			m_registry(std::make_shared<prometheus::Registry>()),
+			m_histograms(std::make_shared<PrometheusHistogramCollectable>())
 	{
 		m_exposer->RegisterCollectable(m_registry);
+		m_exposer->RegisterCollectable(m_histograms);
 	}
 
 	virtual ~PrometheusMetricsBackend() {}
@@ -162,10 +362,15 @@ class PrometheusMetricsBackend : public MetricsBackend
 	MetricGaugePtr addGauge(
 			const std::string &name, const std::string &help_str,
 			Labels labels = {}) override;
+	MetricHistogramPtr addHistogram(
+			const std::string &name, const std::string &help_str,
+			const std::vector<double> &buckets = MetricHistogram::latencyBuckets(),
+			Labels labels = {}) override;
 
 private:
 	std::unique_ptr<prometheus::Exposer> m_exposer;
 	std::shared_ptr<prometheus::Registry> m_registry;
+	std::shared_ptr<PrometheusHistogramCollectable> m_histograms;
 };
 
 MetricCounterPtr PrometheusMetricsBackend::addCounter(
@@ -180,6 +385,14 @@ MetricGaugePtr PrometheusMetricsBackend::addGauge(
 	return std::make_shared<PrometheusMetricGauge>(name, help_str, labels, m_registry);
 }
 
+MetricHistogramPtr PrometheusMetricsBackend::addHistogram(const std::string &name,
+		const std::string &help_str, const std::vector<double> &buckets, Labels labels)
+{
+	auto histogram = std::make_shared<SimpleMetricHistogram>(buckets);
+	m_histograms->add(name, help_str, labels, histogram);
+	return histogram;
+}
+
 MetricsBackend *createPrometheusMetricsBackend()
 {
 	std::string addr;
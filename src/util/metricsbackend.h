@@ -3,9 +3,11 @@
 // Copyright (C) 2013-2020 Minetest core developers team
 
 #pragma once
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 #include "config.h"
 
 class MetricCounter
@@ -35,6 +37,46 @@ class MetricGauge
 
 typedef std::shared_ptr<MetricGauge> MetricGaugePtr;
 
+class MetricHistogram
+{
+public:
+	MetricHistogram() = default;
+	virtual ~MetricHistogram() {}
+
+	// Safe to call from any thread, does not lock
+	virtual void observe(double value) = 0;
+	virtual uint64_t getCount() const = 0;
+	virtual double getSum() const = 0;
+	// Estimated from the buckets like histogram_quantile(), q in [0, 1]
+	virtual double getQuantile(double q) const = 0;
+
+	// 50us .. ~13s, for durations in seconds
+	static std::vector<double> latencyBuckets();
+};
+
+typedef std::shared_ptr<MetricHistogram> MetricHistogramPtr;
+
+// Observes the lifetime of the scope in seconds
+class MetricHistogramTimer
+{
+public:
+	MetricHistogramTimer(MetricHistogram *histogram);
+	MetricHistogramTimer(const MetricHistogramPtr &histogram) :
+			MetricHistogramTimer(histogram.get())
+	{
+	}
+	~MetricHistogramTimer() { stop(); }
+
+	void stop();
+
+	MetricHistogramTimer(const MetricHistogramTimer &) = delete;
+	MetricHistogramTimer &operator=(const MetricHistogramTimer &) = delete;
+
+private:
+	MetricHistogram *m_histogram;
+	uint64_t m_start_us;
+};
+
 class MetricsBackend
 {
 public:
@@ -50,6 +92,11 @@ class MetricsBackend
 	virtual MetricGaugePtr addGauge(
 			const std::string &name, const std::string &help_str,
 			Labels labels = {});
+	// buckets are the sorted upper bounds, +Inf is implied
+	virtual MetricHistogramPtr addHistogram(
+			const std::string &name, const std::string &help_str,
+			const std::vector<double> &buckets = MetricHistogram::latencyBuckets(),
+			Labels labels = {});
 };
 
 #if USE_PROMETHEUS
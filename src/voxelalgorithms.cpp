@@ -8,6 +8,7 @@
 #include "nodedef.h"
 #include "mapblock.h"
 #include "map.h"
+#include "fm_cached_map_block.h"
 
 namespace voxalgo
 {
@@ -252,6 +253,7 @@ void unspread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
 	relative_v3 neighbor_rel_pos;
 	// Direction of the brightest neighbor of the node
 	direction source_dir;
+	cached_map_block blocks(map, "Light");
 	while (from_nodes.next(current_light, current)) {
 		// For all nodes that need unlighting
 
@@ -274,20 +276,21 @@ void unspread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
 			// Get the neighbor's position and block
 			neighbor_rel_pos = current.rel_position;
 			neighbor_block_pos = current.block_position;
-			MapBlock *neighbor_block;
+			MapBlock *neighbor_block = current.block;
+			std::unique_ptr<MapBlock::lock_rec_unique> lock;
 			if (step_rel_block_pos(i, neighbor_rel_pos, neighbor_block_pos)) {
-				neighbor_block = map->getBlockNoCreateNoEx(neighbor_block_pos);
+				bool busy = false;
+				neighbor_block = blocks.getBlock(neighbor_block_pos, true, &busy);
 				if (neighbor_block == NULL) {
-					current.block->setLightingComplete(bank, i, false);
-					continue;
+					if (!busy)
+						current.block->setLightingComplete(bank, i, false);
+					continue; // busy may cause dark areas
 				}
 			} else {
-				neighbor_block = current.block;
-			}
-
-			const auto lock = neighbor_block->try_lock_unique_rec();
-			if (!lock->owns_lock()) {
-				continue; // may cause dark areas
+				lock = neighbor_block->try_lock_unique_rec();
+				if (!lock->owns_lock()) {
+					continue; // may cause dark areas
+				}
 			}
 
 			// Get the neighbor itself
@@ -357,6 +360,7 @@ void spread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
 	// Position of the current neighbor.
 	mapblock_v3 neighbor_block_pos;
 	relative_v3 neighbor_rel_pos;
+	cached_map_block blocks(map, "Light");
 	while (light_sources.next(spreading_light, current)) {
 		spreading_light--;
 		for (direction i = 0; i < 6; i++) {
@@ -367,20 +371,21 @@ void spread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
 			// Get the neighbor's position and block
 			neighbor_rel_pos = current.rel_position;
 			neighbor_block_pos = current.block_position;
-			MapBlock *neighbor_block;
+			MapBlock *neighbor_block = current.block;
+			std::unique_ptr<MapBlock::lock_rec_unique> lock;
 			if (step_rel_block_pos(i, neighbor_rel_pos, neighbor_block_pos)) {
-				neighbor_block = map->getBlockNoCreateNoEx(neighbor_block_pos);
+				bool busy = false;
+				neighbor_block = blocks.getBlock(neighbor_block_pos, true, &busy);
 				if (neighbor_block == NULL) {
-					current.block->setLightingComplete(bank, i, false);
-					continue;
+					if (!busy)
+						current.block->setLightingComplete(bank, i, false);
+					continue; // busy may cause dark areas
 				}
 			} else {
-				neighbor_block = current.block;
-			}
-
-			const auto lock = neighbor_block->try_lock_unique_rec();
-			if (!lock->owns_lock()) {
-				continue; // may cause dark areas
+				lock = neighbor_block->try_lock_unique_rec();
+				if (!lock->owns_lock()) {
+					continue; // may cause dark areas
+				}
 			}
 
 			// Get the neighbor itself